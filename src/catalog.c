@@ -0,0 +1,1093 @@
+/*
+   -	catalog.c --
+   -		Persistent catalog of netCDF headers
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "alloc.h"
+#include "catalog.h"
+
+/* Initial number of buckets for paths in a catalog */
+#define CAT_BUCKETS 4096
+
+/* Postings for one variable name, while building an index */
+struct Cat_Post {
+    const char *nm;			/* Variable name, in mapped catalog */
+    uint32_t *v;			/* Live record numbers */
+    size_t n, sz;			/* Number of postings, allocation */
+};
+
+static int add_ent(struct Cat *, const char *, const struct Cat_Rec_Hdr *,
+	uint64_t);
+static int compact(struct Cat *);
+static void skip_idx(struct Cat *);
+static int write_idx(struct Cat *);
+static uint64_t idx_size(const struct Cat_Idx_Hdr *);
+static uint64_t last_idx(const struct Cat_Map *);
+static int buf_put(struct Cat_Buf *, const void *, size_t);
+static int post_cmp(const void *, const void *);
+static int rd_at(int, void *, size_t, uint64_t);
+static int wr_at(int, const void *, size_t, uint64_t);
+
+/*
+   Open catalog file nm for update, creating it if necessary, and load its
+   live records. The catalog keeps the n_att_nms attributes named in
+   att_nms, att_nms_len bytes of nul terminated names. If att_nms is NULL,
+   keep the attributes the catalog already has. If the names differ from
+   those in the catalog, all records become dead, since they lack the new
+   attributes, and Cat_Finish rewrites the file. Only one process may update
+   a catalog at a time. Return 1 on success. On failure, print a message to
+   stderr and return 0.
+ */
+int Cat_Open(struct Cat *cat, const char *nm, const char *att_nms,
+	uint32_t n_att_nms, uint32_t att_nms_len)
+{
+    struct stat sb;			/* Status of catalog file */
+    struct Cat_Hdr hdr;			/* Catalog header */
+    struct Cat_Foot foot;		/* Catalog footer */
+    struct Cat_Rec_Hdr rh;		/* Record header */
+    struct Cat_Idx_Hdr ih;		/* Header of an old index */
+    char *path = NULL;			/* Path from a record */
+    uint64_t lim;			/* End of records, or of file */
+    uint64_t off;			/* Offset of record */
+    uint64_t len;			/* Size of record or old index */
+    size_t i;
+
+    memset(cat, 0, sizeof(struct Cat));
+    cat->fd = -1;
+    if ( !(cat->nm = MALLOC(strlen(nm) + 1))
+	    || !Hash_Init(&cat->paths, CAT_BUCKETS) ) {
+	fprintf(stderr, "Could not allocate catalog.\n");
+	FREE(cat->nm);
+	return 0;
+    }
+    strcpy(cat->nm, nm);
+    if ( (cat->fd = open(nm, O_RDWR | O_CREAT, 0666)) == -1
+	    || fstat(cat->fd, &sb) == -1 ) {
+	fprintf(stderr, "Could not open catalog %s.\n%s\n",
+		nm, strerror(errno));
+	goto error;
+    }
+    if ( lockf(cat->fd, F_TLOCK, 0) == -1 ) {
+	fprintf(stderr, "Could not lock catalog %s. Another process may be "
+		"updating it.\n%s\n", nm, strerror(errno));
+	goto error;
+    }
+
+    /* New catalog. Cat_Finish writes the header. */
+    if ( sb.st_size == 0 ) {
+	if ( !att_nms ) {
+	    att_nms = "";
+	    n_att_nms = att_nms_len = 0;
+	}
+	if ( !(cat->att_nms = MALLOC(att_nms_len + 1)) ) {
+	    fprintf(stderr, "Could not allocate attribute names.\n");
+	    goto error;
+	}
+	memcpy(cat->att_nms, att_nms, att_nms_len);
+	cat->n_att_nms = n_att_nms;
+	cat->att_nms_len = att_nms_len;
+	cat->data_off = cat->end = cat->tail = 0;
+	cat->rewrite = 1;
+	return 1;
+    }
+
+    if ( !rd_at(cat->fd, &hdr, sizeof(hdr), 0)
+	    || strcmp(hdr.magic, CAT_MAGIC) != 0
+	    || hdr.data_off < sizeof(hdr) + hdr.att_nms_len
+	    || hdr.data_off > (uint64_t)sb.st_size ) {
+	fprintf(stderr, "%s is not a catalog.\n", nm);
+	goto error;
+    }
+    if ( !(cat->att_nms = MALLOC(hdr.att_nms_len + 1))
+	    || !rd_at(cat->fd, cat->att_nms, hdr.att_nms_len, sizeof(hdr)) ) {
+	fprintf(stderr, "Could not read attribute names from catalog %s.\n",
+		nm);
+	goto error;
+    }
+    cat->n_att_nms = hdr.n_att_nms;
+    cat->att_nms_len = hdr.att_nms_len;
+    cat->data_off = hdr.data_off;
+
+    /*
+       Records end at the current index. Indeces from earlier updates lie
+       between records. If there is no valid footer, an update stopped
+       before finishing, so keep the records that are complete.
+     */
+
+    lim = sb.st_size;
+    if ( lim >= cat->data_off + sizeof(foot)
+	    && rd_at(cat->fd, &foot, sizeof(foot), lim - sizeof(foot))
+	    && memcmp(foot.magic, CAT_FOOT_MAGIC, sizeof(foot.magic)) == 0
+	    && foot.idx_off >= cat->data_off && foot.idx_off <= lim ) {
+	lim = foot.idx_off;
+    }
+    for (off = cat->data_off; off + sizeof(rh) <= lim; off += len) {
+	if ( !rd_at(cat->fd, &rh, sizeof(rh), off) ) {
+	    break;
+	}
+	if ( memcmp(&rh, CAT_IDX_MAGIC, sizeof(ih.magic)) == 0 ) {
+	    if ( !rd_at(cat->fd, &ih, sizeof(ih), off)
+		    || (len = idx_size(&ih)) > lim - off ) {
+		break;
+	    }
+	    cat->dead += len;
+	    continue;
+	}
+	len = rh.rec_len;
+	if ( len < sizeof(rh) + rh.path_len + 1
+		|| len % 8 != 0 || off + len > lim ) {
+	    break;
+	}
+	if ( !rh.live ) {
+	    cat->dead += len;
+	    continue;
+	}
+	if ( !(path = REALLOC(path, rh.path_len + 1))
+		|| !rd_at(cat->fd, path, rh.path_len + 1, off + sizeof(rh)) ) {
+	    fprintf(stderr, "Could not read record at %llu in catalog %s.\n",
+		    (unsigned long long)off, nm);
+	    goto error;
+	}
+	path[rh.path_len] = '\0';
+	if ( !add_ent(cat, path, &rh, off) ) {
+	    goto error;
+	}
+    }
+    FREE(path);
+    path = NULL;
+
+    /*
+       If records end cleanly at a valid index, keep the index for readers
+       until a new one follows it. Otherwise, new records overwrite what is
+       left of an update that did not finish.
+     */
+
+    cat->end = off;
+    cat->tail = (off == lim && lim < (uint64_t)sb.st_size) ? sb.st_size : off;
+
+    /* Attribute list changed. Start over. */
+    if ( att_nms && (att_nms_len != cat->att_nms_len
+		|| memcmp(att_nms, cat->att_nms, att_nms_len) != 0) ) {
+	for (i = 0; i < cat->n_ents; i++) {
+	    Cat_Kill(cat, cat->ents[i]);
+	}
+	FREE(cat->att_nms);
+	if ( !(cat->att_nms = MALLOC(att_nms_len + 1)) ) {
+	    fprintf(stderr, "Could not allocate attribute names.\n");
+	    goto error;
+	}
+	memcpy(cat->att_nms, att_nms, att_nms_len);
+	cat->n_att_nms = n_att_nms;
+	cat->att_nms_len = att_nms_len;
+	cat->rewrite = 1;
+    }
+    return 1;
+
+error:
+    FREE(path);
+    Cat_Close(cat);
+    return 0;
+}
+
+/*
+   Return the live entry for path in catalog cat, or NULL if there is none.
+ */
+struct Cat_Ent *Cat_Find(struct Cat *cat, const char *path)
+{
+    return Hash_Get(&cat->paths, path);
+}
+
+/*
+   Mark entry ent of catalog cat dead, because its file has changed or
+   disappeared. Return 1 on success. On failure, print a message to stderr
+   and return 0.
+ */
+int Cat_Kill(struct Cat *cat, struct Cat_Ent *ent)
+{
+    uint32_t live = 0;
+
+    if ( !ent->live ) {
+	return 1;
+    }
+    ent->live = 0;
+    cat->dead += ent->len;
+    cat->dirty = 1;
+    Hash_Rm(&cat->paths, ent->path);
+    if ( !cat->rewrite && !wr_at(cat->fd, &live, sizeof(live),
+		ent->off + offsetof(struct Cat_Rec_Hdr, live)) ) {
+	fprintf(stderr, "Could not update catalog %s.\n%s\n",
+		cat->nm, strerror(errno));
+	return 0;
+    }
+    return 1;
+}
+
+/*
+   Append the records in file fd, as made with Cat_Rec_Init ... Cat_Rec_End,
+   to catalog cat, after its current index. A new record replaces a live
+   record with the same path. Return 1 on success. On failure, print a
+   message to stderr and return 0.
+ */
+int Cat_Append_Fd(struct Cat *cat, int fd)
+{
+    struct Cat_Rec_Hdr rh;		/* Record header */
+    unsigned char *rec = NULL;		/* Record */
+    struct Cat_Ent *ent;		/* Entry being replaced */
+    uint64_t off;			/* Offset of record in fd */
+    ssize_t nr;
+
+    for (off = 0; ; off += rh.rec_len) {
+	nr = pread(fd, &rh, sizeof(rh), off);
+	if ( nr == 0 ) {
+	    break;
+	}
+	if ( nr != sizeof(rh) || rh.rec_len < sizeof(rh) + rh.path_len + 1
+		|| rh.rec_len % 8 != 0 ) {
+	    fprintf(stderr, "Bad record for catalog %s.\n", cat->nm);
+	    goto error;
+	}
+	skip_idx(cat);
+	if ( !(rec = REALLOC(rec, rh.rec_len))
+		|| !rd_at(fd, rec, rh.rec_len, off) ) {
+	    fprintf(stderr, "Could not read record for catalog %s.\n",
+		    cat->nm);
+	    goto error;
+	}
+	rec[sizeof(rh) + rh.path_len] = '\0';
+	if ( (ent = Cat_Find(cat, (char *)rec + sizeof(rh)))
+		&& !Cat_Kill(cat, ent) ) {
+	    goto error;
+	}
+	if ( !wr_at(cat->fd, rec, rh.rec_len, cat->end) ) {
+	    fprintf(stderr, "Could not append to catalog %s.\n%s\n",
+		    cat->nm, strerror(errno));
+	    goto error;
+	}
+	if ( !add_ent(cat, (char *)rec + sizeof(rh), &rh, cat->end) ) {
+	    goto error;
+	}
+	cat->ents[cat->n_ents - 1]->seen = 1;
+	cat->end += rh.rec_len;
+	cat->tail = cat->end;
+	cat->dirty = 1;
+    }
+    FREE(rec);
+    return 1;
+
+error:
+    FREE(rec);
+    return 0;
+}
+
+/*
+   Finish updating catalog cat. If dead records and old indeces take more
+   space than live records, or the attribute list changed, rewrite the
+   catalog with only live records. Then, if anything changed, write a new
+   index after the current one, and drop anything left after it by an
+   update that did not finish. Return 1 on success. On failure, print a
+   message to stderr and return 0.
+ */
+int Cat_Finish(struct Cat *cat)
+{
+    if ( (cat->rewrite || cat->dead > (cat->end - cat->data_off) / 2)
+	    && !compact(cat) ) {
+	return 0;
+    }
+    if ( !cat->dirty && cat->tail > cat->end ) {
+	return 1;
+    }
+    skip_idx(cat);
+    if ( !write_idx(cat) ) {
+	return 0;
+    }
+    if ( ftruncate(cat->fd, cat->tail) == -1 ) {
+	fprintf(stderr, "Could not truncate catalog %s.\n%s\n",
+		cat->nm, strerror(errno));
+	return 0;
+    }
+    cat->dirty = 0;
+    return 1;
+}
+
+/*
+   Free memory associated with catalog cat and close the catalog file.
+ */
+void Cat_Close(struct Cat *cat)
+{
+    size_t i;
+
+    for (i = 0; i < cat->n_ents; i++) {
+	FREE(cat->ents[i]->path);
+	FREE(cat->ents[i]);
+    }
+    FREE(cat->ents);
+    Hash_Clear(&cat->paths);
+    FREE(cat->att_nms);
+    FREE(cat->nm);
+    if ( cat->fd != -1 ) {
+	close(cat->fd);
+    }
+    memset(cat, 0, sizeof(struct Cat));
+    cat->fd = -1;
+}
+
+/*
+   Add a live entry for the record with header rh and path path at offset
+   off to catalog cat. Return 1 on success. On failure, print a message to
+   stderr and return 0.
+ */
+static int add_ent(struct Cat *cat, const char *path,
+	const struct Cat_Rec_Hdr *rh, uint64_t off)
+{
+    struct Cat_Ent *ent, **ents;
+    size_t n_alloc;
+
+    if ( cat->n_ents == cat->n_alloc ) {
+	n_alloc = (cat->n_alloc > 0) ? 2 * cat->n_alloc : 1024;
+	if ( !(ents = REALLOC(cat->ents, n_alloc * sizeof(struct Cat_Ent *))) ) {
+	    fprintf(stderr, "Could not allocate %zu catalog entries.\n",
+		    n_alloc);
+	    return 0;
+	}
+	cat->ents = ents;
+	cat->n_alloc = n_alloc;
+    }
+    if ( !(ent = CALLOC(1, sizeof(struct Cat_Ent)))
+	    || !(ent->path = MALLOC(strlen(path) + 1)) ) {
+	fprintf(stderr, "Could not allocate catalog entry for %s.\n", path);
+	FREE(ent);
+	return 0;
+    }
+    strcpy(ent->path, path);
+    ent->dev = rh->dev;
+    ent->ino = rh->ino;
+    ent->size = rh->size;
+    ent->mtime = rh->mtime;
+    ent->off = off;
+    ent->len = rh->rec_len;
+    ent->live = 1;
+    if ( !Hash_Set(&cat->paths, ent->path, ent) ) {
+	FREE(ent->path);
+	FREE(ent);
+	return 0;
+    }
+    cat->ents[cat->n_ents++] = ent;
+    if ( cat->paths.n_entries > 2 * cat->paths.n_buckets ) {
+	Hash_Adj(&cat->paths, 4 * cat->paths.n_buckets);
+    }
+    return 1;
+}
+
+/*
+   Rewrite catalog cat with the current attribute names and only its live
+   records, through a temporary file that replaces the catalog. Return 1 on
+   success. On failure, print a message to stderr and return 0.
+ */
+static int compact(struct Cat *cat)
+{
+    char *tmp_nm;			/* Temporary file */
+    int fd = -1;			/* Temporary file descriptor */
+    struct Cat_Hdr hdr;			/* New header */
+    unsigned char *rec = NULL;		/* Record being copied */
+    uint32_t len = 0;			/* Allocation at rec */
+    struct Cat_Ent *ent;
+    uint64_t end;			/* End of records in new file */
+    char pad[8] = {0};
+    size_t i, j;
+
+    if ( !(tmp_nm = MALLOC(strlen(cat->nm) + 5)) ) {
+	fprintf(stderr, "Could not allocate name for temporary catalog.\n");
+	return 0;
+    }
+    sprintf(tmp_nm, "%s.tmp", cat->nm);
+    if ( (fd = open(tmp_nm, O_RDWR | O_CREAT | O_TRUNC, 0666)) == -1 ) {
+	fprintf(stderr, "Could not create %s.\n%s\n",
+		tmp_nm, strerror(errno));
+	FREE(tmp_nm);
+	return 0;
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    strcpy(hdr.magic, CAT_MAGIC);
+    hdr.n_att_nms = cat->n_att_nms;
+    hdr.att_nms_len = cat->att_nms_len;
+    hdr.data_off = (sizeof(hdr) + cat->att_nms_len + 7) / 8 * 8;
+    if ( !wr_at(fd, &hdr, sizeof(hdr), 0)
+	    || !wr_at(fd, cat->att_nms, cat->att_nms_len, sizeof(hdr))
+	    || !wr_at(fd, pad, hdr.data_off - sizeof(hdr) - cat->att_nms_len,
+		sizeof(hdr) + cat->att_nms_len) ) {
+	goto error;
+    }
+    for (end = hdr.data_off, i = j = 0; i < cat->n_ents; i++) {
+	ent = cat->ents[i];
+	if ( !ent->live ) {
+	    FREE(ent->path);
+	    FREE(ent);
+	    continue;
+	}
+	if ( ent->len > len ) {
+	    FREE(rec);
+	    if ( !(rec = MALLOC(ent->len)) ) {
+		fprintf(stderr, "Could not allocate %u bytes for catalog "
+			"record.\n", (unsigned)ent->len);
+		goto error;
+	    }
+	    len = ent->len;
+	}
+	if ( !rd_at(cat->fd, rec, ent->len, ent->off)
+		|| !wr_at(fd, rec, ent->len, end) ) {
+	    goto error;
+	}
+	ent->off = end;
+	end += ent->len;
+	cat->ents[j++] = ent;
+    }
+    cat->n_ents = j;
+    if ( rename(tmp_nm, cat->nm) == -1 ) {
+	goto error;
+    }
+    lockf(fd, F_TLOCK, 0);
+    close(cat->fd);
+    cat->fd = fd;
+    cat->data_off = hdr.data_off;
+    cat->end = cat->tail = end;
+    cat->dead = 0;
+    cat->rewrite = 0;
+    FREE(rec);
+    FREE(tmp_nm);
+    return 1;
+
+error:
+    fprintf(stderr, "Could not rewrite catalog %s.\n%s\n",
+	    cat->nm, strerror(errno));
+    close(fd);
+    unlink(tmp_nm);
+    FREE(rec);
+    FREE(tmp_nm);
+    return 0;
+}
+
+/*
+   If catalog cat has an index after its records, leave the index in place
+   for readers that have mapped it, and count it as dead space, so that new
+   records and a new index go after it.
+ */
+static void skip_idx(struct Cat *cat)
+{
+    if ( cat->tail > cat->end ) {
+	cat->dead += cat->tail - cat->end;
+	cat->end = cat->tail;
+    }
+}
+
+/*
+   Return the size of the index with header ih, including its footer.
+ */
+static uint64_t idx_size(const struct Cat_Idx_Hdr *ih)
+{
+    uint64_t sz;
+
+    sz = sizeof(*ih) + ih->n_recs * sizeof(uint64_t)
+	+ ih->n_nms * sizeof(struct Cat_Nm) + ih->nms_len
+	+ ih->n_post * sizeof(uint32_t);
+    return (sz + 7) / 8 * 8 + sizeof(struct Cat_Foot);
+}
+
+/*
+   Write the index and footer after the records of catalog cat. Return 1 on
+   success. On failure, print a message to stderr and return 0.
+ */
+static int write_idx(struct Cat *cat)
+{
+    unsigned char *m = NULL;		/* Records, mapped */
+    struct Hash_Tbl nms;		/* Postings by variable name */
+    struct Cat_Post *posts = NULL;	/* Postings for each name */
+    size_t n_posts = 0, sz_posts = 0;	/* Number of posts, allocation */
+    struct Cat_Post *p;
+    struct Cat_Idx_Hdr ih;		/* Index header */
+    struct Cat_Nm cn;			/* Index entry for a name */
+    struct Cat_Foot foot;		/* Footer */
+    struct Cat_Buf b = {NULL, 0, 0};	/* Index contents */
+    const struct Cat_Rec_Hdr *rh;
+    const unsigned char *q;
+    const char *nm;
+    const unsigned char *dim_ids;
+    uint64_t u, nm_off, post_off;
+    uint32_t r, k, ndims, n_live;
+    int xtype, have_nms = 0;
+    size_t i, l;
+    char pad[8] = {0};
+    int ok = 0;
+
+    if ( cat->end > 0 && (m = mmap(NULL, cat->end, PROT_READ, MAP_SHARED,
+		    cat->fd, 0)) == MAP_FAILED ) {
+	m = NULL;
+	fprintf(stderr, "Could not map catalog %s.\n%s\n",
+		cat->nm, strerror(errno));
+	return 0;
+    }
+    if ( !Hash_Init(&nms, CAT_BUCKETS) ) {
+	goto end;
+    }
+    have_nms = 1;
+
+    /*
+       Postings hold indeces into posts until all names are known, since
+       posts moves as it grows.
+     */
+
+    for (i = 0, n_live = 0; i < cat->n_ents; i++) {
+	if ( !cat->ents[i]->live ) {
+	    continue;
+	}
+	r = n_live++;
+	rh = (const struct Cat_Rec_Hdr *)(m + cat->ents[i]->off);
+	q = Cat_Rec_Items(rh);
+	for (k = 0; k < rh->n_dims; k++) {
+	    q = Cat_Dim_Next(q, &nm, &u, &xtype);
+	}
+	for (k = 0; k < rh->n_vars; k++) {
+	    q = Cat_Var_Next(q, &nm, &xtype, &ndims, &dim_ids);
+	    if ( !(l = (size_t)Hash_Get(&nms, nm)) ) {
+		if ( n_posts == sz_posts ) {
+		    sz_posts = sz_posts ? 2 * sz_posts : 256;
+		    if ( !(p = REALLOC(posts, sz_posts * sizeof(*p))) ) {
+			goto end;
+		    }
+		    posts = p;
+		}
+		memset(posts + n_posts, 0, sizeof(*posts));
+		posts[n_posts].nm = nm;
+		l = ++n_posts;
+		if ( !Hash_Set(&nms, nm, (void *)l) ) {
+		    goto end;
+		}
+		if ( nms.n_entries > 2 * nms.n_buckets ) {
+		    Hash_Adj(&nms, 4 * nms.n_buckets);
+		}
+	    }
+	    p = posts + l - 1;
+	    if ( p->n == p->sz ) {
+		uint32_t *v;
+
+		p->sz = p->sz ? 2 * p->sz : 4;
+		if ( !(v = REALLOC(p->v, p->sz * sizeof(uint32_t))) ) {
+		    goto end;
+		}
+		p->v = v;
+	    }
+	    p->v[p->n++] = r;
+	}
+    }
+    qsort(posts, n_posts, sizeof(*posts), post_cmp);
+
+    /* Header, record offsets, names, name strings, postings */
+    memset(&ih, 0, sizeof(ih));
+    strcpy(ih.magic, CAT_IDX_MAGIC);
+    ih.n_recs = n_live;
+    ih.n_nms = n_posts;
+    for (i = 0; i < n_posts; i++) {
+	ih.nms_len += strlen(posts[i].nm) + 1;
+	ih.n_post += posts[i].n;
+    }
+    ih.nms_len = (ih.nms_len + 7) / 8 * 8;
+    if ( !buf_put(&b, &ih, sizeof(ih)) ) {
+	goto end;
+    }
+    for (i = 0; i < cat->n_ents; i++) {
+	if ( cat->ents[i]->live
+		&& !buf_put(&b, &cat->ents[i]->off, sizeof(uint64_t)) ) {
+	    goto end;
+	}
+    }
+    for (i = 0, nm_off = post_off = 0; i < n_posts; i++) {
+	cn.nm_off = nm_off;
+	cn.post_off = post_off;
+	cn.n_post = posts[i].n;
+	if ( !buf_put(&b, &cn, sizeof(cn)) ) {
+	    goto end;
+	}
+	nm_off += strlen(posts[i].nm) + 1;
+	post_off += posts[i].n;
+    }
+    for (i = 0; i < n_posts; i++) {
+	if ( !buf_put(&b, posts[i].nm, strlen(posts[i].nm) + 1) ) {
+	    goto end;
+	}
+    }
+    if ( !buf_put(&b, pad, ih.nms_len - nm_off) ) {
+	goto end;
+    }
+    for (i = 0; i < n_posts; i++) {
+	if ( !buf_put(&b, posts[i].v, posts[i].n * sizeof(uint32_t)) ) {
+	    goto end;
+	}
+    }
+    if ( !buf_put(&b, pad, (8 - b.len % 8) % 8) ) {
+	goto end;
+    }
+    memset(&foot, 0, sizeof(foot));
+    foot.idx_off = cat->end;
+    memcpy(foot.magic, CAT_FOOT_MAGIC, sizeof(foot.magic));
+    if ( !buf_put(&b, &foot, sizeof(foot)) ) {
+	goto end;
+    }
+    if ( !wr_at(cat->fd, b.b, b.len, cat->end) ) {
+	goto end;
+    }
+    cat->tail = cat->end + b.len;
+    ok = 1;
+
+end:
+    if ( !ok ) {
+	fprintf(stderr, "Could not write index for catalog %s.\n", cat->nm);
+    }
+    for (i = 0; i < n_posts; i++) {
+	FREE(posts[i].v);
+    }
+    FREE(posts);
+    FREE(b.b);
+    if ( have_nms ) {
+	Hash_Clear(&nms);
+    }
+    if ( m ) {
+	munmap(m, cat->end);
+    }
+    return ok;
+}
+
+/*
+   Start a record in b for the netCDF file at path, with device, inode,
+   size, and modification time in nanoseconds from stat. Return 1 on
+   success, 0 if memory runs out.
+ */
+int Cat_Rec_Init(struct Cat_Buf *b, const char *path, uint64_t dev,
+	uint64_t ino, uint64_t size, int64_t mtime)
+{
+    struct Cat_Rec_Hdr rh;
+
+    memset(&rh, 0, sizeof(rh));
+    rh.dev = dev;
+    rh.ino = ino;
+    rh.size = size;
+    rh.mtime = mtime;
+    rh.path_len = strlen(path);
+    b->len = 0;
+    return buf_put(b, &rh, sizeof(rh)) && buf_put(b, path, rh.path_len + 1);
+}
+
+/*
+   Add a dimension of length len to the record in b. Dimensions must come
+   before variables and attributes. Return 1 on success, 0 if memory runs
+   out.
+ */
+int Cat_Rec_Dim(struct Cat_Buf *b, const char *nm, uint64_t len, int unlim)
+{
+    uint32_t u = unlim;
+
+    ((struct Cat_Rec_Hdr *)b->b)->n_dims++;
+    return buf_put(b, &len, sizeof(len)) && buf_put(b, &u, sizeof(u))
+	&& buf_put(b, nm, strlen(nm) + 1);
+}
+
+/*
+   Add a variable of type xtype with ndims dimensions identified by dim_ids
+   to the record in b. Variables must come before attributes. Return 1 on
+   success, 0 if memory runs out.
+ */
+int Cat_Rec_Var(struct Cat_Buf *b, const char *nm, int xtype, int ndims,
+	const int *dim_ids)
+{
+    int32_t t = xtype;
+    uint32_t u = ndims;
+    int d;
+
+    ((struct Cat_Rec_Hdr *)b->b)->n_vars++;
+    if ( !buf_put(b, &t, sizeof(t)) || !buf_put(b, &u, sizeof(u)) ) {
+	return 0;
+    }
+    for (d = 0; d < ndims; d++) {
+	u = dim_ids[d];
+	if ( !buf_put(b, &u, sizeof(u)) ) {
+	    return 0;
+	}
+    }
+    return buf_put(b, nm, strlen(nm) + 1);
+}
+
+/*
+   Add attribute nm of variable v, or -1 for a global attribute, with n
+   values of type xtype in vals_sz bytes at vals, to the record in b. Return
+   1 on success, 0 if memory runs out.
+ */
+int Cat_Rec_Att(struct Cat_Buf *b, int v, const char *nm, int xtype,
+	uint32_t n, const void *vals, size_t vals_sz)
+{
+    int32_t t[2];
+
+    ((struct Cat_Rec_Hdr *)b->b)->n_atts++;
+    t[0] = v;
+    t[1] = xtype;
+    return buf_put(b, t, sizeof(t)) && buf_put(b, &n, sizeof(n))
+	&& buf_put(b, nm, strlen(nm) + 1) && buf_put(b, vals, vals_sz);
+}
+
+/*
+   Finish the record in b. Return 1 on success, 0 if memory runs out.
+ */
+int Cat_Rec_End(struct Cat_Buf *b)
+{
+    char pad[8] = {0};
+    struct Cat_Rec_Hdr *rh;
+
+    if ( !buf_put(b, pad, (8 - b->len % 8) % 8) ) {
+	return 0;
+    }
+    rh = (struct Cat_Rec_Hdr *)b->b;
+    rh->rec_len = b->len;
+    rh->live = 1;
+    return 1;
+}
+
+/*
+   Map catalog file nm into memory for queries. Return 1 on success. On
+   failure, print a message to stderr and return 0.
+ */
+int Cat_Map(struct Cat_Map *map, const char *nm)
+{
+    int fd;
+    struct stat sb;
+    const struct Cat_Foot *foot;
+    const struct Cat_Idx_Hdr *ih;
+    uint64_t idx_off;			/* Offset of index */
+    uint64_t sz;
+
+    memset(map, 0, sizeof(struct Cat_Map));
+    if ( (fd = open(nm, O_RDONLY)) == -1 || fstat(fd, &sb) == -1 ) {
+	fprintf(stderr, "Could not open catalog %s.\n%s\n",
+		nm, strerror(errno));
+	if ( fd != -1 ) {
+	    close(fd);
+	}
+	return 0;
+    }
+    map->sz = sb.st_size;
+    if ( map->sz < sizeof(struct Cat_Hdr) + sizeof(struct Cat_Foot)
+	    || (map->m = mmap(NULL, map->sz, PROT_READ, MAP_SHARED, fd, 0))
+	    == MAP_FAILED ) {
+	fprintf(stderr, "Could not map catalog %s.\n", nm);
+	map->m = NULL;
+	close(fd);
+	return 0;
+    }
+    close(fd);
+    map->hdr = (const struct Cat_Hdr *)map->m;
+    if ( strcmp(map->hdr->magic, CAT_MAGIC) != 0
+	    || map->hdr->data_off % 8 != 0
+	    || map->hdr->data_off > map->sz ) {
+	fprintf(stderr, "%s is not a catalog.\n", nm);
+	Cat_Unmap(map);
+	return 0;
+    }
+
+    /*
+       While an update appends records after the current index, the file
+       does not end with a footer. Use the index the update started from.
+     */
+
+    foot = (const struct Cat_Foot *)(map->m + map->sz - sizeof(*foot));
+    if ( memcmp(foot->magic, CAT_FOOT_MAGIC, sizeof(foot->magic)) == 0
+	    && foot->idx_off % 8 == 0
+	    && foot->idx_off + sizeof(*ih) <= map->sz - sizeof(*foot) ) {
+	idx_off = foot->idx_off;
+    } else if ( !(idx_off = last_idx(map)) ) {
+	fprintf(stderr, "%s is not a complete catalog. Update it.\n", nm);
+	Cat_Unmap(map);
+	return 0;
+    }
+    ih = map->idx = (const struct Cat_Idx_Hdr *)(map->m + idx_off);
+    sz = sizeof(*ih) + ih->n_recs * sizeof(uint64_t)
+	+ ih->n_nms * sizeof(struct Cat_Nm) + ih->nms_len
+	+ ih->n_post * sizeof(uint32_t);
+    if ( strcmp(ih->magic, CAT_IDX_MAGIC) != 0
+	    || idx_off + sz > map->sz - sizeof(*foot) ) {
+	fprintf(stderr, "Index in catalog %s is damaged. Update it.\n", nm);
+	Cat_Unmap(map);
+	return 0;
+    }
+    map->rec_off = (const uint64_t *)(ih + 1);
+    map->nms = (const struct Cat_Nm *)(map->rec_off + ih->n_recs);
+    map->nm_buf = (const char *)(map->nms + ih->n_nms);
+    map->post = (const uint32_t *)(map->nm_buf + ih->nms_len);
+    return 1;
+}
+
+/*
+   Return the offset of the last complete index, with its footer, among the
+   records of mapped catalog map, or 0 if there is none.
+ */
+static uint64_t last_idx(const struct Cat_Map *map)
+{
+    const struct Cat_Rec_Hdr *rh;
+    const struct Cat_Idx_Hdr *ih;
+    const struct Cat_Foot *foot;
+    uint64_t off, len;
+    uint64_t idx_off = 0;
+
+    for (off = map->hdr->data_off; off + sizeof(*rh) <= map->sz; off += len) {
+	rh = (const struct Cat_Rec_Hdr *)(map->m + off);
+	if ( memcmp(rh, CAT_IDX_MAGIC, sizeof(ih->magic)) == 0 ) {
+	    ih = (const struct Cat_Idx_Hdr *)rh;
+	    if ( off + sizeof(*ih) > map->sz
+		    || ih->n_recs > map->sz || ih->n_nms > map->sz
+		    || ih->nms_len > map->sz || ih->n_post > map->sz
+		    || (len = idx_size(ih)) > map->sz - off ) {
+		break;
+	    }
+	    foot = (const struct Cat_Foot *)(map->m + off + len)
+		- 1;
+	    if ( memcmp(foot->magic, CAT_FOOT_MAGIC, sizeof(foot->magic)) != 0
+		    || foot->idx_off != off ) {
+		break;
+	    }
+	    idx_off = off;
+	    continue;
+	}
+	len = rh->rec_len;
+	if ( len < sizeof(*rh) + rh->path_len + 1
+		|| len % 8 != 0 || len > map->sz - off ) {
+	    break;
+	}
+    }
+    return idx_off;
+}
+
+/*
+   Return live record r of mapped catalog map.
+ */
+const struct Cat_Rec_Hdr *Cat_Map_Rec(const struct Cat_Map *map, uint64_t r)
+{
+    return (const struct Cat_Rec_Hdr *)(map->m + map->rec_off[r]);
+}
+
+/*
+   Find the live records of mapped catalog map for files with a variable
+   named nm. Put the address of their numbers, in increasing order, at
+   post_p and their count at n_p. Return 1 if any file has the variable,
+   otherwise 0.
+ */
+int Cat_Map_Post(const struct Cat_Map *map, const char *nm,
+	const uint32_t **post_p, uint64_t *n_p)
+{
+    uint64_t lo, hi, mid;
+    int c;
+
+    *n_p = 0;
+    for (lo = 0, hi = map->idx->n_nms; lo < hi; ) {
+	mid = lo + (hi - lo) / 2;
+	c = strcmp(nm, map->nm_buf + map->nms[mid].nm_off);
+	if ( c == 0 ) {
+	    *post_p = map->post + map->nms[mid].post_off;
+	    *n_p = map->nms[mid].n_post;
+	    return 1;
+	} else if ( c < 0 ) {
+	    hi = mid;
+	} else {
+	    lo = mid + 1;
+	}
+    }
+    return 0;
+}
+
+/*
+   Unmap catalog map.
+ */
+void Cat_Unmap(struct Cat_Map *map)
+{
+    if ( map->m ) {
+	munmap(map->m, map->sz);
+    }
+    memset(map, 0, sizeof(struct Cat_Map));
+}
+
+/*
+   Return the address of the first dimension in record rh. Callers step
+   through dimensions, variables, and attributes, in that order, with
+   Cat_Dim_Next, Cat_Var_Next, and Cat_Att_Next.
+ */
+const unsigned char *Cat_Rec_Items(const struct Cat_Rec_Hdr *rh)
+{
+    return (const unsigned char *)(rh + 1) + rh->path_len + 1;
+}
+
+/*
+   Get the dimension at p. Put its name at nm_p, length at len_p, and 1 at
+   unlim_p if it is unlimited. Return the address of the next item.
+ */
+const unsigned char *Cat_Dim_Next(const unsigned char *p, const char **nm_p,
+	uint64_t *len_p, int *unlim_p)
+{
+    uint32_t u;
+
+    memcpy(len_p, p, sizeof(uint64_t));
+    memcpy(&u, p + 8, sizeof(uint32_t));
+    *unlim_p = u;
+    *nm_p = (const char *)p + 12;
+    return p + 12 + strlen(*nm_p) + 1;
+}
+
+/*
+   Get the variable at p. Put its name at nm_p, type at xtype_p, number of
+   dimensions at ndims_p, and the address of its dimension indeces, which
+   are unaligned uint32_t, at dim_ids_p. Return the address of the next
+   item.
+ */
+const unsigned char *Cat_Var_Next(const unsigned char *p, const char **nm_p,
+	int *xtype_p, uint32_t *ndims_p, const unsigned char **dim_ids_p)
+{
+    int32_t t;
+
+    memcpy(&t, p, sizeof(int32_t));
+    memcpy(ndims_p, p + 4, sizeof(uint32_t));
+    *xtype_p = t;
+    *dim_ids_p = p + 8;
+    *nm_p = (const char *)p + 8 + 4 * *ndims_p;
+    return (const unsigned char *)*nm_p + strlen(*nm_p) + 1;
+}
+
+/*
+   Get the attribute at p. Put the index of its variable, or -1, at v_p, its
+   name at nm_p, type at xtype_p, number of values at n_p, and the address
+   of its values, which are unaligned, at vals_p. Return the address of the
+   next item.
+ */
+const unsigned char *Cat_Att_Next(const unsigned char *p, int *v_p,
+	const char **nm_p, int *xtype_p, uint32_t *n_p,
+	const unsigned char **vals_p)
+{
+    int32_t t[2];
+
+    memcpy(t, p, sizeof(t));
+    memcpy(n_p, p + 8, sizeof(uint32_t));
+    *v_p = t[0];
+    *xtype_p = t[1];
+    *nm_p = (const char *)p + 12;
+    *vals_p = (const unsigned char *)*nm_p + strlen(*nm_p) + 1;
+    return *vals_p + *n_p * Cat_Type_Size(*xtype_p);
+}
+
+/*
+   Return the size of one value of netCDF type xtype, or 0 for types a
+   catalog does not store.
+ */
+size_t Cat_Type_Size(int xtype)
+{
+    static const size_t sz[] = {0, 1, 1, 2, 4, 4, 8, 1, 2, 4, 8, 8};
+
+    return (xtype > 0 && xtype < (int)(sizeof(sz) / sizeof(sz[0])))
+	? sz[xtype] : 0;
+}
+
+/*
+   Append n bytes from p to b. Return 1 on success, 0 if memory runs out.
+ */
+static int buf_put(struct Cat_Buf *b, const void *p, size_t n)
+{
+    unsigned char *b1;
+    size_t sz;
+
+    if ( b->len + n > b->sz ) {
+	for (sz = b->sz ? b->sz : 256; sz < b->len + n; sz *= 2) {
+	}
+	if ( !(b1 = REALLOC(b->b, sz)) ) {
+	    return 0;
+	}
+	b->b = b1;
+	b->sz = sz;
+    }
+    if ( n > 0 ) {
+	memcpy(b->b + b->len, p, n);
+	b->len += n;
+    }
+    return 1;
+}
+
+/* Compare postings by name, for qsort */
+static int post_cmp(const void *a, const void *b)
+{
+    return strcmp(((const struct Cat_Post *)a)->nm,
+	    ((const struct Cat_Post *)b)->nm);
+}
+
+/* Read n bytes at offset off of fd into buf. Return 1 on success. */
+static int rd_at(int fd, void *buf, size_t n, uint64_t off)
+{
+    ssize_t nr;
+    char *p;
+
+    for (p = buf; n > 0; p += nr, n -= nr, off += nr) {
+	if ( (nr = pread(fd, p, n, off)) == -1 && errno == EINTR ) {
+	    nr = 0;
+	    continue;
+	}
+	if ( nr <= 0 ) {
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+/* Write n bytes from buf at offset off of fd. Return 1 on success. */
+static int wr_at(int fd, const void *buf, size_t n, uint64_t off)
+{
+    ssize_t nw;
+    const char *p;
+
+    for (p = buf; n > 0; p += nw, n -= nw, off += nw) {
+	if ( (nw = pwrite(fd, p, n, off)) == -1 && errno == EINTR ) {
+	    nw = 0;
+	    continue;
+	}
+	if ( nw <= 0 ) {
+	    return 0;
+	}
+    }
+    return 1;
+}
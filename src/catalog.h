@@ -0,0 +1,188 @@
+/*
+   -	catalog.h --
+   -		Declarations for a persistent catalog of netCDF headers
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#ifndef CATALOG_H_
+#define CATALOG_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "hash.h"
+
+/*
+   A catalog file records the dimensions, variables, and selected
+   attributes of many netCDF files, so that they can be searched without
+   opening them.
+
+   The file starts with a struct Cat_Hdr and the names of the attributes
+   the catalog keeps, each followed by nul, padded with nul to data_off.
+   Then come records, one per netCDF file, each a struct Cat_Rec_Hdr
+   followed by:
+
+	path, nul terminated
+	n_dims times: uint64_t length, uint32_t unlimited flag, name, nul
+	n_vars times: int32_t type, uint32_t ndims, ndims uint32_t dimension
+		indeces, name, nul
+	n_atts times: int32_t variable index or -1 for global, int32_t type,
+		uint32_t number of values, name, nul, values
+
+   padded with nul to a multiple of 8 bytes. Fields inside a record are
+   not aligned. Updates mark records for changed or missing files dead,
+   and append new records. The file ends with an index: a struct
+   Cat_Idx_Hdr, the offsets of live records as uint64_t, n_nms struct
+   Cat_Nm for variable names in strcmp order, the names, each followed by
+   nul and padded to 8 bytes, and the posting lists, uint32_t live record
+   numbers, then a struct Cat_Foot. Updates append new records and a new
+   index after the old index, which stays in place as dead space until the
+   catalog is rewritten, so a reader that mapped the file earlier keeps a
+   consistent view, and a reader that maps it before the new index is
+   written uses the old one. All values are in native byte order.
+ */
+
+#define CAT_MAGIC "NNCCAT1"
+#define CAT_IDX_MAGIC "NNCIDX1"
+#define CAT_FOOT_MAGIC "NNCFOOT"
+
+struct Cat_Hdr {
+    char magic[8];			/* CAT_MAGIC, nul terminated */
+    uint32_t n_att_nms;			/* Number of attribute names */
+    uint32_t att_nms_len;		/* Bytes in attribute names */
+    uint64_t data_off;			/* Offset of first record */
+};
+
+struct Cat_Rec_Hdr {
+    uint32_t rec_len;			/* Size of record, with header */
+    uint32_t live;			/* 1 if current, 0 if dead */
+    uint64_t dev, ino;			/* Device and inode of file */
+    uint64_t size;			/* Size of file */
+    int64_t mtime;			/* Modification time of file,
+					   nanoseconds */
+    uint32_t path_len;			/* Length of path */
+    uint32_t n_dims, n_vars, n_atts;	/* Numbers of items */
+};
+
+struct Cat_Idx_Hdr {
+    char magic[8];			/* CAT_IDX_MAGIC, nul terminated */
+    uint64_t n_recs;			/* Number of live records */
+    uint64_t n_nms;			/* Number of variable names */
+    uint64_t nms_len;			/* Bytes in names, with padding */
+    uint64_t n_post;			/* Number of postings */
+};
+
+struct Cat_Nm {
+    uint64_t nm_off;			/* Offset of name in names */
+    uint64_t post_off;			/* Index of first posting */
+    uint64_t n_post;			/* Number of postings */
+};
+
+struct Cat_Foot {
+    uint64_t idx_off;			/* Offset of struct Cat_Idx_Hdr */
+    char magic[8];			/* CAT_FOOT_MAGIC, nul terminated */
+};
+
+/* A live record, while updating a catalog */
+struct Cat_Ent {
+    char *path;				/* Path of netCDF file */
+    uint64_t dev, ino, size;		/* From stat of netCDF file */
+    int64_t mtime;			/* From stat of netCDF file,
+					   nanoseconds */
+    uint64_t off;			/* Offset of record in catalog */
+    uint32_t len;			/* Size of record */
+    int live;				/* If false, record is dead */
+    int seen;				/* Set by caller */
+};
+
+/* A catalog open for update */
+struct Cat {
+    int fd;				/* Catalog file */
+    char *nm;				/* Path to catalog file */
+    char *att_nms;			/* Attribute names, nul separated */
+    uint32_t n_att_nms, att_nms_len;	/* Number and size of names */
+    uint64_t data_off;			/* Offset of first record */
+    uint64_t end;			/* End of records */
+    uint64_t tail;			/* End of current index, if any */
+    uint64_t dead;			/* Bytes in dead records and old
+					   indeces */
+    int rewrite;			/* If true, Cat_Finish rewrites file */
+    int dirty;				/* If true, index is out of date */
+    struct Cat_Ent **ents;		/* Records, in file order */
+    size_t n_ents, n_alloc;		/* Number of ents, allocation */
+    struct Hash_Tbl paths;		/* Live entries by path */
+};
+
+/* A catalog mapped for queries */
+struct Cat_Map {
+    unsigned char *m;			/* Contents of catalog file */
+    size_t sz;				/* Size of catalog file */
+    const struct Cat_Hdr *hdr;		/* Header at m */
+    const struct Cat_Idx_Hdr *idx;	/* Index */
+    const uint64_t *rec_off;		/* Offsets of live records */
+    const struct Cat_Nm *nms;		/* Variable names */
+    const char *nm_buf;			/* Name strings */
+    const uint32_t *post;		/* Postings */
+};
+
+/* Growing buffer for a new record */
+struct Cat_Buf {
+    unsigned char *b;			/* Contents */
+    size_t len, sz;			/* Bytes used, allocation */
+};
+
+int Cat_Open(struct Cat *, const char *, const char *, uint32_t, uint32_t);
+struct Cat_Ent *Cat_Find(struct Cat *, const char *);
+int Cat_Kill(struct Cat *, struct Cat_Ent *);
+int Cat_Append_Fd(struct Cat *, int);
+int Cat_Finish(struct Cat *);
+void Cat_Close(struct Cat *);
+int Cat_Rec_Init(struct Cat_Buf *, const char *, uint64_t, uint64_t,
+	uint64_t, int64_t);
+int Cat_Rec_Dim(struct Cat_Buf *, const char *, uint64_t, int);
+int Cat_Rec_Var(struct Cat_Buf *, const char *, int, int, const int *);
+int Cat_Rec_Att(struct Cat_Buf *, int, const char *, int, uint32_t,
+	const void *, size_t);
+int Cat_Rec_End(struct Cat_Buf *);
+int Cat_Map(struct Cat_Map *, const char *);
+const struct Cat_Rec_Hdr *Cat_Map_Rec(const struct Cat_Map *, uint64_t);
+int Cat_Map_Post(const struct Cat_Map *, const char *, const uint32_t **,
+	uint64_t *);
+void Cat_Unmap(struct Cat_Map *);
+const unsigned char *Cat_Rec_Items(const struct Cat_Rec_Hdr *);
+const unsigned char *Cat_Dim_Next(const unsigned char *, const char **,
+	uint64_t *, int *);
+const unsigned char *Cat_Var_Next(const unsigned char *, const char **, int *,
+	uint32_t *, const unsigned char **);
+const unsigned char *Cat_Att_Next(const unsigned char *, int *, const char **,
+	int *, uint32_t *, const unsigned char **);
+size_t Cat_Type_Size(int);
+
+#endif
@@ -0,0 +1,414 @@
+/*
+   -	cdfhdr.c --
+   -		Read headers of classic netCDF files without libnetcdf
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "alloc.h"
+#include "rawout.h"
+#include "cdfhdr.h"
+
+/* Bytes to read first. Most headers fit. */
+#define CDF_HDR_READ (64 * 1024)
+
+/* Longest name to accept, as NC_MAX_NAME */
+#define CDF_MAX_NAME 256
+
+/* Tags for lists in the header */
+#define CDF_DIMENSION 0x0A
+#define CDF_VARIABLE 0x0B
+#define CDF_ATTRIBUTE 0x0C
+
+/* Number of records for a file still being written, all ones at the
+   width of the count */
+#define CDF_STREAMING(version) ((version) == 5 ? UINT64_MAX : 0xFFFFFFFFU)
+
+/* State of the parser */
+struct CDF_Rd {
+    const unsigned char *p;		/* Next byte of header */
+    const unsigned char *end;		/* End of bytes read */
+    uint64_t file_sz;			/* Size of file */
+    int version;			/* 1, 2, or 5 */
+    unsigned char *a, *a_end;		/* Unused part of arena */
+    int more;				/* Set if header is longer than bytes
+					   read */
+};
+
+static int parse(struct CDF_Rd *, struct CDF_Hdr *);
+static int have(struct CDF_Rd *, uint64_t);
+static int rd_uint(struct CDF_Rd *, size_t, uint64_t *);
+static int rd_count(struct CDF_Rd *, uint64_t *);
+static int rd_list(struct CDF_Rd *, uint32_t, uint64_t *);
+static int rd_name(struct CDF_Rd *, char **);
+static int rd_atts(struct CDF_Rd *, int *, struct CDF_Att **);
+static void *carve(struct CDF_Rd *, uint64_t, size_t);
+static size_t type_size(int, int);
+
+/*
+   Read the header of the classic, 64 bit offset, or 64 bit data netCDF
+   file at path into hdr, with as few reads as possible. Most headers take
+   one pread. Return 1 on success. Return 0 if the file cannot be read, is
+   not in one of these formats, has a header this parser does not accept,
+   or is still being written, in which case callers should use libnetcdf,
+   which also reports what went wrong. This function prints nothing.
+ */
+int CDF_Hdr_Read(const char *path, struct CDF_Hdr *hdr)
+{
+    int fd;
+    struct stat sb;
+    unsigned char *buf = NULL, *b1;	/* Bytes from start of file */
+    size_t len = 0, len1;		/* Bytes in buf, wanted in buf */
+    size_t arena_sz;			/* Size of hdr->arena */
+    struct CDF_Rd rd;
+    ssize_t nr;
+    int ok = 0;
+
+    memset(hdr, 0, sizeof(struct CDF_Hdr));
+    if ( (fd = open(path, O_RDONLY)) == -1 ) {
+	return 0;
+    }
+    if ( fstat(fd, &sb) == -1 || sb.st_size < 8 ) {
+	goto end;
+    }
+
+    /*
+       Parse what has been read. If the header goes on, read twice as much
+       and parse again.
+     */
+
+    for (len1 = CDF_HDR_READ; ; len1 *= 2) {
+	if ( len1 > (uint64_t)sb.st_size ) {
+	    len1 = sb.st_size;
+	}
+	if ( !(b1 = REALLOC(buf, len1)) ) {
+	    goto end;
+	}
+	buf = b1;
+	while ( len < len1 ) {
+	    if ( (nr = pread(fd, buf + len, len1 - len, len)) == -1
+		    && errno == EINTR ) {
+		continue;
+	    }
+	    if ( nr <= 0 ) {
+		goto end;
+	    }
+	    len += nr;
+	}
+	if ( memcmp(buf, "CDF", 3) != 0
+		|| (buf[3] != 1 && buf[3] != 2 && buf[3] != 5) ) {
+	    goto end;
+	}
+
+	/*
+	   The arena holds names, values, and structures. Each of these
+	   takes less than four times the bytes it takes in the header.
+	 */
+
+	FREE(hdr->arena);
+	memset(hdr, 0, sizeof(struct CDF_Hdr));
+	arena_sz = 4 * len + 64;
+	if ( !(hdr->arena = MALLOC(arena_sz)) ) {
+	    goto end;
+	}
+	rd.p = buf;
+	rd.end = buf + len;
+	rd.file_sz = sb.st_size;
+	rd.version = buf[3];
+	rd.a = hdr->arena;
+	rd.a_end = rd.a + arena_sz;
+	rd.more = 0;
+	if ( parse(&rd, hdr) ) {
+	    hdr->hdr_len = rd.p - buf;
+	    ok = 1;
+	    break;
+	}
+	if ( !rd.more || len == (uint64_t)sb.st_size ) {
+	    break;
+	}
+    }
+
+end:
+    if ( !ok ) {
+	CDF_Hdr_Free(hdr);
+    }
+    FREE(buf);
+    close(fd);
+    return ok;
+}
+
+/*
+   Free memory associated with hdr.
+ */
+void CDF_Hdr_Free(struct CDF_Hdr *hdr)
+{
+    FREE(hdr->arena);
+    memset(hdr, 0, sizeof(struct CDF_Hdr));
+}
+
+/*
+   Parse the header at rd->p into hdr. Return 1 on success, 0 on failure.
+   If the header goes past rd->end, set rd->more.
+ */
+static int parse(struct CDF_Rd *rd, struct CDF_Hdr *hdr)
+{
+    uint64_t num_recs;			/* Number of records */
+    uint64_t n;				/* Number of list elements */
+    uint64_t u;
+    struct CDF_Dim *dim;
+    struct CDF_Var *var;
+    int d, v;
+
+    hdr->version = rd->version;
+    rd->p += 4;
+    if ( !rd_count(rd, &num_recs)
+	    || num_recs == CDF_STREAMING(rd->version) ) {
+	return 0;
+    }
+
+    if ( !rd_list(rd, CDF_DIMENSION, &n) ) {
+	return 0;
+    }
+    hdr->n_dims = n;
+    if ( !(hdr->dims = carve(rd, n, sizeof(struct CDF_Dim))) ) {
+	return 0;
+    }
+    for (d = 0; d < hdr->n_dims; d++) {
+	dim = hdr->dims + d;
+	if ( !rd_name(rd, &dim->name) || !rd_count(rd, &u) ) {
+	    return 0;
+	}
+	dim->unlim = (u == 0);
+	dim->len = dim->unlim ? num_recs : u;
+    }
+
+    if ( !rd_atts(rd, &hdr->n_atts, &hdr->atts) ) {
+	return 0;
+    }
+
+    if ( !rd_list(rd, CDF_VARIABLE, &n) ) {
+	return 0;
+    }
+    hdr->n_vars = n;
+    if ( !(hdr->vars = carve(rd, n, sizeof(struct CDF_Var))) ) {
+	return 0;
+    }
+    for (v = 0; v < hdr->n_vars; v++) {
+	var = hdr->vars + v;
+	if ( !rd_name(rd, &var->name) || !rd_count(rd, &n)
+		|| n > (uint64_t)hdr->n_dims ) {
+	    return 0;
+	}
+	var->ndims = n;
+	if ( !(var->dim_ids = carve(rd, n, sizeof(int))) ) {
+	    return 0;
+	}
+	for (d = 0; d < var->ndims; d++) {
+	    if ( !rd_count(rd, &u) || u >= (uint64_t)hdr->n_dims ) {
+		return 0;
+	    }
+	    var->dim_ids[d] = u;
+	}
+	if ( !rd_atts(rd, &var->n_atts, &var->atts)
+		|| !rd_uint(rd, 4, &u) || type_size(rd->version, u) == 0 ) {
+	    return 0;
+	}
+	var->xtype = u;
+	if ( !rd_count(rd, &var->vsize)
+		|| !rd_uint(rd, (rd->version == 1) ? 4 : 8, &var->begin) ) {
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+/*
+   Return 1 if n more bytes of header have been read. Otherwise, set
+   rd->more and return 0.
+ */
+static int have(struct CDF_Rd *rd, uint64_t n)
+{
+    if ( (uint64_t)(rd->end - rd->p) < n ) {
+	rd->more = 1;
+	return 0;
+    }
+    return 1;
+}
+
+/*
+   Read an n byte big endian unsigned integer into u. Return 1 on success,
+   0 on failure.
+ */
+static int rd_uint(struct CDF_Rd *rd, size_t n, uint64_t *u)
+{
+    size_t i;
+
+    if ( !have(rd, n) ) {
+	return 0;
+    }
+    for (*u = 0, i = 0; i < n; i++) {
+	*u = (*u << 8) | *rd->p++;
+    }
+    return 1;
+}
+
+/*
+   Read a count or length, which CDF-5 stores in 8 bytes and the other
+   formats in 4. Return 1 on success, 0 on failure.
+ */
+static int rd_count(struct CDF_Rd *rd, uint64_t *u)
+{
+    return rd_uint(rd, (rd->version == 5) ? 8 : 4, u);
+}
+
+/*
+   Read the tag and number of elements of a list, which must have tag tag
+   or be absent. Put the number of elements at n_p. Return 1 on success, 0
+   on failure.
+ */
+static int rd_list(struct CDF_Rd *rd, uint32_t tag, uint64_t *n_p)
+{
+    uint64_t t;
+
+    if ( !rd_uint(rd, 4, &t) || !rd_count(rd, n_p) ) {
+	return 0;
+    }
+
+    /* Each element takes at least 4 bytes */
+    return ((t == tag) || (t == 0 && *n_p == 0))
+	&& *n_p <= rd->file_sz / 4 && *n_p <= INT_MAX;
+}
+
+/*
+   Read a name, padded to 4 bytes, into the arena. Put the address of the
+   nul terminated copy at nm_p. Return 1 on success, 0 on failure.
+ */
+static int rd_name(struct CDF_Rd *rd, char **nm_p)
+{
+    uint64_t l;
+
+    if ( !rd_count(rd, &l) || l == 0 || l > CDF_MAX_NAME ) {
+	return 0;
+    }
+    if ( !have(rd, (l + 3) / 4 * 4) || !(*nm_p = carve(rd, l + 1, 1)) ) {
+	return 0;
+    }
+    memcpy(*nm_p, rd->p, l);
+    (*nm_p)[l] = '\0';
+    rd->p += (l + 3) / 4 * 4;
+    return 1;
+}
+
+/*
+   Read an attribute list. Put the number of attributes at n_p and their
+   address in the arena at atts_p. Values are converted to native byte
+   order. Return 1 on success, 0 on failure.
+ */
+static int rd_atts(struct CDF_Rd *rd, int *n_p, struct CDF_Att **atts_p)
+{
+    uint64_t n, u, nbytes;
+    struct CDF_Att *att;
+    unsigned char *q;
+    size_t sz, i, j;
+    int a;
+
+    if ( !rd_list(rd, CDF_ATTRIBUTE, &n) ) {
+	return 0;
+    }
+    *n_p = n;
+    if ( !(*atts_p = carve(rd, n, sizeof(struct CDF_Att))) ) {
+	return 0;
+    }
+    for (a = 0; a < *n_p; a++) {
+	att = *atts_p + a;
+	if ( !rd_name(rd, &att->name) || !rd_uint(rd, 4, &u)
+		|| (sz = type_size(rd->version, u)) == 0
+		|| !rd_count(rd, &n) || n > rd->file_sz / sz ) {
+	    return 0;
+	}
+	att->xtype = u;
+	att->n = n;
+	nbytes = n * sz;
+	if ( !have(rd, (nbytes + 3) / 4 * 4)
+		|| !(att->vals = q = carve(rd, n, sz)) ) {
+	    return 0;
+	}
+
+	/* Values are big endian. Reverse each one on little endian hosts. */
+	if ( sz == 1 || !Raw_Little_Endian() ) {
+	    memcpy(q, rd->p, nbytes);
+	} else {
+	    for (i = 0; i < n; i++) {
+		for (j = 0; j < sz; j++) {
+		    q[i * sz + j] = rd->p[i * sz + sz - 1 - j];
+		}
+	    }
+	}
+	rd->p += (nbytes + 3) / 4 * 4;
+    }
+    return 1;
+}
+
+/*
+   Return space for n items of sz bytes from the arena, aligned for any
+   type, or NULL if the arena is full.
+ */
+static void *carve(struct CDF_Rd *rd, uint64_t n, size_t sz)
+{
+    unsigned char *p = rd->a;
+    size_t avail = rd->a_end - rd->a;
+
+    if ( n > avail / sz || (n * sz + 7) / 8 * 8 > avail ) {
+	return NULL;
+    }
+    rd->a += (n * sz + 7) / 8 * 8;
+    return p;
+}
+
+/*
+   Return the size of a value of netCDF type xtype in a file of version
+   version, or 0 if the format does not allow the type.
+ */
+static size_t type_size(int version, int xtype)
+{
+    static const size_t sz[] = {0, 1, 1, 2, 4, 4, 8, 1, 2, 4, 8, 8};
+
+    if ( xtype < 1 || xtype > ((version == 5) ? 11 : 6) ) {
+	return 0;
+    }
+    return sz[xtype];
+}
@@ -0,0 +1,89 @@
+/*
+   -	cdfhdr.h --
+   -		Declarations for reading classic netCDF headers
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#ifndef CDFHDR_H_
+#define CDFHDR_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/*
+   Header of a classic (CDF-1), 64 bit offset (CDF-2), or 64 bit data
+   (CDF-5) netCDF file, read without libnetcdf. Types are netCDF type
+   codes, e.g. 5 for NC_FLOAT. Attribute values are in native byte order.
+   Everything, including names and values, lives in one allocation that
+   CDF_Hdr_Free releases.
+ */
+
+struct CDF_Att {
+    char *name;				/* Attribute name */
+    int xtype;				/* Type of values */
+    size_t n;				/* Number of values */
+    void *vals;				/* Values */
+};
+
+struct CDF_Dim {
+    char *name;				/* Dimension name */
+    size_t len;				/* Length, number of records for the
+					   record dimension */
+    int unlim;				/* If true, record dimension */
+};
+
+struct CDF_Var {
+    char *name;				/* Variable name */
+    int xtype;				/* Type of values */
+    int ndims;				/* Number of dimensions */
+    int *dim_ids;			/* Dimension indeces */
+    int n_atts;				/* Number of attributes */
+    struct CDF_Att *atts;		/* Attributes */
+    uint64_t vsize;			/* Bytes per record or variable */
+    uint64_t begin;			/* Offset of data in file */
+};
+
+struct CDF_Hdr {
+    int version;			/* 1, 2, or 5 */
+    size_t hdr_len;			/* Bytes in header */
+    int n_dims;				/* Number of dimensions */
+    struct CDF_Dim *dims;		/* Dimensions */
+    int n_atts;				/* Number of global attributes */
+    struct CDF_Att *atts;		/* Global attributes */
+    int n_vars;				/* Number of variables */
+    struct CDF_Var *vars;		/* Variables */
+    void *arena;			/* Memory for all of the above */
+};
+
+int CDF_Hdr_Read(const char *, struct CDF_Hdr *);
+void CDF_Hdr_Free(struct CDF_Hdr *);
+
+#endif
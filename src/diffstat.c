@@ -0,0 +1,370 @@
+/*
+   -	diffstat.c --
+   -		This file defines accumulators for statistics of
+   -		the difference between two fields. See diffstat.h.
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "diffstat.h"
+
+/* Sign bit of a double */
+#define SIGN64 (UINT64_C(1) << 63)
+
+/* Initialize accumulator stats to empty. */
+void Diff_Init(struct Diff_Stats *stats)
+{
+    memset(stats, 0, sizeof(struct Diff_Stats));
+}
+
+/*
+   Compute statistics for the n pairs in arrays x1 and x2 and store them in
+   stats, replacing its previous contents. Values with absolute value ign or
+   greater are skipped. ulp tells how to compute ULP distances. Indeces
+   stored in stats are offsets into x1 and x2.
+
+   The block is visited twice, once for means and extrema and once for
+   deviations from the means. Both passes run over memory the caller has
+   already filled, so the file is only read once.
+ */
+void Diff_Block(struct Diff_Stats *stats, const double *x1, const double *x2,
+	size_t n, double ign, enum Diff_ULP ulp)
+{
+    double s1, s2, ps1, ps2, ds;	/* Sums */
+    double v1, v2, d, ad;		/* Values, difference */
+    double r;				/* Relative difference */
+    unsigned long long u;		/* ULP distance */
+    int b;				/* Histogram bin */
+    size_t i;
+
+    Diff_Init(stats);
+    if ( n == 0 ) {
+	return;
+    }
+
+    /* Pass 1 - counts, sums, extrema */
+    for (s1 = s2 = ps1 = ps2 = ds = 0.0, i = 0; i < n; i++) {
+	v1 = x1[i];
+	v2 = x2[i];
+	if ( fabs(v1) < ign ) {
+	    s1 += v1;
+	    stats->n1++;
+	}
+	if ( fabs(v2) < ign ) {
+	    s2 += v2;
+	    stats->n2++;
+	}
+	if ( !(fabs(v1) < ign && fabs(v2) < ign) ) {
+	    continue;
+	}
+	ps1 += v1;
+	ps2 += v2;
+	d = v2 - v1;
+	ds += d;
+	stats->nd++;
+	if ( d == 0.0 ) {
+	    continue;
+	}
+	stats->n_diff++;
+	ad = fabs(d);
+	if ( ad > stats->max_abs ) {
+	    stats->max_abs = ad;
+	    stats->max_abs_idx = i;
+	}
+	if ( v1 != 0.0 && (r = ad / fabs(v1)) > stats->max_rel ) {
+	    stats->max_rel = r;
+	    stats->max_rel_idx = i;
+	}
+	if ( ulp != DIFF_ULP_NONE
+		&& (u = Diff_ULP(v1, v2, ulp)) > stats->max_ulp ) {
+	    stats->max_ulp = u;
+	    stats->max_ulp_idx = i;
+	}
+	b = (int)floor(log10(ad)) - DIFF_HIST_MIN;
+	b = (b < 0) ? 0 : (b >= DIFF_HIST_N) ? DIFF_HIST_N - 1 : b;
+	stats->hist[b]++;
+    }
+    if ( stats->n1 > 0 ) {
+	stats->mean1 = s1 / stats->n1;
+    }
+    if ( stats->n2 > 0 ) {
+	stats->mean2 = s2 / stats->n2;
+    }
+    if ( stats->nd > 0 ) {
+	stats->pmean1 = ps1 / stats->nd;
+	stats->pmean2 = ps2 / stats->nd;
+	stats->dmean = ds / stats->nd;
+    }
+
+    /* Pass 2 - second moments */
+    for (i = 0; i < n; i++) {
+	double e1, e2, pe1, pe2, de;
+
+	v1 = x1[i];
+	v2 = x2[i];
+	if ( fabs(v1) < ign ) {
+	    e1 = v1 - stats->mean1;
+	    stats->ss1 += e1 * e1;
+	}
+	if ( fabs(v2) < ign ) {
+	    e2 = v2 - stats->mean2;
+	    stats->ss2 += e2 * e2;
+	}
+	if ( fabs(v1) < ign && fabs(v2) < ign ) {
+	    pe1 = v1 - stats->pmean1;
+	    pe2 = v2 - stats->pmean2;
+	    de = (v2 - v1) - stats->dmean;
+	    stats->pss1 += pe1 * pe1;
+	    stats->pss2 += pe2 * pe2;
+	    stats->psp += pe1 * pe2;
+	    stats->dss += de * de;
+	}
+    }
+}
+
+/*
+   Combine mean and sum of squared deviations for a sample of na values with
+   those of a sample of nb values. See Chan, Golub, and LeVeque, "Algorithms
+   for computing the sample variance", The American Statistician, 1983.
+ */
+void Diff_Merge_Moments(size_t na, double *mean_a, double *ss_a,
+	size_t nb, double mean_b, double ss_b)
+{
+    double n = (double)na + (double)nb;
+    double delta = mean_b - *mean_a;
+
+    if ( nb == 0 ) {
+	return;
+    }
+    if ( na == 0 ) {
+	*mean_a = mean_b;
+	*ss_a = ss_b;
+	return;
+    }
+    *ss_a += ss_b + delta * delta * na * nb / n;
+    *mean_a += delta * nb / n;
+}
+
+/*
+   Add the statistics in b to a. Indeces in b must already refer to the
+   same array as indeces in a.
+ */
+void Diff_Merge(struct Diff_Stats *a, const struct Diff_Stats *b)
+{
+    int i;
+
+    Diff_Merge_Moments(a->n1, &a->mean1, &a->ss1,
+	    b->n1, b->mean1, b->ss1);
+    a->n1 += b->n1;
+    Diff_Merge_Moments(a->n2, &a->mean2, &a->ss2,
+	    b->n2, b->mean2, b->ss2);
+    a->n2 += b->n2;
+    if ( b->nd > 0 ) {
+	if ( a->nd == 0 ) {
+	    a->pmean1 = b->pmean1;
+	    a->pmean2 = b->pmean2;
+	    a->pss1 = b->pss1;
+	    a->pss2 = b->pss2;
+	    a->psp = b->psp;
+	    a->dmean = b->dmean;
+	    a->dss = b->dss;
+	} else {
+	    double n = (double)a->nd + (double)b->nd;
+	    double d1 = b->pmean1 - a->pmean1;
+	    double d2 = b->pmean2 - a->pmean2;
+
+	    a->psp += b->psp + d1 * d2 * a->nd * b->nd / n;
+	    Diff_Merge_Moments(a->nd, &a->pmean1, &a->pss1,
+		    b->nd, b->pmean1, b->pss1);
+	    Diff_Merge_Moments(a->nd, &a->pmean2, &a->pss2,
+		    b->nd, b->pmean2, b->pss2);
+	    Diff_Merge_Moments(a->nd, &a->dmean, &a->dss,
+		    b->nd, b->dmean, b->dss);
+	}
+	a->nd += b->nd;
+    }
+    a->n_diff += b->n_diff;
+    if ( b->max_abs > a->max_abs ) {
+	a->max_abs = b->max_abs;
+	a->max_abs_idx = b->max_abs_idx;
+    }
+    if ( b->max_rel > a->max_rel ) {
+	a->max_rel = b->max_rel;
+	a->max_rel_idx = b->max_rel_idx;
+    }
+    if ( b->max_ulp > a->max_ulp ) {
+	a->max_ulp = b->max_ulp;
+	a->max_ulp_idx = b->max_ulp_idx;
+    }
+    for (i = 0; i < DIFF_HIST_N; i++) {
+	a->hist[i] += b->hist[i];
+    }
+}
+
+/*
+   Store in stats, replacing its previous contents, statistics for two
+   identical fields with n valid values whose mean is mean and whose sum
+   of squared deviations from the mean is ss.
+ */
+void Diff_Same(struct Diff_Stats *stats, size_t n, double mean, double ss)
+{
+    Diff_Init(stats);
+    stats->n1 = stats->n2 = stats->nd = n;
+    stats->mean1 = stats->mean2 = stats->pmean1 = stats->pmean2 = mean;
+    stats->ss1 = stats->ss2 = stats->pss1 = stats->pss2 = stats->psp = ss;
+}
+
+/*
+   Return the number of representable values of the type given by ulp from
+   v1 to v2. The bit patterns are mapped to integers that increase
+   monotonically with value, so that the distance is a subtraction.
+ */
+unsigned long long Diff_ULP(double v1, double v2, enum Diff_ULP ulp)
+{
+    int64_t i1, i2;
+
+    switch (ulp) {
+	case DIFF_ULP_FLOAT:
+	    {
+		float f1 = (float)v1, f2 = (float)v2;
+		int32_t b1, b2;
+
+		memcpy(&b1, &f1, sizeof(b1));
+		memcpy(&b2, &f2, sizeof(b2));
+		i1 = (b1 < 0) ? (int64_t)INT32_MIN - b1 : b1;
+		i2 = (b2 < 0) ? (int64_t)INT32_MIN - b2 : b2;
+	    }
+	    break;
+	case DIFF_ULP_DOUBLE:
+	    {
+		uint64_t u1, u2;
+
+		/*
+		   Map sign-magnitude to offset binary in unsigned arithmetic
+		   to avoid overflow.
+		 */
+
+		memcpy(&u1, &v1, sizeof(u1));
+		memcpy(&u2, &v2, sizeof(u2));
+		u1 = (u1 >> 63) ? SIGN64 - (u1 & ~SIGN64) : SIGN64 + u1;
+		u2 = (u2 >> 63) ? SIGN64 - (u2 & ~SIGN64) : SIGN64 + u2;
+		return (u1 > u2) ? u1 - u2 : u2 - u1;
+	    }
+	case DIFF_ULP_NONE:
+	default:
+	    return 0;
+    }
+    return (i1 > i2) ? (unsigned long long)(i1 - i2)
+	: (unsigned long long)(i2 - i1);
+}
+
+/*
+   Count pairs in arrays x1 and x2, with n elements, that violate tolerances
+   tol. Values with absolute value ign or greater are not valid. Stop
+   counting at max_viol violations, unless max_viol is 0. Store the offsets
+   of the first and last violations counted at first and last, if there are
+   any.
+ */
+size_t Diff_Viol(const double *x1, const double *x2, size_t n, double ign,
+	const struct Diff_Tol *tol, size_t max_viol, size_t *first,
+	size_t *last)
+{
+    size_t n_viol;			/* Return value */
+    int has_tol;			/* True if any tolerance is set */
+    int valid1, valid2;
+    double ad;				/* Absolute difference */
+    size_t i;
+
+    has_tol = tol->has_abs || tol->has_rel || tol->has_ulp;
+    for (n_viol = 0, i = 0; i < n; i++) {
+	valid1 = fabs(x1[i]) < ign;
+	valid2 = fabs(x2[i]) < ign;
+	if ( valid1 && valid2 ) {
+	    if ( x1[i] == x2[i] ) {
+		continue;
+	    }
+	    ad = fabs(x2[i] - x1[i]);
+	    if ( has_tol ) {
+		if ( tol->has_abs && ad <= tol->abs ) {
+		    continue;
+		}
+		if ( tol->has_rel && ad <= tol->rel * fabs(x1[i]) ) {
+		    continue;
+		}
+		if ( tol->has_ulp && ((tol->ulp_type == DIFF_ULP_NONE)
+			    ? ad : Diff_ULP(x1[i], x2[i], tol->ulp_type))
+			<= tol->ulp ) {
+		    continue;
+		}
+	    }
+	} else if ( valid1 == valid2 ) {
+	    continue;
+	}
+	if ( n_viol == 0 ) {
+	    *first = i;
+	}
+	*last = i;
+	if ( ++n_viol == max_viol ) {
+	    break;
+	}
+    }
+    return n_viol;
+}
+
+/* Root mean square of field 1 */
+double Diff_RMS1(const struct Diff_Stats *stats)
+{
+    return (stats->n1 > 0)
+	? sqrt(stats->ss1 / stats->n1 + stats->mean1 * stats->mean1) : NAN;
+}
+
+/* Root mean square of field 2 */
+double Diff_RMS2(const struct Diff_Stats *stats)
+{
+    return (stats->n2 > 0)
+	? sqrt(stats->ss2 / stats->n2 + stats->mean2 * stats->mean2) : NAN;
+}
+
+/* Mean square difference */
+double Diff_MSD(const struct Diff_Stats *stats)
+{
+    return (stats->nd > 0)
+	? stats->dss / stats->nd + stats->dmean * stats->dmean : NAN;
+}
+
+/* Correlation of field 1 and field 2 over valid pairs */
+double Diff_Corr(const struct Diff_Stats *stats)
+{
+    return (stats->pss1 > 0.0 && stats->pss2 > 0.0)
+	? stats->psp / sqrt(stats->pss1 * stats->pss2) : NAN;
+}
@@ -0,0 +1,119 @@
+/*
+   -	diffstat.h --
+   -		This file declares accumulators for statistics of
+   -		the difference between two fields.
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#ifndef DIFFSTAT_H_
+#define DIFFSTAT_H_
+
+#include <stdlib.h>
+
+/*
+   Histogram of absolute differences. Bin b counts differing pairs with
+   10^(DIFF_HIST_MIN + b) <= |diff| < 10^(DIFF_HIST_MIN + b + 1). The first
+   and last bins also count differences beyond their ends.
+ */
+
+#define DIFF_HIST_MIN -15
+#define DIFF_HIST_N 25
+
+/* How to measure distance in units in the last place */
+enum Diff_ULP {
+    DIFF_ULP_NONE, DIFF_ULP_FLOAT, DIFF_ULP_DOUBLE
+};
+
+/*
+   Statistics for two fields and their difference, field 2 - field 1. Values
+   with absolute value greater than or equal to the ignore threshold do not
+   contribute. Second moments are kept as sums of squared deviations, so that
+   accumulators for separate blocks can be merged without loss of precision.
+ */
+
+struct Diff_Stats {
+    size_t n1, n2;			/* Number of valid values in field 1,
+					   field 2 */
+    double mean1, mean2;		/* Means of valid values */
+    double ss1, ss2;			/* Sums of squared deviations from
+					   mean1, mean2 */
+    size_t nd;				/* Number of pairs in which both values
+					   are valid */
+    double pmean1, pmean2;		/* Means of fields over valid pairs */
+    double pss1, pss2;			/* Sums of squared deviations from
+					   pmean1, pmean2 */
+    double psp;				/* Sum of products of deviations */
+    double dmean;			/* Mean difference */
+    double dss;				/* Sum of squared deviations from
+					   dmean */
+    size_t n_diff;			/* Number of pairs that differ */
+    double max_abs;			/* Maximum absolute difference */
+    size_t max_abs_idx;			/* Index of max_abs */
+    double max_rel;			/* Maximum relative difference,
+					   |diff| / |field 1| */
+    size_t max_rel_idx;			/* Index of max_rel */
+    unsigned long long max_ulp;		/* Maximum distance in ULP */
+    size_t max_ulp_idx;			/* Index of max_ulp */
+    size_t hist[DIFF_HIST_N];		/* Histogram of |diff| */
+};
+
+/*
+   Tolerances for a pass/fail comparison. A pair of values violates the
+   tolerances if its difference exceeds every tolerance that is set, or if
+   only one of the values is valid. If no tolerance is set, any difference
+   is a violation. For integer types, the ULP distance is the absolute
+   difference.
+ */
+
+struct Diff_Tol {
+    int has_abs, has_rel, has_ulp;	/* If true, corresponding tolerance
+					   is set */
+    double abs;				/* Absolute tolerance */
+    double rel;				/* Tolerance relative to field 1 */
+    unsigned long long ulp;		/* Tolerance in ULP */
+    enum Diff_ULP ulp_type;		/* How to compute ULP distance */
+};
+
+void Diff_Init(struct Diff_Stats *);
+void Diff_Block(struct Diff_Stats *, const double *, const double *, size_t,
+	double, enum Diff_ULP);
+void Diff_Merge(struct Diff_Stats *, const struct Diff_Stats *);
+void Diff_Merge_Moments(size_t, double *, double *, size_t, double, double);
+void Diff_Same(struct Diff_Stats *, size_t, double, double);
+unsigned long long Diff_ULP(double, double, enum Diff_ULP);
+size_t Diff_Viol(const double *, const double *, size_t, double,
+	const struct Diff_Tol *, size_t, size_t *, size_t *);
+double Diff_RMS1(const struct Diff_Stats *);
+double Diff_RMS2(const struct Diff_Stats *);
+double Diff_MSD(const struct Diff_Stats *);
+double Diff_Corr(const struct Diff_Stats *);
+
+#endif
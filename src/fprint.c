@@ -0,0 +1,392 @@
+/*
+   -	fprint.c --
+   -		This file defines functions that store content
+   -		fingerprints of variables in NetCDF files. See fprint.h.
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#define _XOPEN_SOURCE 700		/* For st_mtim */
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include "alloc.h"
+#include "fprint.h"
+
+/* Identifies a fingerprint file and its format version */
+#define FP_MAGIC "NCFP0002"
+#define FP_MAGIC_LEN 8
+
+/* 64 bit FNV offset basis and prime */
+#define FNV_BASIS UINT64_C(0xcbf29ce484222325)
+#define FNV_PRIME UINT64_C(0x100000001b3)
+
+static int write_str(FILE *, const char *);
+static char *read_str(FILE *);
+
+/*
+   Initialize fp for variable var_nm with ndims dimensions of lengths len in
+   data file path, which is stored as an absolute path, visited in blocks
+   of at most blk_elem elements, with ign as the ignore threshold. Identity
+   of the data file comes from stat, with modification time to the
+   nanosecond where the system provides it. The fingerprint starts with no
+   blocks. Return 1 on success. On failure, return 0 and print a message
+   to stderr.
+ */
+int Fp_Init(struct Fp *fp, const char *path, const char *var_nm, double ign,
+	size_t blk_elem, int ndims, const size_t *len)
+{
+    struct stat sbuf;
+    char abs_path[PATH_MAX];
+    int d;
+
+    memset(fp, 0, sizeof(struct Fp));
+    if ( !realpath(path, abs_path) ) {
+	fprintf(stderr, "Could not get absolute path for %s.\n", path);
+	return 0;
+    }
+    if ( stat(abs_path, &sbuf) == -1 ) {
+	fprintf(stderr, "Could not get status of %s.\n", path);
+	perror(NULL);
+	return 0;
+    }
+    fp->dev = sbuf.st_dev;
+    fp->ino = sbuf.st_ino;
+#if _POSIX_VERSION >= 200809L
+    fp->mtime = (long long)sbuf.st_mtim.tv_sec * 1000000000LL
+	+ sbuf.st_mtim.tv_nsec;
+#else
+    fp->mtime = (long long)sbuf.st_mtime * 1000000000LL;
+#endif
+    fp->size = sbuf.st_size;
+    fp->ign = ign;
+    fp->blk_elem = blk_elem;
+    fp->ndims = ndims;
+    if ( !(fp->path = MALLOC(strlen(abs_path) + 1))
+	    || !(fp->var_nm = MALLOC(strlen(var_nm) + 1))
+	    || !(fp->len = CALLOC(ndims + 1, sizeof(size_t))) ) {
+	fprintf(stderr, "Could not allocate fingerprint for %s in %s.\n",
+		var_nm, path);
+	Fp_Free(fp);
+	return 0;
+    }
+    strcpy(fp->path, abs_path);
+    strcpy(fp->var_nm, var_nm);
+    for (d = 0; d < ndims; d++) {
+	fp->len[d] = len[d];
+    }
+    return 1;
+}
+
+/* Free memory associated with fp. */
+void Fp_Free(struct Fp *fp)
+{
+    FREE(fp->path);
+    FREE(fp->var_nm);
+    FREE(fp->len);
+    FREE(fp->blks);
+    memset(fp, 0, sizeof(struct Fp));
+}
+
+/*
+   Append a block with hash, number of valid values n, and mean and sum of
+   squared deviations of valid values mean and ss to fp. Return 1 on
+   success, 0 on failure.
+ */
+int Fp_Add(struct Fp *fp, unsigned long long hash, size_t n, double mean,
+	double ss)
+{
+    struct Fp_Blk *blks;
+    size_t n_alloc;
+
+    /* Grow block array when n_blks reaches a power of 2 */
+    if ( (fp->n_blks & (fp->n_blks - 1)) == 0 ) {
+	n_alloc = (fp->n_blks == 0) ? 1 : 2 * fp->n_blks;
+	if ( !(blks = REALLOC(fp->blks, n_alloc * sizeof(struct Fp_Blk))) ) {
+	    return 0;
+	}
+	fp->blks = blks;
+    }
+    fp->blks[fp->n_blks].hash = hash;
+    fp->blks[fp->n_blks].n = n;
+    fp->blks[fp->n_blks].mean = mean;
+    fp->blks[fp->n_blks].ss = ss;
+    fp->n_blks++;
+    return 1;
+}
+
+/*
+   Return the path of the entry in store directory dir for variable var_nm
+   in data file path. The entry name is a hash of the absolute path of the
+   data file and the variable name. Return value should be freed with FREE.
+   Return NULL on failure.
+ */
+char *Fp_Entry(const char *dir, const char *path, const char *var_nm)
+{
+    char abs_path[PATH_MAX];
+    uint64_t h;
+    const char *c;
+    char *entry;
+    size_t len;
+
+    if ( !realpath(path, abs_path) ) {
+	fprintf(stderr, "Could not get absolute path for %s.\n", path);
+	return NULL;
+    }
+    for (h = FNV_BASIS, c = abs_path; *c; c++) {
+	h = (h ^ (unsigned char)*c) * FNV_PRIME;
+    }
+    h = (h ^ '/') * FNV_PRIME;
+    for (c = var_nm; *c; c++) {
+	h = (h ^ (unsigned char)*c) * FNV_PRIME;
+    }
+    len = strlen(dir) + 32;
+    if ( !(entry = MALLOC(len)) ) {
+	fprintf(stderr, "Could not allocate fingerprint entry name.\n");
+	return NULL;
+    }
+    snprintf(entry, len, "%s/%016llx.ncfp", dir, (unsigned long long)h);
+    return entry;
+}
+
+/*
+   Read fingerprint entry at path ent into fp. Return 1 on success, or 0 if
+   the entry does not exist or cannot be read.
+ */
+int Fp_Read(const char *ent, struct Fp *fp)
+{
+    FILE *in;
+    char magic[FP_MAGIC_LEN];
+    unsigned long long u[7];
+    int32_t ndims;
+    size_t b;
+
+    memset(fp, 0, sizeof(struct Fp));
+    if ( !(in = fopen(ent, "r")) ) {
+	return 0;
+    }
+    if ( fread(magic, 1, FP_MAGIC_LEN, in) != FP_MAGIC_LEN
+	    || memcmp(magic, FP_MAGIC, FP_MAGIC_LEN) != 0
+	    || !(fp->path = read_str(in))
+	    || !(fp->var_nm = read_str(in))
+	    || fread(u, sizeof(u[0]), 7, in) != 7
+	    || fread(&fp->ign, sizeof(fp->ign), 1, in) != 1
+	    || fread(&ndims, sizeof(ndims), 1, in) != 1
+	    || ndims < 0 ) {
+	goto error;
+    }
+    fp->dev = u[0];
+    fp->ino = u[1];
+    fp->mtime = (long long)u[2];
+    fp->size = (long long)u[3];
+    fp->blk_elem = u[4];
+    fp->n_blks = u[5];
+    fp->ndims = ndims;
+    if ( u[6] != fp->n_blks
+	    || !(fp->len = CALLOC(ndims + 1, sizeof(size_t)))
+	    || fread(fp->len, sizeof(size_t), ndims, in) != ndims
+	    || !(fp->blks = CALLOC(fp->n_blks + 1, sizeof(struct Fp_Blk))) ) {
+	goto error;
+    }
+    for (b = 0; b < fp->n_blks; b++) {
+	if ( fread(&fp->blks[b].hash, sizeof(unsigned long long), 1, in) != 1
+		|| fread(&fp->blks[b].n, sizeof(size_t), 1, in) != 1
+		|| fread(&fp->blks[b].mean, sizeof(double), 1, in) != 1
+		|| fread(&fp->blks[b].ss, sizeof(double), 1, in) != 1 ) {
+	    goto error;
+	}
+    }
+    fclose(in);
+    return 1;
+
+error:
+    fclose(in);
+    Fp_Free(fp);
+    return 0;
+}
+
+/*
+   Return true if stored fingerprint fp describes the same data file,
+   variable, shape, blocking and ignore threshold as cur, which should come
+   from Fp_Init for the current data file. Blocks are not compared.
+ */
+int Fp_Match(const struct Fp *fp, const struct Fp *cur)
+{
+    int d;
+
+    if ( !fp->path || !cur->path
+	    || strcmp(fp->path, cur->path) != 0
+	    || strcmp(fp->var_nm, cur->var_nm) != 0
+	    || fp->dev != cur->dev || fp->ino != cur->ino
+	    || fp->mtime != cur->mtime || fp->size != cur->size
+	    || fp->blk_elem != cur->blk_elem
+	    || !(fp->ign == cur->ign)
+	    || fp->ndims != cur->ndims ) {
+	return 0;
+    }
+    for (d = 0; d < fp->ndims; d++) {
+	if ( fp->len[d] != cur->len[d] ) {
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+/*
+   Write fingerprint fp to entry at path ent. Data go to a temporary file
+   which then replaces the entry, so concurrent readers never see a partial
+   entry. Return 1 on success. On failure, print a message to stderr and
+   return 0.
+ */
+int Fp_Write(const char *ent, const struct Fp *fp)
+{
+    char *tmp;
+    int fd;
+    FILE *out = NULL;
+    unsigned long long u[7];
+    int32_t ndims = fp->ndims;
+    size_t b;
+
+    if ( !(tmp = MALLOC(strlen(ent) + 8)) ) {
+	fprintf(stderr, "Could not allocate name for temporary file.\n");
+	return 0;
+    }
+    sprintf(tmp, "%s.XXXXXX", ent);
+    if ( (fd = mkstemp(tmp)) == -1 || !(out = fdopen(fd, "w")) ) {
+	fprintf(stderr, "Could not create fingerprint file %s.\n", tmp);
+	perror(NULL);
+	if ( fd != -1 ) {
+	    close(fd);
+	    unlink(tmp);
+	}
+	FREE(tmp);
+	return 0;
+    }
+    u[0] = fp->dev;
+    u[1] = fp->ino;
+    u[2] = (unsigned long long)fp->mtime;
+    u[3] = (unsigned long long)fp->size;
+    u[4] = fp->blk_elem;
+    u[5] = fp->n_blks;
+    u[6] = fp->n_blks;
+    if ( fwrite(FP_MAGIC, 1, FP_MAGIC_LEN, out) != FP_MAGIC_LEN
+	    || !write_str(out, fp->path)
+	    || !write_str(out, fp->var_nm)
+	    || fwrite(u, sizeof(u[0]), 7, out) != 7
+	    || fwrite(&fp->ign, sizeof(fp->ign), 1, out) != 1
+	    || fwrite(&ndims, sizeof(ndims), 1, out) != 1
+	    || fwrite(fp->len, sizeof(size_t), ndims, out) != ndims ) {
+	goto error;
+    }
+    for (b = 0; b < fp->n_blks; b++) {
+	if ( fwrite(&fp->blks[b].hash, sizeof(unsigned long long), 1, out) != 1
+		|| fwrite(&fp->blks[b].n, sizeof(size_t), 1, out) != 1
+		|| fwrite(&fp->blks[b].mean, sizeof(double), 1, out) != 1
+		|| fwrite(&fp->blks[b].ss, sizeof(double), 1, out) != 1 ) {
+	    goto error;
+	}
+    }
+    if ( fclose(out) == EOF ) {
+	out = NULL;
+	goto error;
+    }
+    if ( rename(tmp, ent) == -1 ) {
+	fprintf(stderr, "Could not move fingerprint file %s to %s.\n",
+		tmp, ent);
+	perror(NULL);
+	unlink(tmp);
+	FREE(tmp);
+	return 0;
+    }
+    FREE(tmp);
+    return 1;
+
+error:
+    fprintf(stderr, "Could not write fingerprint file %s.\n", tmp);
+    if ( out ) {
+	fclose(out);
+    }
+    unlink(tmp);
+    FREE(tmp);
+    return 0;
+}
+
+/*
+   Return a hash of the n values in x. This is FNV-1a applied to 64 bit
+   words, with a shift after each multiply so that high bits also reach the
+   low bits. It detects changes, but is not meant to resist deliberate
+   collisions.
+ */
+unsigned long long Fp_Hash(const double *x, size_t n)
+{
+    uint64_t h, w;
+    size_t i;
+
+    for (h = FNV_BASIS ^ n, i = 0; i < n; i++) {
+	memcpy(&w, x + i, sizeof(w));
+	h = (h ^ w) * FNV_PRIME;
+	h ^= h >> 32;
+    }
+    return h;
+}
+
+/* Write a length and string to out. Return 1 on success, 0 on failure. */
+static int write_str(FILE *out, const char *s)
+{
+    uint32_t len = strlen(s);
+
+    return fwrite(&len, sizeof(len), 1, out) == 1
+	&& fwrite(s, 1, len, out) == len;
+}
+
+/*
+   Read a string written by write_str from in. Return value should be freed
+   with FREE. Return NULL on failure.
+ */
+static char *read_str(FILE *in)
+{
+    uint32_t len;
+    char *s;
+
+    if ( fread(&len, sizeof(len), 1, in) != 1 || len > PATH_MAX
+	    || !(s = MALLOC(len + 1)) ) {
+	return NULL;
+    }
+    if ( fread(s, 1, len, in) != len ) {
+	FREE(s);
+	return NULL;
+    }
+    s[len] = '\0';
+    return s;
+}
@@ -0,0 +1,86 @@
+/*
+   -	fprint.h --
+   -		This file declares functions that store content
+   -		fingerprints of variables in NetCDF files.
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#ifndef FPRINT_H_
+#define FPRINT_H_
+
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <time.h>
+
+/*
+   A fingerprint records, for each block of a variable as visited by a
+   slab iterator (see slab.h), a hash of the block values and summary
+   statistics of the values that were not ignored. Fingerprints are kept
+   in a store directory, one file per data file and variable. A fingerprint
+   is only valid while the data file keeps the same device, inode,
+   modification time and size.
+ */
+
+struct Fp_Blk {
+    unsigned long long hash;		/* Hash of block values */
+    size_t n;				/* Number of valid values */
+    double mean;			/* Mean of valid values */
+    double ss;				/* Sum of squared deviations from
+					   mean */
+};
+
+struct Fp {
+    char *path;				/* Path to data file */
+    char *var_nm;			/* Variable name */
+    unsigned long long dev, ino;	/* Device and inode of data file */
+    long long mtime, size;		/* Modification time, nanoseconds,
+					   and size */
+    double ign;				/* Ignore values with absolute value
+					   greater than or equal to ign */
+    size_t blk_elem;			/* Maximum number of elements
+					   per block */
+    int ndims;				/* Dimensions of variable */
+    size_t *len;			/* Dimension lengths */
+    size_t n_blks;			/* Number of blocks */
+    struct Fp_Blk *blks;		/* Block fingerprints */
+};
+
+int Fp_Init(struct Fp *, const char *, const char *, double, size_t, int,
+	const size_t *);
+void Fp_Free(struct Fp *);
+int Fp_Add(struct Fp *, unsigned long long, size_t, double, double);
+char *Fp_Entry(const char *, const char *, const char *);
+int Fp_Read(const char *, struct Fp *);
+int Fp_Match(const struct Fp *, const struct Fp *);
+int Fp_Write(const char *, const struct Fp *);
+unsigned long long Fp_Hash(const double *, size_t);
+
+#endif
@@ -0,0 +1,352 @@
+/*
+   -	h5chunk.c --
+   -		Copying compressed chunks with HDF5
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "alloc.h"
+#include "h5chunk.h"
+
+/* Maximum number of filter parameters compared */
+#define H5CHUNK_CD 32
+
+/*
+   Return true if the output chunk at offset off[0 .. ndims - 1], relative
+   to a selection of sel_count values starting at sel_start in a variable
+   with dimension lengths len and chunk lengths chunk, holds the same values
+   as an input chunk. This is so if the chunk lies inside the selection, or
+   if it reaches past the end of the selection only where the selection
+   reaches the end of the input, so both chunks are partial in the same way.
+ */
+int H5Chunk_Whole(int ndims, const size_t *off, const size_t *sel_start,
+	const size_t *sel_count, const size_t *len, const size_t *chunk)
+{
+    int d;
+
+    for (d = 0; d < ndims; d++) {
+	if ( sel_start[d] % chunk[d] != 0 ) {
+	    return 0;
+	}
+	if ( off[d] + chunk[d] > sel_count[d]
+		&& sel_start[d] + sel_count[d] != len[d] ) {
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+#ifdef HAVE_HDF5
+
+static int same_storage(hid_t, hid_t);
+
+/*
+   Open the dataset for netCDF-4 variable var_nm in HDF5 file h5_id. netCDF-4
+   stores a variable as a dataset with the same name, or with a prefix if a
+   dimension with that name is not its coordinate. Return the dataset
+   identifier, or a negative value if there is no such dataset.
+ */
+hid_t H5Chunk_Dset(hid_t h5_id, const char *var_nm)
+{
+    hid_t ds_id;
+    char nm[256 + 16];
+
+    if ( (ds_id = H5Dopen2(h5_id, var_nm, H5P_DEFAULT)) < 0 ) {
+	snprintf(nm, sizeof(nm), "_nc4_non_coord_%s", var_nm);
+	ds_id = H5Dopen2(h5_id, nm, H5P_DEFAULT);
+    }
+    return ds_id;
+}
+
+/*
+   Copy the whole chunks, as identified by H5Chunk_Whole, of the selection
+   sel_start, sel_count from variable var_nm in HDF5 file in_id to the same
+   variable in out_id. The variable has ndims dimensions with lengths len in
+   the input, and chunk lengths chunk in both files. The output variable
+   has dimension lengths sel_count. If both datasets store values the same
+   way, chunks are copied as they are in the file. Otherwise, they are read
+   and written through the HDF5 filters. Chunks never written in the input
+   are skipped. Put the number of chunks copied unchanged at n_raw_p and the
+   number read and written at n_cooked_p. Return 1 on success. On failure,
+   print a message to stderr and return 0.
+ */
+int H5Chunk_Copy(hid_t in_id, hid_t out_id, const char *var_nm, int ndims,
+	const size_t *sel_start, const size_t *sel_count, const size_t *len,
+	const size_t *chunk, size_t *n_raw_p, size_t *n_cooked_p)
+{
+    hid_t in_ds = -1, out_ds = -1;	/* Datasets */
+    hid_t in_sp = -1, out_sp = -1;	/* Dataspaces in files */
+    hid_t mem_sp = -1;			/* Dataspace in memory */
+    hid_t f_type = -1, m_type = -1;	/* Value types, in file and memory */
+    int raw;				/* If true, copy chunks unchanged */
+    size_t *off = NULL;			/* Offset of chunk in output */
+    size_t *n_chk = NULL;		/* Number of chunks along each
+					   dimension of output */
+    hsize_t *in_off = NULL;		/* Offset of chunk in input */
+    hsize_t *out_off = NULL;		/* Offset of chunk in output */
+    hsize_t *count = NULL;		/* Size of chunk, clipped to output */
+    hsize_t *out_dims = NULL;		/* Current output dimensions */
+    hsize_t sz;				/* Size of a chunk in the file */
+    uint32_t mask;			/* Filters skipped for a chunk */
+    void *buf = NULL;			/* Chunk contents */
+    size_t buf_sz = 0;			/* Allocation at buf */
+    size_t n_elem, m_sz;		/* Values in chunk, size of value */
+    size_t k, n_chunks;
+    int d;
+    int ok = 0;
+
+    *n_raw_p = *n_cooked_p = 0;
+    if ( ndims == 0 ) {
+	return 1;
+    }
+    if ( !(off = CALLOC(ndims, sizeof(size_t)))
+	    || !(n_chk = CALLOC(ndims, sizeof(size_t)))
+	    || !(in_off = CALLOC(ndims, sizeof(hsize_t)))
+	    || !(out_off = CALLOC(ndims, sizeof(hsize_t)))
+	    || !(count = CALLOC(ndims, sizeof(hsize_t)))
+	    || !(out_dims = CALLOC(ndims, sizeof(hsize_t))) ) {
+	fprintf(stderr, "Could not allocate chunk offsets for %s.\n", var_nm);
+	goto end;
+    }
+    if ( (in_ds = H5Chunk_Dset(in_id, var_nm)) < 0
+	    || (out_ds = H5Chunk_Dset(out_id, var_nm)) < 0 ) {
+	fprintf(stderr, "Could not find dataset for %s.\n", var_nm);
+	goto end;
+    }
+
+    /*
+       Unlimited dimensions grow as netCDF writes values. Chunks written
+       directly do not extend the dataset, so extend it here.
+     */
+
+    if ( (out_sp = H5Dget_space(out_ds)) < 0
+	    || H5Sget_simple_extent_ndims(out_sp) != ndims
+	    || H5Sget_simple_extent_dims(out_sp, out_dims, NULL) < 0 ) {
+	fprintf(stderr, "Could not get output dimensions for %s.\n", var_nm);
+	goto end;
+    }
+    for (d = 0; d < ndims; d++) {
+	if ( out_dims[d] < sel_count[d] ) {
+	    break;
+	}
+    }
+    if ( d < ndims ) {
+	for (d = 0; d < ndims; d++) {
+	    out_dims[d] = sel_count[d];
+	}
+	H5Sclose(out_sp);
+	if ( H5Dset_extent(out_ds, out_dims) < 0
+		|| (out_sp = H5Dget_space(out_ds)) < 0 ) {
+	    out_sp = -1;
+	    fprintf(stderr, "Could not extend output for %s.\n", var_nm);
+	    goto end;
+	}
+    }
+    if ( (in_sp = H5Dget_space(in_ds)) < 0
+	    || (f_type = H5Dget_type(in_ds)) < 0
+	    || (m_type = H5Tget_native_type(f_type, H5T_DIR_DEFAULT)) < 0 ) {
+	fprintf(stderr, "Could not get input storage for %s.\n", var_nm);
+	goto end;
+    }
+    raw = same_storage(in_ds, out_ds);
+    for (n_elem = 1, n_chunks = 1, d = 0; d < ndims; d++) {
+	n_chk[d] = (sel_count[d] + chunk[d] - 1) / chunk[d];
+	n_chunks *= n_chk[d];
+	n_elem *= chunk[d];
+    }
+    m_sz = H5Tget_size(m_type);
+
+    /* Visit output chunks in order, last dimension varying fastest */
+    for (k = 0; k < n_chunks; k++) {
+	size_t r;
+
+	for (r = k, d = ndims - 1; d >= 0; d--) {
+	    off[d] = (r % n_chk[d]) * chunk[d];
+	    r /= n_chk[d];
+	}
+	if ( !H5Chunk_Whole(ndims, off, sel_start, sel_count, len, chunk) ) {
+	    continue;
+	}
+	for (d = 0; d < ndims; d++) {
+	    out_off[d] = off[d];
+	    in_off[d] = sel_start[d] + off[d];
+	    count[d] = (off[d] + chunk[d] > sel_count[d])
+		? sel_count[d] - off[d] : chunk[d];
+	}
+	if ( H5Dget_chunk_storage_size(in_ds, in_off, &sz) < 0 || sz == 0 ) {
+	    continue;
+	}
+	if ( raw ) {
+	    if ( sz > buf_sz ) {
+		FREE(buf);
+		if ( !(buf = MALLOC(sz)) ) {
+		    buf_sz = 0;
+		    fprintf(stderr, "Could not allocate %llu bytes for chunk "
+			    "of %s.\n", (unsigned long long)sz, var_nm);
+		    goto end;
+		}
+		buf_sz = sz;
+	    }
+	    if ( H5Dread_chunk(in_ds, H5P_DEFAULT, in_off, &mask, buf) < 0
+		    || H5Dwrite_chunk(out_ds, H5P_DEFAULT, mask, out_off, sz,
+			buf) < 0 ) {
+		fprintf(stderr, "Could not copy chunk %zu of %s.\n", k,
+			var_nm);
+		goto end;
+	    }
+	    (*n_raw_p)++;
+	} else {
+	    if ( n_elem * m_sz > buf_sz ) {
+		FREE(buf);
+		if ( !(buf = MALLOC(n_elem * m_sz)) ) {
+		    buf_sz = 0;
+		    fprintf(stderr, "Could not allocate %zu values for chunk "
+			    "of %s.\n", n_elem, var_nm);
+		    goto end;
+		}
+		buf_sz = n_elem * m_sz;
+	    }
+	    if ( (mem_sp = H5Screate_simple(ndims, count, NULL)) < 0
+		    || H5Sselect_hyperslab(in_sp, H5S_SELECT_SET, in_off,
+			NULL, count, NULL) < 0
+		    || H5Sselect_hyperslab(out_sp, H5S_SELECT_SET, out_off,
+			NULL, count, NULL) < 0
+		    || H5Dread(in_ds, m_type, mem_sp, in_sp, H5P_DEFAULT,
+			buf) < 0
+		    || H5Dwrite(out_ds, m_type, mem_sp, out_sp, H5P_DEFAULT,
+			buf) < 0 ) {
+		fprintf(stderr, "Could not copy chunk %zu of %s.\n", k,
+			var_nm);
+		goto end;
+	    }
+	    H5Sclose(mem_sp);
+	    mem_sp = -1;
+	    (*n_cooked_p)++;
+	}
+    }
+    ok = 1;
+
+end:
+    if ( mem_sp >= 0 ) {
+	H5Sclose(mem_sp);
+    }
+    if ( m_type >= 0 ) {
+	H5Tclose(m_type);
+    }
+    if ( f_type >= 0 ) {
+	H5Tclose(f_type);
+    }
+    if ( in_sp >= 0 ) {
+	H5Sclose(in_sp);
+    }
+    if ( out_sp >= 0 ) {
+	H5Sclose(out_sp);
+    }
+    if ( in_ds >= 0 ) {
+	H5Dclose(in_ds);
+    }
+    if ( out_ds >= 0 ) {
+	H5Dclose(out_ds);
+    }
+    FREE(buf);
+    FREE(out_dims);
+    FREE(count);
+    FREE(out_off);
+    FREE(in_off);
+    FREE(n_chk);
+    FREE(off);
+    return ok;
+}
+
+/*
+   Return true if datasets ds1 and ds2 have the same type, chunk shape, and
+   filters with the same parameters, so a chunk from one is valid in the
+   other.
+ */
+static int same_storage(hid_t ds1, hid_t ds2)
+{
+    hid_t t1 = -1, t2 = -1;		/* Types */
+    hid_t p1 = -1, p2 = -1;		/* Creation properties */
+    hsize_t c1[H5S_MAX_RANK], c2[H5S_MAX_RANK];
+					/* Chunk shapes */
+    int nd1, nd2;			/* Chunk ranks */
+    unsigned flags1, flags2;		/* Filter flags */
+    size_t n_cd1, n_cd2;		/* Number of filter parameters */
+    unsigned cd1[H5CHUNK_CD], cd2[H5CHUNK_CD];
+					/* Filter parameters */
+    H5Z_filter_t f1, f2;		/* Filter identifiers */
+    int n_f, i;
+    int same = 0;
+
+    if ( (t1 = H5Dget_type(ds1)) < 0 || (t2 = H5Dget_type(ds2)) < 0
+	    || H5Tequal(t1, t2) <= 0
+	    || (p1 = H5Dget_create_plist(ds1)) < 0
+	    || (p2 = H5Dget_create_plist(ds2)) < 0
+	    || H5Pget_layout(p1) != H5D_CHUNKED
+	    || H5Pget_layout(p2) != H5D_CHUNKED
+	    || (nd1 = H5Pget_chunk(p1, H5S_MAX_RANK, c1)) < 0
+	    || (nd2 = H5Pget_chunk(p2, H5S_MAX_RANK, c2)) != nd1
+	    || memcmp(c1, c2, nd1 * sizeof(hsize_t)) != 0
+	    || (n_f = H5Pget_nfilters(p1)) < 0
+	    || H5Pget_nfilters(p2) != n_f ) {
+	goto end;
+    }
+    for (i = 0; i < n_f; i++) {
+	n_cd1 = n_cd2 = H5CHUNK_CD;
+	f1 = H5Pget_filter2(p1, i, &flags1, &n_cd1, cd1, 0, NULL, NULL);
+	f2 = H5Pget_filter2(p2, i, &flags2, &n_cd2, cd2, 0, NULL, NULL);
+	if ( f1 < 0 || f1 != f2 || n_cd1 != n_cd2 || n_cd1 > H5CHUNK_CD
+		|| memcmp(cd1, cd2, n_cd1 * sizeof(unsigned)) != 0 ) {
+	    goto end;
+	}
+    }
+    same = 1;
+
+end:
+    if ( p2 >= 0 ) {
+	H5Pclose(p2);
+    }
+    if ( p1 >= 0 ) {
+	H5Pclose(p1);
+    }
+    if ( t2 >= 0 ) {
+	H5Tclose(t2);
+    }
+    if ( t1 >= 0 ) {
+	H5Tclose(t1);
+    }
+    return same;
+}
+
+#endif
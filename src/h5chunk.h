@@ -0,0 +1,61 @@
+/*
+   -	h5chunk.h --
+   -		Declarations for copying compressed chunks with HDF5
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#ifndef H5CHUNK_H_
+#define H5CHUNK_H_
+
+#include <stdlib.h>
+#ifdef HAVE_HDF5
+#include <hdf5.h>
+#endif
+
+/*
+   Functions that copy chunks of a netCDF-4 variable from one file to
+   another through HDF5, without decompressing them when both datasets have
+   the same type and filters. A selection with sel_start[d] a multiple of
+   chunk[d] along every dimension d maps whole input chunks onto whole
+   output chunks. H5Chunk_Whole identifies them, so callers can copy the
+   rest of the selection some other way.
+ */
+
+int H5Chunk_Whole(int, const size_t *, const size_t *, const size_t *,
+	const size_t *, const size_t *);
+
+#ifdef HAVE_HDF5
+hid_t H5Chunk_Dset(hid_t, const char *);
+int H5Chunk_Copy(hid_t, hid_t, const char *, int, const size_t *,
+	const size_t *, const size_t *, const size_t *, size_t *, size_t *);
+#endif
+
+#endif
@@ -1,12 +1,70 @@
 /*
    -	nc_cmp.c --
-   -		Compare a field in two netcdf files
+   -		Compare a field in two or more netcdf files
    -
    .	Usage:
-   .		nc_cmp field_name file1 file2
+   .		nc_cmp [options] field_name file1 file2 [file ...]
+   .
+   .	file1 is the reference. Each of the other files is compared with it.
    .
    .	Standard output will be descriptive information about the fields and
-   .	their differences.
+   .	their differences: mean and root mean square of each field, mean
+   .	square difference, bias, correlation, count of differing elements,
+   .	maximum absolute, relative, and ULP differences with their indeces,
+   .	and a histogram of absolute differences. All of these come from a
+   .	single pass that reads the files in blocks. With more than one file
+   .	to compare with file1, output is a table with one line per file.
+   .	Each block of file1 is read once, no matter how many files there are.
+   .	File1 and the other files are read by separate processes at the same
+   .	time, so reading takes about as long as reading the slowest file.
+   .
+   .	Options:
+   .		-i, --ignore value
+   .			Ignore values with absolute value >= value.
+   .		-a, --abs-tol value
+   .			Absolute tolerance.
+   .		-r, --rel-tol value
+   .			Tolerance relative to the value in file1.
+   .		-u, --ulp-tol n
+   .			Tolerance in units in the last place.
+   .		-n, --max-viol n
+   .			Stop comparing a file after n tolerance violations.
+   .			Stop reading when all files have stopped.
+   .		-f, --fp-store dir
+   .			Keep fingerprints of the variable in each file in
+   .			store directory dir. If there is only file2 to
+   .			compare with file1, blocks of file2 whose hash
+   .			matches the fingerprint of file1 are not read from
+   .			file1. If both files have fingerprints and all block
+   .			hashes match, neither file is read.
+   .		-j, --jobs n
+   .			Read the files to compare with file1 in up to n
+   .			processes. Default is the number of processors.
+   .		-m, --map path
+   .			Write statistics of the differences in tiles over
+   .			the last two dimensions to a new NetCDF file at path.
+   .			The file has variables n, n_diff, bias, rms, and
+   .			max_abs with dimensions member, the leading dimensions
+   .			of the field, tile_y, and tile_x.
+   .		-t, --tile NYxNX
+   .			Size of tiles for --map. Default is 32x32. A single
+   .			number N means NxN.
+   .		-s, --state path
+   .			Keep the number of records compared, and the
+   .			statistics for them, in state file path. The next
+   .			run with the same field, files, and options only
+   .			reads records appended since, and merges them into
+   .			the stored statistics. Records are along the first
+   .			dimension. Files may have different numbers of
+   .			records, in which case records present in all files
+   .			are compared. Cannot be used with --fp-store.
+   .
+   .	A pair of values violates the tolerances if it is outside every
+   .	tolerance given, or if one value is ignored and the other is not.
+   .	With no tolerances, any difference is a violation.
+   .
+   .	Exit status is 0 if there are no violations, 1 if there are
+   .	violations, and 2 if something went wrong.
    .
    .	Copyright (c) 2013, Gordon D. Carrie. All rights reserved.
    .	
@@ -43,361 +101,1151 @@
 #include <string.h>
 #include <stdio.h>
 #include <math.h>
+#include <errno.h>
 #include <setjmp.h>
 #include <unistd.h>
 #include <netcdf.h>
 #include "nnetcdf.h"
-#include "hash.h"
 #include "alloc.h"
+#include "slab.h"
+#include "diffstat.h"
+#include "fprint.h"
+#include "rdr.h"
+#include "tmap.h"
 
 /* Length of format specifier */
 #define FMT_LEN 42
 
+/* Maximum number of values from each file to hold in memory */
+#define BLK_ELEM (1 << 20)
+
+/* Default tile size for maps */
+#define TILE 32
+
+/* Identifies a state file and its format version */
+#define ST_MAGIC "NCST0001"
+#define ST_MAGIC_LEN 8
+
+/* Exit statuses */
+#define EXIT_SAME 0
+#define EXIT_DIFF 1
+#define EXIT_TROUBLE 2
+
+/* Comparison of one file with the reference file */
+struct Member {
+    char *path;				/* Path to file */
+    int rdr;				/* Index of reader for this file, -1 if
+					   not read */
+    struct Diff_Stats stats;		/* Statistics for reference and this
+					   file */
+    size_t n_viol;			/* Number of tolerance violations */
+    size_t viol_idx;			/* Index of first violation */
+    double viol_x1, viol_x2;		/* Values at viol_idx */
+    size_t n_cmp;			/* Number of elements compared */
+    int done;				/* If true, stop comparing */
+    int same;				/* If true, fingerprints show this file
+					   is the same as the reference */
+    char *fp_ent;			/* Fingerprint store entry */
+    struct Fp fp;			/* Stored fingerprint */
+    int fp_ok;				/* If true, fp is current */
+    struct Fp fp_cur;			/* Fingerprint from this run */
+    struct Tmap *tmap;			/* Map of tile statistics, or NULL */
+};
+
+/* Options */
+static double ign = INFINITY;		/* Ignore values with absolute value
+					   greater than ign */
+static struct Diff_Tol tol;		/* Tolerances */
+static size_t max_viol = 0;		/* Stop after this many violations,
+					   0 to read everything */
+static enum Diff_ULP ulp;		/* How to compute ULP distance */
+
+static char *opt_arg(char *, char *, int *, int, char **);
+static void open_var(char *, char *, char *, int *, nc_type *, int *,
+	size_t **);
+static size_t cmp_blk(struct Member *, const double *, const double *,
+	size_t, const struct Slab *, struct Diff_Stats *);
+static size_t state_read(const char *, const char *, const char *, int,
+	const size_t *, struct Member *, int, size_t, size_t);
+static int state_write(const char *, const char *, const char *, int,
+	const size_t *, const struct Member *, int, size_t, size_t, size_t);
+static int st_write_str(FILE *, const char *);
+static int st_match_str(FILE *, const char *);
+static void report1(char *, char *, struct Member *, size_t, nc_type, int,
+	const size_t *);
+static void report_tbl(char *, char *, struct Member *, int, size_t, nc_type);
+static char *type_nm(nc_type);
+static void pr_idx(size_t, int, const size_t *);
+
 int main(int argc, char *argv[])
 {
     char *argv0 = argv[0];
     char *var_nm;			/* Variable name, from command line */
-    char *nc_fl_nm1, *nc_fl_nm2;	/* Path to NetCDF file */
-    size_t l1, l2;			/* String lengths of nc_fl_nm1 and
-					   nc_fl_nm2 */
-    char fmt[FMT_LEN];			/* Format output string */
-    double ign = INFINITY;		/* Ignore values with absolute value
-					   greater than ign */
-    int nc_id1, nc_id2;			/* NetCDF file identifier */
-    int var_id;				/* NetCDF identifier for variable */
-    nc_type xtype1, xtype2;		/* Type of var */
-    char *xtype_s;			/* Type of var as a string */
-    int num_dims;			/* Number of dimensions */
-    int *dim_ids = NULL;		/* Dimension identifiers */
-    size_t dimlen;			/* Length of a dimension */
-    int status;				/* Return code from NetCDF function
-					   call */
-    jmp_buf err_env1, err_env2;		/* Jump buffer for nnetcdf calls */
-    int c;				/* Option */
-    int n;				/* Data element index */
-    size_t num_elem1, num_elem2;	/* Number of data values */
-    size_t n1, n2, nd;			/* Number of data values actually
-					   used from file 1, file 2, and
-					   in mean square difference
-					   calculation */
-    char *c1, *c2;			/* Data arrays */
-    int *i1, *i2;
-    float *f1, *f2;
-    double *d1, *d2;
-    unsigned char *uc1, *uc2;
-    unsigned int *ui1, *ui2;
-    double m1, rms1, m2, rms2;		/* Mean, root mean square */
-    double msd;				/* Mean square difference */
+    char *nc_fl_nm1;			/* Path to reference file */
+    int nc_id1, nc_id;			/* NetCDF file identifiers */
+    nc_type xtype1, xtype;		/* Type of var */
+    int num_dims1, num_dims;		/* Number of dimensions */
+    size_t *len1 = NULL, *len = NULL;	/* Dimension lengths */
+    jmp_buf err_env1;			/* Jump buffer for nnetcdf calls */
+    int a;				/* Index in argv */
+    char *val;				/* Option value */
+    struct Member *mbrs, *m, *me;	/* Files to compare with reference */
+    int n_mbrs;				/* Number of members */
+    int n_stream;			/* Number of members to read */
+    int n_active;			/* Number of members still being
+					   compared */
+    long n_jobs = 0;			/* Maximum number of readers */
+    struct Rdr *rdrs = NULL;		/* Reader processes for members */
+    struct Rdr rdr1;			/* Reader process for reference */
+    int lazy1;				/* If true, read reference in this
+					   process, only when needed */
+    int n_rdrs = 0;			/* Number of readers */
+    char **paths;			/* Files for a reader */
+    int n_paths;			/* Number of elements in paths */
+    int r;				/* Reader index */
+    size_t n;				/* Number of values compared */
+    char *fp_dir = NULL;		/* Fingerprint store directory */
+    char *fp_ent1 = NULL;		/* Fingerprint store entry */
+    struct Fp fp1;			/* Stored fingerprint */
+    int fp_ok1 = 0;			/* If true, fp1 is current */
+    struct Fp fp_cur1;			/* Fingerprint from this run */
+    int fp_sum1;			/* If true, fp_cur1 has an entry for
+					   current block */
+    unsigned long long h1 = 0, h2 = 0;	/* Block hashes */
+    size_t k;				/* Block index */
+    size_t n_blk_rd1 = 0;		/* Number of blocks read from file1 */
+    int have_x1;			/* If true, x1 has current block */
+    double *x1p;			/* x1, or x2 if identical */
+    int d;				/* Dimension index */
+    size_t num_elem;			/* Number of data values */
+    struct Slab slab;			/* Block iterator */
+    size_t blk_elem;			/* Number of values in a block */
+    double *x1 = NULL, *x2 = NULL;	/* Values from current block */
+    struct Diff_Stats blk_stats;	/* Statistics for current block */
+    char *map_fl_nm = NULL;		/* Path to map output */
+    size_t tile_y = TILE, tile_x = TILE;	/* Tile size for map */
+    struct Tmap *maps = NULL;		/* Tile maps for members */
+    char **map_paths;			/* Member paths for map output */
+    int tile_end;			/* Characters read for tile size */
+    long l;				/* Integer option value */
+    char *e;				/* End of integer option value */
+    char *st_fl_nm = NULL;		/* Path to state file */
+    size_t n_rec;			/* Number of records in all files */
+    size_t wm = 0;			/* Number of records compared in
+					   previous runs */
+    size_t *org = NULL, *ext = NULL;	/* Box to compare in this run */
+    size_t sub_elem;			/* Number of elements in box */
+    int status = EXIT_SAME;		/* Exit status */
 
     argv0 = argv[0];
-    if ( argc < 4 ) {
-	fprintf(stderr, "Usage: %s [options] field file1 file2\n", argv0);
-	exit(EXIT_FAILURE);
-    }
-    while ((c = getopt(argc, argv, ":i:")) != -1) {
-	switch(c) {
-	    case 'i':
-		if ( sscanf(optarg, "%lf", &ign) != 1 ) {
-		    fprintf(stderr, "%s: expected a float for value to ignore, "
-			    "got %s\n", argv0, optarg);
-		    exit(EXIT_FAILURE);
-		}
-		if ( ign <= 0.0 ) {
-		    fprintf(stderr, "%s: value to ignore must be greater "
-			    "than 0.0\n", argv0);
-		    exit(EXIT_FAILURE);
+    memset(&tol, 0, sizeof(tol));
+    for (a = 1; a < argc && argv[a][0] == '-' && argv[a][1] != '\0'; a++) {
+	if ( strcmp(argv[a], "--") == 0 ) {
+	    a++;
+	    break;
+	}
+	if ( (val = opt_arg(argv0, "-i", &a, argc, argv))
+		|| (val = opt_arg(argv0, "--ignore", &a, argc, argv)) ) {
+	    if ( sscanf(val, "%lf", &ign) != 1 ) {
+		fprintf(stderr, "%s: expected a float for value to ignore, "
+			"got %s\n", argv0, val);
+		exit(EXIT_TROUBLE);
+	    }
+	    if ( ign <= 0.0 ) {
+		fprintf(stderr, "%s: value to ignore must be greater "
+			"than 0.0\n", argv0);
+		exit(EXIT_TROUBLE);
+	    }
+	    printf("Ignoring values with absolute value >= %g\n", ign);
+	} else if ( (val = opt_arg(argv0, "-a", &a, argc, argv))
+		|| (val = opt_arg(argv0, "--abs-tol", &a, argc, argv)) ) {
+	    if ( sscanf(val, "%lf", &tol.abs) != 1 || !(tol.abs >= 0.0) ) {
+		fprintf(stderr, "%s: expected a non-negative float for "
+			"absolute tolerance, got %s\n", argv0, val);
+		exit(EXIT_TROUBLE);
+	    }
+	    tol.has_abs = 1;
+	} else if ( (val = opt_arg(argv0, "-r", &a, argc, argv))
+		|| (val = opt_arg(argv0, "--rel-tol", &a, argc, argv)) ) {
+	    if ( sscanf(val, "%lf", &tol.rel) != 1 || !(tol.rel >= 0.0) ) {
+		fprintf(stderr, "%s: expected a non-negative float for "
+			"relative tolerance, got %s\n", argv0, val);
+		exit(EXIT_TROUBLE);
+	    }
+	    tol.has_rel = 1;
+	} else if ( (val = opt_arg(argv0, "-u", &a, argc, argv))
+		|| (val = opt_arg(argv0, "--ulp-tol", &a, argc, argv)) ) {
+	    if ( strchr(val, '-') || sscanf(val, "%llu", &tol.ulp) != 1 ) {
+		fprintf(stderr, "%s: expected a non-negative integer for ULP "
+			"tolerance, got %s\n", argv0, val);
+		exit(EXIT_TROUBLE);
+	    }
+	    tol.has_ulp = 1;
+	} else if ( (val = opt_arg(argv0, "-n", &a, argc, argv))
+		|| (val = opt_arg(argv0, "--max-viol", &a, argc, argv)) ) {
+	    errno = 0;
+	    l = strtol(val, &e, 10);
+	    if ( e == val || *e != '\0' || errno == ERANGE || l < 1 ) {
+		fprintf(stderr, "%s: expected a positive integer for maximum "
+			"number of violations, got %s\n", argv0, val);
+		exit(EXIT_TROUBLE);
+	    }
+	    max_viol = l;
+	} else if ( (val = opt_arg(argv0, "-f", &a, argc, argv))
+		|| (val = opt_arg(argv0, "--fp-store", &a, argc, argv)) ) {
+	    fp_dir = val;
+	} else if ( (val = opt_arg(argv0, "-j", &a, argc, argv))
+		|| (val = opt_arg(argv0, "--jobs", &a, argc, argv)) ) {
+	    if ( sscanf(val, "%ld", &n_jobs) != 1 || n_jobs < 1 ) {
+		fprintf(stderr, "%s: expected a positive integer for number "
+			"of jobs, got %s\n", argv0, val);
+		exit(EXIT_TROUBLE);
+	    }
+	} else if ( (val = opt_arg(argv0, "-m", &a, argc, argv))
+		|| (val = opt_arg(argv0, "--map", &a, argc, argv)) ) {
+	    map_fl_nm = val;
+	} else if ( (val = opt_arg(argv0, "-t", &a, argc, argv))
+		|| (val = opt_arg(argv0, "--tile", &a, argc, argv)) ) {
+	    tile_y = tile_x = 0;
+	    tile_end = 0;
+	    if ( strspn(val, "0123456789x") == strlen(val)
+		    && sscanf(val, "%zux%zu%n", &tile_y, &tile_x, &tile_end)
+		    != 2 ) {
+		tile_end = 0;
+		if ( sscanf(val, "%zu%n", &tile_y, &tile_end) == 1 ) {
+		    tile_x = tile_y;
 		}
-		printf("Ignoring values with absolute value >= %g\n", ign);
-		break;
-	    case ':':
-		fprintf(stderr, "%s: -%c requires an argument\n",
-			argv0, optopt);
-		exit(EXIT_FAILURE);
-		break;
-	    case '?':
-		fprintf(stderr, "%s: unknown option %c\n", argv0, c);
-		exit(EXIT_FAILURE);
-		break;
-	}
-    }
-    var_nm = argv[argc - 3];
-    nc_fl_nm1 = argv[argc - 2];
-    nc_fl_nm2 = argv[argc - 1];
-
-    /* Open first file and get variable information*/
-    if ( (status = nc_open(nc_fl_nm1, 0, &nc_id1)) != NC_NOERR ) {
-	fprintf(stderr, "%s: failed to open %s.\n%s\n",
-		argv0, nc_fl_nm1, nc_strerror(status));
-	exit(EXIT_FAILURE);
+	    }
+	    if ( val[tile_end] != '\0' || tile_y == 0 || tile_x == 0 ) {
+		fprintf(stderr, "%s: expected NYxNX or N for tile size, "
+			"got %s\n", argv0, val);
+		exit(EXIT_TROUBLE);
+	    }
+	} else if ( (val = opt_arg(argv0, "-s", &a, argc, argv))
+		|| (val = opt_arg(argv0, "--state", &a, argc, argv)) ) {
+	    st_fl_nm = val;
+	} else {
+	    fprintf(stderr, "%s: unknown option %s\n", argv0, argv[a]);
+	    exit(EXIT_TROUBLE);
+	}
     }
-    if ( (status = nc_inq_varid(nc_id1, var_nm, &var_id)) != NC_NOERR ) {
-	fprintf(stderr, "%s: could not find variable named %s in %s.\n%s\n",
-		argv0, var_nm, nc_fl_nm1, nc_strerror(status));
-	exit(EXIT_FAILURE);
+    if ( argc - a < 3 ) {
+	fprintf(stderr, "Usage: %s [options] field file1 file2 [file ...]\n",
+		argv0);
+	exit(EXIT_TROUBLE);
     }
-    if ( (nc_inq_vartype(nc_id1, var_id, &xtype1)) != NC_NOERR ) {
-	fprintf(stderr, "%s: could not determine type for %s in %s.\n"
-		"%s\n", argv0, var_nm, nc_fl_nm1, nc_strerror(status));
-	exit(EXIT_FAILURE);
+    if ( st_fl_nm && fp_dir ) {
+	fprintf(stderr, "%s: cannot use state file with fingerprint store\n",
+		argv0);
+	exit(EXIT_TROUBLE);
     }
-    if ( (status = nc_inq_ndims(nc_id1, &num_dims)) != NC_NOERR ) {
-	fprintf(stderr, "%s: could not get number of dimensions for %s.\n"
-		"%s\n", argv0, nc_fl_nm1, nc_strerror(status));
-	exit(EXIT_FAILURE);
+    var_nm = argv[a];
+    nc_fl_nm1 = argv[a + 1];
+    n_mbrs = argc - a - 2;
+    if ( !(mbrs = CALLOC(n_mbrs, sizeof(struct Member))) ) {
+	fprintf(stderr, "%s: could not allocate memory for %d files.\n",
+		argv0, n_mbrs);
+	exit(EXIT_TROUBLE);
     }
-    if ( !(dim_ids = CALLOC(num_dims, sizeof(int))) ) {
-	fprintf(stderr, "%s: could not allocate array of %u dimension "
-		"identifiers for %s.\n", argv0, num_dims, nc_fl_nm1);
-	exit(EXIT_FAILURE);
+    for (m = mbrs, me = m + n_mbrs; m < me; m++) {
+	m->path = argv[a + 2 + (m - mbrs)];
+	m->rdr = -1;
+	Diff_Init(&m->stats);
     }
-    if ( (status = nc_inq_vardimid(nc_id1, var_id, dim_ids)) != NC_NOERR ) {
-	fprintf(stderr, "%s: could not get dimension identifiers for %s "
-		"in %s.\n%s\n", argv0, var_nm, nc_fl_nm1, nc_strerror(status));
-	exit(EXIT_FAILURE);
+
+    /*
+       Open reference file and get variable information. Ensure variable name
+       corresponds to variable of same type and shape in all files. With a
+       state file, files may have different numbers of records. Only the
+       reference stays open in this process.
+     */
+
+    open_var(argv0, nc_fl_nm1, var_nm, &nc_id1, &xtype1, &num_dims1, &len1);
+    if ( st_fl_nm && num_dims1 == 0 ) {
+	fprintf(stderr, "%s: %s has no record dimension for state file\n",
+		argv0, var_nm);
+	exit(EXIT_TROUBLE);
     }
-    for (num_elem1 = 0, n = 0; n < num_dims; n++) {
-	status = nc_inq_dimlen(nc_id1, dim_ids[n], &dimlen);
-	if ( status != NC_NOERR ) {
-	    fprintf(stderr, "%s: could not get length for dimension %d "
-		    "in %s.\n%s\n", argv0, n, nc_fl_nm1, nc_strerror(status));
-	    exit(EXIT_FAILURE);
+    n_rec = (num_dims1 > 0) ? len1[0] : 1;
+    for (m = mbrs; m < me; m++) {
+	open_var(argv0, m->path, var_nm, &nc_id, &xtype, &num_dims, &len);
+	nc_close(nc_id);
+	if ( xtype != xtype1 ) {
+	    fprintf(stderr, "%s not the same type in %s and %s\n",
+		    var_nm, nc_fl_nm1, m->path);
+	    exit(EXIT_TROUBLE);
+	}
+	if ( num_dims != num_dims1 ) {
+	    fprintf(stderr, "%s: %s has different number of dimensions "
+		    "in %s and %s\n", argv0, var_nm, nc_fl_nm1, m->path);
+	    exit(EXIT_TROUBLE);
 	}
-	num_elem1 += dimlen;
+	if ( st_fl_nm && len[0] < n_rec ) {
+	    n_rec = len[0];
+	}
+	for (d = st_fl_nm ? 1 : 0; d < num_dims1; d++) {
+	    if ( len[d] != len1[d] ) {
+		fprintf(stderr, "%s: %s has different length for dimension "
+			"%d in %s and %s\n", argv0, var_nm, d, nc_fl_nm1,
+			m->path);
+		exit(EXIT_TROUBLE);
+	    }
+	}
+	FREE(len);
     }
-
-    /* Open second file and get variable information*/
-    if ( (status = nc_open(nc_fl_nm2, 0, &nc_id2)) != NC_NOERR ) {
-	fprintf(stderr, "%s: failed to open %s.\n%s\n",
-		argv0, nc_fl_nm2, nc_strerror(status));
-	exit(EXIT_FAILURE);
+    if ( num_dims1 > 0 ) {
+	len1[0] = n_rec;
     }
-    if ( (status = nc_inq_varid(nc_id2, var_nm, &var_id)) != NC_NOERR ) {
-	fprintf(stderr, "%s: could not find variable named %s in %s.\n%s\n",
-		argv0, var_nm, nc_fl_nm2, nc_strerror(status));
-	exit(EXIT_FAILURE);
+    for (num_elem = 1, d = 0; d < num_dims1; d++) {
+	num_elem *= len1[d];
     }
-    if ( (nc_inq_vartype(nc_id2, var_id, &xtype2)) != NC_NOERR ) {
-	fprintf(stderr, "%s: could not determine type for %s in %s.\n"
-		"%s\n", argv0, var_nm, nc_fl_nm2, nc_strerror(status));
-	exit(EXIT_FAILURE);
+    switch (xtype1) {
+	case NC_FLOAT:
+	    ulp = DIFF_ULP_FLOAT;
+	    break;
+	case NC_DOUBLE:
+	    ulp = DIFF_ULP_DOUBLE;
+	    break;
+	default:
+	    ulp = DIFF_ULP_NONE;
+	    break;
     }
-    if ( (status = nc_inq_ndims(nc_id2, &num_dims)) != NC_NOERR ) {
-	fprintf(stderr, "%s: could not get number of dimensions for %s.\n"
-		"%s\n", argv0, nc_fl_nm2, nc_strerror(status));
-	exit(EXIT_FAILURE);
+    tol.ulp_type = ulp;
+    if ( map_fl_nm ) {
+	if ( !(maps = CALLOC(n_mbrs, sizeof(struct Tmap))) ) {
+	    fprintf(stderr, "%s: could not allocate maps.\n", argv0);
+	    exit(EXIT_TROUBLE);
+	}
+	for (m = mbrs; m < me; m++) {
+	    m->tmap = maps + (m - mbrs);
+	    if ( !Tmap_Init(m->tmap, num_dims1, len1, tile_y, tile_x) ) {
+		fprintf(stderr, "%s: could not set up map for %s\n",
+			argv0, m->path);
+		exit(EXIT_TROUBLE);
+	    }
+	}
+    }
+
+    /*
+       Fetch results for records compared in previous runs. This run
+       compares the box from the watermark to the last record.
+     */
+
+    if ( num_dims1 > 0 && (!(org = CALLOC(num_dims1, sizeof(size_t)))
+		|| !(ext = CALLOC(num_dims1, sizeof(size_t)))) ) {
+	fprintf(stderr, "%s: could not allocate memory for %d dimensions.\n",
+		argv0, num_dims1);
+	exit(EXIT_TROUBLE);
     }
-    if ( !(dim_ids = CALLOC(num_dims, sizeof(int))) ) {
-	fprintf(stderr, "%s: could not allocate array of %u dimension "
-		"identifiers for %s.\n", argv0, num_dims, nc_fl_nm2);
-	exit(EXIT_FAILURE);
+    if ( st_fl_nm ) {
+	wm = state_read(st_fl_nm, var_nm, nc_fl_nm1, num_dims1, len1, mbrs,
+		n_mbrs, map_fl_nm ? tile_y : 0, map_fl_nm ? tile_x : 0);
+	printf("%zu records compared previously. Comparing %zu new records.\n",
+		wm, n_rec - wm);
     }
-    if ( (status = nc_inq_vardimid(nc_id2, var_id, dim_ids)) != NC_NOERR ) {
-	fprintf(stderr, "%s: could not get dimension identifiers for %s "
-		"in %s.\n%s\n", argv0, var_nm, nc_fl_nm2, nc_strerror(status));
-	exit(EXIT_FAILURE);
+    for (sub_elem = 1, d = 0; d < num_dims1; d++) {
+	org[d] = (d == 0) ? wm : 0;
+	ext[d] = len1[d] - org[d];
+	sub_elem *= ext[d];
     }
-    for (num_elem2 = 0, n = 0; n < num_dims; n++) {
-	status = nc_inq_dimlen(nc_id2, dim_ids[n], &dimlen);
-	if ( status != NC_NOERR ) {
-	    fprintf(stderr, "%s: could not get length for dimension %d "
-		    "in %s.\n%s\n", argv0, n, nc_fl_nm2, nc_strerror(status));
-	    exit(EXIT_FAILURE);
+
+    /*
+       Fetch fingerprints from store. Members whose block hashes all match
+       those of the reference are the same as the reference. Get their
+       statistics from the fingerprints and do not read them.
+     */
+
+    memset(&fp1, 0, sizeof(fp1));
+    memset(&fp_cur1, 0, sizeof(fp_cur1));
+    if ( fp_dir ) {
+	if ( !(fp_ent1 = Fp_Entry(fp_dir, nc_fl_nm1, var_nm))
+		|| !Fp_Init(&fp_cur1, nc_fl_nm1, var_nm, ign, BLK_ELEM,
+		    num_dims1, len1) ) {
+	    fprintf(stderr, "%s: could not set up fingerprints in %s\n",
+		    argv0, fp_dir);
+	    exit(EXIT_TROUBLE);
+	}
+	fp_ok1 = Fp_Read(fp_ent1, &fp1) && Fp_Match(&fp1, &fp_cur1);
+	for (m = mbrs; m < me; m++) {
+	    if ( !(m->fp_ent = Fp_Entry(fp_dir, m->path, var_nm))
+		    || !Fp_Init(&m->fp_cur, m->path, var_nm, ign, BLK_ELEM,
+			num_dims1, len1) ) {
+		fprintf(stderr, "%s: could not set up fingerprints in %s\n",
+			argv0, fp_dir);
+		exit(EXIT_TROUBLE);
+	    }
+	    m->fp_ok = Fp_Read(m->fp_ent, &m->fp)
+		&& Fp_Match(&m->fp, &m->fp_cur);
+	    if ( !fp_ok1 || !m->fp_ok || m->fp.n_blks != fp1.n_blks ) {
+		continue;
+	    }
+	    for (k = 0; k < fp1.n_blks; k++) {
+		if ( fp1.blks[k].hash != m->fp.blks[k].hash ) {
+		    break;
+		}
+	    }
+	    if ( k == fp1.n_blks ) {
+		for (k = 0; k < fp1.n_blks; k++) {
+		    Diff_Same(&blk_stats, fp1.blks[k].n, fp1.blks[k].mean,
+			    fp1.blks[k].ss);
+		    Diff_Merge(&m->stats, &blk_stats);
+		}
+		m->n_cmp = num_elem;
+		m->same = m->done = 1;
+		if ( m->tmap ) {
+		    m->tmap->same = 1;
+		}
+		printf("Fingerprints match for %s. Not read.\n", m->path);
+	    }
 	}
-	num_elem2 += dimlen;
     }
 
     /*
-       Ensure variable name corresponds to variable of same type and size in
-       both files
+       Start readers for the members that must be read. Each reader takes
+       every n_rdrs'th member.
      */
 
-    if ( xtype1 != xtype2 ) {
-	fprintf(stderr, "%s not the same type in %s and %s\n",
-		var_nm, nc_fl_nm1, nc_fl_nm2);
-	exit(EXIT_FAILURE);
+    for (n_stream = 0, m = mbrs; m < me; m++) {
+	n_stream += !m->done;
     }
-    if ( num_elem1 != num_elem2 ) {
-	fprintf(stderr, "%s: %s has different number of elements "
-		"in %s and %s\n", argv0, var_nm, nc_fl_nm1, nc_fl_nm2);
-	exit(EXIT_FAILURE);
+    if ( n_jobs == 0 && (n_jobs = sysconf(_SC_NPROCESSORS_ONLN)) < 1 ) {
+	n_jobs = 1;
+    }
+    n_rdrs = (n_stream < n_jobs) ? n_stream : n_jobs;
+    for (r = 0, m = mbrs; m < me; m++) {
+	if ( !m->done ) {
+	    m->rdr = r++ % n_rdrs;
+	}
     }
+    blk_elem = (sub_elem < BLK_ELEM) ? sub_elem : BLK_ELEM;
+    if ( n_rdrs > 0 && (!(rdrs = CALLOC(n_rdrs, sizeof(struct Rdr)))
+		|| !(paths = CALLOC(n_mbrs, sizeof(char *)))) ) {
+	fprintf(stderr, "%s: could not allocate readers.\n", argv0);
+	exit(EXIT_TROUBLE);
+    }
+    for (r = 0; r < n_rdrs; r++) {
+	for (n_paths = 0, m = mbrs; m < me; m++) {
+	    if ( m->rdr == r ) {
+		paths[n_paths++] = m->path;
+	    }
+	}
+	if ( !Rdr_Start(rdrs + r, n_paths, paths, var_nm, num_dims1, len1,
+		    org, ext, blk_elem) ) {
+	    fprintf(stderr, "%s: could not start reader for %s\n",
+		    argv0, paths[0]);
+	    exit(EXIT_TROUBLE);
+	}
+    }
+    if ( n_rdrs > 0 ) {
+	FREE(paths);
+    }
+
+    /*
+       Read the reference in another process as well, so that it is read
+       while the members are. The pipe holds the next block while this
+       process compares the current one. If there is one member and the
+       reference has a current fingerprint, read the reference here
+       instead, and only for blocks whose hashes do not match.
+     */
 
-    /* Fetch arrays and compare */
+    lazy1 = fp_ok1 && n_stream == 1;
+    if ( !lazy1 && n_stream > 0
+	    && !Rdr_Start(&rdr1, 1, &nc_fl_nm1, var_nm, num_dims1, len1,
+		org, ext, blk_elem) ) {
+	fprintf(stderr, "%s: could not start reader for %s\n",
+		argv0, nc_fl_nm1);
+	exit(EXIT_TROUBLE);
+    }
+
+    /*
+       Fetch arrays one block at a time and compare. The reference block is
+       read once and compared with each member in turn.
+     */
+
+    if ( !Slab_Init_Box(&slab, num_dims1, len1, org, ext, BLK_ELEM) ) {
+	fprintf(stderr, "%s: could not allocate block iterator for %s.\n",
+		argv0, var_nm);
+	exit(EXIT_TROUBLE);
+    }
+    if ( blk_elem > 0 && (!(x1 = CALLOC(blk_elem, sizeof(double)))
+		|| !(x2 = CALLOC(blk_elem, sizeof(double)))) ) {
+	fprintf(stderr, "%s: could not allocate buffers for %zu values.\n",
+		argv0, blk_elem);
+	exit(EXIT_TROUBLE);
+    }
     if ( setjmp(err_env1) == NNCDF_ERROR ) {
-	fprintf(stderr, "%s: failed to retrieve %s from %s",
+	fprintf(stderr, "%s: failed to retrieve %s from %s\n",
 		argv0, var_nm, nc_fl_nm1);
-	exit(EXIT_FAILURE);
+	exit(EXIT_TROUBLE);
     }
-    if ( setjmp(err_env2) == NNCDF_ERROR ) {
-	fprintf(stderr, "%s: failed to retrieve %s from %s",
-		argv0, var_nm, nc_fl_nm2);
-	exit(EXIT_FAILURE);
-    }
-    switch (xtype1) {
-	case NC_BYTE:
-	case NC_CHAR:
-	    xtype_s = "byte";
-	    c1 = NNC_Get_Var_Text(nc_id1, var_nm, NULL, err_env1);
-	    c2 = NNC_Get_Var_Text(nc_id2, var_nm, NULL, err_env2);
-	    for (m1 = m2 = rms1 = rms2 = msd = 0.0, n = n1 = n2 = nd = 0;
-		    n < num_elem1;
-		    n++) {
-		if ( fabs(c1[n]) < ign ) {
-		    m1 += c1[n];
-		    rms1 += c1[n] * c1[n];
-		    n1++;
-		}
-		if ( fabs(c2[n]) < ign ) {
-		    m2 += c2[n];
-		    rms2 += c2[n] * c2[n];
-		    n2++;
-		}
-		if ( fabs(c1[n]) < ign &&  fabs(c2[n]) < ign ) {
-		    msd += (c1[n] - c2[n]) * (c1[n] - c2[n]);
-		    nd++;
-		}
+    n_active = n_stream;
+    for (k = 0; n_active > 0 && (blk_elem = Slab_Next(&slab)) > 0; k++) {
+	have_x1 = fp_sum1 = 0;
+	if ( !lazy1 ) {
+	    if ( !Rdr_Get(&rdr1, x1, blk_elem) ) {
+		fprintf(stderr, "%s: failed to retrieve %s from %s\n",
+			argv0, var_nm, nc_fl_nm1);
+		exit(EXIT_TROUBLE);
 	    }
-	case NC_INT:
-	    xtype_s = "integer";
-	    i1 = NNC_Get_Var_Int(nc_id1, var_nm, NULL, err_env1);
-	    i2 = NNC_Get_Var_Int(nc_id2, var_nm, NULL, err_env2);
-	    for (m1 = m2 = rms1 = rms2 = msd = 0.0, n = n1 = n2 = nd = 0;
-		    n < num_elem1;
-		    n++) {
-		if ( fabs(i1[n]) < ign ) {
-		    m1 += i1[n];
-		    rms1 += i1[n] * i1[n];
-		    n1++;
-		}
-		if ( fabs(i2[n]) < ign ) {
-		    m2 += i2[n];
-		    rms2 += i2[n] * i2[n];
-		    n2++;
-		}
-		if ( fabs(i1[n]) < ign &&  fabs(i2[n]) < ign ) {
-		    msd += (i1[n] - i2[n]) * (i1[n] - i2[n]);
-		    nd++;
-		}
+	    have_x1 = 1;
+	    n_blk_rd1++;
+	    if ( fp_dir ) {
+		h1 = Fp_Hash(x1, blk_elem);
 	    }
-	    break;
-	case NC_FLOAT:
-	    xtype_s = "float";
-	    f1 = NNC_Get_Var_Float(nc_id1, var_nm, NULL, err_env1);
-	    f2 = NNC_Get_Var_Float(nc_id2, var_nm, NULL, err_env2);
-	    for (m1 = m2 = rms1 = rms2 = msd = 0.0, n = n1 = n2 = nd = 0;
-		    n < num_elem1;
-		    n++) {
-		if ( fabs(f1[n]) < ign ) {
-		    m1 += f1[n];
-		    rms1 += f1[n] * f1[n];
-		    n1++;
-		}
-		if ( fabs(f2[n]) < ign ) {
-		    m2 += f2[n];
-		    rms2 += f2[n] * f2[n];
-		    n2++;
-		}
-		if ( fabs(f1[n]) < ign &&  fabs(f2[n]) < ign ) {
-		    msd += (f1[n] - f2[n]) * (f1[n] - f2[n]);
-		    nd++;
-		}
+	}
+	for (m = mbrs; m < me; m++) {
+	    if ( m->rdr == -1 ) {
+		continue;
 	    }
-	    break;
-	case NC_DOUBLE:
-	    xtype_s = "double";
-	    d1 = NNC_Get_Var_Double(nc_id1, var_nm, NULL, err_env1);
-	    d2 = NNC_Get_Var_Double(nc_id2, var_nm, NULL, err_env2);
-	    for (m1 = m2 = rms1 = rms2 = msd = 0.0, n = n1 = n2 = nd = 0;
-		    n < num_elem1;
-		    n++) {
-		if ( fabs(d1[n]) < ign ) {
-		    m1 += d1[n];
-		    rms1 += d1[n] * d1[n];
-		    n1++;
-		}
-		if ( fabs(d2[n]) < ign ) {
-		    m2 += d2[n];
-		    rms2 += d2[n] * d2[n];
-		    n2++;
-		}
-		if ( fabs(d1[n]) < ign &&  fabs(d2[n]) < ign ) {
-		    msd += (d1[n] - d2[n]) * (d1[n] - d2[n]);
-		    nd++;
-		}
+	    if ( !Rdr_Get(rdrs + m->rdr, x2, blk_elem) ) {
+		fprintf(stderr, "%s: failed to retrieve %s from %s\n",
+			argv0, var_nm, m->path);
+		exit(EXIT_TROUBLE);
 	    }
-	    break;
-	case NC_UBYTE:
-	    xtype_s = "unsigned byte";
-	    uc1 = NNC_Get_Var_UChar(nc_id1, var_nm, NULL, err_env1);
-	    uc2 = NNC_Get_Var_UChar(nc_id2, var_nm, NULL, err_env2);
-	    for (m1 = m2 = rms1 = rms2 = msd = 0.0, n = n1 = n2 = nd = 0;
-		    n < num_elem1;
-		    n++) {
-		if ( fabs(uc1[n]) < ign ) {
-		    m1 += uc1[n];
-		    rms1 += uc1[n] * uc1[n];
-		    n1++;
-		}
-		if ( fabs(uc2[n]) < ign ) {
-		    m2 += uc2[n];
-		    rms2 += uc2[n] * uc2[n];
-		    n2++;
-		}
-		if ( fabs(uc1[n]) < ign &&  fabs(uc2[n]) < ign ) {
-		    msd += (uc1[n] - uc2[n]) * (uc1[n] - uc2[n]);
-		    nd++;
-		}
+	    if ( m->done ) {
+		continue;
 	    }
-	    break;
-	case NC_UINT:
-	    xtype_s = "unsigned integer";
-	    ui1 = NNC_Get_Var_UInt(nc_id1, var_nm, NULL, err_env1);
-	    ui2 = NNC_Get_Var_UInt(nc_id2, var_nm, NULL, err_env2);
-	    for (m1 = m2 = rms1 = rms2 = msd = 0.0, n = n1 = n2 = nd = 0;
-		    n < num_elem1;
-		    n++) {
-		if ( fabs(ui1[n]) < ign ) {
-		    m1 += ui1[n];
-		    rms1 += ui1[n] * ui1[n];
-		    n1++;
-		}
-		if ( fabs(ui2[n]) < ign ) {
-		    m2 += ui2[n];
-		    rms2 += ui2[n] * ui2[n];
-		    n2++;
+	    if ( fp_dir ) {
+		h2 = Fp_Hash(x2, blk_elem);
+	    }
+	    x1p = x1;
+	    if ( !have_x1 ) {
+		if ( fp_ok1 && k < fp1.n_blks && fp1.blks[k].hash == h2 ) {
+		    /* Block in reference matches block in member. */
+		    x1p = x2;
+		    h1 = h2;
+		} else {
+		    NNC_Get_Vara_Double(nc_id1, var_nm, slab.start, slab.count,
+			    x1, err_env1);
+		    have_x1 = 1;
+		    n_blk_rd1++;
+		    if ( fp_dir ) {
+			h1 = Fp_Hash(x1, blk_elem);
+		    }
 		}
-		if ( fabs(ui1[n]) < ign &&  fabs(ui2[n]) < ign ) {
-		    msd += (ui1[n] - ui2[n]) * (ui1[n] - ui2[n]);
-		    nd++;
+	    }
+	    n = cmp_blk(m, x1p, x2, blk_elem, &slab, &blk_stats);
+	    if ( m->done ) {
+		n_active--;
+	    }
+	    if ( fp_dir ) {
+		if ( !Fp_Add(&m->fp_cur, h2, blk_stats.n2, blk_stats.mean2,
+			    blk_stats.ss2)
+			|| (!fp_sum1 && n == blk_elem
+			    && !Fp_Add(&fp_cur1, h1, blk_stats.n1,
+				blk_stats.mean1, blk_stats.ss1)) ) {
+		    fprintf(stderr, "%s: could not allocate fingerprints.\n",
+			    argv0);
+		    exit(EXIT_TROUBLE);
 		}
+		fp_sum1 = fp_sum1 || n == blk_elem;
 	    }
-	    break;
-	default:
-	    fprintf(stderr, "%s: cannot read type of %s\n",
-		    argv0, var_nm);
-	    exit(EXIT_FAILURE);
-    }
-    m1 /= n1;
-    rms1 = sqrt(rms1 / n1);
-    m2 /= n2;
-    rms2 = sqrt(rms2 / n2);
-    msd /= nd;
-    printf("Field %s. %zd %s elements\n", var_nm, num_elem1, xtype_s);
+	}
+    }
+    for (r = 0; r < n_rdrs; r++) {
+	if ( !Rdr_Finish(rdrs + r, n_active == 0) ) {
+	    fprintf(stderr, "%s: reader %d failed.\n", argv0, r);
+	    exit(EXIT_TROUBLE);
+	}
+    }
+    if ( !lazy1 && n_stream > 0 && !Rdr_Finish(&rdr1, n_active == 0) ) {
+	fprintf(stderr, "%s: reader for %s failed.\n", argv0, nc_fl_nm1);
+	exit(EXIT_TROUBLE);
+    }
+
+    /*
+       Store fingerprints for files that did not have current ones. Skip
+       files that were not read to the end.
+     */
+
+    if ( fp_dir ) {
+	if ( !fp_ok1 && blk_elem == 0 && fp_cur1.n_blks == k ) {
+	    Fp_Write(fp_ent1, &fp_cur1);
+	}
+	for (m = mbrs; m < me; m++) {
+	    if ( !m->fp_ok && !m->same && m->n_cmp == num_elem ) {
+		Fp_Write(m->fp_ent, &m->fp_cur);
+	    }
+	}
+	printf("Read %zu of %zu blocks from %s.\n", n_blk_rd1, k, nc_fl_nm1);
+    }
+    if ( st_fl_nm && (blk_elem == 0 || n_active == 0)
+	    && !state_write(st_fl_nm, var_nm, nc_fl_nm1, num_dims1, len1, mbrs,
+		n_mbrs, map_fl_nm ? tile_y : 0, map_fl_nm ? tile_x : 0,
+		n_rec) ) {
+	fprintf(stderr, "%s: could not save state in %s\n", argv0, st_fl_nm);
+	status = EXIT_TROUBLE;
+    }
+    Slab_Free(&slab);
+    FREE(org);
+    FREE(ext);
+    FREE(x1);
+    FREE(x2);
+    FREE(rdrs);
+    nc_close(nc_id1);
+
+    /* Report */
+    if ( n_mbrs == 1 ) {
+	report1(var_nm, nc_fl_nm1, mbrs, num_elem, xtype1, num_dims1, len1);
+    } else {
+	report_tbl(var_nm, nc_fl_nm1, mbrs, n_mbrs, num_elem, xtype1);
+    }
+    if ( map_fl_nm ) {
+	if ( !(map_paths = CALLOC(n_mbrs, sizeof(char *))) ) {
+	    fprintf(stderr, "%s: could not allocate maps.\n", argv0);
+	    exit(EXIT_TROUBLE);
+	}
+	for (m = mbrs; m < me; m++) {
+	    map_paths[m - mbrs] = m->path;
+	}
+	if ( !Tmap_Write(map_fl_nm, var_nm, nc_fl_nm1, map_paths, maps,
+		    n_mbrs) ) {
+	    exit(EXIT_TROUBLE);
+	}
+	printf("Wrote %zu by %zu tile map to %s\n", tile_y, tile_x,
+		map_fl_nm);
+	for (m = mbrs; m < me; m++) {
+	    Tmap_Free(m->tmap);
+	}
+	FREE(map_paths);
+	FREE(maps);
+    }
+    for (m = mbrs; m < me; m++) {
+	if ( m->n_viol > 0 && status == EXIT_SAME ) {
+	    status = EXIT_DIFF;
+	}
+	if ( fp_dir ) {
+	    Fp_Free(&m->fp);
+	    Fp_Free(&m->fp_cur);
+	    FREE(m->fp_ent);
+	}
+    }
+    if ( fp_dir ) {
+	Fp_Free(&fp1);
+	Fp_Free(&fp_cur1);
+	FREE(fp_ent1);
+    }
+    FREE(mbrs);
+    FREE(len1);
+
+    exit(status);
+}
+
+/*
+   Compare a block of n values from the reference, in x1, with the
+   corresponding block from member m, in x2. slab gives location of the
+   block. Add the results to the member's statistics. Store statistics for
+   the block in blk_stats. Return the number of values compared, which is
+   less than n if the member reached the maximum number of violations.
+ */
+static size_t cmp_blk(struct Member *m, const double *x1, const double *x2,
+	size_t n, const struct Slab *slab, struct Diff_Stats *blk_stats)
+{
+    size_t n_blk_viol;			/* Number of violations in block */
+    size_t first, last;			/* Offsets in block of first and last
+					   violations */
+
+    n_blk_viol = Diff_Viol(x1, x2, n, ign, &tol,
+	    (max_viol > 0) ? max_viol - m->n_viol : 0, &first, &last);
+    if ( n_blk_viol > 0 && m->n_viol == 0 ) {
+	m->viol_idx = Slab_Offset(slab, first);
+	m->viol_x1 = x1[first];
+	m->viol_x2 = x2[first];
+    }
+    m->n_viol += n_blk_viol;
+    if ( max_viol > 0 && m->n_viol == max_viol ) {
+	/*
+	   Stop at the last violation allowed. Statistics cover the values
+	   up to that point.
+	 */
+
+	n = last + 1;
+	m->done = 1;
+    }
+    m->n_cmp += n;
+    if ( m->tmap ) {
+	Tmap_Block(m->tmap, x1, x2, n, slab, ign);
+    }
+    Diff_Block(blk_stats, x1, x2, n, ign, ulp);
+    blk_stats->max_abs_idx = Slab_Offset(slab, blk_stats->max_abs_idx);
+    blk_stats->max_rel_idx = Slab_Offset(slab, blk_stats->max_rel_idx);
+    blk_stats->max_ulp_idx = Slab_Offset(slab, blk_stats->max_ulp_idx);
+    Diff_Merge(&m->stats, blk_stats);
+    return n;
+}
+
+/*
+   Fetch state for a comparison of variable var_nm in reference file ref
+   with the n_mbrs members in mbrs from state file path. The variable has
+   ndims dimensions with lengths len. Dimension 0, the record dimension, may
+   have grown since the state was saved. If ty and tx are not 0, members
+   have tile maps with tiles of ty by tx. Return the number of records
+   compared in previous runs. If path does not exist or is for a different
+   comparison, return 0 and leave mbrs as they are.
+ */
+static size_t state_read(const char *path, const char *var_nm,
+	const char *ref, int ndims, const size_t *len, struct Member *mbrs,
+	int n_mbrs, size_t ty, size_t tx)
+{
+    FILE *in;
+    char magic[ST_MAGIC_LEN];
+    struct Member *mbrs1 = NULL, *m1;	/* Members as read */
+    struct Diff_Tol tol1;		/* Tolerances for state */
+    double ign1;			/* Ignore threshold for state */
+    size_t u[6];			/* Sizes and counts from state */
+    int i[2];				/* Number of dimensions, members */
+    size_t wm = 0;			/* Return value */
+    size_t l;				/* Dimension length */
+    int d, mi;
+
+    if ( !(in = fopen(path, "r")) ) {
+	return 0;
+    }
+    if ( fread(magic, 1, ST_MAGIC_LEN, in) != ST_MAGIC_LEN
+	    || memcmp(magic, ST_MAGIC, ST_MAGIC_LEN) != 0
+	    || !st_match_str(in, var_nm) || !st_match_str(in, ref)
+	    || fread(i, sizeof(int), 2, in) != 2
+	    || i[0] != ndims || i[1] != n_mbrs
+	    || fread(u, sizeof(size_t), 6, in) != 6
+	    || u[0] != sizeof(struct Diff_Stats)
+	    || u[1] != sizeof(struct Tmap_Tile)
+	    || u[2] != max_viol || u[3] != ty || u[4] != tx || u[5] > len[0]
+	    || fread(&ign1, sizeof(double), 1, in) != 1
+	    || memcmp(&ign1, &ign, sizeof(double)) != 0
+	    || fread(&tol1, sizeof(struct Diff_Tol), 1, in) != 1
+	    || memcmp(&tol1, &tol, sizeof(struct Diff_Tol)) != 0 ) {
+	goto mismatch;
+    }
+    for (d = 1; d < ndims; d++) {
+	if ( fread(&l, sizeof(size_t), 1, in) != 1 || l != len[d] ) {
+	    goto mismatch;
+	}
+    }
+    wm = u[5];
+
+    /*
+       Read members into a copy, so that mbrs are not changed if the state
+       turns out to be for different files.
+     */
+
+    if ( !(mbrs1 = CALLOC(n_mbrs, sizeof(struct Member))) ) {
+	goto mismatch;
+    }
+    for (mi = 0; mi < n_mbrs; mi++) {
+	m1 = mbrs1 + mi;
+	if ( !st_match_str(in, mbrs[mi].path)
+		|| fread(&m1->stats, sizeof(struct Diff_Stats), 1, in) != 1
+		|| fread(&m1->n_viol, sizeof(size_t), 1, in) != 1
+		|| fread(&m1->viol_idx, sizeof(size_t), 1, in) != 1
+		|| fread(&m1->viol_x1, sizeof(double), 1, in) != 1
+		|| fread(&m1->viol_x2, sizeof(double), 1, in) != 1
+		|| fread(&m1->n_cmp, sizeof(size_t), 1, in) != 1
+		|| fread(&m1->done, sizeof(int), 1, in) != 1
+		|| fread(&l, sizeof(size_t), 1, in) != 1 ) {
+	    goto mismatch;
+	}
+
+	/*
+	   Records are the outermost dimension of a map, so tiles for the
+	   records in the state are the first tiles in the map.
+	 */
+
+	if ( mbrs[mi].tmap ) {
+	    if ( l > mbrs[mi].tmap->n_tiles ) {
+		goto mismatch;
+	    }
+	    if ( fread(mbrs[mi].tmap->tiles, sizeof(struct Tmap_Tile), l, in)
+		    != l ) {
+		goto mismatch;
+	    }
+	} else if ( l != 0 ) {
+	    goto mismatch;
+	}
+    }
+    for (mi = 0; mi < n_mbrs; mi++) {
+	m1 = mbrs1 + mi;
+	mbrs[mi].stats = m1->stats;
+	mbrs[mi].n_viol = m1->n_viol;
+	mbrs[mi].viol_idx = m1->viol_idx;
+	mbrs[mi].viol_x1 = m1->viol_x1;
+	mbrs[mi].viol_x2 = m1->viol_x2;
+	mbrs[mi].n_cmp = m1->n_cmp;
+	mbrs[mi].done = m1->done;
+    }
+    FREE(mbrs1);
+    fclose(in);
+    return wm;
+
+mismatch:
+    for (mi = 0; mbrs1 && mi < n_mbrs; mi++) {
+	if ( mbrs[mi].tmap ) {
+	    memset(mbrs[mi].tmap->tiles, 0,
+		    mbrs[mi].tmap->n_tiles * sizeof(struct Tmap_Tile));
+	}
+    }
+    FREE(mbrs1);
+    fclose(in);
+    printf("State in %s is for a different comparison. Comparing all "
+	    "records.\n", path);
+    return 0;
+}
+
+/*
+   Save state for a comparison of variable var_nm in reference file ref with
+   the n_mbrs members in mbrs to state file path, after n_rec records have
+   been compared. Other arguments are as for state_read. The file is
+   replaced atomically. Return 1 on success, 0 on failure.
+ */
+static int state_write(const char *path, const char *var_nm,
+	const char *ref, int ndims, const size_t *len,
+	const struct Member *mbrs, int n_mbrs, size_t ty, size_t tx,
+	size_t n_rec)
+{
+    char *tmp_path;			/* Temporary file to rename to path */
+    int fd;
+    FILE *out;
+    size_t u[6];			/* Sizes and counts */
+    int i[2];				/* Number of dimensions, members */
+    size_t l;				/* Number of tiles */
+    const struct Member *m;
+    int d, ok;
+
+    if ( !(tmp_path = MALLOC(strlen(path) + 8)) ) {
+	return 0;
+    }
+    sprintf(tmp_path, "%s.XXXXXX", path);
+    if ( (fd = mkstemp(tmp_path)) == -1 ) {
+	fprintf(stderr, "Could not create temporary file for %s.\n", path);
+	perror(NULL);
+	FREE(tmp_path);
+	return 0;
+    }
+    if ( !(out = fdopen(fd, "w")) ) {
+	close(fd);
+	unlink(tmp_path);
+	FREE(tmp_path);
+	return 0;
+    }
+    i[0] = ndims;
+    i[1] = n_mbrs;
+    u[0] = sizeof(struct Diff_Stats);
+    u[1] = sizeof(struct Tmap_Tile);
+    u[2] = max_viol;
+    u[3] = ty;
+    u[4] = tx;
+    u[5] = n_rec;
+    ok = fwrite(ST_MAGIC, 1, ST_MAGIC_LEN, out) == ST_MAGIC_LEN
+	&& st_write_str(out, var_nm) && st_write_str(out, ref)
+	&& fwrite(i, sizeof(int), 2, out) == 2
+	&& fwrite(u, sizeof(size_t), 6, out) == 6
+	&& fwrite(&ign, sizeof(double), 1, out) == 1
+	&& fwrite(&tol, sizeof(struct Diff_Tol), 1, out) == 1;
+    for (d = 1; ok && d < ndims; d++) {
+	ok = fwrite(len + d, sizeof(size_t), 1, out) == 1;
+    }
+    for (m = mbrs; ok && m < mbrs + n_mbrs; m++) {
+	l = m->tmap ? m->tmap->n_tiles : 0;
+	ok = st_write_str(out, m->path)
+	    && fwrite(&m->stats, sizeof(struct Diff_Stats), 1, out) == 1
+	    && fwrite(&m->n_viol, sizeof(size_t), 1, out) == 1
+	    && fwrite(&m->viol_idx, sizeof(size_t), 1, out) == 1
+	    && fwrite(&m->viol_x1, sizeof(double), 1, out) == 1
+	    && fwrite(&m->viol_x2, sizeof(double), 1, out) == 1
+	    && fwrite(&m->n_cmp, sizeof(size_t), 1, out) == 1
+	    && fwrite(&m->done, sizeof(int), 1, out) == 1
+	    && fwrite(&l, sizeof(size_t), 1, out) == 1
+	    && (l == 0 || fwrite(m->tmap->tiles, sizeof(struct Tmap_Tile), l,
+			out) == l);
+    }
+    if ( fclose(out) != 0 ) {
+	ok = 0;
+    }
+    if ( ok && rename(tmp_path, path) == -1 ) {
+	fprintf(stderr, "Could not move %s to %s.\n", tmp_path, path);
+	perror(NULL);
+	ok = 0;
+    }
+    if ( !ok ) {
+	unlink(tmp_path);
+    }
+    FREE(tmp_path);
+    return ok;
+}
+
+/* Write string s with its length to out. Return 1 on success, 0 on failure. */
+static int st_write_str(FILE *out, const char *s)
+{
+    size_t l = strlen(s);
+
+    return fwrite(&l, sizeof(size_t), 1, out) == 1
+	&& fwrite(s, 1, l, out) == l;
+}
+
+/*
+   Read a string written by st_write_str from in. Return 1 if it is the
+   same as s, otherwise 0.
+ */
+static int st_match_str(FILE *in, const char *s)
+{
+    size_t l;
+    int c;
+    const char *p;
+
+    if ( fread(&l, sizeof(size_t), 1, in) != 1 || l != strlen(s) ) {
+	return 0;
+    }
+    for (p = s; *p; p++) {
+	if ( (c = getc(in)) == EOF || c != (unsigned char)*p ) {
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+/*
+   Print a full report of the comparison of variable var_nm in reference
+   file nc_fl_nm1 with member m. The variable has num_elem elements of type
+   xtype, and num_dims dimensions with lengths len.
+ */
+static void report1(char *var_nm, char *nc_fl_nm1, struct Member *m,
+	size_t num_elem, nc_type xtype, int num_dims, const size_t *len)
+{
+    char *nc_fl_nm2 = m->path;		/* Path to member file */
+    size_t l1, l2;			/* String lengths of nc_fl_nm1 and
+					   nc_fl_nm2 */
+    char fmt[FMT_LEN];			/* Format output string */
+    struct Diff_Stats *stats = &m->stats;
+    int b;				/* Histogram bin index */
+
+    printf("Field %s. %zd %s elements\n", var_nm, num_elem, type_nm(xtype));
     l1 = strlen(nc_fl_nm1);
     l2 = strlen(nc_fl_nm2);
     if ( l2 > l1 ) {
 	l1 = l2;
     }
-    if ( snprintf(fmt, FMT_LEN, "File %%-%zds: mean = %%g mean square = %%g\n",
+    if ( snprintf(fmt, FMT_LEN, "File %%-%zds: mean = %%g rms = %%g\n",
 		l1) > FMT_LEN ) {
 	fprintf(stderr, "Could not format output for file name "
 		"with %zd characters.\n", l1);
-	exit(EXIT_FAILURE);
+	exit(EXIT_TROUBLE);
     }
-    printf(fmt, nc_fl_nm1, m1, rms1);
-    printf(fmt, nc_fl_nm2, m2, rms2);
-    printf("Mean square difference = %g\n", msd);
+    printf(fmt, nc_fl_nm1, stats->mean1, Diff_RMS1(stats));
+    printf(fmt, nc_fl_nm2, stats->mean2, Diff_RMS2(stats));
+    printf("Mean square difference = %g\n", Diff_MSD(stats));
+    printf("Root mean square difference = %g\n", sqrt(Diff_MSD(stats)));
+    printf("Bias (file2 - file1) = %g\n", stats->dmean);
+    printf("Correlation = %g\n", Diff_Corr(stats));
+    printf("Differing elements = %zu of %zu compared\n",
+	    stats->n_diff, stats->nd);
+    if ( stats->n_diff > 0 ) {
+	printf("Max absolute difference = %g at ", stats->max_abs);
+	pr_idx(stats->max_abs_idx, num_dims, len);
+	if ( stats->max_rel > 0.0 ) {
+	    printf("Max relative difference = %g at ", stats->max_rel);
+	    pr_idx(stats->max_rel_idx, num_dims, len);
+	}
+	if ( ulp != DIFF_ULP_NONE ) {
+	    printf("Max ULP distance = %llu at ", stats->max_ulp);
+	    pr_idx(stats->max_ulp_idx, num_dims, len);
+	}
+	printf("Histogram of |file2 - file1|\n");
+	for (b = 0; b < DIFF_HIST_N; b++) {
+	    if ( stats->hist[b] > 0 ) {
+		printf("    %s1e%+03d %-14zu\n", (b == 0) ? "<  " : ">= ",
+			(b == 0) ? DIFF_HIST_MIN + 1 : DIFF_HIST_MIN + b,
+			stats->hist[b]);
+	    }
+	}
+    }
+    if ( m->n_cmp < num_elem ) {
+	printf("Stopped after %zu violations. Statistics cover %zu of %zu "
+		"elements.\n", m->n_viol, m->n_cmp, num_elem);
+    }
+    if ( tol.has_abs ) {
+	printf("Absolute tolerance = %g\n", tol.abs);
+    }
+    if ( tol.has_rel ) {
+	printf("Relative tolerance = %g\n", tol.rel);
+    }
+    if ( tol.has_ulp ) {
+	printf("ULP tolerance = %llu\n", tol.ulp);
+    }
+    printf("Tolerance violations = %zu\n", m->n_viol);
+    if ( m->n_viol > 0 ) {
+	printf("First violation at ");
+	pr_idx(m->viol_idx, num_dims, len);
+	printf("    %s: %g\n    %s: %g\n",
+		nc_fl_nm1, m->viol_x1, nc_fl_nm2, m->viol_x2);
+    }
+}
 
-    exit(EXIT_SUCCESS);
+/*
+   Print a table with one line of statistics for each of the n_mbrs members
+   in mbrs compared with reference file nc_fl_nm1. The variable is named
+   var_nm and has num_elem elements of type xtype.
+ */
+static void report_tbl(char *var_nm, char *nc_fl_nm1, struct Member *mbrs,
+	int n_mbrs, size_t num_elem, nc_type xtype)
+{
+    struct Member *m, *me;
+    struct Diff_Stats *stats;
+
+    printf("Field %s. %zd %s elements\n", var_nm, num_elem, type_nm(xtype));
+    for (stats = NULL, m = mbrs, me = m + n_mbrs; m < me; m++) {
+	if ( m->n_cmp == num_elem ) {
+	    stats = &m->stats;
+	    break;
+	}
+    }
+    if ( stats ) {
+	printf("Reference %s: mean = %g rms = %g\n",
+		nc_fl_nm1, stats->mean1, Diff_RMS1(stats));
+    }
+    printf("%-12s %-12s %-12s %-12s %-12s %-12s %-12s %-12s %-12s %-12s "
+	    "%-12s %-12s %s\n", "mean", "rms", "msd", "bias", "corr",
+	    "n_diff", "max_abs", "max_rel", "max_ulp", "n_viol", "n_cmp",
+	    "same", "file");
+    for (m = mbrs; m < me; m++) {
+	stats = &m->stats;
+	printf("%-12g %-12g %-12g %-12g %-12g %-12zu %-12g %-12g %-12llu "
+		"%-12zu %-12zu %-12s %s\n", stats->mean2, Diff_RMS2(stats),
+		Diff_MSD(stats), stats->dmean, Diff_Corr(stats),
+		stats->n_diff, stats->max_abs, stats->max_rel, stats->max_ulp,
+		m->n_viol, m->n_cmp, m->same ? "yes" : "no", m->path);
+    }
+}
+
+/*
+   If argv[*a] is option nm, return its value and advance *a past it. The
+   value may be the next argument, or follow an '=', or, for single letter
+   options, be attached. Return NULL if argv[*a] is some other option. Exit
+   if the value is missing.
+ */
+static char *opt_arg(char *argv0, char *nm, int *a, int argc, char *argv[])
+{
+    size_t l = strlen(nm);
+    char *rest;
+
+    if ( strncmp(argv[*a], nm, l) != 0 ) {
+	return NULL;
+    }
+    rest = argv[*a] + l;
+    if ( *rest == '=' ) {
+	return rest + 1;
+    }
+    if ( *rest != '\0' ) {
+	return (l == 2) ? rest : NULL;
+    }
+    if ( ++*a == argc ) {
+	fprintf(stderr, "%s: %s requires an argument\n", argv0, nm);
+	exit(EXIT_TROUBLE);
+    }
+    return argv[*a];
 }
 
+/*
+   Open NetCDF file nc_fl_nm and get information about variable var_nm.
+   Store file identifier, variable type, number of dimensions and dimension
+   lengths at nc_id_p, xtype_p, num_dims_p, and len_p. Dimension lengths are
+   allocated and should be freed with FREE. Exit on failure.
+ */
+static void open_var(char *argv0, char *nc_fl_nm, char *var_nm, int *nc_id_p,
+	nc_type *xtype_p, int *num_dims_p, size_t **len_p)
+{
+    int nc_id;				/* NetCDF file identifier */
+    int var_id;				/* NetCDF identifier for variable */
+    int num_dims;			/* Number of dimensions */
+    int *dim_ids = NULL;		/* Dimension identifiers */
+    size_t *len;			/* Dimension lengths */
+    int status;				/* Return code from NetCDF function
+					   call */
+    int d;
+
+    if ( (status = nc_open(nc_fl_nm, 0, &nc_id)) != NC_NOERR ) {
+	fprintf(stderr, "%s: failed to open %s.\n%s\n",
+		argv0, nc_fl_nm, nc_strerror(status));
+	exit(EXIT_TROUBLE);
+    }
+    if ( (status = nc_inq_varid(nc_id, var_nm, &var_id)) != NC_NOERR ) {
+	fprintf(stderr, "%s: could not find variable named %s in %s.\n%s\n",
+		argv0, var_nm, nc_fl_nm, nc_strerror(status));
+	exit(EXIT_TROUBLE);
+    }
+    if ( (status = nc_inq_vartype(nc_id, var_id, xtype_p)) != NC_NOERR ) {
+	fprintf(stderr, "%s: could not determine type for %s in %s.\n"
+		"%s\n", argv0, var_nm, nc_fl_nm, nc_strerror(status));
+	exit(EXIT_TROUBLE);
+    }
+    if ( (status = nc_inq_varndims(nc_id, var_id, &num_dims)) != NC_NOERR ) {
+	fprintf(stderr, "%s: could not get number of dimensions for %s "
+		"in %s.\n%s\n", argv0, var_nm, nc_fl_nm, nc_strerror(status));
+	exit(EXIT_TROUBLE);
+    }
+    if ( !(dim_ids = CALLOC(num_dims + 1, sizeof(int)))
+	    || !(len = CALLOC(num_dims + 1, sizeof(size_t))) ) {
+	fprintf(stderr, "%s: could not allocate arrays for %u dimensions "
+		"for %s.\n", argv0, num_dims, nc_fl_nm);
+	exit(EXIT_TROUBLE);
+    }
+    if ( (status = nc_inq_vardimid(nc_id, var_id, dim_ids)) != NC_NOERR ) {
+	fprintf(stderr, "%s: could not get dimension identifiers for %s "
+		"in %s.\n%s\n", argv0, var_nm, nc_fl_nm, nc_strerror(status));
+	exit(EXIT_TROUBLE);
+    }
+    for (d = 0; d < num_dims; d++) {
+	status = nc_inq_dimlen(nc_id, dim_ids[d], len + d);
+	if ( status != NC_NOERR ) {
+	    fprintf(stderr, "%s: could not get length for dimension %d "
+		    "in %s.\n%s\n", argv0, d, nc_fl_nm, nc_strerror(status));
+	    exit(EXIT_TROUBLE);
+	}
+    }
+    FREE(dim_ids);
+    *nc_id_p = nc_id;
+    *num_dims_p = num_dims;
+    *len_p = len;
+}
+
+/* Return a descriptive name for NetCDF type xtype */
+static char *type_nm(nc_type xtype)
+{
+    switch (xtype) {
+	case NC_BYTE:   return "byte";
+	case NC_CHAR:   return "character";
+	case NC_SHORT:  return "short";
+	case NC_INT:    return "integer";
+	case NC_FLOAT:  return "float";
+	case NC_DOUBLE: return "double";
+	case NC_UBYTE:  return "unsigned byte";
+	case NC_USHORT: return "unsigned short";
+	case NC_UINT:   return "unsigned integer";
+	case NC_INT64:  return "64 bit integer";
+	case NC_UINT64: return "unsigned 64 bit integer";
+	default:        return "unknown";
+    }
+}
+
+/*
+   Print the row major index idx of an array with num_dims dimensions of
+   lengths len as [i0, i1, ...], followed by a newline.
+ */
+static void pr_idx(size_t idx, int num_dims, const size_t *len)
+{
+    size_t *i;
+    int d;
+
+    if ( num_dims == 0 || !(i = CALLOC(num_dims, sizeof(size_t))) ) {
+	printf("[%zu]\n", idx);
+	return;
+    }
+    for (d = num_dims - 1; d >= 0; d--) {
+	i[d] = idx % len[d];
+	idx /= len[d];
+    }
+    printf("[");
+    for (d = 0; d < num_dims; d++) {
+	printf("%s%zu", (d == 0) ? "" : ", ", i[d]);
+    }
+    printf("]\n");
+    FREE(i);
+}
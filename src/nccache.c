@@ -0,0 +1,375 @@
+/*
+   -	nccache.c --
+   -		Cache of open NetCDF files
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#define _XOPEN_SOURCE 700		/* For st_mtim */
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <netcdf.h>
+#include "alloc.h"
+#include "hash.h"
+#include "nccache.h"
+
+/* Number of buckets in hash table of variables for each file */
+#define N_VAR_BUCKETS 64
+
+/* Number of buckets in hash table of slabs */
+#define N_SLAB_BUCKETS 1024
+
+static void unlink_ent(struct NC_Cache *, struct NC_Cache_Ent *);
+static void push_ent(struct NC_Cache *, struct NC_Cache_Ent *);
+static void free_ent(struct NC_Cache *, struct NC_Cache_Ent *);
+static void unlink_slab(struct NC_Cache *, struct NC_Cache_Slab *);
+static void push_slab(struct NC_Cache *, struct NC_Cache_Slab *);
+static void free_slab(struct NC_Cache *, struct NC_Cache_Slab *);
+static long long mtime_ns(const struct stat *);
+
+/*
+   Initialize cache to hold up to max_files open files and max_slab_bytes
+   bytes of slabs. If max_slab_bytes is 0, slabs are not cached. Return 1
+   on success. On failure, print a message to stderr and return 0.
+ */
+int NC_Cache_Init(struct NC_Cache *cache, unsigned max_files,
+	size_t max_slab_bytes)
+{
+    cache->head = cache->tail = NULL;
+    cache->n_files = 0;
+    cache->max_files = (max_files > 0) ? max_files : 1;
+    cache->hits = cache->misses = 0;
+    cache->slab_head = cache->slab_tail = NULL;
+    cache->slab_bytes = 0;
+    cache->max_slab_bytes = max_slab_bytes;
+    if ( !Hash_Init(&cache->files, 2 * cache->max_files) ) {
+	fprintf(stderr, "Could not create hash table for file cache.\n");
+	return 0;
+    }
+    if ( !Hash_Init(&cache->slabs, max_slab_bytes ? N_SLAB_BUCKETS : 0) ) {
+	fprintf(stderr, "Could not create hash table for slab cache.\n");
+	Hash_Clear(&cache->files);
+	return 0;
+    }
+    return 1;
+}
+
+/*
+   Put the identifier for NetCDF file path at nc_id_p, opening the file if
+   it is not in cache or has changed since it was opened. Return value is
+   as for nc_open. The identifier belongs to the cache. Do not close it.
+ */
+int NC_Cache_Open(struct NC_Cache *cache, const char *path, int *nc_id_p)
+{
+    struct NC_Cache_Ent *ent;
+    struct stat sbuf;
+    int status;
+
+    if ( stat(path, &sbuf) == -1 ) {
+	return errno;
+    }
+    if ( (ent = Hash_Get(&cache->files, path)) ) {
+	if ( ent->dev == sbuf.st_dev && ent->ino == sbuf.st_ino
+		&& ent->mtime == mtime_ns(&sbuf)
+		&& ent->size == sbuf.st_size ) {
+	    cache->hits++;
+	    unlink_ent(cache, ent);
+	    push_ent(cache, ent);
+	    *nc_id_p = ent->nc_id;
+	    return NC_NOERR;
+	}
+	free_ent(cache, ent);
+    }
+    cache->misses++;
+    if ( cache->n_files == cache->max_files ) {
+	free_ent(cache, cache->tail);
+    }
+    if ( !(ent = CALLOC(1, sizeof(struct NC_Cache_Ent)))
+	    || !(ent->path = MALLOC(strlen(path) + 1)) ) {
+	FREE(ent);
+	return NC_ENOMEM;
+    }
+    strcpy(ent->path, path);
+    if ( (status = nc_open(path, 0, &ent->nc_id)) != NC_NOERR ) {
+	FREE(ent->path);
+	FREE(ent);
+	return status;
+    }
+    ent->dev = sbuf.st_dev;
+    ent->ino = sbuf.st_ino;
+    ent->mtime = mtime_ns(&sbuf);
+    ent->size = sbuf.st_size;
+    if ( !Hash_Init(&ent->vars, N_VAR_BUCKETS)
+	    || !Hash_Add(&cache->files, path, ent) ) {
+	nc_close(ent->nc_id);
+	Hash_Clear(&ent->vars);
+	FREE(ent->path);
+	FREE(ent);
+	return NC_ENOMEM;
+    }
+    push_ent(cache, ent);
+    cache->n_files++;
+    *nc_id_p = ent->nc_id;
+    return NC_NOERR;
+}
+
+/*
+   Put the identifier for variable var_nm in cached file nc_id at var_id_p.
+   Return value is as for nc_inq_varid.
+ */
+int NC_Cache_Varid(struct NC_Cache *cache, int nc_id, const char *var_nm,
+	int *var_id_p)
+{
+    struct NC_Cache_Ent *ent;
+    int *var_id;
+    int status;
+
+    for (ent = cache->head; ent && ent->nc_id != nc_id; ent = ent->next) {
+    }
+    if ( !ent ) {
+	return nc_inq_varid(nc_id, var_nm, var_id_p);
+    }
+    if ( (var_id = Hash_Get(&ent->vars, var_nm)) ) {
+	*var_id_p = *var_id;
+	return NC_NOERR;
+    }
+    if ( (status = nc_inq_varid(nc_id, var_nm, var_id_p)) != NC_NOERR ) {
+	return status;
+    }
+    if ( (var_id = MALLOC(sizeof(int))) ) {
+	*var_id = *var_id_p;
+	if ( !Hash_Add(&ent->vars, var_nm, var_id) ) {
+	    FREE(var_id);
+	}
+    }
+    return NC_NOERR;
+}
+
+/*
+   Return the values cached for key, and put their size in bytes at sz_p.
+   path is the file the values came from. If the values are not in cache,
+   or path has changed since they were read, return NULL. The values belong
+   to the cache, and are only good until the next call to NC_Cache_Slab_Put
+   or NC_Cache_Free.
+ */
+void *NC_Cache_Slab_Get(struct NC_Cache *cache, const char *key,
+	const char *path, size_t *sz_p)
+{
+    struct NC_Cache_Slab *slab;
+    struct stat sbuf;
+
+    if ( !(slab = Hash_Get(&cache->slabs, key)) ) {
+	return NULL;
+    }
+    if ( stat(path, &sbuf) == -1 || strcmp(path, slab->path) != 0
+	    || slab->dev != sbuf.st_dev || slab->ino != sbuf.st_ino
+	    || slab->mtime != mtime_ns(&sbuf) || slab->size != sbuf.st_size ) {
+	free_slab(cache, slab);
+	return NULL;
+    }
+    unlink_slab(cache, slab);
+    push_slab(cache, slab);
+    *sz_p = slab->sz;
+    return slab->buf;
+}
+
+/*
+   Store sz bytes at buf as the values for key, read from file path,
+   evicting least recently used slabs to make room. If successful, buf
+   belongs to the cache, and the function returns 1. If the values do not
+   fit or cannot be stored, the function returns 0, and the caller still
+   owns buf.
+ */
+int NC_Cache_Slab_Put(struct NC_Cache *cache, const char *key,
+	const char *path, void *buf, size_t sz)
+{
+    struct NC_Cache_Slab *slab;
+    struct stat sbuf;
+
+    if ( sz > cache->max_slab_bytes || stat(path, &sbuf) == -1 ) {
+	return 0;
+    }
+    if ( (slab = Hash_Get(&cache->slabs, key)) ) {
+	free_slab(cache, slab);
+    }
+    while ( cache->slab_bytes + sz > cache->max_slab_bytes ) {
+	free_slab(cache, cache->slab_tail);
+    }
+    if ( !(slab = CALLOC(1, sizeof(struct NC_Cache_Slab)))
+	    || !(slab->key = MALLOC(strlen(key) + 1))
+	    || !(slab->path = MALLOC(strlen(path) + 1)) ) {
+	if ( slab ) {
+	    FREE(slab->key);
+	}
+	FREE(slab);
+	return 0;
+    }
+    strcpy(slab->key, key);
+    strcpy(slab->path, path);
+    if ( !Hash_Add(&cache->slabs, key, slab) ) {
+	FREE(slab->path);
+	FREE(slab->key);
+	FREE(slab);
+	return 0;
+    }
+    slab->dev = sbuf.st_dev;
+    slab->ino = sbuf.st_ino;
+    slab->mtime = mtime_ns(&sbuf);
+    slab->size = sbuf.st_size;
+    slab->buf = buf;
+    slab->sz = sz;
+    push_slab(cache, slab);
+    cache->slab_bytes += sz;
+    return 1;
+}
+
+/* Close all files in cache and free its memory */
+void NC_Cache_Free(struct NC_Cache *cache)
+{
+    while ( cache->head ) {
+	free_ent(cache, cache->head);
+    }
+    while ( cache->slab_head ) {
+	free_slab(cache, cache->slab_head);
+    }
+    Hash_Clear(&cache->files);
+    Hash_Clear(&cache->slabs);
+}
+
+/* Remove ent from the recently used list of cache */
+static void unlink_ent(struct NC_Cache *cache, struct NC_Cache_Ent *ent)
+{
+    if ( ent->prev ) {
+	ent->prev->next = ent->next;
+    } else {
+	cache->head = ent->next;
+    }
+    if ( ent->next ) {
+	ent->next->prev = ent->prev;
+    } else {
+	cache->tail = ent->prev;
+    }
+    ent->prev = ent->next = NULL;
+}
+
+/* Put ent at the front of the recently used list of cache */
+static void push_ent(struct NC_Cache *cache, struct NC_Cache_Ent *ent)
+{
+    ent->prev = NULL;
+    ent->next = cache->head;
+    if ( cache->head ) {
+	cache->head->prev = ent;
+    }
+    cache->head = ent;
+    if ( !cache->tail ) {
+	cache->tail = ent;
+    }
+}
+
+/* Close the file for ent, remove it from cache, and free it */
+static void free_ent(struct NC_Cache *cache, struct NC_Cache_Ent *ent)
+{
+    struct Hash_Entry **bp, **bp1, *ep;
+
+    unlink_ent(cache, ent);
+    Hash_Rm(&cache->files, ent->path);
+    cache->n_files--;
+    nc_close(ent->nc_id);
+    for (bp = ent->vars.buckets, bp1 = bp + ent->vars.n_buckets;
+	    bp && bp < bp1; bp++) {
+	for (ep = *bp; ep; ep = ep->next) {
+	    FREE(ep->val);
+	}
+    }
+    Hash_Clear(&ent->vars);
+    FREE(ent->path);
+    FREE(ent);
+}
+
+/* Remove slab from the recently used list of cache */
+static void unlink_slab(struct NC_Cache *cache, struct NC_Cache_Slab *slab)
+{
+    if ( slab->prev ) {
+	slab->prev->next = slab->next;
+    } else {
+	cache->slab_head = slab->next;
+    }
+    if ( slab->next ) {
+	slab->next->prev = slab->prev;
+    } else {
+	cache->slab_tail = slab->prev;
+    }
+    slab->prev = slab->next = NULL;
+}
+
+/* Put slab at the front of the recently used list of cache */
+static void push_slab(struct NC_Cache *cache, struct NC_Cache_Slab *slab)
+{
+    slab->prev = NULL;
+    slab->next = cache->slab_head;
+    if ( cache->slab_head ) {
+	cache->slab_head->prev = slab;
+    }
+    cache->slab_head = slab;
+    if ( !cache->slab_tail ) {
+	cache->slab_tail = slab;
+    }
+}
+
+/* Remove slab from cache and free it */
+static void free_slab(struct NC_Cache *cache, struct NC_Cache_Slab *slab)
+{
+    unlink_slab(cache, slab);
+    Hash_Rm(&cache->slabs, slab->key);
+    cache->slab_bytes -= slab->sz;
+    FREE(slab->buf);
+    FREE(slab->path);
+    FREE(slab->key);
+    FREE(slab);
+}
+
+/*
+   Return the modification time in sbuf in nanoseconds, to the nanosecond
+   where the system provides it, so that a file replaced within a second
+   is not taken for the one in cache.
+ */
+static long long mtime_ns(const struct stat *sbuf)
+{
+#if _POSIX_VERSION >= 200809L
+    return (long long)sbuf->st_mtim.tv_sec * 1000000000LL
+	+ sbuf->st_mtim.tv_nsec;
+#else
+    return (long long)sbuf->st_mtime * 1000000000LL;
+#endif
+}
@@ -0,0 +1,101 @@
+/*
+   -	nccache.h --
+   -		Declarations for a cache of open NetCDF files
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#ifndef NCCACHE_H_
+#define NCCACHE_H_
+
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <time.h>
+#include "hash.h"
+
+/*
+   A cache of open NetCDF files, so that a process that answers many
+   requests does not open and parse the header of the same file for each
+   one. Files are found by path and closed in least recently used order
+   when the cache is full. Variable identifiers are cached with each file.
+   Optionally, the cache also keeps recently read slabs, up to a limit on
+   their total size, so that repeated requests for the same values do not
+   read the file again.
+ */
+
+struct NC_Cache_Ent {
+    char *path;				/* Path to file */
+    int nc_id;				/* NetCDF file identifier */
+    dev_t dev;				/* Device when opened */
+    ino_t ino;				/* Inode when opened */
+    long long mtime;			/* Modification time when opened,
+					   nanoseconds */
+    off_t size;				/* Size when opened */
+    struct Hash_Tbl vars;		/* Variable name -> int * identifier */
+    struct NC_Cache_Ent *prev, *next;	/* Neighbors in recently used list */
+};
+
+struct NC_Cache_Slab {
+    char *key;				/* Identifies the values */
+    char *path;				/* File the values came from */
+    dev_t dev;				/* Device of path */
+    ino_t ino;				/* Inode of path */
+    long long mtime;			/* Modification time of path,
+					   nanoseconds */
+    off_t size;				/* Size of path */
+    void *buf;				/* The values */
+    size_t sz;				/* Number of bytes at buf */
+    struct NC_Cache_Slab *prev, *next;	/* Neighbors in recently used list */
+};
+
+struct NC_Cache {
+    struct Hash_Tbl files;		/* Path -> struct NC_Cache_Ent * */
+    struct NC_Cache_Ent *head;		/* Most recently used file */
+    struct NC_Cache_Ent *tail;		/* Least recently used file */
+    unsigned n_files;			/* Number of open files */
+    unsigned max_files;			/* Maximum number of open files */
+    unsigned long hits, misses;		/* Counts of Open requests */
+    struct Hash_Tbl slabs;		/* Key -> struct NC_Cache_Slab * */
+    struct NC_Cache_Slab *slab_head;	/* Most recently used slab */
+    struct NC_Cache_Slab *slab_tail;	/* Least recently used slab */
+    size_t slab_bytes;			/* Bytes in cached slabs */
+    size_t max_slab_bytes;		/* Limit on slab_bytes */
+};
+
+int NC_Cache_Init(struct NC_Cache *, unsigned, size_t);
+int NC_Cache_Open(struct NC_Cache *, const char *, int *);
+int NC_Cache_Varid(struct NC_Cache *, int, const char *, int *);
+void *NC_Cache_Slab_Get(struct NC_Cache *, const char *, const char *,
+	size_t *);
+int NC_Cache_Slab_Put(struct NC_Cache *, const char *, const char *, void *,
+	size_t);
+void NC_Cache_Free(struct NC_Cache *);
+
+#endif
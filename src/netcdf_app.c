@@ -32,18 +32,325 @@
    .	$Revision: 1.4 $ $Date: 2013/12/13 20:18:28 $
  */
 
+#define _XOPEN_SOURCE 700		/* For st_mtim */
 #include "unix_defs.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <math.h>
+#include <stddef.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <ftw.h>
+#include <fnmatch.h>
 #include <netcdf.h>
+#ifdef HAVE_HDF5
+#include <hdf5.h>
+#endif
 #include "hash.h"
 #include "alloc.h"
+#include "fmt.h"
+#include "obuf.h"
+#include "rawout.h"
+#include "slab.h"
+#include "tpipe.h"
+#include "varstat.h"
+#include "rdr.h"
+#include "nccache.h"
+#include "shmout.h"
+#include "zmap.h"
+#include "h5chunk.h"
+#include "catalog.h"
+#include "cdfhdr.h"
+
+/* Size of output buffer for data values */
+#define OBUF_SIZE (1 << 20)
+
+/* Maximum number of data values to read at a time */
+#define SLAB_ELEM (1 << 20)
+
+/*
+   Number of data values per slab when reading, formatting, and writing
+   text in separate threads.
+ */
+#define PIPE_ELEM (1 << 15)
+
+/*
+   headers --storage warns about chunks smaller than SMALL_CHUNK bytes, and
+   about chunks that make reading one record read MAX_REC_AMP or more times
+   the data it needs.
+ */
+#define SMALL_CHUNK 4096
+#define MAX_REC_AMP 8
+
+/* Number of values stats reads at a time */
+#define STATS_ELEM (1 << 20)
+
+/* Variable for a stats worker, in order of decreasing size */
+struct Stats_Task {
+    int v;				/* Variable identifier */
+    size_t n;				/* Number of values */
+};
+
+/* Result from a stats worker */
+struct Stats_Res {
+    int v;				/* Variable identifier */
+    int ok;				/* If false, worker failed */
+    struct Var_Stats stats;		/* Statistics for variable v */
+};
+
+/*
+   bench reads whole variables in slabs of BENCH_ELEM values, and random
+   hyperslabs of at most BENCH_RAND_ELEM values.
+ */
+#define BENCH_ELEM (1 << 20)
+#define BENCH_RAND_ELEM (1 << 16)
+
+/* Reads for one bench access pattern */
+struct Bench_Plan {
+    char *name;				/* Name of access pattern */
+    int ndims;				/* Number of dimensions of variable */
+    size_t n_reads;			/* Number of reads */
+    size_t *start;			/* Start of each read, n_reads * ndims */
+    size_t *count;			/* Count for each read, n_reads * ndims */
+    ptrdiff_t *stride;			/* Stride for every read, ndims */
+    size_t max_elem;			/* Number of values in largest read */
+    size_t tot_elem;			/* Number of values in all reads */
+};
+
+/*
+   rechunk aims for chunks of about RECHUNK_BYTES bytes, and by default
+   keeps at most RECHUNK_MEM bytes of values in memory.
+ */
+#define RECHUNK_BYTES (1 << 20)
+#define RECHUNK_MEM (256 << 20)
+
+/* Output formats for data values */
+enum Out_Fmt {OUT_TEXT, OUT_RAW, OUT_NPY, OUT_SHM};
+
+/* Maximum size of npy header */
+#define NPY_HDR_LEN 1024
+
+/* Size hint for the I/O buffer of classic cat output, bytes */
+#define CAT_BUF (4 << 20)
+
+/*
+   Maximum length of a path scan gives to a worker. A task must not be
+   larger than PIPE_BUF.
+ */
+#define SCAN_PATH 1024
+
+/* Default number of scan workers per processor */
+#define SCAN_JOBS_PER_CPU 4
+
+/* Maximum number of directories nftw keeps open for scan */
+#define SCAN_FDS 64
+
+/* Number of values in each zone map block, if variable is not chunked */
+#define ZMAP_ELEM (1 << 16)
+
+/* Maximum length of shared memory segment name, including nul */
+#define SHM_NM_LEN 256
+
+/* Maximum number of files batch keeps open by default */
+#define BATCH_FILES 16
+
+/* Initial size of batch command line buffer. Grows as needed. */
+#define BATCH_LINE 1024
+
+/* Default megabytes of recently read values serve keeps */
+#define SERVE_SLAB_MB 64
+
+/* Maximum length of a serve request */
+#define SERVE_LINE (1 << 16)
+
+/* Bytes of responses waiting for a serve client at which serve stops
+   taking its requests until they are sent */
+#define SERVE_OUT (1 << 24)
+
+/* A serve client */
+struct Serve_Clnt {
+    int fd;				/* Socket, or -1 after close */
+    int eof;				/* If true, client sends no more */
+    char *in;				/* Request text not yet processed */
+    size_t in_len;			/* Number of bytes at in */
+    char *out;				/* Responses not yet sent */
+    size_t out_off;			/* Index in out of next byte to send */
+    size_t out_len;			/* Number of bytes at out */
+    size_t out_sz;			/* Allocation at out */
+};
+
+/* A variable from one cat input file */
+struct Cat_Task {
+    int f;				/* Index of input file */
+    int v;				/* Variable identifier */
+    size_t rec_off;			/* First output record for this file */
+    int rank;				/* Index among tasks with readers,
+					   or -1 if parent copies values */
+};
+
+/* A variable whose whole chunks extract copies through HDF5 */
+struct Ext_Var {
+    int v;				/* Variable identifier */
+    char nm[NC_MAX_NAME + 1];		/* Variable name */
+    int ndims;				/* Number of dimensions */
+    size_t *start;			/* Start of selection in input */
+    size_t *count;			/* Size of selection, and of output */
+    size_t *len;			/* Dimension lengths in input */
+    size_t *chunk;			/* Chunk lengths in both files */
+};
+
+/* A condition on the contents of a file for scan */
+struct Scan_Pred {
+    enum {SCAN_VAR, SCAN_DIM, SCAN_ATT} type;
+					/* What to look for */
+    char *var_nm;			/* Variable with attribute, NULL for
+					   global attribute */
+    char *nm;				/* Variable, dimension, or attribute
+					   name */
+    char *val;				/* Required value, or NULL for any */
+    size_t len;				/* val as dimension length */
+    double x;				/* val as number */
+    int is_num;				/* If true, x is set */
+};
+
+/* State of scan that the nftw callback needs */
+struct Scan_Walk {
+    char *argv0, *argv1;		/* argv[0], argv[1] */
+    char *pat;				/* Pattern for file names, or NULL */
+    int task_fd;			/* Write end of task pipe */
+    int res_fd;				/* Read end of result pipe, or -1 */
+    struct Cat *cat;			/* Catalog being updated, or NULL */
+    int ok;				/* 1 if no problems, 0 after an error,
+					   -1 to stop the walk */
+};
+
+/* A condition in a query */
+struct Qry_Pred {
+    char *var_nm;			/* Variable name */
+    int var_id;				/* NetCDF identifier for variable */
+    nc_type xtype;			/* Type of variable */
+    enum Zmap_Op op;			/* Comparison */
+    double v;				/* Right hand side of comparison */
+    int have_fill;			/* If true, fill is a fill value */
+    double fill;			/* Fill value */
+    struct Zmap zm;			/* Zone map, if have_zm */
+    int have_zm;			/* If true, zm is usable */
+    double *buf;			/* Values for current block */
+};
+
+/* Set by signal handler to stop serve */
+static volatile sig_atomic_t serve_stop;
+
+/* Where data_cb gets slabs of values */
+struct Data_Src {
+    char *argv0, *argv1;		/* For error messages */
+    int nc_id;				/* NetCDF file identifier */
+    int var_id;				/* NetCDF identifier for variable */
+    char *var_nm;			/* Variable name */
+    nc_type xtype;			/* Type of var */
+    int num_dims;			/* Number of dimensions of variable */
+    size_t *sel_start;			/* Start of selection in file */
+    ptrdiff_t *stride;			/* Step along each dimension */
+    size_t *start;			/* Start of current slab in file */
+    ptrdiff_t *rd_stride;		/* Step for reading current slab,
+					   positive */
+    size_t elem_sz;			/* Size of a value in bytes */
+    struct Slab *slab;			/* Iterates over selection */
+    size_t i;				/* Index in output of next value */
+    size_t llen;			/* Number of values in each line of
+					   text output */
+};
 
 /* Callbacks for the subcommands.  */ 
 typedef int (callback)(int , char **);
 static callback headers_cb;
+static int headers_cdf(char *, char *, const struct CDF_Hdr *);
+static char *type_nm(nc_type);
 static callback data_cb;
+static callback stats_cb;
+static callback bench_cb;
+static callback rechunk_cb;
+static callback batch_cb;
+static callback serve_cb;
+static callback index_cb;
+static callback query_cb;
+static callback cat_cb;
+static int cat_direct(char *, int, int, nc_type, int, const size_t *, size_t,
+	int);
+static callback extract_cb;
+static int extract_box(int, int, int, int, nc_type, int, const size_t *,
+	const size_t *, const size_t *, const size_t *);
+static int create_mode(int);
+static callback scan_cb;
+static int scan_visit(const char *, const struct stat *, int, struct FTW *);
+static ssize_t scan_drain(int);
+static void scan_worker(struct Scan_Pred *, int, int, int);
+static int nc_magic(const char *);
+static int scan_match(int, const struct Scan_Pred *, int);
+static int path_under(const char *, char **, int);
+static int att_listed(const char *, const char *, uint32_t);
+static callback catalog_cb;
+static void catalog_worker(const char *, uint32_t, int, int);
+static int catalog_rec(int, const char *, const struct stat *, const char *,
+	uint32_t, struct Cat_Buf *);
+static int catalog_rec_cdf(const struct CDF_Hdr *, const char *,
+	const struct stat *, const char *, uint32_t, struct Cat_Buf *);
+static int64_t mtime_ns(const struct stat *);
+static int scan_cat(char *, char *, const char *, const struct Scan_Pred *,
+	int, const char *, char **, int);
+static int scan_cat_match(const struct Cat_Rec_Hdr *,
+	const struct Scan_Pred *, int);
+static double cat_att_val(int, const unsigned char *, uint32_t);
+static int split_ln(char *, char *, char ***, size_t *);
+static int run_cmd(int, char **);
+static void serve_req(struct Serve_Clnt *, char *, char *, char ***, size_t *,
+	int, int);
+static int serve_put(struct Serve_Clnt *, const void *, size_t);
+static void serve_close(struct Serve_Clnt *);
+static void serve_handler(int);
+static int app_open(char *, int *);
+static int app_close(int);
+static int app_varid(int, char *, int *);
+static int parse_sel(const char *, size_t, size_t *, size_t *, ptrdiff_t *,
+	int *);
+static int get_vars(int, int, nc_type, const size_t *, const size_t *,
+	const ptrdiff_t *, void *);
+static int print_vals(struct Obuf *, nc_type, const void *, size_t, size_t,
+	size_t);
+static int data_rd(void *, void *, size_t *, size_t *);
+static void rev_dim(unsigned char *, size_t, int, const size_t *, int);
+static int data_fmt(void *, const void *, size_t, size_t, struct Obuf *);
+static char *npy_descr(nc_type, size_t *);
+static int print_storage(char *, char *, char *, int, int, int, char *,
+	nc_type, int, const int *);
+static int disk_size(char *, char *, unsigned long long *);
+static int stats_task_cmp(const void *, const void *);
+static void stats_worker(char *, int, int);
+static int var_stats(int, int, double *, struct Var_Stats *);
+static int var_fill(int, int, nc_type, double *);
+static char *opt_val(char *, int *, int, char **);
+static int bench_plan(struct Bench_Plan *, char *, int, const size_t *,
+	size_t, ptrdiff_t, unsigned long long *);
+static int bench_run(char *, char *, nc_type, const struct Bench_Plan *, int,
+	void *, double *);
+static void bench_report(char *, const struct Bench_Plan *, char *, size_t,
+	double *);
+static void bench_free(struct Bench_Plan *);
+static unsigned long long bench_rand(unsigned long long *);
+static int dbl_cmp(const void *, const void *);
+static int chunk_shape(char *, int, const size_t *, size_t, size_t *);
+static void chunk_blk(int, const size_t *, const size_t *, size_t, size_t *);
+static int copy_var(char *, int, int, int, int, const size_t *,
+	const size_t *, size_t, int, void *);
 
 /*
    Subcommand names and associated callbacks. Empty command names and NULL
@@ -52,14 +359,40 @@ static callback data_cb;
    pr_hash_cmd helps make this table.
  */
 
-#define N_HASH_CMD 7
+#define N_HASH_CMD 64
 static char *cmd1v[N_HASH_CMD] = {
-    "data", "", "", "", "", "headers", "", 
+    "", "extract", "", "", "", "", "headers", "", 
+    "query", "", "", "", "", "", "", "serve", 
+    "", "", "index", "", "", "", "cat", "", 
+    "", "catalog", "rechunk", "", "", "", "", "stats", 
+    "", "", "", "", "", "", "", "", 
+    "", "", "data", "", "", "", "", "", 
+    "bench", "", "", "", "", "", "", "", 
+    "", "", "batch", "", "", "scan", "", "", 
+    
 };
 static callback *cb1v[N_HASH_CMD] = {
-    data_cb, NULL, NULL, NULL, NULL, headers_cb, NULL, 
+    NULL, extract_cb, NULL, NULL, NULL, NULL, headers_cb, NULL, 
+    query_cb, NULL, NULL, NULL, NULL, NULL, NULL, serve_cb, 
+    NULL, NULL, index_cb, NULL, NULL, NULL, cat_cb, NULL, 
+    NULL, catalog_cb, rechunk_cb, NULL, NULL, NULL, NULL, stats_cb, 
+    NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 
+    NULL, NULL, data_cb, NULL, NULL, NULL, NULL, NULL, 
+    bench_cb, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 
+    NULL, NULL, batch_cb, NULL, NULL, scan_cb, NULL, NULL, 
+    
 };
 
+/*
+   Open files for batch. NULL outside of batch, in which case subcommands
+   open and close files themselves.
+ */
+
+static struct NC_Cache *nc_cache;
+
+/* Set up by scan_cb and catalog_cb for scan_visit */
+static struct Scan_Walk scan_walk;
+
 /* Usage: nnetcdf command [args ...] */
 
 int main(int argc, char *argv[])
@@ -92,7 +425,7 @@ int main(int argc, char *argv[])
     return 0;
 }
 
-/* nnetcdf headers file */
+/* nnetcdf headers [-s|--storage] file */
 static int headers_cb(int argc, char *argv[])
 {
     char *argv0, *argv1;		/* argv[0], argv[1] */
@@ -106,19 +439,50 @@ static int headers_cb(int argc, char *argv[])
     size_t len;				/* Dimension length */
     nc_type xtype;			/* Data type */
     int d, v;				/* Dimension, variable index */
+    int storage = 0;			/* If true, report storage layout */
+    int fmt;				/* File format */
+    char *fmt_nm;			/* Name for fmt */
+    char *t_nm;				/* Name for xtype */
+    struct CDF_Hdr hdr;			/* Header of classic file */
 
     argv0 = argv[0];
     argv1 = argv[1];
-    if ( argc != 3 ) {
-	fprintf(stderr, "Usage: %s %s file\n", argv0, argv1);
+    if ( argc == 4 && (strcmp(argv[2], "-s") == 0
+		|| strcmp(argv[2], "--storage") == 0) ) {
+	storage = 1;
+    } else if ( argc != 3 ) {
+	fprintf(stderr, "Usage: %s %s [-s|--storage] file\n", argv0, argv1);
 	return 0;
     }
-    nc_fl_nm = argv[2];
-    if ( (status = nc_open(nc_fl_nm, 0, &nc_id)) != NC_NOERR ) {
+    nc_fl_nm = argv[argc - 1];
+
+    /* Classic headers take one read without libnetcdf */
+    if ( !storage && CDF_Hdr_Read(nc_fl_nm, &hdr) ) {
+	status = headers_cdf(argv0, argv1, &hdr);
+	CDF_Hdr_Free(&hdr);
+	return status;
+    }
+    if ( (status = app_open(nc_fl_nm, &nc_id)) != NC_NOERR ) {
 	fprintf(stderr, "%s %s: failed to open %s.\n%s\n",
 		argv0, argv1, nc_fl_nm, nc_strerror(status));
+	return 0;
+    }
+    if ( (status = nc_inq_format(nc_id, &fmt)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: could not get format of %s.\n%s\n",
+		argv0, argv1, nc_fl_nm, nc_strerror(status));
 	goto error;
     }
+    if ( storage ) {
+	switch (fmt) {
+	    case NC_FORMAT_CLASSIC:         fmt_nm = "classic";         break;
+	    case NC_FORMAT_64BIT_OFFSET:    fmt_nm = "64bit_offset";    break;
+	    case NC_FORMAT_CDF5:            fmt_nm = "cdf5";            break;
+	    case NC_FORMAT_NETCDF4:         fmt_nm = "netcdf4";         break;
+	    case NC_FORMAT_NETCDF4_CLASSIC: fmt_nm = "netcdf4_classic"; break;
+	    default:                        fmt_nm = "unknown";         break;
+	}
+	printf("format %s\n", fmt_nm);
+    }
     if ( (status = nc_inq_ndims(nc_id, &num_dims)) != NC_NOERR ) {
 	fprintf(stderr, "%s %s: could not get number of dimensions.\n"
 		"%s\n", argv0, argv1, nc_strerror(status));
@@ -150,20 +514,12 @@ static int headers_cb(int argc, char *argv[])
 	    goto error;
 	}
 	printf("var %s", name);
-	switch (xtype) {
-	    case NC_BYTE:   printf(" NC_BYTE");   break;
-	    case NC_CHAR:   printf(" NC_CHAR");   break;
-	    case NC_SHORT:  printf(" NC_SHORT");  break;
-	    case NC_INT:    printf(" NC_INT");    break;
-	    case NC_FLOAT:  printf(" NC_FLOAT");  break;
-	    case NC_DOUBLE: printf(" NC_DOUBLE"); break;
-	    case NC_UBYTE:  printf(" NC_UBYTE");  break;
-	    case NC_USHORT: printf(" NC_USHORT"); break;
-	    case NC_UINT:   printf(" NC_UINT");   break;
-	    default:        fprintf(stderr, "\n%s %s: unknown type for "
-				    "variable %s\n", argv0, argv1,
-				    name);        goto error;
+	if ( !(t_nm = type_nm(xtype)) ) {
+	    fprintf(stderr, "\n%s %s: unknown type for variable %s\n",
+		    argv0, argv1, name);
+	    goto error;
 	}
+	printf(" %s", t_nm);
 	for (d = 0; d < num_dims; d++) {
 	    status = nc_inq_dimname(nc_id, dim_ids[d], name);
 	    if ( status != NC_NOERR ) {
@@ -175,93 +531,248 @@ static int headers_cb(int argc, char *argv[])
 	    printf(" %s", name);
 	}
 	printf("\n");
+	if ( storage ) {
+	    status = nc_inq_varname(nc_id, v, name);
+	    if ( status != NC_NOERR ) {
+		fprintf(stderr, "%s %s: could not get name for variable %d."
+			"\n%s\n", argv0, argv1, v, nc_strerror(status));
+		goto error;
+	    }
+	    if ( !print_storage(argv0, argv1, nc_fl_nm, nc_id, fmt, v, name,
+			xtype, num_dims, dim_ids) ) {
+		goto error;
+	    }
+	}
     }
     FREE(dim_ids);
-    nc_close(nc_id);
+    app_close(nc_id);
     return 1;
 
 error:
     FREE(dim_ids);
-    nc_close(nc_id);
+    app_close(nc_id);
     return 0;
 }
 
-/* nnetcdf data var_name index [index ...] file */
+/*
+   Print the dimensions and variables in classic header hdr as headers_cb
+   prints them. Return 1 on success. On failure, print a message to stderr
+   and return 0.
+ */
+static int headers_cdf(char *argv0, char *argv1, const struct CDF_Hdr *hdr)
+{
+    const struct CDF_Var *var;
+    char *t_nm;				/* Name for variable type */
+    int d, v;
+
+    for (d = 0; d < hdr->n_dims; d++) {
+	printf("dim %s %zi\n", hdr->dims[d].name, hdr->dims[d].len);
+    }
+    for (v = 0; v < hdr->n_vars; v++) {
+	var = hdr->vars + v;
+	printf("var %s", var->name);
+	if ( !(t_nm = type_nm(var->xtype)) ) {
+	    fprintf(stderr, "\n%s %s: unknown type for variable %s\n",
+		    argv0, argv1, var->name);
+	    return 0;
+	}
+	printf(" %s", t_nm);
+	for (d = 0; d < var->ndims; d++) {
+	    printf(" %s", hdr->dims[var->dim_ids[d]].name);
+	}
+	printf("\n");
+    }
+    return 1;
+}
+
+/*
+   Return the name headers prints for type xtype, or NULL if headers does
+   not print it.
+ */
+static char *type_nm(nc_type xtype)
+{
+    switch (xtype) {
+	case NC_BYTE:   return "NC_BYTE";
+	case NC_CHAR:   return "NC_CHAR";
+	case NC_SHORT:  return "NC_SHORT";
+	case NC_INT:    return "NC_INT";
+	case NC_FLOAT:  return "NC_FLOAT";
+	case NC_DOUBLE: return "NC_DOUBLE";
+	case NC_UBYTE:  return "NC_UBYTE";
+	case NC_USHORT: return "NC_USHORT";
+	case NC_UINT:   return "NC_UINT";
+	default:        return NULL;
+    }
+}
+
+/*
+   nnetcdf data [--format=text|raw|npy] [--shm[=name]] [--jobs=n] var_name
+	   [selection ...] file
+
+   With --shm, put the values in a POSIX shared memory segment laid out as
+   described in shmout.h, and print only the segment name. The consumer
+   removes the segment.
+ */
 static int data_cb(int argc, char *argv[])
 {
     char *argv0, *argv1;		/* argv[0], argv[1] */
     char *nc_fl_nm;			/* Path to NetCDF file */
-    int nc_id;				/* NetCDF file identifier */
+    int nc_id = -1;			/* NetCDF file identifier */
     char *var_nm;			/* Variable name, from command line */
     int var_id;				/* NetCDF identifier for variable */
     nc_type xtype;			/* Type of var */
-    int num_idx;			/* Number of indeces specified on
+    int num_idx;			/* Number of selections specified on
 					   command line */
     int status;				/* Return code from NetCDF function
 					   call */
-    size_t *start = NULL;		/* Where to start slice in NetCDF file.
-					   See netcdf (3). */
     int num_dims;			/* Number of dimensions of variable */
     int *dim_ids = NULL;		/* Dimension identifiers */
-    size_t *count = NULL;		/* Count of values along each dimension
-					   for which values will be printed.
+    size_t *len = NULL;			/* Dimension lengths */
+    size_t *sel_start = NULL;		/* Start of selection in file */
+    size_t *sel_count = NULL;		/* Number of elements selected along
+					   each dimension */
+    ptrdiff_t *stride = NULL;		/* Step along each dimension */
+    int *fixed = NULL;			/* If true, dimension was given as a
+					   single index */
+    size_t *start = NULL;		/* Start of current slab in file.
 					   See netcdf (3). */
+    ptrdiff_t *rd_stride = NULL;	/* Step for reading current slab */
+    struct Slab slab;			/* Iterates over selection */
+    int have_slab = 0;			/* If true, slab must be freed */
     int a, d;				/* Argument index, dimension index */
-    void *dat = NULL;			/* Data values to fetch and print */
-    size_t num_elem;			/* Number of data values */
-    int llen;				/* Number of elements in each line of
+    void *dat = NULL;			/* Values from current slab */
+    size_t num_elem;			/* Number of values selected */
+    size_t slab_elem;			/* Maximum number of values in a slab */
+    size_t n;				/* Number of values in current slab */
+    size_t llen;			/* Number of elements in each line of
 					   output */
+    size_t i;				/* Index of first value of slab in
+					   selection */
+    struct Obuf ob = {STDOUT_FILENO, NULL, 0, 0};
+					/* Output buffer */
+    enum Out_Fmt out_fmt = OUT_TEXT;	/* Output format */
+    long n_jobs = 0;			/* Number of formatter threads */
+    int pipe;				/* If true, read, format, and write
+					   text in separate threads */
+    char *opt, *val;			/* Option name and value */
+    size_t opt_len;			/* Length of option name */
+    int a0;				/* Index in argv of first selection */
+    struct Data_Src src;		/* Where to get slabs */
+    char *descr;			/* Numpy type */
+    size_t elem_sz;			/* Size of one value in bytes */
+    char npy_hdr[NPY_HDR_LEN];		/* npy header */
+    size_t *shape = NULL;		/* Shape of output array */
+    int num_shape;			/* Number of dimensions in shape */
+    size_t hdr_len;			/* Length of npy header */
+    int pinned = 0;			/* If true, dat belongs to output pipe */
+    char shm_nm[SHM_NM_LEN] = "";	/* Shared memory segment name */
+    void *seg = NULL;			/* Shared memory segment */
+    size_t seg_sz;			/* Size of segment */
+    size_t data_off;			/* Offset of values in segment */
+    unsigned char fill[8];		/* Fill value */
+    int no_fill;			/* If true, variable has no fill */
 
     argv0 = argv[0];
     argv1 = argv[1];
-    if ( argc < 4 ) {
-	fprintf(stderr, "Usage: %s %s var_name [index ...] file\n",
-		argv0, argv1);
+    for (a0 = 3; a0 < argc && strncmp(argv[a0 - 1], "--", 2) == 0; a0++) {
+	opt = argv[a0 - 1];
+	if ( strcmp(opt, "--shm") == 0 ) {
+	    out_fmt = OUT_SHM;
+	    continue;
+	}
+	if ( (val = strchr(opt, '=')) ) {
+	    opt_len = val++ - opt;
+	} else if ( a0 < argc - 1 ) {
+	    opt_len = strlen(opt);
+	    val = argv[a0++];
+	} else {
+	    fprintf(stderr, "%s %s: %s requires an argument\n",
+		    argv0, argv1, opt);
+	    return 0;
+	}
+	if ( opt_len == 8 && strncmp(opt, "--format", 8) == 0 ) {
+	    if ( strcmp(val, "text") == 0 ) {
+		out_fmt = OUT_TEXT;
+	    } else if ( strcmp(val, "raw") == 0 ) {
+		out_fmt = OUT_RAW;
+	    } else if ( strcmp(val, "npy") == 0 ) {
+		out_fmt = OUT_NPY;
+	    } else {
+		fprintf(stderr, "%s %s: unknown format %s. Format must be "
+			"text, raw, or npy.\n", argv0, argv1, val);
+		return 0;
+	    }
+	} else if ( opt_len == 6 && strncmp(opt, "--jobs", 6) == 0 ) {
+	    if ( sscanf(val, "%ld", &n_jobs) != 1 || n_jobs < 1 ) {
+		fprintf(stderr, "%s %s: expected positive integer for number "
+			"of jobs, got %s\n", argv0, argv1, val);
+		return 0;
+	    }
+	} else if ( opt_len == 5 && strncmp(opt, "--shm", 5) == 0 ) {
+	    if ( strlen(val) == 0 || strlen(val) >= SHM_NM_LEN ) {
+		fprintf(stderr, "%s %s: shared memory name must have 1 to %d "
+			"characters.\n", argv0, argv1, SHM_NM_LEN - 1);
+		return 0;
+	    }
+	    strcpy(shm_nm, val);
+	    out_fmt = OUT_SHM;
+	} else {
+	    fprintf(stderr, "%s %s: unknown option %s\n", argv0, argv1, opt);
+	    return 0;
+	}
+    }
+    if ( argc < a0 + 1 ) {
+	fprintf(stderr, "Usage: %s %s [--format=text|raw|npy] [--shm[=name]] "
+		"[--jobs=n] var_name [selection ...] file\n", argv0, argv1);
 	return 0;
     }
-    var_nm = argv[2];
+    var_nm = argv[a0 - 1];
     nc_fl_nm = argv[argc - 1];
-    num_idx = argc - 4;
+    num_idx = argc - a0 - 1;
 
     /* Open data file and get information about the variable */
-    if ( (status = nc_open(nc_fl_nm, 0, &nc_id)) != NC_NOERR ) {
+    if ( (status = app_open(nc_fl_nm, &nc_id)) != NC_NOERR ) {
 	fprintf(stderr, "%s %s: failed to open %s.\n%s\n",
 		argv0, argv1, nc_fl_nm, nc_strerror(status));
+	nc_id = -1;
 	goto error;
     }
-    if ( (status = nc_inq_varid(nc_id, var_nm, &var_id)) != NC_NOERR ) {
+    if ( (status = app_varid(nc_id, var_nm, &var_id)) != NC_NOERR ) {
 	fprintf(stderr, "%s %s: could not find variable named %s.\n%s\n",
 		argv0, argv1, var_nm, nc_strerror(status));
 	goto error;
     }
-    if ( (nc_inq_vartype(nc_id, var_id, &xtype)) != NC_NOERR ) {
+    if ( (status = nc_inq_vartype(nc_id, var_id, &xtype)) != NC_NOERR ) {
 	fprintf(stderr, "%s %s: could not determine type for %s.\n"
 		"%s\n", argv0, argv1, var_nm, nc_strerror(status));
 	goto error;
     }
+    if ( !(descr = npy_descr(xtype, &elem_sz)) ) {
+	fprintf(stderr, "%s %s: cannot read type of %s\n",
+		argv0, argv1, var_nm);
+	goto error;
+    }
     if ( (status = nc_inq_varndims(nc_id, var_id, &num_dims)) != NC_NOERR ) {
 	fprintf(stderr, "%s %s: could not get number of dimensions for %s.\n"
 		"%s\n", argv0, argv1, var_nm, nc_strerror(status));
 	goto error;
     }
     if ( num_idx > num_dims ) {
-	fprintf(stderr, "%s %s: number of indeces exceeds number of "
+	fprintf(stderr, "%s %s: number of selections exceeds number of "
 		"dimensions.\n", argv0, argv1);
 	goto error;
     }
-    if ( !(dim_ids = CALLOC(num_dims, sizeof(int))) ) {
-	fprintf(stderr, "%s %s: could not allocate array of %u dimension "
-		"identifiers.\n", argv0, argv1, num_dims);
-	goto error;
-    }
-    if ( !(start = CALLOC(num_dims, sizeof(size_t))) ) {
-	fprintf(stderr, "%s %s: could not allocate array of %u indeces.\n",
-		argv0, argv1, num_dims);
-	goto error;
-    }
-    if ( !(count = CALLOC(num_dims, sizeof(size_t))) ) {
-	fprintf(stderr, "%s %s: could not allocate array of %u dimension "
-		"sizes.\n", argv0, argv1, num_dims);
+    if ( !(dim_ids = CALLOC(num_dims + 1, sizeof(int)))
+	    || !(len = CALLOC(num_dims + 1, sizeof(size_t)))
+	    || !(sel_start = CALLOC(num_dims + 1, sizeof(size_t)))
+	    || !(sel_count = CALLOC(num_dims + 1, sizeof(size_t)))
+	    || !(stride = CALLOC(num_dims + 1, sizeof(ptrdiff_t)))
+	    || !(fixed = CALLOC(num_dims + 1, sizeof(int)))
+	    || !(start = CALLOC(num_dims + 1, sizeof(size_t)))
+	    || !(rd_stride = CALLOC(num_dims + 1, sizeof(ptrdiff_t)))
+	    || !(shape = CALLOC(num_dims + 1, sizeof(size_t))) ) {
+	fprintf(stderr, "%s %s: could not allocate arrays for %d "
+		"dimensions.\n", argv0, argv1, num_dims);
 	goto error;
     }
     if ( (status = nc_inq_vardimid(nc_id, var_id, dim_ids)) != NC_NOERR ) {
@@ -269,14 +780,8 @@ static int data_cb(int argc, char *argv[])
 		"%s\n", argv0, argv1, var_nm, nc_strerror(status));
 	goto error;
     }
-
-    /*
-       Initialize count array with sizes of each dimension. Thus, default
-       is to print all values for each dimension.
-     */
-
     for (d = 0; d < num_dims; d++) {
-	if ( (status = nc_inq_dimlen(nc_id, dim_ids[d], count + d))
+	if ( (status = nc_inq_dimlen(nc_id, dim_ids[d], len + d))
 		!= NC_NOERR ) {
 	    fprintf(stderr, "%s %s: could not get length for dimension %d.\n"
 		    "%s\n", argv0, argv1, d, nc_strerror(status));
@@ -285,187 +790,5352 @@ static int data_cb(int argc, char *argv[])
     }
 
     /*
-       Put indeces from command line into start. Set corresponding element
-       of count to 1, indicating that the only element of this dimension to be
-       printed is the one the index specifies, instead of all members.
+       Default is to print all values for each dimension. Selections from
+       the command line apply to the leading dimensions. A selection is an
+       index, or start:stop:step as for a Python slice.
      */
 
-    for (a = 3, d = 0; a < argc - 1; a++, d++) {
-	if ( sscanf(argv[a], "%zd", start + d) != 1 ) {
-	    fprintf(stderr, "%s %s: expected integer for index %d, got %s\n",
-		    argv0, argv1, a - 3, argv[a]);
+    for (d = 0; d < num_dims; d++) {
+	sel_start[d] = 0;
+	sel_count[d] = len[d];
+	stride[d] = 1;
+    }
+    for (a = a0, d = 0; a < argc - 1; a++, d++) {
+	if ( !parse_sel(argv[a], len[d], sel_start + d, sel_count + d,
+		    stride + d, fixed + d) ) {
+	    fprintf(stderr, "%s %s: expected index or start:stop:step for "
+		    "dimension %d of length %zu, got %s\n",
+		    argv0, argv1, d, len[d], argv[a]);
 	    goto error;
 	}
-	count[d] = 1;
     }
-
-    /* Fetch and print array */
     for (num_elem = 1, d = 0; d < num_dims; d++) {
-	num_elem *= count[d];
+	num_elem *= sel_count[d];
     }
-    llen = count[num_dims - 1];
-    switch (xtype) {
-	case NC_BYTE:
-	case NC_CHAR:
-	    if ( !(dat = CALLOC(num_elem, 1)) ) {
-		fprintf(stderr, "%s %s: could not allocate data array "
-			"with %zd elements.\n", argv0, argv1, num_elem);
-	    }
-	    status = nc_get_vara_text(nc_id, var_id, start, count, (char *)dat);
-	    if ( status != NC_NOERR ) {
-		fprintf(stderr, "%s %s: could not read %s.\n%s\n",
-			argv0, argv1, var_nm, nc_strerror(status));
-		goto error;
-	    }
-	    for (d = 0; d < num_elem; d++) {
-		printf("%d%s",
-			((char *)dat)[d],
-			((d + 1) % llen) == 0 ? "\n" : " ");
-	    }
-	    break;
-	case NC_SHORT:
-	    if ( !(dat = CALLOC(num_elem, 2)) ) {
-		fprintf(stderr, "%s %s: could not allocate data array "
-			"with %zd elements.\n", argv0, argv1, num_elem);
-	    }
-	    status = nc_get_vara_short(nc_id, var_id, start, count,
-		    (short *)dat);
-	    if ( status != NC_NOERR ) {
-		fprintf(stderr, "%s %s: could not read %s.\n%s\n",
-			argv0, argv1, var_nm, nc_strerror(status));
-		goto error;
-	    }
-	    for (d = 0; d < num_elem; d++) {
-		printf("%d%s",
-			((short *)dat)[d],
-			((d + 1) % llen) == 0 ? "\n" : " ");
-	    }
-	    break;
-	case NC_INT:
-	    if ( !(dat = CALLOC(num_elem, 4)) ) {
-		fprintf(stderr, "%s %s: could not allocate data array "
-			"with %zd elements.\n", argv0, argv1, num_elem);
-	    }
-	    status = nc_get_vara_int(nc_id, var_id, start, count, (int *)dat);
-	    if ( status != NC_NOERR ) {
-		fprintf(stderr, "%s %s: could not read %s.\n%s\n",
-			argv0, argv1, var_nm, nc_strerror(status));
-		goto error;
-	    }
-	    for (d = 0; d < num_elem; d++) {
-		printf("%d%s",
-			((int *)dat)[d],
-			((d + 1) % llen) == 0 ? "\n" : " ");
-	    }
-	    break;
-	case NC_FLOAT:
-	    if ( !(dat = CALLOC(num_elem, 4)) ) {
-		fprintf(stderr, "%s %s: could not allocate data array "
-			"with %zd elements.\n", argv0, argv1, num_elem);
-	    }
-	    status = nc_get_vara_float(nc_id, var_id, start, count,
-		    (float *)dat);
-	    if ( status != NC_NOERR ) {
-		fprintf(stderr, "%s %s: could not read %s.\n%s\n",
-			argv0, argv1, var_nm, nc_strerror(status));
+    llen = (num_dims > 0) ? sel_count[num_dims - 1] : 1;
+
+    /*
+       Fetch and print selection in slabs. Slab indeces are relative to the
+       selection, so slab start i along dimension d is sel_start[d]
+       + i * stride[d] in the file. With a negative step, data_rd reads
+       each slab forward and reverses it.
+     */
+
+    if ( n_jobs == 0 && (n_jobs = sysconf(_SC_NPROCESSORS_ONLN)) < 1 ) {
+	n_jobs = 1;
+    }
+    pipe = out_fmt == OUT_TEXT && n_jobs > 1 && num_elem > PIPE_ELEM;
+    slab_elem = pipe ? PIPE_ELEM : SLAB_ELEM;
+    if ( slab_elem > num_elem ) {
+	slab_elem = num_elem;
+    }
+    if ( !Slab_Init(&slab, num_dims, sel_count, slab_elem) ) {
+	fprintf(stderr, "%s %s: could not allocate slab iterator.\n",
+		argv0, argv1);
+	goto error;
+    }
+    have_slab = 1;
+    src.argv0 = argv0;
+    src.argv1 = argv1;
+    src.nc_id = nc_id;
+    src.var_id = var_id;
+    src.var_nm = var_nm;
+    src.xtype = xtype;
+    src.num_dims = num_dims;
+    src.sel_start = sel_start;
+    src.stride = stride;
+    src.start = start;
+    src.rd_stride = rd_stride;
+    src.elem_sz = elem_sz;
+    src.slab = &slab;
+    src.i = 0;
+    src.llen = llen;
+    fflush(stdout);
+
+    /* npy and shared memory shape omits dimensions given as single indeces */
+    for (num_shape = 0, d = 0; d < num_dims; d++) {
+	if ( !fixed[d] ) {
+	    shape[num_shape++] = sel_count[d];
+	}
+    }
+
+    /*
+       Text conversion is slow compared to reading and writing, so with
+       several processors and enough values, the calling thread reads slabs
+       while n_jobs threads convert them to text and another thread writes
+       the text in order. Each slab of text fits in about PIPE_ELEM
+       * FMT_BUF_LEN bytes.
+     */
+
+    if ( pipe ) {
+	if ( !Tpipe_Run(STDOUT_FILENO, n_jobs, slab_elem * elem_sz,
+		    (slab_elem + 1) * FMT_BUF_LEN, data_rd, data_fmt, &src) ) {
+	    fprintf(stderr, "%s %s: could not print %s.\n",
+		    argv0, argv1, var_nm);
+	    goto error;
+	}
+    } else if ( out_fmt == OUT_SHM ) {
+	/*
+	   Read slabs straight into the segment, so values are not copied
+	   after libnetcdf delivers them.
+	 */
+
+	status = nc_inq_var_fill(nc_id, var_id, &no_fill, fill);
+	if ( !(seg = Shm_Create(shm_nm, SHM_NM_LEN, xtype, elem_sz, num_shape,
+			shape, (status == NC_NOERR && !no_fill) ? fill : NULL,
+			&seg_sz)) ) {
+	    fprintf(stderr, "%s %s: could not create shared memory for %s.\n",
+		    argv0, argv1, var_nm);
+	    goto error;
+	}
+	data_off = ((struct Shm_Hdr *)seg)->data_off;
+	for (i = 0; i < num_elem; i += n) {
+	    if ( !data_rd(&src, (char *)seg + data_off + i * elem_sz, &n, &i) ) {
 		goto error;
 	    }
-	    for (d = 0; d < num_elem; d++) {
-		printf("%g%s",
-			((float *)dat)[d],
-			((d + 1) % llen) == 0 ? "\n" : " ");
-	    }
-	    break;
-	case NC_DOUBLE:
-	    if ( !(dat = CALLOC(num_elem, 8)) ) {
-		fprintf(stderr, "%s %s: could not allocate data array "
-			"with %zd elements.\n", argv0, argv1, num_elem);
-	    }
-	    status = nc_get_vara_double(nc_id, var_id, start, count,
-		    (double *)dat);
-	    if ( status != NC_NOERR ) {
-		fprintf(stderr, "%s %s: could not read %s.\n%s\n",
-			argv0, argv1, var_nm, nc_strerror(status));
+	    if ( n == 0 ) {
+		fprintf(stderr, "%s %s: selection of %s ended early.\n",
+			argv0, argv1, var_nm);
 		goto error;
 	    }
-	    for (d = 0; d < num_elem; d++) {
-		printf("%g%s",
-			((double *)dat)[d],
-			((d + 1) % llen) == 0 ? "\n" : " ");
-	    }
-	    break;
-	case NC_UBYTE:
-	    if ( !(dat = CALLOC(num_elem, 1)) ) {
-		fprintf(stderr, "%s %s: could not allocate data array "
-			"with %zd elements.\n", argv0, argv1, num_elem);
-	    }
-	    status = nc_get_vara_ubyte(nc_id, var_id, start, count,
-		    (unsigned char *)dat);
-	    if ( status != NC_NOERR ) {
-		fprintf(stderr, "%s %s: could not read %s.\n%s\n",
-			argv0, argv1, var_nm, nc_strerror(status));
+	}
+	munmap(seg, seg_sz);
+	seg = NULL;
+	printf("%s\n", shm_nm);
+    } else {
+	if ( !(dat = CALLOC(slab_elem > 0 ? slab_elem : 1, elem_sz)) ) {
+	    fprintf(stderr, "%s %s: could not allocate data array "
+		    "with %zd elements.\n", argv0, argv1, slab_elem);
+	    goto error;
+	}
+	if ( out_fmt == OUT_TEXT
+		&& !Obuf_Init(&ob, STDOUT_FILENO, OBUF_SIZE) ) {
+	    goto error;
+	}
+	if ( out_fmt == OUT_NPY ) {
+	    if ( !(hdr_len = Raw_Npy_Header(npy_hdr, NPY_HDR_LEN, descr,
+			    num_shape, shape))
+		    || !Raw_Write(STDOUT_FILENO, npy_hdr, hdr_len, NULL) ) {
+		fprintf(stderr, "%s %s: could not write npy header for %s.\n",
+			argv0, argv1, var_nm);
 		goto error;
 	    }
-	    for (d = 0; d < num_elem; d++) {
-		printf("%d%s",
-			((unsigned char *)dat)[d],
-			((d + 1) % llen) == 0 ? "\n" : " ");
-	    }
-	    break;
-	case NC_USHORT:
-	    if ( !(dat = CALLOC(num_elem, 2)) ) {
-		fprintf(stderr, "%s %s: could not allocate data array "
-			"with %zd elements.\n", argv0, argv1, num_elem);
-	    }
-	    status = nc_get_vara_ushort(nc_id, var_id, start, count,
-		    (unsigned short *)dat);
-	    if ( status != NC_NOERR ) {
-		fprintf(stderr, "%s %s: could not read %s.\n%s\n",
-			argv0, argv1, var_nm, nc_strerror(status));
+	}
+	while ( 1 ) {
+	    if ( !data_rd(&src, dat, &n, &i) ) {
 		goto error;
 	    }
-	    for (d = 0; d < num_elem; d++) {
-		printf("%d%s",
-			((unsigned short *)dat)[d],
-			((d + 1) % llen) == 0 ? "\n" : " ");
-	    }
-	    break;
-	case NC_UINT:
-	    if ( !(dat = CALLOC(num_elem, 4)) ) {
-		fprintf(stderr, "%s %s: could not allocate data array "
-			"with %zd elements.\n", argv0, argv1, num_elem);
-	    }
-	    status = nc_get_vara_uint(nc_id, var_id, start, count,
-		    (unsigned int *)dat);
-	    if ( status != NC_NOERR ) {
-		fprintf(stderr, "%s %s: could not read %s.\n%s\n",
-			argv0, argv1, var_nm, nc_strerror(status));
-		goto error;
+	    if ( n == 0 ) {
+		break;
 	    }
-	    for (d = 0; d < num_elem; d++) {
-		printf("%d%s",
-			((unsigned int *)dat)[d],
-			((d + 1) % llen) == 0 ? "\n" : " ");
+	    if ( out_fmt == OUT_TEXT ) {
+		if ( !print_vals(&ob, xtype, dat, n, i, llen) ) {
+		    fprintf(stderr, "%s %s: could not print %s.\n",
+			    argv0, argv1, var_nm);
+		    goto error;
+		}
+	    } else {
+		/*
+		   Values can go to a pipe by vmsplice only if dat will not
+		   be reused for another slab, and the process will exit
+		   soon. In batch mode, dat would leak on every request.
+		 */
+
+		if ( !Raw_Write(STDOUT_FILENO, dat, n * elem_sz,
+			    (n == num_elem && !nc_cache) ? &pinned : NULL) ) {
+		    fprintf(stderr, "%s %s: could not write %s.\n",
+			    argv0, argv1, var_nm);
+		    goto error;
+		}
 	    }
-	    break;
-	default:
-	    fprintf(stderr, "%s %s: cannot read type of %s\n",
+	}
+	if ( out_fmt == OUT_TEXT && !Obuf_Flush(&ob) ) {
+	    fprintf(stderr, "%s %s: could not print %s.\n",
 		    argv0, argv1, var_nm);
 	    goto error;
+	}
     }
 
+    /*
+       If dat went to a pipe by vmsplice, the pipe still refers to its
+       pages. Do not give it back to the allocator, which might reuse it.
+     */
+
+    if ( pinned ) {
+	dat = NULL;
+    }
+    Slab_Free(&slab);
+    Obuf_Free(&ob);
+    FREE(shape);
+    FREE(rd_stride);
     FREE(start);
+    FREE(fixed);
+    FREE(stride);
+    FREE(sel_count);
+    FREE(sel_start);
+    FREE(len);
     FREE(dim_ids);
-    FREE(count);
     FREE(dat);
-    nc_close(nc_id);
+    app_close(nc_id);
     return 1;
 
 error:
+    if ( seg ) {
+	munmap(seg, seg_sz);
+	Shm_Unlink(shm_nm);
+    }
+    if ( have_slab ) {
+	Slab_Free(&slab);
+    }
+    Obuf_Free(&ob);
+    FREE(shape);
+    FREE(rd_stride);
     FREE(start);
+    FREE(fixed);
+    FREE(stride);
+    FREE(sel_count);
+    FREE(sel_start);
+    FREE(len);
     FREE(dim_ids);
-    FREE(count);
     FREE(dat);
-    nc_close(nc_id);
+    if ( nc_id != -1 ) {
+	app_close(nc_id);
+    }
     return 0;
 }
+
+/* nnetcdf stats [--jobs=n] file [var_name ...] */
+static int stats_cb(int argc, char *argv[])
+{
+    char *argv0, *argv1;		/* argv[0], argv[1] */
+    char *nc_fl_nm;			/* Path to NetCDF file */
+    int nc_id = -1;			/* NetCDF file identifier */
+    int status;				/* Return code from NetCDF function
+					   call */
+    char name[NC_MAX_NAME + 1];		/* Variable name */
+    long n_jobs = 0;			/* Number of worker processes */
+    char *opt, *val;			/* Option name and value */
+    int a, a0;				/* Index in argv, first variable */
+    int num_vars;			/* Number of variables in file */
+    int num_sel;			/* Number of variables to visit */
+    int *sel = NULL;			/* Variables to visit, in output
+					   order */
+    struct Stats_Task *tasks = NULL;	/* Variables to visit, largest
+					   first */
+    struct Stats_Res *res = NULL;	/* Results, indexed by variable */
+    struct Stats_Res r;			/* Result from a worker */
+    int *have = NULL;			/* If have[v], res[v] is set */
+    int num_dims;			/* Number of dimensions of variable */
+    int dim_ids[NC_MAX_VAR_DIMS];	/* Dimension identifiers */
+    size_t len;				/* Dimension length */
+    nc_type xtype;			/* Type of variable */
+    int task_fd[2] = {-1, -1};		/* Parent sends variables to
+					   workers */
+    int res_fd[2] = {-1, -1};		/* Workers send results to parent */
+    pid_t *pids = NULL;			/* Worker processes */
+    int n_pids = 0;			/* Number of workers started */
+    int i, d, v;
+    ssize_t nr;
+    char min_s[FMT_BUF_LEN], max_s[FMT_BUF_LEN];
+    char mean_s[FMT_BUF_LEN], sd_s[FMT_BUF_LEN];
+    int ok = 1;				/* Return value */
+    int wstatus;			/* Exit status of worker */
+    struct sigaction act, old_pipe;	/* SIGPIPE disposition */
+
+    argv0 = argv[0];
+    argv1 = argv[1];
+    for (a0 = 2; a0 < argc && strncmp(argv[a0], "--", 2) == 0; a0++) {
+	opt = argv[a0];
+	if ( !(val = opt_val("--jobs", &a0, argc, argv)) ) {
+	    fprintf(stderr, "%s %s: unknown option or missing value %s\n",
+		    argv0, argv1, opt);
+	    return 0;
+	}
+	if ( sscanf(val, "%ld", &n_jobs) != 1 || n_jobs < 1 ) {
+	    fprintf(stderr, "%s %s: expected positive integer for number "
+		    "of jobs, got %s\n", argv0, argv1, val);
+	    return 0;
+	}
+    }
+    if ( a0 >= argc ) {
+	fprintf(stderr, "Usage: %s %s [--jobs=n] file [var_name ...]\n",
+		argv0, argv1);
+	return 0;
+    }
+    nc_fl_nm = argv[a0++];
+
+    /*
+       Make a list of variables, either from the command line or all
+       numeric variables in the file.
+     */
+
+    if ( (status = app_open(nc_fl_nm, &nc_id)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: failed to open %s.\n%s\n",
+		argv0, argv1, nc_fl_nm, nc_strerror(status));
+	return 0;
+    }
+    if ( (status = nc_inq_nvars(nc_id, &num_vars)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: could not get number of variables.\n"
+		"%s\n", argv0, argv1, nc_strerror(status));
+	goto error;
+    }
+    if ( !(sel = CALLOC(num_vars + 1, sizeof(int)))
+	    || !(tasks = CALLOC(num_vars + 1, sizeof(struct Stats_Task)))
+	    || !(res = CALLOC(num_vars + 1, sizeof(struct Stats_Res)))
+	    || !(have = CALLOC(num_vars + 1, sizeof(int))) ) {
+	fprintf(stderr, "%s %s: could not allocate arrays for %d "
+		"variables.\n", argv0, argv1, num_vars);
+	goto error;
+    }
+    num_sel = 0;
+    if ( a0 < argc ) {
+	for (a = a0; a < argc && num_sel < num_vars; a++) {
+	    if ( (status = app_varid(nc_id, argv[a], &v)) != NC_NOERR ) {
+		fprintf(stderr, "%s %s: could not find variable named %s."
+			"\n%s\n", argv0, argv1, argv[a], nc_strerror(status));
+		goto error;
+	    }
+	    sel[num_sel++] = v;
+	}
+    } else {
+	for (v = 0; v < num_vars; v++) {
+	    if ( (status = nc_inq_vartype(nc_id, v, &xtype)) != NC_NOERR ) {
+		fprintf(stderr, "%s %s: could not get type of variable %d."
+			"\n%s\n", argv0, argv1, v, nc_strerror(status));
+		goto error;
+	    }
+	    if ( xtype != NC_CHAR && xtype < NC_STRING ) {
+		sel[num_sel++] = v;
+	    }
+	}
+    }
+    for (i = 0; i < num_sel; i++) {
+	v = sel[i];
+	status = nc_inq_var(nc_id, v, NULL, NULL, &num_dims, dim_ids, NULL);
+	if ( status != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not get information for variable"
+		    " %d.\n%s\n", argv0, argv1, v, nc_strerror(status));
+	    goto error;
+	}
+	tasks[i].v = v;
+	for (tasks[i].n = 1, d = 0; d < num_dims; d++) {
+	    if ( (status = nc_inq_dimlen(nc_id, dim_ids[d], &len))
+		    != NC_NOERR ) {
+		fprintf(stderr, "%s %s: could not get length for dimension "
+			"%d.\n%s\n", argv0, argv1, d, nc_strerror(status));
+		goto error;
+	    }
+	    tasks[i].n *= len;
+	}
+    }
+
+    /*
+       libnetcdf is not thread safe, so workers are processes with their
+       own file identifiers. Give out the largest variables first so the
+       workers finish at about the same time.
+     */
+
+    app_close(nc_id);
+    nc_id = -1;
+    qsort(tasks, num_sel, sizeof(struct Stats_Task), stats_task_cmp);
+    if ( n_jobs == 0 && (n_jobs = sysconf(_SC_NPROCESSORS_ONLN)) < 1 ) {
+	n_jobs = 1;
+    }
+    if ( n_jobs > num_sel ) {
+	n_jobs = (num_sel > 0) ? num_sel : 1;
+    }
+    if ( !(pids = CALLOC(n_jobs, sizeof(pid_t))) ) {
+	fprintf(stderr, "%s %s: could not allocate array of %ld process "
+		"identifiers.\n", argv0, argv1, n_jobs);
+	goto error;
+    }
+    if ( pipe(task_fd) == -1 || pipe(res_fd) == -1 ) {
+	fprintf(stderr, "%s %s: could not create pipes for workers.\n",
+		argv0, argv1);
+	perror(NULL);
+	goto error;
+    }
+
+    /* Do not let the children repeat output that is still buffered */
+    fflush(stdout);
+    fflush(stderr);
+    for (n_pids = 0; n_pids < n_jobs; n_pids++) {
+	switch (pids[n_pids] = fork()) {
+	    case -1:
+		fprintf(stderr, "%s %s: could not create worker process.\n",
+			argv0, argv1);
+		perror(NULL);
+		goto error;
+	    case 0:
+		close(task_fd[1]);
+		close(res_fd[0]);
+		stats_worker(nc_fl_nm, task_fd[0], res_fd[1]);
+		_exit(EXIT_FAILURE);
+	}
+    }
+    close(task_fd[0]);
+    close(res_fd[1]);
+    task_fd[0] = res_fd[1] = -1;
+
+    /*
+       Each identifier is one small write, so workers read whole
+       identifiers. If all workers have died, the write fails and missing
+       results are reported below.
+     */
+
+    memset(&act, 0, sizeof(act));
+    sigemptyset(&act.sa_mask);
+    act.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &act, &old_pipe);
+    for (i = 0; i < num_sel; i++) {
+	if ( write(task_fd[1], &tasks[i].v, sizeof(int)) != sizeof(int) ) {
+	    break;
+	}
+    }
+    close(task_fd[1]);
+    task_fd[1] = -1;
+    sigaction(SIGPIPE, &old_pipe, NULL);
+    while ( (nr = read(res_fd[0], &r, sizeof(r))) != 0 ) {
+	if ( nr == -1 && errno == EINTR ) {
+	    continue;
+	}
+	if ( nr != sizeof(r) || r.v < 0 || r.v >= num_vars ) {
+	    fprintf(stderr, "%s %s: bad result from worker.\n", argv0, argv1);
+	    ok = 0;
+	    break;
+	}
+	res[r.v] = r;
+	have[r.v] = 1;
+    }
+    close(res_fd[0]);
+    res_fd[0] = -1;
+    for ( ; n_pids > 0; n_pids--) {
+	if ( waitpid(pids[n_pids - 1], &wstatus, 0) == -1
+		|| !WIFEXITED(wstatus)
+		|| WEXITSTATUS(wstatus) != EXIT_SUCCESS ) {
+	    ok = 0;
+	}
+    }
+
+    /* Print results in the order the variables were requested */
+    if ( (status = app_open(nc_fl_nm, &nc_id)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: failed to open %s.\n%s\n",
+		argv0, argv1, nc_fl_nm, nc_strerror(status));
+	goto error;
+    }
+    for (i = 0; i < num_sel; i++) {
+	v = sel[i];
+	if ( (status = nc_inq_varname(nc_id, v, name)) != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not get name for variable %d.\n"
+		    "%s\n", argv0, argv1, v, nc_strerror(status));
+	    goto error;
+	}
+	if ( !have[v] || !res[v].ok ) {
+	    fprintf(stderr, "%s %s: could not get statistics for %s.\n",
+		    argv0, argv1, name);
+	    ok = 0;
+	    continue;
+	}
+	min_s[Fmt_Double(min_s, res[v].stats.min)] = '\0';
+	max_s[Fmt_Double(max_s, res[v].stats.max)] = '\0';
+	mean_s[Fmt_Double(mean_s,
+		(res[v].stats.n > 0) ? res[v].stats.mean : NAN)] = '\0';
+	sd_s[Fmt_Double(sd_s, Var_Stats_SD(&res[v].stats))] = '\0';
+	printf("%s n=%zu fill=%zu min=%s max=%s mean=%s sd=%s\n", name,
+		res[v].stats.n, res[v].stats.n_fill, min_s, max_s, mean_s,
+		sd_s);
+    }
+    app_close(nc_id);
+    FREE(pids);
+    FREE(have);
+    FREE(res);
+    FREE(tasks);
+    FREE(sel);
+    return ok;
+
+error:
+    if ( n_pids > 0 ) {
+	for (i = 0; i < n_pids; i++) {
+	    kill(pids[i], SIGTERM);
+	}
+	for (i = 0; i < n_pids; i++) {
+	    waitpid(pids[i], NULL, 0);
+	}
+    }
+    for (i = 0; i < 2; i++) {
+	if ( task_fd[i] != -1 ) {
+	    close(task_fd[i]);
+	}
+	if ( res_fd[i] != -1 ) {
+	    close(res_fd[i]);
+	}
+    }
+    if ( nc_id != -1 ) {
+	app_close(nc_id);
+    }
+    FREE(pids);
+    FREE(have);
+    FREE(res);
+    FREE(tasks);
+    FREE(sel);
+    return 0;
+}
+
+/* Sort stats tasks by decreasing size */
+static int stats_task_cmp(const void *a, const void *b)
+{
+    size_t na = ((const struct Stats_Task *)a)->n;
+    size_t nb = ((const struct Stats_Task *)b)->n;
+
+    return (na < nb) ? 1 : (na > nb) ? -1 : 0;
+}
+
+/*
+   Stats worker process. Read variable identifiers from task_fd until end
+   of file, and send a struct Stats_Res for each to res_fd. Exit when done.
+ */
+static void stats_worker(char *nc_fl_nm, int task_fd, int res_fd)
+{
+    int nc_id;				/* NetCDF file identifier */
+    int status;				/* Return code from NetCDF function
+					   call */
+    double *buf;			/* Values from a block */
+    struct Stats_Res r;			/* Result for a variable */
+    ssize_t nr;
+
+    if ( (status = nc_open(nc_fl_nm, 0, &nc_id)) != NC_NOERR ) {
+	fprintf(stderr, "Worker failed to open %s.\n%s\n",
+		nc_fl_nm, nc_strerror(status));
+	_exit(EXIT_FAILURE);
+    }
+    if ( !(buf = CALLOC(STATS_ELEM, sizeof(double))) ) {
+	fprintf(stderr, "Worker could not allocate buffer for %d values.\n",
+		STATS_ELEM);
+	_exit(EXIT_FAILURE);
+    }
+    memset(&r, 0, sizeof(r));
+    while ( (nr = read(task_fd, &r.v, sizeof(int))) != 0 ) {
+	if ( nr == -1 && errno == EINTR ) {
+	    continue;
+	}
+	if ( nr != sizeof(int) ) {
+	    _exit(EXIT_FAILURE);
+	}
+	r.ok = var_stats(nc_id, r.v, buf, &r.stats);
+	if ( write(res_fd, &r, sizeof(r)) != sizeof(r) ) {
+	    _exit(EXIT_FAILURE);
+	}
+    }
+    nc_close(nc_id);
+    _exit(EXIT_SUCCESS);
+}
+
+/*
+   Compute statistics for variable v in file nc_id, reading up to
+   STATS_ELEM values at a time into buf. Values equal to the _FillValue
+   attribute, or the default fill value if there is none, are fill values.
+   Return 1 on success. On failure, print a message to stderr and return 0.
+ */
+static int var_stats(int nc_id, int v, double *buf, struct Var_Stats *stats)
+{
+    char name[NC_MAX_NAME + 1];		/* Variable name */
+    nc_type xtype;			/* Type of variable */
+    int num_dims;			/* Number of dimensions */
+    int dim_ids[NC_MAX_VAR_DIMS];	/* Dimension identifiers */
+    size_t len[NC_MAX_VAR_DIMS];	/* Dimension lengths */
+    int have_fill;			/* If true, fill is a fill value */
+    double fill;			/* Fill value */
+    struct Slab slab;			/* Iterates over variable */
+    struct Var_Stats blk;		/* Statistics for a block */
+    size_t n;
+    int d;
+    int status;
+
+    Var_Stats_Init(stats);
+    status = nc_inq_var(nc_id, v, name, &xtype, &num_dims, dim_ids, NULL);
+    if ( status != NC_NOERR ) {
+	fprintf(stderr, "Could not get information for variable %d.\n%s\n",
+		v, nc_strerror(status));
+	return 0;
+    }
+    for (d = 0; d < num_dims; d++) {
+	if ( (status = nc_inq_dimlen(nc_id, dim_ids[d], len + d))
+		!= NC_NOERR ) {
+	    fprintf(stderr, "Could not get length for dimension %d of %s.\n"
+		    "%s\n", d, name, nc_strerror(status));
+	    return 0;
+	}
+    }
+    have_fill = var_fill(nc_id, v, xtype, &fill);
+    if ( !Slab_Init(&slab, num_dims, len, STATS_ELEM) ) {
+	fprintf(stderr, "Could not allocate slab iterator for %s.\n", name);
+	return 0;
+    }
+    while ( (n = Slab_Next(&slab)) > 0 ) {
+	status = nc_get_vara_double(nc_id, v, slab.start, slab.count, buf);
+	if ( status != NC_NOERR ) {
+	    fprintf(stderr, "Could not read %s.\n%s\n", name,
+		    nc_strerror(status));
+	    Slab_Free(&slab);
+	    return 0;
+	}
+	Var_Stats_Block(&blk, buf, n, have_fill, fill);
+	Var_Stats_Merge(stats, &blk);
+    }
+    Slab_Free(&slab);
+    return 1;
+}
+
+/*
+   Put the fill value for variable v of type xtype in file nc_id at fill_p.
+   This is the _FillValue attribute, or the default fill value for the
+   type if fill mode is on. Return 1 if the variable has a fill value,
+   otherwise 0.
+ */
+static int var_fill(int nc_id, int v, nc_type xtype, double *fill_p)
+{
+    int no_fill = 0;			/* If true, fill mode is off */
+
+    if ( nc_get_att_double(nc_id, v, "_FillValue", fill_p) == NC_NOERR ) {
+	return 1;
+    }
+    nc_inq_var_fill(nc_id, v, &no_fill, NULL);
+    if ( no_fill ) {
+	return 0;
+    }
+
+    /*
+       As in ncdump, signed bytes have no default fill value, since byte
+       data often use every value. The 64 bit fill values round to the
+       nearest double, as values read for statistics do.
+     */
+
+    switch (xtype) {
+	case NC_SHORT:  *fill_p = NC_FILL_SHORT;  return 1;
+	case NC_INT:    *fill_p = NC_FILL_INT;    return 1;
+	case NC_FLOAT:  *fill_p = NC_FILL_FLOAT;  return 1;
+	case NC_DOUBLE: *fill_p = NC_FILL_DOUBLE; return 1;
+	case NC_UBYTE:  *fill_p = NC_FILL_UBYTE;  return 1;
+	case NC_USHORT: *fill_p = NC_FILL_USHORT; return 1;
+	case NC_UINT:   *fill_p = NC_FILL_UINT;   return 1;
+	case NC_INT64:  *fill_p = NC_FILL_INT64;  return 1;
+	case NC_UINT64: *fill_p = NC_FILL_UINT64; return 1;
+	default:        return 0;
+    }
+}
+
+/*
+   If argv[*a] is option nm, return its value and advance *a past it. The
+   value may follow an '=' or be the next argument. Return NULL if argv[*a]
+   is some other option, or if the value is missing.
+ */
+static char *opt_val(char *nm, int *a, int argc, char *argv[])
+{
+    size_t l = strlen(nm);
+
+    if ( strncmp(argv[*a], nm, l) != 0 ) {
+	return NULL;
+    }
+    if ( argv[*a][l] == '=' ) {
+	return argv[*a] + l + 1;
+    }
+    if ( argv[*a][l] != '\0' || *a + 1 == argc ) {
+	return NULL;
+    }
+    return argv[++*a];
+}
+
+/*
+   nnetcdf bench [--reads=n] [--stride=n] [--seed=n] var_name file
+
+   Time reads of var_name with several access patterns, first with the file
+   evicted from the page cache before every read (cold), then after reading
+   the same hyperslabs once (warm).
+ */
+static int bench_cb(int argc, char *argv[])
+{
+    char *argv0, *argv1;		/* argv[0], argv[1] */
+    char *nc_fl_nm;			/* Path to NetCDF file */
+    int nc_id = -1;			/* NetCDF file identifier */
+    char *var_nm;			/* Variable name, from command line */
+    int var_id;				/* NetCDF identifier for variable */
+    nc_type xtype;			/* Type of var */
+    int status;				/* Return code from NetCDF function
+					   call */
+    int num_dims;			/* Number of dimensions of variable */
+    int dim_ids[NC_MAX_VAR_DIMS];	/* Dimension identifiers */
+    size_t len[NC_MAX_VAR_DIMS];	/* Dimension lengths */
+    size_t elem_sz;			/* Size of one value in bytes */
+    long n_reads = 100;			/* Maximum reads per pattern */
+    long stride = 1;			/* Step along first dimension for
+					   point series */
+    unsigned long long seed = 1;	/* Random number state */
+    char *opt, *val;			/* Option name and value */
+    int a;				/* Index in argv */
+    static char *pats[] = {"whole", "record", "slice", "series", "random"};
+					/* Access patterns */
+    int p, d;
+    struct Bench_Plan plan;		/* Reads for current pattern */
+    void *buf = NULL;			/* Receives values */
+    double *lat = NULL;			/* Time for each read, seconds */
+    int cold;				/* If true, evict file before reads */
+
+    argv0 = argv[0];
+    argv1 = argv[1];
+    for (a = 2; a < argc && strncmp(argv[a], "--", 2) == 0; a++) {
+	opt = argv[a];
+	if ( (val = opt_val("--reads", &a, argc, argv)) ) {
+	    if ( sscanf(val, "%ld", &n_reads) != 1 || n_reads < 1 ) {
+		fprintf(stderr, "%s %s: expected positive integer for number "
+			"of reads, got %s\n", argv0, argv1, val);
+		return 0;
+	    }
+	} else if ( (val = opt_val("--stride", &a, argc, argv)) ) {
+	    if ( sscanf(val, "%ld", &stride) != 1 || stride < 1 ) {
+		fprintf(stderr, "%s %s: expected positive integer for "
+			"stride, got %s\n", argv0, argv1, val);
+		return 0;
+	    }
+	} else if ( (val = opt_val("--seed", &a, argc, argv)) ) {
+	    if ( sscanf(val, "%llu", &seed) != 1 ) {
+		fprintf(stderr, "%s %s: expected integer for seed, got %s\n",
+			argv0, argv1, val);
+		return 0;
+	    }
+	} else {
+	    fprintf(stderr, "%s %s: unknown option or missing value %s\n",
+		    argv0, argv1, opt);
+	    return 0;
+	}
+    }
+    if ( argc - a != 2 ) {
+	fprintf(stderr, "Usage: %s %s [--reads=n] [--stride=n] [--seed=n] "
+		"var_name file\n", argv0, argv1);
+	return 0;
+    }
+    var_nm = argv[a];
+    nc_fl_nm = argv[a + 1];
+    if ( seed == 0 ) {
+	seed = 1;
+    }
+
+    /* Get variable shape, then close so each run starts fresh */
+    if ( (status = nc_open(nc_fl_nm, 0, &nc_id)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: failed to open %s.\n%s\n",
+		argv0, argv1, nc_fl_nm, nc_strerror(status));
+	return 0;
+    }
+    if ( (status = nc_inq_varid(nc_id, var_nm, &var_id)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: could not find variable named %s.\n%s\n",
+		argv0, argv1, var_nm, nc_strerror(status));
+	nc_close(nc_id);
+	return 0;
+    }
+    status = nc_inq_var(nc_id, var_id, NULL, &xtype, &num_dims, dim_ids,
+	    NULL);
+    for (d = 0; status == NC_NOERR && d < num_dims; d++) {
+	status = nc_inq_dimlen(nc_id, dim_ids[d], len + d);
+    }
+    nc_close(nc_id);
+    if ( status != NC_NOERR ) {
+	fprintf(stderr, "%s %s: could not get shape of %s.\n%s\n",
+		argv0, argv1, var_nm, nc_strerror(status));
+	return 0;
+    }
+    if ( !npy_descr(xtype, &elem_sz) ) {
+	fprintf(stderr, "%s %s: cannot read type of %s\n",
+		argv0, argv1, var_nm);
+	return 0;
+    }
+    for (d = 0; d < num_dims; d++) {
+	if ( len[d] == 0 ) {
+	    fprintf(stderr, "%s %s: %s has no values.\n",
+		    argv0, argv1, var_nm);
+	    return 1;
+	}
+    }
+
+    for (p = 0; p < (int)(sizeof(pats) / sizeof(pats[0])); p++) {
+	if ( !bench_plan(&plan, pats[p], num_dims, len, n_reads, stride,
+		    &seed) ) {
+	    fprintf(stderr, "%s %s: could not plan %s reads.\n",
+		    argv0, argv1, pats[p]);
+	    goto error;
+	}
+	if ( plan.n_reads == 0 ) {
+	    bench_free(&plan);
+	    continue;
+	}
+	if ( !(buf = MALLOC(plan.max_elem * elem_sz))
+		|| !(lat = CALLOC(plan.n_reads, sizeof(double))) ) {
+	    fprintf(stderr, "%s %s: could not allocate buffers for %s "
+		    "reads.\n", argv0, argv1, pats[p]);
+	    bench_free(&plan);
+	    goto error;
+	}
+	for (cold = 1; cold >= 0; cold--) {
+	    if ( !bench_run(nc_fl_nm, var_nm, xtype, &plan, cold, buf, lat) ) {
+		fprintf(stderr, "%s %s: %s reads failed.\n",
+			argv0, argv1, pats[p]);
+		bench_free(&plan);
+		goto error;
+	    }
+	    bench_report(var_nm, &plan, cold ? "cold" : "warm", elem_sz,
+		    lat);
+	}
+	FREE(lat);
+	FREE(buf);
+	lat = buf = NULL;
+	bench_free(&plan);
+    }
+    return 1;
+
+error:
+    FREE(lat);
+    FREE(buf);
+    return 0;
+}
+
+/*
+   Make a plan with reads for access pattern pat of a variable with ndims
+   dimensions of lengths len. Plans other than "whole" have at most n_reads
+   reads. stride is the step along the first dimension for "series". state
+   is the random number generator state. Patterns that do not apply to the
+   shape get no reads. Return 1 on success, or 0 if allocation fails.
+
+   whole	every value, in slabs of BENCH_ELEM values
+   record	every value for one index of the first dimension, at evenly
+		spaced indeces
+   slice	every value for one index of the first two dimensions, at
+		random indeces
+   series	every stride'th value along the first dimension, at random
+		indeces of the others
+   random	random boxes of at most BENCH_RAND_ELEM values
+ */
+static int bench_plan(struct Bench_Plan *plan, char *pat, int ndims,
+	const size_t *len, size_t n_reads, ptrdiff_t stride,
+	unsigned long long *state)
+{
+    struct Slab slab;			/* Iterates over variable for whole */
+    size_t *start, *count;		/* Start and count for a read */
+    size_t budget;			/* Values left for a random box */
+    size_t lim;
+    size_t r, n;
+    int d;
+
+    plan->name = pat;
+    plan->ndims = ndims;
+    plan->n_reads = plan->max_elem = plan->tot_elem = 0;
+    plan->start = plan->count = NULL;
+    plan->stride = NULL;
+    if ( strcmp(pat, "whole") == 0 ) {
+	if ( !Slab_Init(&slab, ndims, len, BENCH_ELEM) ) {
+	    return 0;
+	}
+	for (n_reads = 0; Slab_Next(&slab) > 0; n_reads++) {
+	}
+	Slab_Free(&slab);
+    } else if ( (strcmp(pat, "record") == 0 && ndims < 1)
+	    || (strcmp(pat, "slice") == 0 && ndims < 3)
+	    || (strcmp(pat, "series") == 0 && ndims < 2)
+	    || (strcmp(pat, "random") == 0 && ndims < 1) ) {
+	return 1;
+    } else if ( strcmp(pat, "record") == 0 && n_reads > len[0] ) {
+	n_reads = len[0];
+    }
+    if ( !(plan->start = CALLOC(n_reads * ndims + 1, sizeof(size_t)))
+	    || !(plan->count = CALLOC(n_reads * ndims + 1, sizeof(size_t)))
+	    || !(plan->stride = CALLOC(ndims + 1, sizeof(ptrdiff_t))) ) {
+	bench_free(plan);
+	return 0;
+    }
+    plan->n_reads = n_reads;
+    for (d = 0; d < ndims; d++) {
+	plan->stride[d] = 1;
+    }
+    if ( strcmp(pat, "whole") == 0 && !Slab_Init(&slab, ndims, len,
+		BENCH_ELEM) ) {
+	bench_free(plan);
+	return 0;
+    }
+    for (r = 0; r < n_reads; r++) {
+	start = plan->start + r * ndims;
+	count = plan->count + r * ndims;
+	if ( strcmp(pat, "whole") == 0 ) {
+	    Slab_Next(&slab);
+	    for (d = 0; d < ndims; d++) {
+		start[d] = slab.start[d];
+		count[d] = slab.count[d];
+	    }
+	} else if ( strcmp(pat, "record") == 0 ) {
+	    start[0] = r * len[0] / n_reads;
+	    count[0] = 1;
+	    for (d = 1; d < ndims; d++) {
+		count[d] = len[d];
+	    }
+	} else if ( strcmp(pat, "slice") == 0 ) {
+	    for (d = 0; d < ndims; d++) {
+		start[d] = (d < 2) ? bench_rand(state) % len[d] : 0;
+		count[d] = (d < 2) ? 1 : len[d];
+	    }
+	} else if ( strcmp(pat, "series") == 0 ) {
+	    plan->stride[0] = stride;
+	    count[0] = (len[0] + stride - 1) / stride;
+	    for (d = 1; d < ndims; d++) {
+		start[d] = bench_rand(state) % len[d];
+		count[d] = 1;
+	    }
+	} else {
+	    for (budget = BENCH_RAND_ELEM, d = ndims - 1; d >= 0; d--) {
+		lim = (len[d] < budget) ? len[d] : budget;
+		count[d] = 1 + bench_rand(state) % lim;
+		start[d] = bench_rand(state) % (len[d] - count[d] + 1);
+		budget /= count[d];
+	    }
+	}
+	for (n = 1, d = 0; d < ndims; d++) {
+	    n *= count[d];
+	}
+	plan->max_elem = (n > plan->max_elem) ? n : plan->max_elem;
+	plan->tot_elem += n;
+    }
+    if ( strcmp(pat, "whole") == 0 ) {
+	Slab_Free(&slab);
+    }
+    return 1;
+}
+
+/*
+   Do the reads in plan from variable var_nm of type xtype in file
+   nc_fl_nm into buf, and store the time for each read, in seconds, in lat.
+   If cold is true, drop the file from the page cache and reopen it before
+   every read. Otherwise, do all the reads once before timing them. Return
+   1 on success. On failure, print a message to stderr and return 0.
+ */
+static int bench_run(char *nc_fl_nm, char *var_nm, nc_type xtype,
+	const struct Bench_Plan *plan, int cold, void *buf, double *lat)
+{
+    int fd;				/* File descriptor for posix_fadvise */
+    int nc_id = -1;			/* NetCDF file identifier */
+    int var_id;				/* NetCDF identifier for variable */
+    int pass;				/* 0 to warm up, 1 to time */
+    struct timespec t0, t1;		/* Time before and after read */
+    size_t r;
+    size_t off;
+    int status;
+
+    if ( (fd = open(nc_fl_nm, O_RDONLY)) == -1 ) {
+	fprintf(stderr, "Could not open %s.\n", nc_fl_nm);
+	perror(NULL);
+	return 0;
+    }
+    for (pass = cold ? 1 : 0; pass < 2; pass++) {
+	for (r = 0; r < plan->n_reads; r++) {
+	    /*
+	       Closing the netCDF file also discards its chunk cache, so a
+	       cold read finds nothing in memory.
+	     */
+
+	    if ( cold || nc_id == -1 ) {
+		if ( nc_id != -1 ) {
+		    nc_close(nc_id);
+		    nc_id = -1;
+		}
+		if ( cold ) {
+		    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		}
+		if ( (status = nc_open(nc_fl_nm, 0, &nc_id)) != NC_NOERR
+			|| (status = nc_inq_varid(nc_id, var_nm, &var_id))
+			!= NC_NOERR ) {
+		    fprintf(stderr, "Could not open %s in %s.\n%s\n",
+			    var_nm, nc_fl_nm, nc_strerror(status));
+		    goto error;
+		}
+	    }
+	    off = r * plan->ndims;
+	    clock_gettime(CLOCK_MONOTONIC, &t0);
+	    status = get_vars(nc_id, var_id, xtype, plan->start + off,
+		    plan->count + off, plan->stride, buf);
+	    clock_gettime(CLOCK_MONOTONIC, &t1);
+	    if ( status != NC_NOERR ) {
+		fprintf(stderr, "Could not read %s.\n%s\n", var_nm,
+			nc_strerror(status));
+		goto error;
+	    }
+	    lat[r] = (t1.tv_sec - t0.tv_sec) + 1.0e-9 * (t1.tv_nsec
+		    - t0.tv_nsec);
+	}
+    }
+    nc_close(nc_id);
+    close(fd);
+    return 1;
+
+error:
+    if ( nc_id != -1 ) {
+	nc_close(nc_id);
+    }
+    close(fd);
+    return 0;
+}
+
+/*
+   Print throughput and latency percentiles for reads in plan of variable
+   var_nm, with values of elem_sz bytes, that took lat seconds each. mode
+   is "cold" or "warm". lat is sorted.
+ */
+static void bench_report(char *var_nm, const struct Bench_Plan *plan,
+	char *mode, size_t elem_sz, double *lat)
+{
+    size_t n = plan->n_reads;
+    double mb = (double)plan->tot_elem * elem_sz / 1.0e6;
+    double tot;
+    double q[] = {0.5, 0.9, 0.99};	/* Percentiles */
+    double ms[3];			/* Latency at q, milliseconds */
+    size_t r;
+    int k;
+
+    for (tot = 0.0, r = 0; r < n; r++) {
+	tot += lat[r];
+    }
+    qsort(lat, n, sizeof(double), dbl_cmp);
+    for (k = 0; k < 3; k++) {
+	r = (size_t)ceil(q[k] * n);
+	ms[k] = 1.0e3 * lat[(r > 0 ? r : 1) - 1];
+    }
+    printf("%s %s %s reads=%zu MB=%.3f MB/s=%.1f p50=%.3fms p90=%.3fms "
+	    "p99=%.3fms max=%.3fms\n", var_nm, plan->name, mode, n, mb,
+	    (tot > 0.0) ? mb / tot : 0.0, ms[0], ms[1], ms[2],
+	    1.0e3 * lat[n - 1]);
+}
+
+/* Free memory associated with plan */
+static void bench_free(struct Bench_Plan *plan)
+{
+    FREE(plan->start);
+    FREE(plan->count);
+    FREE(plan->stride);
+    plan->start = plan->count = NULL;
+    plan->stride = NULL;
+    plan->n_reads = 0;
+}
+
+/* Return next value from xorshift64* generator with nonzero state */
+static unsigned long long bench_rand(unsigned long long *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+/* Compare doubles for qsort */
+static int dbl_cmp(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+/*
+   nnetcdf rechunk [--pattern=record|series|balanced] [--chunk=var:c0,c1,...]
+	   [--chunk-bytes=n] [--deflate=n] [--shuffle] [--memory=MB] [--jobs=n]
+	   in_file out_file
+
+   Copy in_file to netCDF-4 file out_file, with chunks suited to an access
+   pattern. record chunks hold part of one record, series chunks hold long
+   runs along the first dimension, and balanced chunks have about the same
+   length along every dimension. --chunk gives the chunk shape for one
+   variable, and may be repeated.
+ */
+static int rechunk_cb(int argc, char *argv[])
+{
+    char *argv0, *argv1;		/* argv[0], argv[1] */
+    char *in_nm, *out_nm;		/* Paths to input and output files */
+    int in_id = -1, out_id = -1;	/* NetCDF file identifiers */
+    int status;				/* Return code from NetCDF function
+					   call */
+    char *pat = "balanced";		/* Access pattern */
+    char **chunk_opts = NULL;		/* --chunk values */
+    int n_chunk_opts = 0;		/* Number of --chunk values */
+    long chunk_bytes = RECHUNK_BYTES;	/* Target chunk size */
+    long deflate = 0;			/* Deflate level, 0 for none */
+    int shuffle = 0;			/* If true, shuffle before deflate */
+    long mem_mb = RECHUNK_MEM >> 20;	/* Memory budget, megabytes */
+    long n_jobs = 0;			/* Number of reader processes */
+    char *opt, *val;			/* Option name and value */
+    int a;				/* Index in argv */
+    int num_dims, num_vars, num_atts;	/* Number of dimensions, variables,
+					   global attributes */
+    int num_unlim;			/* Number of unlimited dimensions */
+    int unlim_ids[NC_MAX_DIMS];		/* Unlimited dimensions */
+    int dim_id;				/* Dimension identifier in output */
+    char name[NC_MAX_NAME + 1];		/* Dimension, variable, or attribute
+					   name */
+    size_t len;				/* Dimension length */
+    nc_type xtype;			/* Variable type */
+    int var_dims;			/* Number of dimensions of variable */
+    int dim_ids[NC_MAX_VAR_DIMS];	/* Dimensions of variable */
+    size_t var_len[NC_MAX_VAR_DIMS];	/* Dimension lengths of variable */
+    size_t chunk[NC_MAX_VAR_DIMS];	/* Chunk shape */
+    int var_id;				/* Variable identifier in output */
+    size_t elem_sz;			/* Size of a value in bytes */
+    size_t blk_elem;			/* Values per block when copying */
+    void *buf = NULL;			/* Values for a block */
+    size_t zero[NC_MAX_VAR_DIMS];	/* Start of variable */
+    int no_fill;			/* If true, variable has no fill */
+    int d, i, k, v;
+    char *c, *e;
+
+    argv0 = argv[0];
+    argv1 = argv[1];
+    if ( !(chunk_opts = CALLOC(argc, sizeof(char *))) ) {
+	fprintf(stderr, "%s %s: could not allocate option array.\n",
+		argv0, argv1);
+	return 0;
+    }
+    for (a = 2; a < argc && strncmp(argv[a], "--", 2) == 0; a++) {
+	opt = argv[a];
+	if ( strcmp(opt, "--shuffle") == 0 ) {
+	    shuffle = 1;
+	} else if ( (val = opt_val("--pattern", &a, argc, argv)) ) {
+	    if ( strcmp(val, "record") != 0 && strcmp(val, "series") != 0
+		    && strcmp(val, "balanced") != 0 ) {
+		fprintf(stderr, "%s %s: unknown access pattern %s. Pattern "
+			"must be record, series, or balanced.\n",
+			argv0, argv1, val);
+		goto error;
+	    }
+	    pat = val;
+	} else if ( (val = opt_val("--chunk-bytes", &a, argc, argv)) ) {
+	    if ( sscanf(val, "%ld", &chunk_bytes) != 1 || chunk_bytes < 1 ) {
+		fprintf(stderr, "%s %s: expected positive integer for chunk "
+			"size, got %s\n", argv0, argv1, val);
+		goto error;
+	    }
+	} else if ( (val = opt_val("--chunk", &a, argc, argv)) ) {
+	    chunk_opts[n_chunk_opts++] = val;
+	} else if ( (val = opt_val("--deflate", &a, argc, argv)) ) {
+	    if ( sscanf(val, "%ld", &deflate) != 1
+		    || deflate < 0 || deflate > 9 ) {
+		fprintf(stderr, "%s %s: expected deflate level 0 to 9, got "
+			"%s\n", argv0, argv1, val);
+		goto error;
+	    }
+	} else if ( (val = opt_val("--memory", &a, argc, argv)) ) {
+	    if ( sscanf(val, "%ld", &mem_mb) != 1 || mem_mb < 1 ) {
+		fprintf(stderr, "%s %s: expected positive integer for memory "
+			"budget in megabytes, got %s\n", argv0, argv1, val);
+		goto error;
+	    }
+	} else if ( (val = opt_val("--jobs", &a, argc, argv)) ) {
+	    if ( sscanf(val, "%ld", &n_jobs) != 1 || n_jobs < 1 ) {
+		fprintf(stderr, "%s %s: expected positive integer for number "
+			"of jobs, got %s\n", argv0, argv1, val);
+		goto error;
+	    }
+	} else {
+	    fprintf(stderr, "%s %s: unknown option or missing value %s\n",
+		    argv0, argv1, opt);
+	    goto error;
+	}
+    }
+    if ( argc - a != 2 ) {
+	fprintf(stderr, "Usage: %s %s [--pattern=record|series|balanced] "
+		"[--chunk=var:c0,c1,...] [--chunk-bytes=n] [--deflate=n] "
+		"[--shuffle] [--memory=MB] [--jobs=n] in_file out_file\n",
+		argv0, argv1);
+	goto error;
+    }
+    in_nm = argv[a];
+    out_nm = argv[a + 1];
+    if ( strcmp(in_nm, out_nm) == 0 ) {
+	fprintf(stderr, "%s %s: output %s is also the input.\n",
+		argv0, argv1, out_nm);
+	goto error;
+    }
+    if ( n_jobs == 0 && (n_jobs = sysconf(_SC_NPROCESSORS_ONLN)) < 1 ) {
+	n_jobs = 1;
+    }
+
+    /*
+       Each reader and the writer hold one block of values, none larger
+       than a double, so the budget is shared n_jobs + 1 ways.
+     */
+
+    blk_elem = ((size_t)mem_mb << 20) / ((n_jobs + 1) * sizeof(double));
+    if ( blk_elem < 1 ) {
+	blk_elem = 1;
+    }
+
+    /* Define output dimensions, attributes, and variables */
+    if ( (status = nc_open(in_nm, 0, &in_id)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: failed to open %s.\n%s\n",
+		argv0, argv1, in_nm, nc_strerror(status));
+	in_id = -1;
+	goto error;
+    }
+    if ( (status = nc_inq(in_id, &num_dims, &num_vars, &num_atts, NULL))
+		!= NC_NOERR
+	    || (status = nc_inq_unlimdims(in_id, &num_unlim, unlim_ids))
+		!= NC_NOERR ) {
+	fprintf(stderr, "%s %s: could not get contents of %s.\n%s\n",
+		argv0, argv1, in_nm, nc_strerror(status));
+	goto error;
+    }
+    status = nc_create(out_nm, NC_CLOBBER | NC_NETCDF4, &out_id);
+    if ( status != NC_NOERR ) {
+	fprintf(stderr, "%s %s: could not create %s.\n%s\n",
+		argv0, argv1, out_nm, nc_strerror(status));
+	out_id = -1;
+	goto error;
+    }
+
+    /*
+       Dimensions are defined in input order, so dimension identifiers are
+       the same in both files.
+     */
+
+    for (d = 0; d < num_dims; d++) {
+	if ( (status = nc_inq_dim(in_id, d, name, &len)) != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not get information for dimension"
+		    " %d.\n%s\n", argv0, argv1, d, nc_strerror(status));
+	    goto error;
+	}
+	for (i = 0; i < num_unlim && unlim_ids[i] != d; i++) {
+	}
+	status = nc_def_dim(out_id, name, (i < num_unlim) ? NC_UNLIMITED : len,
+		&dim_id);
+	if ( status != NC_NOERR || dim_id != d ) {
+	    fprintf(stderr, "%s %s: could not define dimension %s.\n%s\n",
+		    argv0, argv1, name, nc_strerror(status));
+	    goto error;
+	}
+    }
+    for (i = 0; i < num_atts; i++) {
+	if ( (status = nc_inq_attname(in_id, NC_GLOBAL, i, name)) != NC_NOERR
+		|| (status = nc_copy_att(in_id, NC_GLOBAL, name, out_id,
+			NC_GLOBAL)) != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not copy global attribute %d.\n%s\n",
+		    argv0, argv1, i, nc_strerror(status));
+	    goto error;
+	}
+    }
+    for (v = 0; v < num_vars; v++) {
+	status = nc_inq_var(in_id, v, name, &xtype, &var_dims, dim_ids,
+		&num_atts);
+	if ( status != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not get information for variable"
+		    " %d.\n%s\n", argv0, argv1, v, nc_strerror(status));
+	    goto error;
+	}
+
+	/* User defined types would have to be defined in the output first */
+	if ( xtype > NC_STRING ) {
+	    fprintf(stderr, "%s %s: skipping %s, which has a user defined "
+		    "type.\n", argv0, argv1, name);
+	    continue;
+	}
+	if ( (status = nc_inq_type(in_id, xtype, NULL, &elem_sz))
+		!= NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not get size of type of %s.\n%s\n",
+		    argv0, argv1, name, nc_strerror(status));
+	    goto error;
+	}
+	status = nc_def_var(out_id, name, xtype, var_dims, dim_ids, &var_id);
+	if ( status == NC_NOERR
+		&& (status = nc_inq_var_fill(in_id, v, &no_fill, NULL))
+		== NC_NOERR ) {
+	    status = nc_def_var_fill(out_id, var_id, no_fill, NULL);
+	}
+	if ( status != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not define variable %s.\n%s\n",
+		    argv0, argv1, name, nc_strerror(status));
+	    goto error;
+	}
+	for (d = 0; d < var_dims; d++) {
+	    nc_inq_dimlen(in_id, dim_ids[d], var_len + d);
+	}
+
+	/* Chunk shape from command line, if any, else from pattern */
+	for (k = n_chunk_opts - 1; k >= 0; k--) {
+	    c = strchr(chunk_opts[k], ':');
+	    if ( c && (size_t)(c - chunk_opts[k]) == strlen(name)
+		    && strncmp(chunk_opts[k], name, c - chunk_opts[k]) == 0 ) {
+		break;
+	    }
+	}
+	if ( var_dims > 0 && k >= 0 ) {
+	    for (d = 0, c++; d < var_dims; d++, c = e + 1) {
+		chunk[d] = strtoul(c, &e, 10);
+		if ( e == c || chunk[d] < 1
+			|| *e != ((d == var_dims - 1) ? '\0' : ',') ) {
+		    fprintf(stderr, "%s %s: expected %d positive chunk "
+			    "lengths for %s, got %s\n", argv0, argv1,
+			    var_dims, name, chunk_opts[k]);
+		    goto error;
+		}
+	    }
+	} else if ( var_dims > 0 ) {
+	    chunk_shape(pat, var_dims, var_len, chunk_bytes / elem_sz, chunk);
+	}
+	if ( var_dims > 0 ) {
+	    status = nc_def_var_chunking(out_id, var_id, NC_CHUNKED, chunk);
+	    if ( status == NC_NOERR && (deflate > 0 || shuffle) ) {
+		status = nc_def_var_deflate(out_id, var_id, shuffle,
+			deflate > 0, deflate);
+	    }
+	    if ( status != NC_NOERR ) {
+		fprintf(stderr, "%s %s: could not set storage for %s.\n%s\n",
+			argv0, argv1, name, nc_strerror(status));
+		goto error;
+	    }
+	}
+	for (i = 0; i < num_atts; i++) {
+	    if ( (status = nc_inq_attname(in_id, v, i, name)) != NC_NOERR
+		    || (status = nc_copy_att(in_id, v, name, out_id, var_id))
+		    != NC_NOERR ) {
+		fprintf(stderr, "%s %s: could not copy attribute %d of "
+			"variable %d.\n%s\n", argv0, argv1, i, v,
+			nc_strerror(status));
+		goto error;
+	    }
+	}
+    }
+    if ( (status = nc_enddef(out_id)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: could not finish defining %s.\n%s\n",
+		argv0, argv1, out_nm, nc_strerror(status));
+	goto error;
+    }
+
+    /* Copy values */
+    memset(zero, 0, sizeof(zero));
+    if ( !(buf = CALLOC(blk_elem, sizeof(double))) ) {
+	fprintf(stderr, "%s %s: could not allocate buffer for %zu values.\n",
+		argv0, argv1, blk_elem);
+	goto error;
+    }
+    for (v = 0; v < num_vars; v++) {
+	status = nc_inq_var(in_id, v, name, &xtype, &var_dims, dim_ids, NULL);
+	if ( status == NC_NOERR && xtype > NC_STRING ) {
+	    continue;
+	}
+	if ( status == NC_NOERR ) {
+	    status = nc_inq_varid(out_id, name, &var_id);
+	}
+	for (len = 1, d = 0; status == NC_NOERR && d < var_dims; d++) {
+	    status = nc_inq_dimlen(in_id, dim_ids[d], var_len + d);
+	    len *= var_len[d];
+	}
+	if ( status == NC_NOERR && var_dims > 0 ) {
+	    status = nc_inq_var_chunking(out_id, var_id, &i, chunk);
+	}
+	if ( status != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not get information for variable"
+		    " %s.\n%s\n", argv0, argv1, name, nc_strerror(status));
+	    goto error;
+	}
+	if ( len == 0 ) {
+	    continue;
+	}
+
+	/*
+	   Reader processes send values through a pipe, which cannot carry
+	   the pointers in strings, so text is copied here.
+	 */
+
+	if ( xtype == NC_CHAR || xtype == NC_STRING ) {
+	    if ( !extract_box(in_id, v, out_id, var_id, xtype, var_dims,
+			var_len, zero, zero, var_len) ) {
+		fprintf(stderr, "%s %s: could not copy %s.\n",
+			argv0, argv1, name);
+		goto error;
+	    }
+	} else if ( !copy_var(in_nm, out_id, var_id, var_dims, n_jobs,
+		    var_len, chunk, blk_elem, var_dims > 0, buf) ) {
+	    fprintf(stderr, "%s %s: could not copy %s.\n",
+		    argv0, argv1, name);
+	    goto error;
+	}
+    }
+    FREE(buf);
+    FREE(chunk_opts);
+    nc_close(in_id);
+    if ( (status = nc_close(out_id)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: could not close %s.\n%s\n",
+		argv0, argv1, out_nm, nc_strerror(status));
+	return 0;
+    }
+    return 1;
+
+error:
+    FREE(buf);
+    FREE(chunk_opts);
+    if ( in_id != -1 ) {
+	nc_close(in_id);
+    }
+    if ( out_id != -1 ) {
+	nc_close(out_id);
+    }
+    return 0;
+}
+
+/*
+   nnetcdf index [--block=b0,b1,...] [--output=path] var_name file
+
+   Scan var_name once and write a zone map with the extrema and fill count
+   of each block to path, default file.var_name.zmap. Blocks are the chunks
+   of the variable if it is chunked, otherwise tiles of about ZMAP_ELEM
+   values, unless given with --block.
+ */
+static int index_cb(int argc, char *argv[])
+{
+    char *argv0, *argv1;		/* argv[0], argv[1] */
+    char *nc_fl_nm;			/* Path to NetCDF file */
+    int nc_id = -1;			/* NetCDF file identifier */
+    char *var_nm;			/* Variable name, from command line */
+    int var_id;				/* NetCDF identifier for variable */
+    nc_type xtype;			/* Type of var */
+    int status;				/* Return code from NetCDF function
+					   call */
+    int num_dims;			/* Number of dimensions of variable */
+    int dim_ids[NC_MAX_VAR_DIMS];	/* Dimension identifiers */
+    size_t len[NC_MAX_VAR_DIMS];	/* Dimension lengths */
+    size_t blk[NC_MAX_VAR_DIMS];	/* Block lengths */
+    size_t start[NC_MAX_VAR_DIMS];	/* Start of current block */
+    size_t count[NC_MAX_VAR_DIMS];	/* Size of current block */
+    int storage;			/* NC_CONTIGUOUS or NC_CHUNKED */
+    char *blk_opt = NULL;		/* --block value */
+    char *out_nm = NULL;		/* Zone map path */
+    char path[FILENAME_MAX];		/* Default zone map path */
+    int have_fill;			/* If true, fill is a fill value */
+    double fill;			/* Fill value */
+    struct Zmap zm;			/* Zone map */
+    double *buf = NULL;			/* Values for a block */
+    size_t blk_elem;			/* Number of values in a block */
+    size_t b;				/* Block index */
+    size_t n;
+    char *opt, *val, *c, *e;
+    int a, d;
+
+    memset(&zm, 0, sizeof(zm));
+    argv0 = argv[0];
+    argv1 = argv[1];
+    for (a = 2; a < argc && strncmp(argv[a], "--", 2) == 0; a++) {
+	opt = argv[a];
+	if ( (val = opt_val("--block", &a, argc, argv)) ) {
+	    blk_opt = val;
+	} else if ( (val = opt_val("--output", &a, argc, argv)) ) {
+	    out_nm = val;
+	} else {
+	    fprintf(stderr, "%s %s: unknown option or missing value %s\n",
+		    argv0, argv1, opt);
+	    return 0;
+	}
+    }
+    if ( argc - a != 2 ) {
+	fprintf(stderr, "Usage: %s %s [--block=b0,b1,...] [--output=path] "
+		"var_name file\n", argv0, argv1);
+	return 0;
+    }
+    var_nm = argv[a];
+    nc_fl_nm = argv[a + 1];
+    if ( !out_nm ) {
+	if ( !Zmap_Path(path, sizeof(path), nc_fl_nm, var_nm) ) {
+	    fprintf(stderr, "%s %s: zone map path for %s too long.\n",
+		    argv0, argv1, nc_fl_nm);
+	    return 0;
+	}
+	out_nm = path;
+    }
+
+    if ( (status = app_open(nc_fl_nm, &nc_id)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: failed to open %s.\n%s\n",
+		argv0, argv1, nc_fl_nm, nc_strerror(status));
+	return 0;
+    }
+    if ( (status = app_varid(nc_id, var_nm, &var_id)) != NC_NOERR
+	    || (status = nc_inq_var(nc_id, var_id, NULL, &xtype, &num_dims,
+		    dim_ids, NULL)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: could not get information for %s.\n%s\n",
+		argv0, argv1, var_nm, nc_strerror(status));
+	goto error;
+    }
+    if ( xtype == NC_CHAR ) {
+	fprintf(stderr, "%s %s: cannot index character variable %s.\n",
+		argv0, argv1, var_nm);
+	goto error;
+    }
+    for (d = 0; d < num_dims; d++) {
+	if ( (status = nc_inq_dimlen(nc_id, dim_ids[d], len + d))
+		!= NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not get length for dimension %d.\n"
+		    "%s\n", argv0, argv1, d, nc_strerror(status));
+	    goto error;
+	}
+    }
+
+    /* Blocks from command line, else chunks, else balanced tiles */
+    if ( blk_opt ) {
+	for (d = 0, c = blk_opt; d < num_dims; d++, c = e + 1) {
+	    blk[d] = strtoul(c, &e, 10);
+	    if ( e == c || blk[d] < 1
+		    || *e != ((d == num_dims - 1) ? '\0' : ',') ) {
+		fprintf(stderr, "%s %s: expected %d positive block lengths, "
+			"got %s\n", argv0, argv1, num_dims, blk_opt);
+		goto error;
+	    }
+	}
+    } else if ( num_dims == 0
+	    || nc_inq_var_chunking(nc_id, var_id, &storage, blk) != NC_NOERR
+	    || storage != NC_CHUNKED ) {
+	chunk_shape("balanced", num_dims, len, ZMAP_ELEM, blk);
+    }
+    have_fill = var_fill(nc_id, var_id, xtype, &fill);
+    if ( !Zmap_Init(&zm, var_nm, num_dims, len, blk) ) {
+	goto error;
+    }
+    for (blk_elem = 1, d = 0; d < num_dims; d++) {
+	blk_elem *= zm.blk[d];
+    }
+    if ( !(buf = CALLOC(blk_elem, sizeof(double))) ) {
+	fprintf(stderr, "%s %s: could not allocate buffer for %zu values.\n",
+		argv0, argv1, blk_elem);
+	goto error;
+    }
+
+    /* Scan blocks in file order */
+    for (b = 0; b < zm.n_blk; b++) {
+	Zmap_Blk_Box(&zm, b, start, count);
+	for (n = 1, d = 0; d < num_dims; d++) {
+	    n *= count[d];
+	}
+	status = nc_get_vara_double(nc_id, var_id, start, count, buf);
+	if ( status != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not read %s.\n%s\n",
+		    argv0, argv1, var_nm, nc_strerror(status));
+	    goto error;
+	}
+	Zmap_Scan(zm.blks + b, buf, n, have_fill, fill);
+    }
+    if ( !Zmap_Write(&zm, out_nm, nc_fl_nm) ) {
+	goto error;
+    }
+    printf("%s %zu blocks\n", out_nm, zm.n_blk);
+    FREE(buf);
+    Zmap_Free(&zm);
+    app_close(nc_id);
+    return 1;
+
+error:
+    FREE(buf);
+    Zmap_Free(&zm);
+    app_close(nc_id);
+    return 0;
+}
+
+/*
+   nnetcdf query [--no-index] var_name op value [var_name op value ...] file
+
+   Print the indeces and values of elements for which all comparisons
+   "var_name op value" are true. op is one of < <= > >= == !=. Variables
+   must have the same dimensions. Fill and NaN values never match. Unless
+   --no-index is given, zone maps from index at the default paths let the
+   query skip blocks that cannot match. Matches are printed in block order,
+   which is file order if there is no zone map.
+ */
+static int query_cb(int argc, char *argv[])
+{
+    char *argv0, *argv1;		/* argv[0], argv[1] */
+    char *nc_fl_nm;			/* Path to NetCDF file */
+    int nc_id = -1;			/* NetCDF file identifier */
+    int status;				/* Return code from NetCDF function
+					   call */
+    int use_idx = 1;			/* If true, look for zone maps */
+    struct Qry_Pred *preds = NULL, *pr;	/* Conditions */
+    int n_preds = 0;			/* Number of conditions */
+    int num_dims, nd;			/* Number of dimensions */
+    int dim_ids[NC_MAX_VAR_DIMS];	/* Dimension identifiers of first
+					   variable */
+    int dim_ids1[NC_MAX_VAR_DIMS];	/* Dimension identifiers of others */
+    size_t len[NC_MAX_VAR_DIMS];	/* Dimension lengths */
+    size_t blk[NC_MAX_VAR_DIMS];	/* Block lengths */
+    size_t start[NC_MAX_VAR_DIMS];	/* Start of current block */
+    size_t count[NC_MAX_VAR_DIMS];	/* Size of current block */
+    size_t idx[NC_MAX_VAR_DIMS];	/* Index of a match */
+    char path[FILENAME_MAX];		/* Zone map path */
+    struct Zmap grid;			/* Blocks to visit */
+    struct Zmap *zm0 = NULL;		/* Zone map that defines grid */
+    unsigned char *blk_ok = NULL;	/* If blk_ok[b], block b might match */
+    unsigned char *blk_ok1 = NULL;	/* Block matches for one condition */
+    unsigned char *m = NULL;		/* Element matches in current block */
+    size_t *hits = NULL;		/* Indeces of matches in block */
+    size_t blk_elem;			/* Maximum values in a block */
+    size_t b, n, k, i, j;
+    struct Obuf ob = {STDOUT_FILENO, NULL, 0, 0};
+					/* Output buffer */
+    char *e;
+    int a, p, d;
+
+    memset(&grid, 0, sizeof(grid));
+    argv0 = argv[0];
+    argv1 = argv[1];
+    for (a = 2; a < argc && strncmp(argv[a], "--", 2) == 0; a++) {
+	if ( strcmp(argv[a], "--no-index") == 0 ) {
+	    use_idx = 0;
+	} else {
+	    fprintf(stderr, "%s %s: unknown option %s\n",
+		    argv0, argv1, argv[a]);
+	    return 0;
+	}
+    }
+    if ( argc - a < 4 || (argc - a - 1) % 3 != 0 ) {
+	fprintf(stderr, "Usage: %s %s [--no-index] var_name op value "
+		"[var_name op value ...] file\n", argv0, argv1);
+	return 0;
+    }
+    nc_fl_nm = argv[argc - 1];
+    n_preds = (argc - a - 1) / 3;
+    if ( !(preds = CALLOC(n_preds, sizeof(struct Qry_Pred))) ) {
+	fprintf(stderr, "%s %s: could not allocate %d conditions.\n",
+		argv0, argv1, n_preds);
+	return 0;
+    }
+    for (p = 0; p < n_preds; p++, a += 3) {
+	pr = preds + p;
+	pr->var_nm = argv[a];
+	if ( !Zmap_Op_Parse(argv[a + 1], &pr->op) ) {
+	    fprintf(stderr, "%s %s: expected < <= > >= == or !=, got %s\n",
+		    argv0, argv1, argv[a + 1]);
+	    goto error;
+	}
+	pr->v = strtod(argv[a + 2], &e);
+	if ( e == argv[a + 2] || *e != '\0' ) {
+	    fprintf(stderr, "%s %s: expected number for %s, got %s\n",
+		    argv0, argv1, pr->var_nm, argv[a + 2]);
+	    goto error;
+	}
+    }
+
+    /* Check variables and get dimensions from the first one */
+    if ( (status = app_open(nc_fl_nm, &nc_id)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: failed to open %s.\n%s\n",
+		argv0, argv1, nc_fl_nm, nc_strerror(status));
+	nc_id = -1;
+	goto error;
+    }
+    for (p = 0; p < n_preds; p++) {
+	pr = preds + p;
+	if ( (status = app_varid(nc_id, pr->var_nm, &pr->var_id)) != NC_NOERR
+		|| (status = nc_inq_var(nc_id, pr->var_id, NULL, &pr->xtype,
+			&nd, (p == 0) ? dim_ids : dim_ids1, NULL))
+		!= NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not get information for %s.\n"
+		    "%s\n", argv0, argv1, pr->var_nm, nc_strerror(status));
+	    goto error;
+	}
+	if ( pr->xtype == NC_CHAR ) {
+	    fprintf(stderr, "%s %s: cannot compare character variable %s.\n",
+		    argv0, argv1, pr->var_nm);
+	    goto error;
+	}
+	if ( p == 0 ) {
+	    num_dims = nd;
+	} else if ( nd != num_dims
+		|| memcmp(dim_ids, dim_ids1, nd * sizeof(int)) != 0 ) {
+	    fprintf(stderr, "%s %s: %s and %s have different dimensions.\n",
+		    argv0, argv1, preds[0].var_nm, pr->var_nm);
+	    goto error;
+	}
+	pr->have_fill = var_fill(nc_id, pr->var_id, pr->xtype, &pr->fill);
+    }
+    for (d = 0; d < num_dims; d++) {
+	if ( (status = nc_inq_dimlen(nc_id, dim_ids[d], len + d))
+		!= NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not get length for dimension %d.\n"
+		    "%s\n", argv0, argv1, d, nc_strerror(status));
+	    goto error;
+	}
+    }
+
+    /*
+       Visit the blocks of the first zone map found. Zone maps with other
+       blocks cannot help. Without a zone map, visit slabs in file order.
+     */
+
+    for (p = 0; use_idx && p < n_preds; p++) {
+	pr = preds + p;
+	if ( Zmap_Path(path, sizeof(path), nc_fl_nm, pr->var_nm)
+		&& Zmap_Read(&pr->zm, path, nc_fl_nm, pr->var_nm) == 1 ) {
+	    pr->have_zm = pr->zm.ndims == num_dims
+		&& memcmp(pr->zm.len, len, num_dims * sizeof(size_t)) == 0
+		&& (!zm0 || memcmp(pr->zm.blk, zm0->blk,
+			    num_dims * sizeof(size_t)) == 0);
+	    if ( pr->have_zm && !zm0 ) {
+		zm0 = &pr->zm;
+	    }
+	}
+    }
+    if ( zm0 ) {
+	memcpy(blk, zm0->blk, num_dims * sizeof(size_t));
+    } else {
+	for (n = 1, d = num_dims - 1; d >= 0; d--) {
+	    blk[d] = (len[d] < SLAB_ELEM / n) ? len[d] : SLAB_ELEM / n;
+	    blk[d] = (blk[d] > 0) ? blk[d] : 1;
+	    n *= blk[d];
+	}
+    }
+    if ( !Zmap_Init(&grid, preds[0].var_nm, num_dims, len, blk) ) {
+	goto error;
+    }
+    for (blk_elem = 1, d = 0; d < num_dims; d++) {
+	blk_elem *= grid.blk[d];
+    }
+    if ( !(blk_ok = MALLOC(grid.n_blk + 1))
+	    || !(blk_ok1 = MALLOC(grid.n_blk + 1))
+	    || !(m = MALLOC(blk_elem))
+	    || !(hits = CALLOC(blk_elem, sizeof(size_t))) ) {
+	fprintf(stderr, "%s %s: could not allocate query arrays.\n",
+		argv0, argv1);
+	goto error;
+    }
+    memset(blk_ok, 1, grid.n_blk);
+    for (p = 0; p < n_preds; p++) {
+	pr = preds + p;
+	if ( pr->have_zm ) {
+	    Zmap_Match(&pr->zm, pr->op, pr->v, blk_ok1);
+	    for (b = 0; b < grid.n_blk; b++) {
+		blk_ok[b] &= blk_ok1[b];
+	    }
+	}
+	if ( !(pr->buf = CALLOC(blk_elem, sizeof(double))) ) {
+	    fprintf(stderr, "%s %s: could not allocate buffer for %s.\n",
+		    argv0, argv1, pr->var_nm);
+	    goto error;
+	}
+    }
+    if ( !Obuf_Init(&ob, STDOUT_FILENO, OBUF_SIZE) ) {
+	goto error;
+    }
+    fflush(stdout);
+
+    /*
+       For each block that might match, read the variables one at a time,
+       and stop reading as soon as no element can match.
+     */
+
+    for (b = 0; b < grid.n_blk; b++) {
+	if ( !blk_ok[b] ) {
+	    continue;
+	}
+	Zmap_Blk_Box(&grid, b, start, count);
+	for (n = 1, d = 0; d < num_dims; d++) {
+	    n *= count[d];
+	}
+	memset(m, 1, n);
+	for (k = 1, p = 0; k > 0 && p < n_preds; p++) {
+	    pr = preds + p;
+	    status = nc_get_vara_double(nc_id, pr->var_id, start, count,
+		    pr->buf);
+	    if ( status != NC_NOERR ) {
+		fprintf(stderr, "%s %s: could not read %s.\n%s\n",
+			argv0, argv1, pr->var_nm, nc_strerror(status));
+		goto error;
+	    }
+	    k = Zmap_Filter(pr->op, pr->v, pr->buf, n, pr->have_fill,
+		    pr->fill, m);
+	}
+	if ( k == 0 ) {
+	    continue;
+	}
+	k = Zmap_Compress(m, n, hits);
+	for (i = 0; i < k; i++) {
+	    for (j = hits[i], d = num_dims - 1; d >= 0; d--) {
+		idx[d] = start[d] + j % count[d];
+		j /= count[d];
+	    }
+	    for (d = 0; d < num_dims; d++) {
+		Obuf_ULLong(&ob, idx[d]);
+		Obuf_Char(&ob, ' ');
+	    }
+	    for (p = 0; p < n_preds; p++) {
+		pr = preds + p;
+		switch (pr->xtype) {
+		    case NC_FLOAT:
+			Obuf_Float(&ob, (float)pr->buf[hits[i]]);
+			break;
+		    case NC_DOUBLE:
+			Obuf_Double(&ob, pr->buf[hits[i]]);
+			break;
+		    case NC_UBYTE:
+		    case NC_USHORT:
+		    case NC_UINT:
+		    case NC_UINT64:
+			Obuf_ULLong(&ob, (unsigned long long)pr->buf[hits[i]]);
+			break;
+		    default:
+			Obuf_LLong(&ob, (long long)pr->buf[hits[i]]);
+			break;
+		}
+		Obuf_Char(&ob, (p + 1 < n_preds) ? ' ' : '\n');
+	    }
+	}
+    }
+    if ( !Obuf_Flush(&ob) ) {
+	fprintf(stderr, "%s %s: could not print matches.\n", argv0, argv1);
+	goto error;
+    }
+    Obuf_Free(&ob);
+    for (p = 0; p < n_preds; p++) {
+	FREE(preds[p].buf);
+	Zmap_Free(&preds[p].zm);
+    }
+    FREE(preds);
+    FREE(hits);
+    FREE(m);
+    FREE(blk_ok1);
+    FREE(blk_ok);
+    Zmap_Free(&grid);
+    app_close(nc_id);
+    return 1;
+
+error:
+    Obuf_Free(&ob);
+    for (p = 0; p < n_preds; p++) {
+	FREE(preds[p].buf);
+	Zmap_Free(&preds[p].zm);
+    }
+    FREE(preds);
+    FREE(hits);
+    FREE(m);
+    FREE(blk_ok1);
+    FREE(blk_ok);
+    Zmap_Free(&grid);
+    if ( nc_id != -1 ) {
+	app_close(nc_id);
+    }
+    return 0;
+}
+
+/*
+   nnetcdf cat [--jobs=n] out_file in_file ...
+
+   Concatenate the input files along their record dimension into out_file.
+   The inputs must have the same dimensions, except for the number of
+   records, and the same variables. Variables without a record dimension
+   and attributes come from the first input, as do storage settings of
+   netCDF-4 variables. Up to n reader processes read input variables ahead
+   of the writer, each holding at most one slab, so the writer can write in
+   order without waiting on one file at a time.
+ */
+static int cat_cb(int argc, char *argv[])
+{
+    char *argv0, *argv1;		/* argv[0], argv[1] */
+    char *opt, *val;			/* Option and its value */
+    char *out_nm;			/* Output file */
+    char **in_nms;			/* Input files */
+    int n_in;				/* Number of input files */
+    int in_id = -1, out_id = -1;	/* NetCDF file identifiers */
+    int status;				/* Return code from NetCDF function
+					   call */
+    long n_jobs = 0;			/* Number of reader processes */
+    int fmt;				/* Format of first input */
+    int nc4;				/* If true, inputs are HDF5 based */
+    int cmode;				/* Output creation mode */
+    size_t buf_hint = CAT_BUF;		/* Output I/O buffer size */
+    int num_dims = 0, num_vars = 0;	/* Counts in first input */
+    int num_atts;
+    int nd, nv;				/* Counts in other inputs */
+    int rec_dim = -1, rec1;		/* Record dimension */
+    size_t *rec_len = NULL;		/* Number of records in each input */
+    size_t *rec_off = NULL;		/* First output record of each input */
+    char name[NC_MAX_NAME + 1];		/* Dimension, variable, attribute name */
+    char name1[NC_MAX_NAME + 1];	/* Name from another input */
+    size_t len, len1;			/* Dimension lengths */
+    nc_type xtype, xtype1;		/* Variable types */
+    int var_dims, var_dims1;		/* Number of dimensions of variable */
+    int dim_ids[NC_MAX_VAR_DIMS];	/* Dimensions of variable */
+    int dim_ids1[NC_MAX_VAR_DIMS];	/* Dimensions of variable elsewhere */
+    size_t var_len[NC_MAX_VAR_DIMS];	/* Dimension lengths of variable */
+    size_t start[NC_MAX_VAR_DIMS];	/* Where to write block */
+    int dim_id, var_id;			/* Identifiers in output */
+    int old_fill;			/* Previous fill mode */
+    size_t chunk[NC_MAX_VAR_DIMS];	/* Chunk lengths */
+    int storage;			/* NC_CONTIGUOUS or NC_CHUNKED */
+    int shuffle, deflate, level;	/* Compression settings */
+    int fletcher32;			/* Checksum setting */
+    int endian;				/* Byte order */
+    int no_fill;			/* If true, variable has no fill */
+    struct Cat_Task *tasks = NULL, *t;	/* Variables to copy, in order */
+    int n_tasks = 0;			/* Number of tasks */
+    int n_rdr_tasks = 0;		/* Number of tasks with readers */
+    int *rdr_task = NULL;		/* Task for each rank */
+    struct Rdr *rdrs = NULL;		/* Reader for each slot */
+    int *rdr_on = NULL;			/* If true, reader in slot started */
+    int next;				/* Next rank to start */
+    struct Slab slab;			/* Iterates over blocks */
+    double *buf = NULL;			/* Values for a block */
+    size_t n;
+    int f, v, d, i, r;
+    int ok = 0;
+
+    argv0 = argv[0];
+    argv1 = argv[1];
+    for (i = 2; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+	opt = argv[i];
+	if ( (val = opt_val("--jobs", &i, argc, argv)) ) {
+	    if ( sscanf(val, "%ld", &n_jobs) != 1 || n_jobs < 1 ) {
+		fprintf(stderr, "%s %s: expected positive integer for number "
+			"of jobs, got %s\n", argv0, argv1, val);
+		return 0;
+	    }
+	} else {
+	    fprintf(stderr, "%s %s: unknown option or missing value %s\n",
+		    argv0, argv1, opt);
+	    return 0;
+	}
+    }
+    if ( argc - i < 2 ) {
+	fprintf(stderr, "Usage: %s %s [--jobs=n] out_file in_file ...\n",
+		argv0, argv1);
+	return 0;
+    }
+    out_nm = argv[i];
+    in_nms = argv + i + 1;
+    n_in = argc - i - 1;
+    for (f = 0; f < n_in; f++) {
+	if ( strcmp(in_nms[f], out_nm) == 0 ) {
+	    fprintf(stderr, "%s %s: output %s is also an input.\n",
+		    argv0, argv1, out_nm);
+	    return 0;
+	}
+    }
+    if ( n_jobs == 0 && (n_jobs = sysconf(_SC_NPROCESSORS_ONLN)) < 1 ) {
+	n_jobs = 1;
+    }
+    if ( !(rec_len = CALLOC(n_in, sizeof(size_t)))
+	    || !(rec_off = CALLOC(n_in + 1, sizeof(size_t))) ) {
+	fprintf(stderr, "%s %s: could not allocate record counts for %d "
+		"files.\n", argv0, argv1, n_in);
+	goto end;
+    }
+
+    /*
+       Check every input against the first one. Headers come from the file
+       cache in batch, so repeated runs over the same inputs are cheap.
+     */
+
+    for (f = 0; f < n_in; f++) {
+	if ( (status = app_open(in_nms[f], &in_id)) != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: failed to open %s.\n%s\n",
+		    argv0, argv1, in_nms[f], nc_strerror(status));
+	    in_id = -1;
+	    goto end;
+	}
+	if ( (status = nc_inq(in_id, &nd, &nv, NULL, &rec1)) != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not get contents of %s.\n%s\n",
+		    argv0, argv1, in_nms[f], nc_strerror(status));
+	    goto end;
+	}
+	if ( f == 0 ) {
+	    if ( rec1 == -1 ) {
+		fprintf(stderr, "%s %s: %s has no record dimension.\n",
+			argv0, argv1, in_nms[f]);
+		goto end;
+	    }
+	    num_dims = nd;
+	    num_vars = nv;
+	    rec_dim = rec1;
+	}
+	if ( nd != num_dims || nv != num_vars || rec1 != rec_dim ) {
+	    fprintf(stderr, "%s %s: %s and %s have different dimensions or "
+		    "variables.\n", argv0, argv1, in_nms[f], in_nms[0]);
+	    goto end;
+	}
+	if ( (status = nc_inq_dimlen(in_id, rec_dim, rec_len + f))
+		!= NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not get number of records in %s.\n"
+		    "%s\n", argv0, argv1, in_nms[f], nc_strerror(status));
+	    goto end;
+	}
+	app_close(in_id);
+	in_id = -1;
+    }
+
+    /*
+       Names and lengths of dimensions, and variables, must agree. The
+       first input stays open while the others are checked and the output
+       is defined, so it does not come from the file cache, which could
+       close it to make room.
+     */
+
+    if ( (status = nc_open(in_nms[0], NC_NOWRITE, &in_id)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: failed to open %s.\n%s\n",
+		argv0, argv1, in_nms[0], nc_strerror(status));
+	in_id = -1;
+	goto end;
+    }
+    for (f = 1; f < n_in; f++) {
+	int id1;
+
+	if ( (status = app_open(in_nms[f], &id1)) != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: failed to open %s.\n%s\n",
+		    argv0, argv1, in_nms[f], nc_strerror(status));
+	    goto end;
+	}
+	for (d = 0; status == NC_NOERR && d < num_dims; d++) {
+	    if ( (status = nc_inq_dim(in_id, d, name, &len)) == NC_NOERR
+		    && (status = nc_inq_dim(id1, d, name1, &len1))
+		    == NC_NOERR
+		    && (strcmp(name, name1) != 0
+			|| (d != rec_dim && len != len1)) ) {
+		fprintf(stderr, "%s %s: dimension %s of %s does not match "
+			"%s.\n", argv0, argv1, name1, in_nms[f], in_nms[0]);
+		app_close(id1);
+		goto end;
+	    }
+	}
+	for (v = 0; status == NC_NOERR && v < num_vars; v++) {
+	    if ( (status = nc_inq_var(in_id, v, name, &xtype, &var_dims,
+			    dim_ids, NULL)) == NC_NOERR
+		    && (status = nc_inq_var(id1, v, name1, &xtype1,
+			    &var_dims1, dim_ids1, NULL)) == NC_NOERR
+		    && (strcmp(name, name1) != 0 || xtype != xtype1
+			|| var_dims != var_dims1
+			|| memcmp(dim_ids, dim_ids1, var_dims * sizeof(int))
+			!= 0) ) {
+		fprintf(stderr, "%s %s: variable %s of %s does not match "
+			"%s.\n", argv0, argv1, name1, in_nms[f], in_nms[0]);
+		app_close(id1);
+		goto end;
+	    }
+	}
+	app_close(id1);
+	if ( status != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not compare %s with %s.\n%s\n",
+		    argv0, argv1, in_nms[f], in_nms[0], nc_strerror(status));
+	    goto end;
+	}
+    }
+    for (f = 0; f < n_in; f++) {
+	rec_off[f + 1] = rec_off[f] + rec_len[f];
+    }
+
+    /* Define output like the first input, in the same format */
+    if ( (status = nc_inq_format(in_id, &fmt)) != NC_NOERR
+	    || (status = nc_inq_natts(in_id, &num_atts)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: could not get format of %s.\n%s\n",
+		argv0, argv1, in_nms[0], nc_strerror(status));
+	goto end;
+    }
+    cmode = create_mode(fmt);
+    nc4 = fmt == NC_FORMAT_NETCDF4 || fmt == NC_FORMAT_NETCDF4_CLASSIC;
+
+    /*
+       For classic formats, a large I/O buffer lets libnetcdf gather many
+       small record writes into few system calls.
+     */
+
+    status = nc__create(out_nm, cmode, 0, &buf_hint, &out_id);
+    if ( status != NC_NOERR ) {
+	fprintf(stderr, "%s %s: could not create %s.\n%s\n",
+		argv0, argv1, out_nm, nc_strerror(status));
+	out_id = -1;
+	goto end;
+    }
+
+    /*
+       Every value of a classic file is written, so fill values would only
+       cost time. netCDF-4 variables get the fill mode of their input below.
+     */
+
+    if ( !nc4 ) {
+	nc_set_fill(out_id, NC_NOFILL, &old_fill);
+    }
+    for (d = 0; d < num_dims; d++) {
+	if ( (status = nc_inq_dim(in_id, d, name, &len)) != NC_NOERR
+		|| (status = nc_def_dim(out_id, name,
+			(d == rec_dim) ? NC_UNLIMITED : len, &dim_id))
+		!= NC_NOERR || dim_id != d ) {
+	    fprintf(stderr, "%s %s: could not define dimension %d.\n%s\n",
+		    argv0, argv1, d, nc_strerror(status));
+	    goto end;
+	}
+    }
+    for (i = 0; i < num_atts; i++) {
+	if ( (status = nc_inq_attname(in_id, NC_GLOBAL, i, name)) != NC_NOERR
+		|| (status = nc_copy_att(in_id, NC_GLOBAL, name, out_id,
+			NC_GLOBAL)) != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not copy global attribute %d.\n%s\n",
+		    argv0, argv1, i, nc_strerror(status));
+	    goto end;
+	}
+    }
+    if ( !(tasks = CALLOC(n_in * num_vars + 1, sizeof(struct Cat_Task)))
+	    || !(rdr_task = CALLOC(n_in * num_vars + 1, sizeof(int))) ) {
+	fprintf(stderr, "%s %s: could not allocate copy list.\n",
+		argv0, argv1);
+	goto end;
+    }
+    for (v = 0; v < num_vars; v++) {
+	status = nc_inq_var(in_id, v, name, &xtype, &var_dims, dim_ids,
+		&num_atts);
+	if ( status == NC_NOERR ) {
+	    status = nc_def_var(out_id, name, xtype, var_dims, dim_ids,
+		    &var_id);
+	}
+	if ( status != NC_NOERR || var_id != v ) {
+	    fprintf(stderr, "%s %s: could not define variable %d.\n%s\n",
+		    argv0, argv1, v, nc_strerror(status));
+	    goto end;
+	}
+
+	/* Keep chunks, filters, byte order, and fill mode, as extract does */
+	if ( nc4 && var_dims > 0 ) {
+	    status = nc_inq_var_chunking(in_id, v, &storage, chunk);
+	    if ( status == NC_NOERR && storage == NC_CHUNKED ) {
+		status = nc_def_var_chunking(out_id, v, NC_CHUNKED, chunk);
+	    }
+	    if ( status == NC_NOERR ) {
+		status = nc_inq_var_deflate(in_id, v, &shuffle, &deflate,
+			&level);
+	    }
+	    if ( status == NC_NOERR && (shuffle || deflate) ) {
+		status = nc_def_var_deflate(out_id, v, shuffle, deflate,
+			level);
+	    }
+	    if ( status == NC_NOERR ) {
+		status = nc_inq_var_fletcher32(in_id, v, &fletcher32);
+	    }
+	    if ( status == NC_NOERR && fletcher32 ) {
+		status = nc_def_var_fletcher32(out_id, v, NC_FLETCHER32);
+	    }
+	    if ( status == NC_NOERR ) {
+		status = nc_inq_var_endian(in_id, v, &endian);
+	    }
+	    if ( status == NC_NOERR ) {
+		status = nc_def_var_endian(out_id, v, endian);
+	    }
+	}
+	if ( nc4 && status == NC_NOERR ) {
+	    status = nc_inq_var_fill(in_id, v, &no_fill, NULL);
+	    if ( status == NC_NOERR ) {
+		status = nc_def_var_fill(out_id, v, no_fill, NULL);
+	    }
+	}
+	if ( status != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not copy storage settings for "
+		    "%s.\n%s\n", argv0, argv1, name, nc_strerror(status));
+	    goto end;
+	}
+	for (d = 1; d < var_dims; d++) {
+	    if ( dim_ids[d] == rec_dim ) {
+		fprintf(stderr, "%s %s: record dimension of %s is not its "
+			"first dimension.\n", argv0, argv1, name);
+		goto end;
+	    }
+	}
+	for (i = 0; i < num_atts; i++) {
+	    if ( (status = nc_inq_attname(in_id, v, i, name)) != NC_NOERR
+		    || (status = nc_copy_att(in_id, v, name, out_id, v))
+		    != NC_NOERR ) {
+		fprintf(stderr, "%s %s: could not copy attribute %d of "
+			"variable %d.\n%s\n", argv0, argv1, i, v,
+			nc_strerror(status));
+		goto end;
+	    }
+	}
+    }
+    if ( (status = nc_enddef(out_id)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: could not finish defining %s.\n%s\n",
+		argv0, argv1, out_nm, nc_strerror(status));
+	goto end;
+    }
+
+    /*
+       List what to copy in output order: file by file, each record
+       variable, and variables without records from the first file.
+       Numeric arrays get readers, which deliver doubles. The parent copies
+       text and scalars, which are small, and 64 bit integers and strings,
+       which doubles cannot hold exactly, itself in their own type.
+     */
+
+    for (f = 0; f < n_in; f++) {
+	for (v = 0; v < num_vars; v++) {
+	    if ( (status = nc_inq_var(in_id, v, NULL, &xtype, &var_dims,
+			    dim_ids, NULL)) != NC_NOERR ) {
+		fprintf(stderr, "%s %s: could not get information for "
+			"variable %d.\n%s\n", argv0, argv1, v,
+			nc_strerror(status));
+		goto end;
+	    }
+	    if ( (var_dims > 0 && dim_ids[0] == rec_dim) ? rec_len[f] == 0
+		    : f > 0 ) {
+		continue;
+	    }
+	    t = tasks + n_tasks++;
+	    t->f = f;
+	    t->v = v;
+	    t->rec_off = (var_dims > 0 && dim_ids[0] == rec_dim)
+		? rec_off[f] : 0;
+	    if ( xtype == NC_CHAR || xtype == NC_INT64 || xtype == NC_UINT64
+		    || xtype >= NC_STRING || var_dims == 0 ) {
+		t->rank = -1;
+	    } else {
+		rdr_task[n_rdr_tasks] = n_tasks - 1;
+		t->rank = n_rdr_tasks++;
+	    }
+	}
+    }
+    if ( n_jobs > n_rdr_tasks ) {
+	n_jobs = (n_rdr_tasks > 0) ? n_rdr_tasks : 1;
+    }
+    if ( !(rdrs = CALLOC(n_jobs, sizeof(struct Rdr)))
+	    || !(rdr_on = CALLOC(n_jobs, sizeof(int)))
+	    || !(buf = CALLOC(SLAB_ELEM, sizeof(double))) ) {
+	fprintf(stderr, "%s %s: could not allocate readers.\n",
+		argv0, argv1);
+	goto end;
+    }
+
+    /*
+       Shapes come from the first input, except for the number of records.
+       Reader for rank r uses slot r % n_jobs. When the writer finishes a
+       rank, the slot takes the rank n_jobs further on.
+     */
+
+    for (next = 0, i = 0; i < n_tasks; i++) {
+	t = tasks + i;
+	status = nc_inq_var(in_id, t->v, name, &xtype, &var_dims, dim_ids,
+		NULL);
+	for (d = 0; status == NC_NOERR && d < var_dims; d++) {
+	    status = nc_inq_dimlen(in_id, dim_ids[d], var_len + d);
+	}
+	if ( status != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not get information for variable "
+		    "%d.\n%s\n", argv0, argv1, t->v, nc_strerror(status));
+	    goto end;
+	}
+	rec1 = var_dims > 0 && dim_ids[0] == rec_dim;
+	if ( rec1 ) {
+	    var_len[0] = rec_len[t->f];
+	}
+	if ( t->rank == -1 ) {
+	    if ( !cat_direct(in_nms[t->f], out_id, t->v, xtype, var_dims,
+			var_len, t->rec_off, rec1) ) {
+		goto end;
+	    }
+	    continue;
+	}
+	for ( ; next < n_rdr_tasks && next < t->rank + n_jobs; next++) {
+	    struct Cat_Task *t1 = tasks + rdr_task[next];
+	    size_t len1_v[NC_MAX_VAR_DIMS];
+	    int vd1, di1[NC_MAX_VAR_DIMS];
+
+	    status = nc_inq_var(in_id, t1->v, name1, NULL, &vd1, di1, NULL);
+	    for (d = 0; status == NC_NOERR && d < vd1; d++) {
+		status = nc_inq_dimlen(in_id, di1[d], len1_v + d);
+	    }
+	    if ( status != NC_NOERR ) {
+		fprintf(stderr, "%s %s: could not get information for "
+			"variable %d.\n%s\n", argv0, argv1, t1->v,
+			nc_strerror(status));
+		goto end;
+	    }
+	    if ( di1[0] == rec_dim ) {
+		len1_v[0] = rec_len[t1->f];
+	    }
+	    r = next % n_jobs;
+	    if ( !Rdr_Start(rdrs + r, 1, in_nms + t1->f, name1, vd1, len1_v,
+			NULL, NULL, SLAB_ELEM) ) {
+		goto end;
+	    }
+	    rdr_on[r] = 1;
+	}
+	r = t->rank % n_jobs;
+	if ( !Slab_Init(&slab, var_dims, var_len, SLAB_ELEM) ) {
+	    fprintf(stderr, "%s %s: could not allocate slab iterator for %s.\n",
+		    argv0, argv1, name);
+	    goto end;
+	}
+	while ( (n = Slab_Next(&slab)) > 0 ) {
+	    if ( !Rdr_Get(rdrs + r, buf, n) ) {
+		Slab_Free(&slab);
+		goto end;
+	    }
+	    memcpy(start, slab.start, var_dims * sizeof(size_t));
+	    start[0] += t->rec_off;
+	    status = nc_put_vara_double(out_id, t->v, start, slab.count, buf);
+	    if ( status != NC_NOERR ) {
+		fprintf(stderr, "%s %s: could not write %s.\n%s\n",
+			argv0, argv1, name, nc_strerror(status));
+		Slab_Free(&slab);
+		goto end;
+	    }
+	}
+	Slab_Free(&slab);
+	rdr_on[r] = 0;
+	if ( !Rdr_Finish(rdrs + r, 0) ) {
+	    goto end;
+	}
+    }
+    ok = 1;
+
+end:
+    for (r = 0; rdr_on && r < n_jobs; r++) {
+	if ( rdr_on[r] ) {
+	    Rdr_Finish(rdrs + r, 1);
+	}
+    }
+    if ( in_id != -1 ) {
+	nc_close(in_id);
+    }
+    if ( out_id != -1 && (status = nc_close(out_id)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: could not close %s.\n%s\n",
+		argv0, argv1, out_nm, nc_strerror(status));
+	ok = 0;
+    }
+
+    /* Do not leave a partial output that looks like a result */
+    if ( out_id != -1 && !ok ) {
+	unlink(out_nm);
+    }
+    FREE(buf);
+    FREE(rdr_on);
+    FREE(rdrs);
+    FREE(rdr_task);
+    FREE(tasks);
+    FREE(rec_off);
+    FREE(rec_len);
+    return ok;
+}
+
+/*
+   Copy variable v, of type xtype with ndims dimensions of lengths len, from
+   file in_nm to file out_id, where v has the same identifier, in slabs of
+   values of type xtype. If rec is true, the values go to records starting
+   at rec_off. Return 1 on success. On failure, print a message to stderr
+   and return 0.
+ */
+static int cat_direct(char *in_nm, int out_id, int v, nc_type xtype,
+	int ndims, const size_t *len, size_t rec_off, int rec)
+{
+    int in_id;
+    size_t start[NC_MAX_VAR_DIMS];	/* Start of variable in input */
+    size_t out_start[NC_MAX_VAR_DIMS];	/* Start of values in output */
+    size_t n;
+    int d;
+    int status;
+    int ok;
+
+    for (n = 1, d = 0; d < ndims; d++) {
+	start[d] = out_start[d] = 0;
+	n *= len[d];
+    }
+    if ( n == 0 ) {
+	return 1;
+    }
+    if ( rec ) {
+	out_start[0] = rec_off;
+    }
+    if ( (status = nc_open(in_nm, 0, &in_id)) != NC_NOERR ) {
+	fprintf(stderr, "Could not open %s.\n%s\n", in_nm,
+		nc_strerror(status));
+	return 0;
+    }
+    ok = extract_box(in_id, v, out_id, v, xtype, ndims, len, start,
+	    out_start, len);
+    nc_close(in_id);
+    if ( !ok ) {
+	fprintf(stderr, "Could not copy variable %d from %s.\n", v, in_nm);
+    }
+    return ok;
+}
+
+/*
+   nnetcdf extract [--dim=name:selection ...] in_file out_file [var_name ...]
+
+   Copy variables var_name, default all, with the coordinate variables of
+   their dimensions, from in_file to a new file out_file in the same format.
+   --dim limits dimension name to selection, an index or start:stop as for
+   data, and may be repeated. Storage settings of netCDF-4 variables are
+   kept. If a selection starts on chunk boundaries, chunks inside it are
+   copied through HDF5 without decompressing them, and only the partial
+   chunks at its edges go through netCDF. For each such variable, print the
+   number of chunks copied, and the number decompressed and compressed
+   again because filters differ.
+ */
+static int extract_cb(int argc, char *argv[])
+{
+    char *argv0, *argv1;		/* argv[0], argv[1] */
+    char *in_nm, *out_nm;		/* Paths to input and output files */
+    int in_id = -1, out_id = -1;	/* NetCDF file identifiers */
+    int status;				/* Return code from NetCDF function
+					   call */
+    char *opt, *val;			/* Option name and value */
+    char **dim_opts = NULL;		/* --dim values */
+    int n_dim_opts = 0;			/* Number of --dim values */
+    int a;				/* Index in argv */
+    int fmt;				/* Format of input */
+    int nc4;				/* If true, input is HDF5 based */
+    int num_dims, num_vars, num_atts;	/* Counts in input */
+    int rec_dim;			/* Record dimension, or -1 */
+    size_t *len = NULL;			/* Length of input dimensions */
+    size_t *sel_start = NULL;		/* Start of selection along each
+					   input dimension */
+    size_t *sel_count = NULL;		/* Length of selection along each
+					   input dimension */
+    int *dim_map = NULL;		/* Output identifier for each input
+					   dimension, -1 if not used */
+    int *var_map = NULL;		/* Output identifier for each input
+					   variable, -1 if not copied */
+    struct Ext_Var *ev = NULL;		/* Variables to copy chunks for */
+    int n_ev = 0;			/* Number of elements in ev */
+    int direct;				/* If true, copy chunks of current
+					   variable with HDF5 */
+    char name[NC_MAX_NAME + 1];		/* Dimension, variable, attribute name */
+    nc_type xtype;			/* Variable type */
+    int var_dims;			/* Number of dimensions of variable */
+    int dim_ids[NC_MAX_VAR_DIMS];	/* Input dimensions of variable */
+    int out_dims[NC_MAX_VAR_DIMS];	/* Output dimensions of variable */
+    size_t start[NC_MAX_VAR_DIMS];	/* Start of box in input */
+    size_t count[NC_MAX_VAR_DIMS];	/* Size of box */
+    size_t var_len[NC_MAX_VAR_DIMS];	/* Dimension lengths of variable */
+    size_t chunk[NC_MAX_VAR_DIMS];	/* Chunk lengths */
+    int storage;			/* NC_CHUNKED, NC_CONTIGUOUS, ... */
+    int shuffle, deflate, level;	/* Compression settings */
+    int fletcher32;			/* If true, variable has checksums */
+    int endian;				/* Byte order */
+    int no_fill;			/* If true, fill mode is off */
+    int old_fill;			/* Previous fill mode */
+    ptrdiff_t stride;			/* Step from parse_sel */
+    int fixed;				/* Single index flag from parse_sel */
+    struct Slab chk;			/* Iterates over output chunks */
+    int d, i, v;
+    char *c;
+    int ok = 0;
+
+    argv0 = argv[0];
+    argv1 = argv[1];
+    if ( !(dim_opts = CALLOC(argc, sizeof(char *))) ) {
+	fprintf(stderr, "%s %s: could not allocate option array.\n",
+		argv0, argv1);
+	return 0;
+    }
+    for (a = 2; a < argc && strncmp(argv[a], "--", 2) == 0; a++) {
+	opt = argv[a];
+	if ( (val = opt_val("--dim", &a, argc, argv)) ) {
+	    dim_opts[n_dim_opts++] = val;
+	} else {
+	    fprintf(stderr, "%s %s: unknown option or missing value %s\n",
+		    argv0, argv1, opt);
+	    goto end;
+	}
+    }
+    if ( argc - a < 2 ) {
+	fprintf(stderr, "Usage: %s %s [--dim=name:selection ...] in_file "
+		"out_file [var_name ...]\n", argv0, argv1);
+	goto end;
+    }
+    in_nm = argv[a];
+    out_nm = argv[a + 1];
+    if ( strcmp(in_nm, out_nm) == 0 ) {
+	fprintf(stderr, "%s %s: output %s is also the input.\n",
+		argv0, argv1, out_nm);
+	goto end;
+    }
+    if ( (status = nc_open(in_nm, NC_NOWRITE, &in_id)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: failed to open %s.\n%s\n",
+		argv0, argv1, in_nm, nc_strerror(status));
+	in_id = -1;
+	goto end;
+    }
+    if ( (status = nc_inq(in_id, &num_dims, &num_vars, &num_atts, &rec_dim))
+	    != NC_NOERR
+	    || (status = nc_inq_format(in_id, &fmt)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: could not get contents of %s.\n%s\n",
+		argv0, argv1, in_nm, nc_strerror(status));
+	goto end;
+    }
+    nc4 = fmt == NC_FORMAT_NETCDF4 || fmt == NC_FORMAT_NETCDF4_CLASSIC;
+    if ( !(len = CALLOC(num_dims + 1, sizeof(size_t)))
+	    || !(sel_start = CALLOC(num_dims + 1, sizeof(size_t)))
+	    || !(sel_count = CALLOC(num_dims + 1, sizeof(size_t)))
+	    || !(dim_map = CALLOC(num_dims + 1, sizeof(int)))
+	    || !(var_map = CALLOC(num_vars + 1, sizeof(int)))
+	    || !(ev = CALLOC(num_vars + 1, sizeof(struct Ext_Var))) ) {
+	fprintf(stderr, "%s %s: could not allocate arrays for %d dimensions "
+		"and %d variables.\n", argv0, argv1, num_dims, num_vars);
+	goto end;
+    }
+    for (d = 0; d < num_dims; d++) {
+	if ( (status = nc_inq_dimlen(in_id, d, len + d)) != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not get length for dimension %d.\n"
+		    "%s\n", argv0, argv1, d, nc_strerror(status));
+	    goto end;
+	}
+	sel_start[d] = 0;
+	sel_count[d] = len[d];
+	dim_map[d] = -1;
+    }
+
+    /* Selections. Chunks copy whole, so there is no step. */
+    for (i = 0; i < n_dim_opts; i++) {
+	if ( !(c = strchr(dim_opts[i], ':'))
+		|| (size_t)(c - dim_opts[i]) > NC_MAX_NAME ) {
+	    fprintf(stderr, "%s %s: expected name:selection for --dim, got "
+		    "%s\n", argv0, argv1, dim_opts[i]);
+	    goto end;
+	}
+	strncpy(name, dim_opts[i], c - dim_opts[i]);
+	name[c - dim_opts[i]] = '\0';
+	if ( (status = nc_inq_dimid(in_id, name, &d)) != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: no dimension named %s in %s.\n%s\n",
+		    argv0, argv1, name, in_nm, nc_strerror(status));
+	    goto end;
+	}
+	if ( !parse_sel(c + 1, len[d], sel_start + d, sel_count + d,
+		    &stride, &fixed) || stride != 1 || sel_count[d] == 0 ) {
+	    fprintf(stderr, "%s %s: expected index or start:stop for "
+		    "dimension %s of length %zu, got %s\n",
+		    argv0, argv1, name, len[d], c + 1);
+	    goto end;
+	}
+    }
+
+    /* Variables to copy, and coordinate variables for their dimensions */
+    for (v = 0; v < num_vars; v++) {
+	var_map[v] = (a + 2 == argc) ? 1 : -1;
+    }
+    for (i = a + 2; i < argc; i++) {
+	if ( (status = nc_inq_varid(in_id, argv[i], &v)) != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not find variable named %s.\n%s\n",
+		    argv0, argv1, argv[i], nc_strerror(status));
+	    goto end;
+	}
+	var_map[v] = 1;
+    }
+    for (v = 0; v < num_vars; v++) {
+	if ( var_map[v] == -1 ) {
+	    continue;
+	}
+	status = nc_inq_var(in_id, v, NULL, NULL, &var_dims, dim_ids, NULL);
+	for (d = 0; status == NC_NOERR && d < var_dims; d++) {
+	    dim_map[dim_ids[d]] = 1;
+	    status = nc_inq_dimname(in_id, dim_ids[d], name);
+	    if ( status == NC_NOERR
+		    && nc_inq_varid(in_id, name, &i) == NC_NOERR ) {
+		var_map[i] = 1;
+	    }
+	}
+	if ( status != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not get dimensions for variable "
+		    "%d.\n%s\n", argv0, argv1, v, nc_strerror(status));
+	    goto end;
+	}
+    }
+
+    /* Define output, dimensions and variables in input order */
+    status = nc_create(out_nm, create_mode(fmt), &out_id);
+    if ( status != NC_NOERR ) {
+	fprintf(stderr, "%s %s: could not create %s.\n%s\n",
+		argv0, argv1, out_nm, nc_strerror(status));
+	out_id = -1;
+	goto end;
+    }
+
+    /*
+       Every value of a classic file is written, so fill values would only
+       cost time. In netCDF-4 files, the file fill mode would become the
+       fill mode of every variable, so each variable gets its own below.
+     */
+
+    if ( !nc4 ) {
+	nc_set_fill(out_id, NC_NOFILL, &old_fill);
+    }
+    for (d = 0; d < num_dims; d++) {
+	if ( dim_map[d] == -1 ) {
+	    continue;
+	}
+	if ( (status = nc_inq_dimname(in_id, d, name)) != NC_NOERR
+		|| (status = nc_def_dim(out_id, name,
+			(d == rec_dim) ? NC_UNLIMITED : sel_count[d],
+			dim_map + d)) != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not define dimension %d.\n%s\n",
+		    argv0, argv1, d, nc_strerror(status));
+	    goto end;
+	}
+    }
+    for (i = 0; i < num_atts; i++) {
+	if ( (status = nc_inq_attname(in_id, NC_GLOBAL, i, name)) != NC_NOERR
+		|| (status = nc_copy_att(in_id, NC_GLOBAL, name, out_id,
+			NC_GLOBAL)) != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not copy global attribute %d.\n%s\n",
+		    argv0, argv1, i, nc_strerror(status));
+	    goto end;
+	}
+    }
+    for (v = 0; v < num_vars; v++) {
+	if ( var_map[v] == -1 ) {
+	    continue;
+	}
+	status = nc_inq_var(in_id, v, name, &xtype, &var_dims, dim_ids,
+		&num_atts);
+	for (d = 0; d < var_dims; d++) {
+	    out_dims[d] = dim_map[dim_ids[d]];
+	}
+	if ( status == NC_NOERR ) {
+	    status = nc_def_var(out_id, name, xtype, var_dims, out_dims,
+		    var_map + v);
+	}
+	if ( status != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not define variable %d.\n%s\n",
+		    argv0, argv1, v, nc_strerror(status));
+	    goto end;
+	}
+
+	/*
+	   Keep chunks, filters, byte order, and fill mode. Fixed dimensions
+	   cannot be shorter than a chunk, so a chunk longer than the
+	   selection shrinks, and then the chunks no longer match. Chunks of
+	   strings and user types refer to data elsewhere in the file, so
+	   they are never copied raw.
+	 */
+
+	direct = 0;
+	storage = NC_CONTIGUOUS;
+	if ( nc4 && var_dims > 0 ) {
+	    status = nc_inq_var_chunking(in_id, v, &storage, chunk);
+	    if ( status == NC_NOERR && storage == NC_CHUNKED ) {
+		for (direct = 1, d = 0; d < var_dims; d++) {
+		    if ( dim_ids[d] != rec_dim
+			    && chunk[d] > sel_count[dim_ids[d]] ) {
+			chunk[d] = sel_count[dim_ids[d]];
+			direct = 0;
+		    }
+		    if ( sel_start[dim_ids[d]] % chunk[d] != 0 ) {
+			direct = 0;
+		    }
+		}
+		status = nc_def_var_chunking(out_id, var_map[v], NC_CHUNKED,
+			chunk);
+	    }
+	    if ( status == NC_NOERR ) {
+		status = nc_inq_var_deflate(in_id, v, &shuffle, &deflate,
+			&level);
+	    }
+	    if ( status == NC_NOERR && (shuffle || deflate) ) {
+		status = nc_def_var_deflate(out_id, var_map[v], shuffle,
+			deflate, level);
+	    }
+	    if ( status == NC_NOERR ) {
+		status = nc_inq_var_fletcher32(in_id, v, &fletcher32);
+	    }
+	    if ( status == NC_NOERR && fletcher32 ) {
+		status = nc_def_var_fletcher32(out_id, var_map[v],
+			NC_FLETCHER32);
+	    }
+	    if ( status == NC_NOERR ) {
+		status = nc_inq_var_endian(in_id, v, &endian);
+	    }
+	    if ( status == NC_NOERR ) {
+		status = nc_def_var_endian(out_id, var_map[v], endian);
+	    }
+	    if ( status == NC_NOERR ) {
+		status = nc_inq_var_fill(in_id, v, &no_fill, NULL);
+	    }
+	    if ( status == NC_NOERR ) {
+		status = nc_def_var_fill(out_id, var_map[v], no_fill, NULL);
+	    }
+	    if ( status != NC_NOERR ) {
+		fprintf(stderr, "%s %s: could not copy storage settings for "
+			"%s.\n%s\n", argv0, argv1, name, nc_strerror(status));
+		goto end;
+	    }
+	}
+#ifndef HAVE_HDF5
+	direct = 0;
+#endif
+	if ( xtype >= NC_STRING ) {
+	    direct = 0;
+	}
+	if ( direct ) {
+	    struct Ext_Var *e = ev + n_ev;
+
+	    if ( !(e->start = CALLOC(4 * var_dims, sizeof(size_t))) ) {
+		fprintf(stderr, "%s %s: could not allocate chunk information "
+			"for %s.\n", argv0, argv1, name);
+		goto end;
+	    }
+	    e->v = v;
+	    strcpy(e->nm, name);
+	    e->ndims = var_dims;
+	    e->count = e->start + var_dims;
+	    e->len = e->start + 2 * var_dims;
+	    e->chunk = e->start + 3 * var_dims;
+	    for (d = 0; d < var_dims; d++) {
+		e->start[d] = sel_start[dim_ids[d]];
+		e->count[d] = sel_count[dim_ids[d]];
+		e->len[d] = len[dim_ids[d]];
+		e->chunk[d] = chunk[d];
+	    }
+	    n_ev++;
+	}
+	for (i = 0; i < num_atts; i++) {
+	    if ( (status = nc_inq_attname(in_id, v, i, name)) != NC_NOERR
+		    || (status = nc_copy_att(in_id, v, name, out_id,
+			    var_map[v])) != NC_NOERR ) {
+		fprintf(stderr, "%s %s: could not copy attribute %d of "
+			"variable %d.\n%s\n", argv0, argv1, i, v,
+			nc_strerror(status));
+		goto end;
+	    }
+	}
+    }
+    if ( (status = nc_enddef(out_id)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: could not finish defining %s.\n%s\n",
+		argv0, argv1, out_nm, nc_strerror(status));
+	goto end;
+    }
+
+    /*
+       Copy values through netCDF, except for whole chunks of variables in
+       ev, which are copied after the files are closed.
+     */
+
+    for (v = 0, i = 0; v < num_vars; v++) {
+	if ( var_map[v] == -1 ) {
+	    continue;
+	}
+	status = nc_inq_var(in_id, v, name, &xtype, &var_dims, dim_ids, NULL);
+	if ( status != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not get information for variable "
+		    "%d.\n%s\n", argv0, argv1, v, nc_strerror(status));
+	    goto end;
+	}
+	for (d = 0; d < var_dims; d++) {
+	    start[d] = sel_start[dim_ids[d]];
+	    count[d] = sel_count[dim_ids[d]];
+	    var_len[d] = len[dim_ids[d]];
+	}
+	if ( i == n_ev || ev[i].v != v ) {
+	    size_t zero[NC_MAX_VAR_DIMS] = {0};
+
+	    if ( !extract_box(in_id, v, out_id, var_map[v], xtype, var_dims,
+			var_len, start, zero, count) ) {
+		fprintf(stderr, "%s %s: could not copy %s.\n",
+			argv0, argv1, name);
+		goto end;
+	    }
+	    continue;
+	}
+	if ( !Slab_Init_Blk(&chk, var_dims, count, ev[i].chunk) ) {
+	    fprintf(stderr, "%s %s: could not allocate chunk iterator for "
+		    "%s.\n", argv0, argv1, name);
+	    goto end;
+	}
+	while ( Slab_Next(&chk) > 0 ) {
+	    size_t box[NC_MAX_VAR_DIMS];
+
+	    if ( H5Chunk_Whole(var_dims, chk.start, start, count, var_len,
+			ev[i].chunk) ) {
+		continue;
+	    }
+	    for (d = 0; d < var_dims; d++) {
+		box[d] = start[d] + chk.start[d];
+	    }
+	    if ( !extract_box(in_id, v, out_id, var_map[v], xtype, var_dims,
+			var_len, box, chk.start, chk.count) ) {
+		fprintf(stderr, "%s %s: could not copy %s.\n",
+			argv0, argv1, name);
+		Slab_Free(&chk);
+		goto end;
+	    }
+	}
+	Slab_Free(&chk);
+	i++;
+    }
+    nc_close(in_id);
+    in_id = -1;
+    status = nc_close(out_id);
+    out_id = -1;
+    if ( status != NC_NOERR ) {
+	fprintf(stderr, "%s %s: could not close %s.\n%s\n",
+		argv0, argv1, out_nm, nc_strerror(status));
+	goto end;
+    }
+
+#ifdef HAVE_HDF5
+    if ( n_ev > 0 ) {
+	hid_t h5_in, h5_out;		/* HDF5 file identifiers */
+	size_t n_raw, n_cooked;		/* Chunks copied, recompressed */
+
+	H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+	if ( (h5_in = H5Fopen(in_nm, H5F_ACC_RDONLY, H5P_DEFAULT)) < 0 ) {
+	    fprintf(stderr, "%s %s: could not open %s with HDF5.\n",
+		    argv0, argv1, in_nm);
+	    goto end;
+	}
+	if ( (h5_out = H5Fopen(out_nm, H5F_ACC_RDWR, H5P_DEFAULT)) < 0 ) {
+	    fprintf(stderr, "%s %s: could not open %s with HDF5.\n",
+		    argv0, argv1, out_nm);
+	    H5Fclose(h5_in);
+	    goto end;
+	}
+	for (i = 0; i < n_ev; i++) {
+	    if ( !H5Chunk_Copy(h5_in, h5_out, ev[i].nm, ev[i].ndims,
+			ev[i].start, ev[i].count, ev[i].len, ev[i].chunk,
+			&n_raw, &n_cooked) ) {
+		fprintf(stderr, "%s %s: could not copy chunks of %s.\n",
+			argv0, argv1, ev[i].nm);
+		H5Fclose(h5_out);
+		H5Fclose(h5_in);
+		goto end;
+	    }
+	    printf("%s %zu chunks copied, %zu recompressed\n",
+		    ev[i].nm, n_raw, n_cooked);
+	}
+	H5Fclose(h5_out);
+	H5Fclose(h5_in);
+    }
+#endif
+    ok = 1;
+
+end:
+    if ( in_id != -1 ) {
+	nc_close(in_id);
+    }
+    if ( out_id != -1 ) {
+	nc_close(out_id);
+    }
+    for (i = 0; ev && i < n_ev; i++) {
+	FREE(ev[i].start);
+    }
+    FREE(ev);
+    FREE(var_map);
+    FREE(dim_map);
+    FREE(sel_count);
+    FREE(sel_start);
+    FREE(len);
+    FREE(dim_opts);
+    return ok;
+}
+
+/*
+   Copy the box of count values starting at in_start from variable v_in, of
+   type xtype with ndims dimensions of lengths len, in file in_id, to
+   out_start in variable v_out of file out_id, in slabs. Values keep their
+   type, so 64 bit integers and strings copy exactly. Return 1 on success.
+   On failure, print a message to stderr and return 0.
+ */
+static int extract_box(int in_id, int v_in, int out_id, int v_out,
+	nc_type xtype, int ndims, const size_t *len, const size_t *in_start,
+	const size_t *out_start, const size_t *count)
+{
+    struct Slab slab;			/* Iterates over box */
+    size_t start[NC_MAX_VAR_DIMS];	/* Start of slab in output */
+    void *buf;				/* Values from a slab */
+    size_t sz;				/* Size of a value */
+    size_t n;				/* Number of values in slab */
+    int d;
+    int status = NC_NOERR;
+
+    if ( (status = nc_inq_type(in_id, xtype, NULL, &sz)) != NC_NOERR ) {
+	fprintf(stderr, "%s\n", nc_strerror(status));
+	return 0;
+    }
+    if ( !(buf = CALLOC(SLAB_ELEM, sz)) ) {
+	fprintf(stderr, "Could not allocate buffer for %d values.\n",
+		SLAB_ELEM);
+	return 0;
+    }
+    if ( !Slab_Init_Box(&slab, ndims, len, in_start, count, SLAB_ELEM) ) {
+	fprintf(stderr, "Could not allocate slab iterator.\n");
+	FREE(buf);
+	return 0;
+    }
+    while ( status == NC_NOERR && (n = Slab_Next(&slab)) > 0 ) {
+	for (d = 0; d < ndims; d++) {
+	    start[d] = out_start[d] + slab.start[d] - in_start[d];
+	}
+	if ( (status = nc_get_vara(in_id, v_in, slab.start, slab.count,
+			buf)) != NC_NOERR ) {
+	    break;
+	}
+	status = nc_put_vara(out_id, v_out, start, slab.count, buf);
+	if ( xtype == NC_STRING ) {
+	    nc_free_string(n, buf);
+	}
+    }
+    Slab_Free(&slab);
+    FREE(buf);
+    if ( status != NC_NOERR ) {
+	fprintf(stderr, "%s\n", nc_strerror(status));
+	return 0;
+    }
+    return 1;
+}
+
+/*
+   Return the mode for nc_create that makes a file with format fmt, as from
+   nc_inq_format.
+ */
+static int create_mode(int fmt)
+{
+    switch (fmt) {
+	case NC_FORMAT_64BIT_OFFSET:
+	    return NC_CLOBBER | NC_64BIT_OFFSET;
+	case NC_FORMAT_CDF5:
+	    return NC_CLOBBER | NC_64BIT_DATA;
+	case NC_FORMAT_NETCDF4:
+	    return NC_CLOBBER | NC_NETCDF4;
+	case NC_FORMAT_NETCDF4_CLASSIC:
+	    return NC_CLOBBER | NC_NETCDF4 | NC_CLASSIC_MODEL;
+	default:
+	    return NC_CLOBBER;
+    }
+}
+
+/*
+   nnetcdf scan [--jobs=n] [--name=pattern] [--var=name] [--dim=name[=len]]
+	   [--att=[var:]name[=value]] path ...
+
+   Walk the directory trees at path ... and print the path of every netCDF
+   file that meets all of the conditions. --var requires a variable, --dim
+   a dimension, optionally with a length, and --att a global attribute, or
+   an attribute of variable var, optionally with a value. A numeric
+   attribute matches if any of its values equals value. --name limits the
+   search to files whose names match a shell pattern. Condition options may
+   be repeated. Worker processes open files n at a time, reading only
+   headers, and paths are printed as workers find them.
+
+   nnetcdf scan --catalog=file [--name=pattern] [conditions] [path ...]
+
+   Search catalog file, made with the catalog subcommand, instead of the
+   file system. No netCDF file is opened. Without path, search every file
+   in the catalog. --att conditions may only name attributes that the
+   catalog keeps.
+ */
+static int scan_cb(int argc, char *argv[])
+{
+    char *argv0, *argv1;		/* argv[0], argv[1] */
+    char *opt, *val;			/* Option name and value */
+    int a;				/* Index in argv */
+    long n_jobs = 0;			/* Number of worker processes */
+    struct Scan_Pred *preds = NULL, *pr;/* Conditions */
+    int n_preds = 0;			/* Number of conditions */
+    char *cat_nm = NULL;		/* Catalog to search instead */
+    pid_t *pids = NULL;			/* Worker process identifiers */
+    int n_pids = 0;			/* Number of workers started */
+    int task_fd[2] = {-1, -1};		/* Paths to workers */
+    int res_fd[2] = {-1, -1};		/* Matching paths from workers */
+    int wstatus;			/* Exit status of worker */
+    struct sigaction act, old_pipe;	/* SIGPIPE disposition */
+    int ign_pipe = 0;			/* If true, restore old_pipe */
+    char *e;
+    int i;
+
+    argv0 = argv[0];
+    argv1 = argv[1];
+    scan_walk.argv0 = argv0;
+    scan_walk.argv1 = argv1;
+    scan_walk.pat = NULL;
+    scan_walk.cat = NULL;
+    scan_walk.ok = 1;
+    if ( !(preds = CALLOC(argc, sizeof(struct Scan_Pred))) ) {
+	fprintf(stderr, "%s %s: could not allocate conditions.\n",
+		argv0, argv1);
+	return 0;
+    }
+    for (a = 2; a < argc && strncmp(argv[a], "--", 2) == 0; a++) {
+	opt = argv[a];
+	pr = preds + n_preds;
+	if ( (val = opt_val("--jobs", &a, argc, argv)) ) {
+	    if ( sscanf(val, "%ld", &n_jobs) != 1 || n_jobs < 1 ) {
+		fprintf(stderr, "%s %s: expected positive integer for number "
+			"of jobs, got %s\n", argv0, argv1, val);
+		goto error;
+	    }
+	} else if ( (val = opt_val("--name", &a, argc, argv)) ) {
+	    scan_walk.pat = val;
+	} else if ( (val = opt_val("--catalog", &a, argc, argv)) ) {
+	    cat_nm = val;
+	} else if ( (val = opt_val("--var", &a, argc, argv)) ) {
+	    pr->type = SCAN_VAR;
+	    pr->nm = val;
+	    n_preds++;
+	} else if ( (val = opt_val("--dim", &a, argc, argv)) ) {
+	    pr->type = SCAN_DIM;
+	    pr->nm = val;
+	    if ( (pr->val = strchr(val, '=')) ) {
+		*pr->val++ = '\0';
+		pr->len = strtoul(pr->val, &e, 10);
+		if ( e == pr->val || *e != '\0' ) {
+		    fprintf(stderr, "%s %s: expected dimension length for %s, "
+			    "got %s\n", argv0, argv1, pr->nm, pr->val);
+		    goto error;
+		}
+	    }
+	    n_preds++;
+	} else if ( (val = opt_val("--att", &a, argc, argv)) ) {
+	    pr->type = SCAN_ATT;
+	    pr->nm = val;
+	    if ( (pr->val = strchr(val, '=')) ) {
+		*pr->val++ = '\0';
+		pr->x = strtod(pr->val, &e);
+		pr->is_num = e != pr->val && *e == '\0';
+	    }
+	    if ( (e = strchr(val, ':')) ) {
+		*e = '\0';
+		pr->var_nm = val;
+		pr->nm = e + 1;
+	    }
+	    n_preds++;
+	} else {
+	    fprintf(stderr, "%s %s: unknown option or missing value %s\n",
+		    argv0, argv1, opt);
+	    goto error;
+	}
+    }
+    if ( cat_nm ) {
+	i = scan_cat(argv0, argv1, cat_nm, preds, n_preds, scan_walk.pat,
+		argv + a, argc - a);
+	FREE(preds);
+	return i;
+    }
+    if ( a == argc ) {
+	fprintf(stderr, "Usage: %s %s [--jobs=n] [--name=pattern] "
+		"[--var=name] [--dim=name[=len]] [--att=[var:]name[=value]] "
+		"path ...\n       %s %s --catalog=file [--name=pattern] "
+		"[conditions] [path ...]\n", argv0, argv1, argv0, argv1);
+	goto error;
+    }
+
+    /*
+       Opening a file waits mostly on the file system, so run several
+       workers per processor. libnetcdf is not thread safe, so workers are
+       processes.
+     */
+
+    if ( n_jobs == 0 ) {
+	if ( (n_jobs = sysconf(_SC_NPROCESSORS_ONLN)) < 1 ) {
+	    n_jobs = 1;
+	}
+	n_jobs *= SCAN_JOBS_PER_CPU;
+    }
+    if ( !(pids = CALLOC(n_jobs, sizeof(pid_t))) ) {
+	fprintf(stderr, "%s %s: could not allocate array of %ld process "
+		"identifiers.\n", argv0, argv1, n_jobs);
+	goto error;
+    }
+    if ( pipe(task_fd) == -1 || pipe(res_fd) == -1 ) {
+	fprintf(stderr, "%s %s: could not create pipes for workers.\n",
+		argv0, argv1);
+	perror(NULL);
+	goto error;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    for (n_pids = 0; n_pids < n_jobs; n_pids++) {
+	switch (pids[n_pids] = fork()) {
+	    case -1:
+		fprintf(stderr, "%s %s: could not create worker process.\n",
+			argv0, argv1);
+		perror(NULL);
+		goto error;
+	    case 0:
+		close(task_fd[1]);
+		close(res_fd[0]);
+		scan_worker(preds, n_preds, task_fd[0], res_fd[1]);
+		_exit(EXIT_FAILURE);
+	}
+    }
+    close(task_fd[0]);
+    close(res_fd[1]);
+    task_fd[0] = res_fd[1] = -1;
+
+    /*
+       The walk must keep reading results while it waits to give out paths,
+       or workers blocked on a full result pipe would never take more.
+     */
+
+    memset(&act, 0, sizeof(act));
+    sigemptyset(&act.sa_mask);
+    act.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &act, &old_pipe);
+    ign_pipe = 1;
+    if ( fcntl(task_fd[1], F_SETFL, O_NONBLOCK) == -1 ) {
+	fprintf(stderr, "%s %s: could not set up task pipe.\n",
+		argv0, argv1);
+	perror(NULL);
+	goto error;
+    }
+    scan_walk.task_fd = task_fd[1];
+    scan_walk.res_fd = res_fd[0];
+    for ( ; a < argc && scan_walk.ok != -1; a++) {
+	if ( nftw(argv[a], scan_visit, SCAN_FDS, FTW_PHYS) == -1
+		&& scan_walk.ok != -1 ) {
+	    fprintf(stderr, "%s %s: could not walk %s.\n",
+		    argv0, argv1, argv[a]);
+	    perror(NULL);
+	    scan_walk.ok = 0;
+	}
+    }
+    close(task_fd[1]);
+    task_fd[1] = -1;
+    sigaction(SIGPIPE, &old_pipe, NULL);
+    ign_pipe = 0;
+    while ( scan_drain(res_fd[0]) > 0 ) {
+    }
+    close(res_fd[0]);
+    res_fd[0] = -1;
+    for ( ; n_pids > 0; n_pids--) {
+	if ( waitpid(pids[n_pids - 1], &wstatus, 0) == -1
+		|| !WIFEXITED(wstatus)
+		|| WEXITSTATUS(wstatus) != EXIT_SUCCESS ) {
+	    scan_walk.ok = 0;
+	}
+    }
+    FREE(pids);
+    FREE(preds);
+    return scan_walk.ok == 1;
+
+error:
+    for (i = 0; i < n_pids; i++) {
+	kill(pids[i], SIGTERM);
+    }
+    for (i = 0; i < n_pids; i++) {
+	waitpid(pids[i], NULL, 0);
+    }
+    for (i = 0; i < 2; i++) {
+	if ( task_fd[i] != -1 ) {
+	    close(task_fd[i]);
+	}
+	if ( res_fd[i] != -1 ) {
+	    close(res_fd[i]);
+	}
+    }
+    if ( ign_pipe ) {
+	sigaction(SIGPIPE, &old_pipe, NULL);
+    }
+    FREE(pids);
+    FREE(preds);
+    return 0;
+}
+
+/*
+   nftw callback for scan and catalog. Give regular files whose names match
+   the scan pattern to the workers, copying their output, if any, while
+   waiting. Return 0 to continue the walk, or -1 to stop it.
+ */
+static int scan_visit(const char *path, const struct stat *sb, int flag,
+	struct FTW *ftw)
+{
+    char task[SCAN_PATH];		/* Path for a worker */
+    size_t l;				/* Length of path */
+    struct stat sb1;			/* Target of symbolic link */
+    struct pollfd fds[2];		/* Task and result pipes */
+    struct Cat_Ent *ent;		/* Catalog entry for path */
+    ssize_t nw;
+
+    switch (flag) {
+	case FTW_F:
+	    break;
+	case FTW_SL:
+	    if ( stat(path, &sb1) == -1 || !S_ISREG(sb1.st_mode) ) {
+		return 0;
+	    }
+	    sb = &sb1;
+	    break;
+	case FTW_DNR:
+	case FTW_NS:
+	    fprintf(stderr, "%s %s: could not read %s.\n",
+		    scan_walk.argv0, scan_walk.argv1, path);
+	    scan_walk.ok = 0;
+	    return 0;
+	default:
+	    return 0;
+    }
+    if ( !S_ISREG(sb->st_mode) || (scan_walk.pat
+		&& fnmatch(scan_walk.pat, path + ftw->base, 0) != 0) ) {
+	return 0;
+    }
+
+    /* When updating a catalog, skip files that have not changed */
+    if ( scan_walk.cat && (ent = Cat_Find(scan_walk.cat, path))
+	    && ent->dev == (uint64_t)sb->st_dev
+	    && ent->ino == (uint64_t)sb->st_ino
+	    && ent->size == (uint64_t)sb->st_size
+	    && ent->mtime == mtime_ns(sb) ) {
+	ent->seen = 1;
+	return 0;
+    }
+    if ( (l = strlen(path)) >= SCAN_PATH ) {
+	fprintf(stderr, "%s %s: skipping %s, path is too long.\n",
+		scan_walk.argv0, scan_walk.argv1, path);
+	scan_walk.ok = 0;
+	return 0;
+    }
+    memset(task, 0, SCAN_PATH);
+    memcpy(task, path, l);
+
+    /* Each task is one write no larger than PIPE_BUF, so it stays whole */
+    fds[0].fd = scan_walk.task_fd;
+    fds[0].events = POLLOUT;
+    fds[1].fd = scan_walk.res_fd;
+    fds[1].events = POLLIN;
+    while ( (nw = write(scan_walk.task_fd, task, SCAN_PATH)) != SCAN_PATH ) {
+	if ( nw == -1 && errno != EAGAIN && errno != EINTR ) {
+	    fprintf(stderr, "%s %s: could not give %s to a worker.\n",
+		    scan_walk.argv0, scan_walk.argv1, path);
+	    perror(NULL);
+	    scan_walk.ok = -1;
+	    return -1;
+	}
+	if ( poll(fds, 2, -1) == -1 && errno != EINTR ) {
+	    scan_walk.ok = -1;
+	    return -1;
+	}
+	if ( (fds[1].revents & (POLLIN | POLLHUP))
+		&& scan_drain(fds[1].fd) < 0 ) {
+	    scan_walk.ok = -1;
+	    return -1;
+	}
+    }
+    return 0;
+}
+
+/*
+   Copy what is available from scan result pipe fd to standard output.
+   Return the number of bytes copied, 0 at end of file, or -1 on failure.
+ */
+static ssize_t scan_drain(int fd)
+{
+    char buf[SCAN_PATH * 4];
+    ssize_t nr;
+
+    while ( (nr = read(fd, buf, sizeof(buf))) == -1 && errno == EINTR ) {
+    }
+    if ( nr > 0 ) {
+	fwrite(buf, 1, nr, stdout);
+	fflush(stdout);
+    }
+    return nr;
+}
+
+/*
+   Worker process for scan. Read paths of SCAN_PATH bytes from task_fd, and
+   write each path for which the file meets all n_preds conditions in preds,
+   with a newline, to res_fd. Classic headers are read without libnetcdf,
+   into a catalog record that scan_cat_match checks. Other files that do not
+   start like a netCDF file are skipped without opening them. Exit when
+   task_fd is closed.
+ */
+static void scan_worker(struct Scan_Pred *preds, int n_preds, int task_fd,
+	int res_fd)
+{
+    char path[SCAN_PATH + 1];		/* Path from task pipe */
+    int nc_id;				/* NetCDF file identifier */
+    int status;				/* Return code from NetCDF function
+					   call */
+    int match;				/* If true, file meets conditions */
+    struct CDF_Hdr hdr;			/* Header of classic file */
+    struct Cat_Buf b = {NULL, 0, 0};	/* Record for hdr */
+    char *att_nms = NULL;		/* Attributes in conditions */
+    uint32_t n_att_nms = 0;		/* Number of names in att_nms */
+    size_t att_nms_len = 0;		/* Bytes in att_nms */
+    struct Scan_Pred *pr;
+    size_t l;
+    ssize_t nr;
+
+    for (pr = preds; pr < preds + n_preds; pr++) {
+	if ( pr->type == SCAN_ATT ) {
+	    att_nms_len += strlen(pr->nm) + 1;
+	}
+    }
+    if ( !(att_nms = MALLOC(att_nms_len + 1)) ) {
+	_exit(EXIT_FAILURE);
+    }
+    for (l = 0, pr = preds; pr < preds + n_preds; pr++) {
+	if ( pr->type == SCAN_ATT ) {
+	    strcpy(att_nms + l, pr->nm);
+	    l += strlen(pr->nm) + 1;
+	    n_att_nms++;
+	}
+    }
+    path[SCAN_PATH] = '\0';
+    while ( (nr = read(task_fd, path, SCAN_PATH)) != 0 ) {
+	if ( nr == -1 && errno == EINTR ) {
+	    continue;
+	}
+	if ( nr != SCAN_PATH ) {
+	    _exit(EXIT_FAILURE);
+	}
+	if ( CDF_Hdr_Read(path, &hdr) ) {
+	    match = catalog_rec_cdf(&hdr, path, NULL, att_nms, n_att_nms, &b)
+		&& scan_cat_match((const struct Cat_Rec_Hdr *)b.b,
+			preds, n_preds);
+	    CDF_Hdr_Free(&hdr);
+	} else if ( nc_magic(path) ) {
+	    status = nc_open(path, NC_NOWRITE, &nc_id);
+	    if ( status != NC_NOERR ) {
+		fprintf(stderr, "Worker could not open %s.\n%s\n",
+			path, nc_strerror(status));
+		continue;
+	    }
+	    match = scan_match(nc_id, preds, n_preds);
+	    nc_close(nc_id);
+	} else {
+	    continue;
+	}
+	if ( match ) {
+	    l = strlen(path);
+	    path[l] = '\n';
+	    if ( write(res_fd, path, l + 1) != (ssize_t)(l + 1) ) {
+		_exit(EXIT_FAILURE);
+	    }
+	}
+    }
+    FREE(b.b);
+    FREE(att_nms);
+    _exit(EXIT_SUCCESS);
+}
+
+/*
+   Return true if the file at path starts with the signature of a classic
+   netCDF file, or has an HDF5 signature where HDF5 looks for one.
+ */
+static int nc_magic(const char *path)
+{
+    int fd;
+    unsigned char buf[8];
+    off_t off;
+    int ok = 0;
+
+    if ( (fd = open(path, O_RDONLY)) == -1 ) {
+	return 0;
+    }
+    if ( read(fd, buf, 4) == 4 && memcmp(buf, "CDF", 3) == 0
+	    && (buf[3] == 1 || buf[3] == 2 || buf[3] == 5) ) {
+	ok = 1;
+    }
+    for (off = 0; !ok && off <= 2048; off = (off == 0) ? 512 : 2 * off) {
+	if ( pread(fd, buf, 8, off) == 8
+		&& memcmp(buf, "\211HDF\r\n\032\n", 8) == 0 ) {
+	    ok = 1;
+	}
+    }
+    close(fd);
+    return ok;
+}
+
+/*
+   Return true if netCDF file nc_id meets all n_preds conditions in preds.
+ */
+static int scan_match(int nc_id, const struct Scan_Pred *preds, int n_preds)
+{
+    const struct Scan_Pred *pr;
+    int id;				/* Dimension or variable identifier */
+    nc_type xtype;			/* Attribute type */
+    size_t len;				/* Dimension or attribute size */
+    char *txt;				/* Text attribute value */
+    double *x;				/* Numeric attribute values */
+    size_t k;
+    int match;
+
+    for (pr = preds; pr < preds + n_preds; pr++) {
+	switch (pr->type) {
+	    case SCAN_VAR:
+		if ( nc_inq_varid(nc_id, pr->nm, &id) != NC_NOERR ) {
+		    return 0;
+		}
+		break;
+	    case SCAN_DIM:
+		if ( nc_inq_dimid(nc_id, pr->nm, &id) != NC_NOERR
+			|| (pr->val && (nc_inq_dimlen(nc_id, id, &len)
+				!= NC_NOERR || len != pr->len)) ) {
+		    return 0;
+		}
+		break;
+	    case SCAN_ATT:
+		id = NC_GLOBAL;
+		if ( (pr->var_nm && nc_inq_varid(nc_id, pr->var_nm, &id)
+			    != NC_NOERR)
+			|| nc_inq_att(nc_id, id, pr->nm, &xtype, &len)
+			!= NC_NOERR ) {
+		    return 0;
+		}
+		if ( !pr->val ) {
+		    break;
+		}
+		match = 0;
+		if ( xtype == NC_CHAR ) {
+		    if ( len == strlen(pr->val) && (txt = MALLOC(len + 1)) ) {
+			match = nc_get_att_text(nc_id, id, pr->nm, txt)
+			    == NC_NOERR && memcmp(txt, pr->val, len) == 0;
+			FREE(txt);
+		    }
+		} else if ( pr->is_num
+			&& (x = CALLOC(len + 1, sizeof(double))) ) {
+		    if ( nc_get_att_double(nc_id, id, pr->nm, x) == NC_NOERR ) {
+			for (k = 0; k < len && !match; k++) {
+			    match = x[k] == pr->x;
+			}
+		    }
+		    FREE(x);
+		}
+		if ( !match ) {
+		    return 0;
+		}
+		break;
+	}
+    }
+    return 1;
+}
+
+/*
+   Return true if path is root, or is in the directory tree at root, for
+   one of the n_roots paths in roots.
+ */
+static int path_under(const char *path, char **roots, int n_roots)
+{
+    size_t l;
+    int i;
+
+    for (i = 0; i < n_roots; i++) {
+	l = strlen(roots[i]);
+	if ( strncmp(path, roots[i], l) == 0 && (path[l] == '\0'
+		    || path[l] == '/' || (l > 0 && roots[i][l - 1] == '/')) ) {
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+/*
+   Return true if nm is one of the n_att_nms nul terminated attribute names
+   at att_nms.
+ */
+static int att_listed(const char *nm, const char *att_nms, uint32_t n_att_nms)
+{
+    for ( ; n_att_nms > 0; n_att_nms--, att_nms += strlen(att_nms) + 1) {
+	if ( strcmp(nm, att_nms) == 0 ) {
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+/*
+   nnetcdf catalog [--jobs=n] [--name=pattern] [--att=name ...] catalog
+	   path ...
+
+   Update catalog file catalog with the dimensions, variables, and
+   attributes named with --att, global or of any variable, of the netCDF
+   files in the directory trees at path .... Only files whose inode, size,
+   or modification time differ from the catalog, or that are new, are
+   opened, by worker processes as in scan. Entries for files that have
+   disappeared from path ... are removed. --name limits the update to files
+   whose names match a shell pattern. Without --att, the catalog keeps the
+   attributes it already has. Changing them reads every file again. Use
+   scan --catalog to search the catalog.
+ */
+static int catalog_cb(int argc, char *argv[])
+{
+    char *argv0, *argv1;		/* argv[0], argv[1] */
+    char *val;				/* Option value */
+    int a;				/* Index in argv */
+    long n_jobs = 0;			/* Number of worker processes */
+    char *att_nms = NULL;		/* Attribute names, nul separated */
+    uint32_t n_att_nms = 0;		/* Number of names in att_nms */
+    uint32_t att_nms_len = 0;		/* Bytes in att_nms */
+    char *cat_nm;			/* Path to catalog file */
+    struct Cat cat;			/* Catalog being updated */
+    int have_cat = 0;			/* If true, cat is open */
+    char **roots = NULL;		/* Absolute paths of trees to walk */
+    int n_roots = 0;			/* Number of roots */
+    pid_t *pids = NULL;			/* Worker process identifiers */
+    FILE **recs = NULL;			/* Records from each worker */
+    int n_pids = 0;			/* Number of workers started */
+    int task_fd[2] = {-1, -1};		/* Paths to workers */
+    int wstatus;			/* Exit status of worker */
+    struct sigaction act, old_pipe;	/* SIGPIPE disposition */
+    int ign_pipe = 0;			/* If true, restore old_pipe */
+    size_t n_read;			/* Number of files read */
+    size_t n_gone;			/* Number of files removed */
+    size_t n_ents;
+    struct Cat_Ent *ent;
+    char *p;
+    size_t i;
+    int ok = 0;
+
+    argv0 = argv[0];
+    argv1 = argv[1];
+    memset(&scan_walk, 0, sizeof(struct Scan_Walk));
+    scan_walk.argv0 = argv0;
+    scan_walk.argv1 = argv1;
+    scan_walk.ok = 1;
+    for (a = 2; a < argc && strncmp(argv[a], "--", 2) == 0; a++) {
+	if ( (val = opt_val("--jobs", &a, argc, argv)) ) {
+	    if ( sscanf(val, "%ld", &n_jobs) != 1 || n_jobs < 1 ) {
+		fprintf(stderr, "%s %s: expected positive integer for number "
+			"of jobs, got %s\n", argv0, argv1, val);
+		goto end;
+	    }
+	} else if ( (val = opt_val("--name", &a, argc, argv)) ) {
+	    scan_walk.pat = val;
+	} else if ( (val = opt_val("--att", &a, argc, argv)) ) {
+	    if ( strlen(val) == 0 || strlen(val) > NC_MAX_NAME ) {
+		fprintf(stderr, "%s %s: bad attribute name %s\n",
+			argv0, argv1, val);
+		goto end;
+	    }
+	    if ( att_listed(val, att_nms, n_att_nms) ) {
+		continue;
+	    }
+	    if ( !(p = REALLOC(att_nms, att_nms_len + strlen(val) + 1)) ) {
+		fprintf(stderr, "%s %s: could not allocate attribute names.\n",
+			argv0, argv1);
+		goto end;
+	    }
+	    att_nms = p;
+	    strcpy(att_nms + att_nms_len, val);
+	    att_nms_len += strlen(val) + 1;
+	    n_att_nms++;
+	} else {
+	    fprintf(stderr, "%s %s: unknown option or missing value %s\n",
+		    argv0, argv1, argv[a]);
+	    goto end;
+	}
+    }
+    if ( argc - a < 2 ) {
+	fprintf(stderr, "Usage: %s %s [--jobs=n] [--name=pattern] "
+		"[--att=name ...] catalog path ...\n", argv0, argv1);
+	goto end;
+    }
+    cat_nm = argv[a++];
+
+    /* Catalog paths are absolute, so they do not depend on where we are */
+    if ( !(roots = CALLOC(argc - a, sizeof(char *))) ) {
+	fprintf(stderr, "%s %s: could not allocate paths.\n", argv0, argv1);
+	goto end;
+    }
+    for ( ; a < argc; a++) {
+	if ( !(roots[n_roots] = realpath(argv[a], NULL)) ) {
+	    fprintf(stderr, "%s %s: could not find %s.\n%s\n",
+		    argv0, argv1, argv[a], strerror(errno));
+	    goto end;
+	}
+	n_roots++;
+    }
+    if ( !Cat_Open(&cat, cat_nm, att_nms, n_att_nms, att_nms_len) ) {
+	fprintf(stderr, "%s %s: could not open catalog.\n", argv0, argv1);
+	goto end;
+    }
+    have_cat = 1;
+
+    if ( n_jobs == 0 ) {
+	if ( (n_jobs = sysconf(_SC_NPROCESSORS_ONLN)) < 1 ) {
+	    n_jobs = 1;
+	}
+	n_jobs *= SCAN_JOBS_PER_CPU;
+    }
+    if ( !(pids = CALLOC(n_jobs, sizeof(pid_t)))
+	    || !(recs = CALLOC(n_jobs, sizeof(FILE *))) ) {
+	fprintf(stderr, "%s %s: could not allocate arrays for %ld "
+		"workers.\n", argv0, argv1, n_jobs);
+	goto end;
+    }
+
+    /*
+       Each worker appends records to its own temporary file, so the
+       catalog is only written after the walk, by this process.
+     */
+
+    for (i = 0; i < (size_t)n_jobs; i++) {
+	if ( !(recs[i] = tmpfile()) ) {
+	    fprintf(stderr, "%s %s: could not create temporary file.\n",
+		    argv0, argv1);
+	    perror(NULL);
+	    goto end;
+	}
+    }
+    if ( pipe(task_fd) == -1 ) {
+	fprintf(stderr, "%s %s: could not create pipe for workers.\n",
+		argv0, argv1);
+	perror(NULL);
+	goto end;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    for (n_pids = 0; n_pids < n_jobs; n_pids++) {
+	switch (pids[n_pids] = fork()) {
+	    case -1:
+		fprintf(stderr, "%s %s: could not create worker process.\n",
+			argv0, argv1);
+		perror(NULL);
+		goto end;
+	    case 0:
+		close(task_fd[1]);
+		catalog_worker(cat.att_nms, cat.n_att_nms, task_fd[0],
+			fileno(recs[n_pids]));
+		_exit(EXIT_FAILURE);
+	}
+    }
+    close(task_fd[0]);
+    task_fd[0] = -1;
+    memset(&act, 0, sizeof(act));
+    sigemptyset(&act.sa_mask);
+    act.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &act, &old_pipe);
+    ign_pipe = 1;
+    if ( fcntl(task_fd[1], F_SETFL, O_NONBLOCK) == -1 ) {
+	fprintf(stderr, "%s %s: could not set up task pipe.\n",
+		argv0, argv1);
+	perror(NULL);
+	goto end;
+    }
+    scan_walk.task_fd = task_fd[1];
+    scan_walk.res_fd = -1;
+    scan_walk.cat = &cat;
+    for (i = 0; i < (size_t)n_roots && scan_walk.ok != -1; i++) {
+	if ( nftw(roots[i], scan_visit, SCAN_FDS, FTW_PHYS) == -1
+		&& scan_walk.ok != -1 ) {
+	    fprintf(stderr, "%s %s: could not walk %s.\n",
+		    argv0, argv1, roots[i]);
+	    perror(NULL);
+	    scan_walk.ok = 0;
+	}
+    }
+    close(task_fd[1]);
+    task_fd[1] = -1;
+    for ( ; n_pids > 0; n_pids--) {
+	if ( waitpid(pids[n_pids - 1], &wstatus, 0) == -1
+		|| !WIFEXITED(wstatus)
+		|| WEXITSTATUS(wstatus) != EXIT_SUCCESS ) {
+	    fprintf(stderr, "%s %s: worker failed. Catalog not updated.\n",
+		    argv0, argv1);
+	    scan_walk.ok = -1;
+	}
+    }
+    if ( scan_walk.ok == -1 ) {
+	goto end;
+    }
+
+    /*
+       Files that changed, or were not found, lose their entries. If the
+       walk missed part of a tree, keep entries that might still be good.
+     */
+
+    if ( scan_walk.ok == 1 ) {
+	for (n_ents = cat.n_ents, i = 0; i < n_ents; i++) {
+	    ent = cat.ents[i];
+	    if ( ent->live && !ent->seen
+		    && path_under(ent->path, roots, n_roots)
+		    && (!scan_walk.pat || fnmatch(scan_walk.pat,
+			    strrchr(ent->path, '/') + 1, 0) == 0)
+		    && !Cat_Kill(&cat, ent) ) {
+		goto end;
+	    }
+	}
+    }
+    n_ents = cat.n_ents;
+    for (i = 0; i < (size_t)n_jobs; i++) {
+	if ( !Cat_Append_Fd(&cat, fileno(recs[i])) ) {
+	    goto end;
+	}
+    }
+    n_read = cat.n_ents - n_ents;
+    for (n_gone = 0, i = 0; i < n_ents; i++) {
+	ent = cat.ents[i];
+	if ( !ent->live && !Cat_Find(&cat, ent->path) ) {
+	    n_gone++;
+	}
+    }
+    if ( !Cat_Finish(&cat) ) {
+	goto end;
+    }
+    printf("%s %u files, %zu read, %zu removed\n", cat_nm,
+	    cat.paths.n_entries, n_read, n_gone);
+    ok = scan_walk.ok == 1;
+
+end:
+    for (i = 0; i < (size_t)n_pids; i++) {
+	kill(pids[i], SIGTERM);
+    }
+    for (i = 0; i < (size_t)n_pids; i++) {
+	waitpid(pids[i], NULL, 0);
+    }
+    for (i = 0; i < 2; i++) {
+	if ( task_fd[i] != -1 ) {
+	    close(task_fd[i]);
+	}
+    }
+    if ( ign_pipe ) {
+	sigaction(SIGPIPE, &old_pipe, NULL);
+    }
+    for (i = 0; recs && i < (size_t)n_jobs; i++) {
+	if ( recs[i] ) {
+	    fclose(recs[i]);
+	}
+    }
+    if ( have_cat ) {
+	Cat_Close(&cat);
+    }
+
+    /* realpath allocates with malloc */
+    for (i = 0; i < (size_t)n_roots; i++) {
+	free(roots[i]);
+    }
+    FREE(roots);
+    FREE(recs);
+    FREE(pids);
+    FREE(att_nms);
+    return ok;
+}
+
+/*
+   Worker process for catalog. Read paths of SCAN_PATH bytes from task_fd,
+   and append a catalog record for each netCDF file to out_fd. Records keep
+   the n_att_nms attributes named in att_nms. Exit when task_fd is closed.
+ */
+static void catalog_worker(const char *att_nms, uint32_t n_att_nms,
+	int task_fd, int out_fd)
+{
+    char path[SCAN_PATH + 1];		/* Path from task pipe */
+    struct stat sb;			/* Status of file at path */
+    int nc_id;				/* NetCDF file identifier */
+    int status;				/* Return code from NetCDF function
+					   call */
+    struct CDF_Hdr hdr;			/* Header of classic file */
+    struct Cat_Buf b = {NULL, 0, 0};	/* Record */
+    int ok;
+    ssize_t nr;
+
+    path[SCAN_PATH] = '\0';
+    while ( (nr = read(task_fd, path, SCAN_PATH)) != 0 ) {
+	if ( nr == -1 && errno == EINTR ) {
+	    continue;
+	}
+	if ( nr != SCAN_PATH ) {
+	    _exit(EXIT_FAILURE);
+	}
+
+	/*
+	   Get status before reading, so a file that changes while it is
+	   read will differ from its record on the next update.
+	 */
+
+	if ( stat(path, &sb) == -1 ) {
+	    continue;
+	}
+	if ( CDF_Hdr_Read(path, &hdr) ) {
+	    ok = catalog_rec_cdf(&hdr, path, &sb, att_nms, n_att_nms, &b);
+	    CDF_Hdr_Free(&hdr);
+	} else if ( nc_magic(path) ) {
+	    status = nc_open(path, NC_NOWRITE, &nc_id);
+	    if ( status != NC_NOERR ) {
+		fprintf(stderr, "Worker could not open %s.\n%s\n",
+			path, nc_strerror(status));
+		continue;
+	    }
+	    ok = catalog_rec(nc_id, path, &sb, att_nms, n_att_nms, &b);
+	    nc_close(nc_id);
+	} else {
+	    continue;
+	}
+	if ( !ok ) {
+	    fprintf(stderr, "Worker could not read header of %s.\n", path);
+	    continue;
+	}
+	if ( write(out_fd, b.b, b.len) != (ssize_t)b.len ) {
+	    _exit(EXIT_FAILURE);
+	}
+    }
+    FREE(b.b);
+    _exit(EXIT_SUCCESS);
+}
+
+/*
+   Make a catalog record in b for netCDF file nc_id, at path with status
+   sb, keeping the n_att_nms attributes named in att_nms. Attributes of
+   types a catalog cannot store are left out. Return 1 on success, 0 on
+   failure.
+ */
+static int catalog_rec(int nc_id, const char *path, const struct stat *sb,
+	const char *att_nms, uint32_t n_att_nms, struct Cat_Buf *b)
+{
+    char name[NC_MAX_NAME + 1];		/* Dimension, variable, attribute */
+    int num_dims, num_vars, num_atts;	/* Numbers of items in file */
+    int num_unlim;			/* Number of unlimited dimensions */
+    int unlim_ids[NC_MAX_DIMS];		/* Unlimited dimensions */
+    int dim_ids[NC_MAX_VAR_DIMS];	/* Dimensions of a variable */
+    int ndims;				/* Number of dimensions of variable */
+    nc_type xtype;			/* Variable or attribute type */
+    size_t len;				/* Dimension or attribute length */
+    size_t sz;				/* Size of attribute value */
+    void *vals = NULL;			/* Attribute values */
+    int d, v, i, k;
+
+    if ( nc_inq(nc_id, &num_dims, &num_vars, NULL, NULL) != NC_NOERR
+	    || nc_inq_unlimdims(nc_id, &num_unlim, unlim_ids) != NC_NOERR
+	    || !Cat_Rec_Init(b, path, sb->st_dev, sb->st_ino, sb->st_size,
+		mtime_ns(sb)) ) {
+	return 0;
+    }
+    for (d = 0; d < num_dims; d++) {
+	if ( nc_inq_dim(nc_id, d, name, &len) != NC_NOERR ) {
+	    return 0;
+	}
+	for (k = 0; k < num_unlim && unlim_ids[k] != d; k++) {
+	}
+	if ( !Cat_Rec_Dim(b, name, len, k < num_unlim) ) {
+	    return 0;
+	}
+    }
+    for (v = 0; v < num_vars; v++) {
+	if ( nc_inq_var(nc_id, v, name, &xtype, &ndims, dim_ids, NULL)
+		!= NC_NOERR || !Cat_Rec_Var(b, name, xtype, ndims, dim_ids) ) {
+	    return 0;
+	}
+    }
+
+    /* Attributes come after all variables in a record */
+    for (v = (n_att_nms > 0) ? NC_GLOBAL : num_vars; v < num_vars; v++) {
+	if ( (v == NC_GLOBAL ? nc_inq_natts(nc_id, &num_atts)
+		    : nc_inq_varnatts(nc_id, v, &num_atts)) != NC_NOERR ) {
+	    return 0;
+	}
+	for (i = 0; i < num_atts; i++) {
+	    if ( nc_inq_attname(nc_id, v, i, name) != NC_NOERR
+		    || nc_inq_att(nc_id, v, name, &xtype, &len) != NC_NOERR ) {
+		return 0;
+	    }
+	    if ( !att_listed(name, att_nms, n_att_nms)
+		    || (sz = Cat_Type_Size(xtype)) == 0 ) {
+		continue;
+	    }
+	    if ( !(vals = MALLOC(len * sz + 1))
+		    || nc_get_att(nc_id, v, name, vals) != NC_NOERR
+		    || !Cat_Rec_Att(b, v, name, xtype, len, vals, len * sz) ) {
+		FREE(vals);
+		return 0;
+	    }
+	    FREE(vals);
+	}
+    }
+    return Cat_Rec_End(b);
+}
+
+/*
+   Make a catalog record in b for the classic file at path with header hdr
+   and status sb, keeping the n_att_nms attributes named in att_nms. sb may
+   be NULL for a record that is only for scan_cat_match. Return 1 on
+   success, 0 if memory runs out.
+ */
+static int catalog_rec_cdf(const struct CDF_Hdr *hdr, const char *path,
+	const struct stat *sb, const char *att_nms, uint32_t n_att_nms,
+	struct Cat_Buf *b)
+{
+    const struct CDF_Dim *dim;
+    const struct CDF_Var *var;
+    const struct CDF_Att *atts, *att;
+    int n_atts;
+    int d, v;
+
+    if ( !Cat_Rec_Init(b, path, sb ? sb->st_dev : 0, sb ? sb->st_ino : 0,
+		sb ? sb->st_size : 0, sb ? mtime_ns(sb) : 0) ) {
+	return 0;
+    }
+    for (dim = hdr->dims; dim < hdr->dims + hdr->n_dims; dim++) {
+	if ( !Cat_Rec_Dim(b, dim->name, dim->len, dim->unlim) ) {
+	    return 0;
+	}
+    }
+    for (var = hdr->vars; var < hdr->vars + hdr->n_vars; var++) {
+	if ( !Cat_Rec_Var(b, var->name, var->xtype, var->ndims,
+		    var->dim_ids) ) {
+	    return 0;
+	}
+    }
+    for (v = (n_att_nms > 0) ? NC_GLOBAL : hdr->n_vars; v < hdr->n_vars;
+	    v++) {
+	atts = (v == NC_GLOBAL) ? hdr->atts : hdr->vars[v].atts;
+	n_atts = (v == NC_GLOBAL) ? hdr->n_atts : hdr->vars[v].n_atts;
+	for (d = 0; d < n_atts; d++) {
+	    att = atts + d;
+	    if ( att_listed(att->name, att_nms, n_att_nms)
+		    && !Cat_Rec_Att(b, v, att->name, att->xtype, att->n,
+			att->vals, att->n * Cat_Type_Size(att->xtype)) ) {
+		return 0;
+	    }
+	}
+    }
+    return Cat_Rec_End(b);
+}
+
+/*
+   Return the modification time in sb in nanoseconds, to the nanosecond
+   where the system provides it, so that catalog updates notice files
+   rewritten within a second.
+ */
+static int64_t mtime_ns(const struct stat *sb)
+{
+#if _POSIX_VERSION >= 200809L
+    return (int64_t)sb->st_mtim.tv_sec * 1000000000 + sb->st_mtim.tv_nsec;
+#else
+    return (int64_t)sb->st_mtime * 1000000000;
+#endif
+}
+
+/*
+   Print the paths in catalog file cat_nm of netCDF files that meet all
+   n_preds conditions in preds, are in the trees at the n_paths paths in
+   paths, or anywhere if n_paths is 0, and have names matching pat, if pat
+   is not NULL. Return 1 on success. On failure, print a message to stderr
+   and return 0.
+ */
+static int scan_cat(char *argv0, char *argv1, const char *cat_nm,
+	const struct Scan_Pred *preds, int n_preds, const char *pat,
+	char **paths, int n_paths)
+{
+    struct Cat_Map map;			/* Catalog */
+    const char *att_nms;		/* Attributes the catalog keeps */
+    const struct Scan_Pred *pr;
+    const uint32_t *post = NULL;	/* Records with a variable */
+    uint64_t n;				/* Number of candidate records */
+    uint64_t k, r;
+    const struct Cat_Rec_Hdr *rh;
+    const char *path;
+    char **roots = NULL;		/* Absolute paths */
+    int n_roots = 0;			/* Number of roots */
+    int i;
+    int ok = 0;
+
+    if ( !Cat_Map(&map, cat_nm) ) {
+	fprintf(stderr, "%s %s: could not read catalog.\n", argv0, argv1);
+	return 0;
+    }
+    att_nms = (const char *)(map.hdr + 1);
+    for (pr = preds; pr < preds + n_preds; pr++) {
+	if ( pr->type == SCAN_ATT
+		&& !att_listed(pr->nm, att_nms, map.hdr->n_att_nms) ) {
+	    fprintf(stderr, "%s %s: catalog %s does not keep attribute %s. "
+		    "Update it with --att=%s.\n", argv0, argv1, cat_nm,
+		    pr->nm, pr->nm);
+	    goto end;
+	}
+    }
+    if ( n_paths > 0 && !(roots = CALLOC(n_paths, sizeof(char *))) ) {
+	fprintf(stderr, "%s %s: could not allocate paths.\n", argv0, argv1);
+	goto end;
+    }
+    for ( ; n_roots < n_paths; n_roots++) {
+	if ( !(roots[n_roots] = realpath(paths[n_roots], NULL)) ) {
+	    fprintf(stderr, "%s %s: could not find %s.\n%s\n",
+		    argv0, argv1, paths[n_roots], strerror(errno));
+	    goto end;
+	}
+    }
+
+    /* A variable condition limits the search to its posting list */
+    n = map.idx->n_recs;
+    for (pr = preds; pr < preds + n_preds; pr++) {
+	if ( pr->type == SCAN_VAR ) {
+	    Cat_Map_Post(&map, pr->nm, &post, &n);
+	    break;
+	}
+    }
+    for (k = 0; k < n; k++) {
+	r = post ? post[k] : k;
+	rh = Cat_Map_Rec(&map, r);
+	path = (const char *)(rh + 1);
+	if ( rh->live && (n_roots == 0 || path_under(path, roots, n_roots))
+		&& (!pat || fnmatch(pat, strrchr(path, '/') + 1, 0) == 0)
+		&& scan_cat_match(rh, preds, n_preds) ) {
+	    printf("%s\n", path);
+	}
+    }
+    ok = 1;
+
+end:
+    for (i = 0; i < n_roots; i++) {
+	free(roots[i]);
+    }
+    FREE(roots);
+    Cat_Unmap(&map);
+    return ok;
+}
+
+/*
+   Return true if the file with catalog record rh meets all n_preds
+   conditions in preds.
+ */
+static int scan_cat_match(const struct Cat_Rec_Hdr *rh,
+	const struct Scan_Pred *preds, int n_preds)
+{
+    const struct Scan_Pred *pr;
+    const unsigned char *p;		/* Items in record */
+    const unsigned char *dim_ids;	/* Dimensions of a variable */
+    const unsigned char *vals;		/* Attribute values */
+    const char *nm;			/* Item name */
+    uint64_t len;			/* Dimension length */
+    uint32_t ndims, n, k, j;
+    int unlim, xtype, id, v, match;
+
+    for (pr = preds; pr < preds + n_preds; pr++) {
+	match = 0;
+	p = Cat_Rec_Items(rh);
+	for (k = 0; k < rh->n_dims; k++) {
+	    p = Cat_Dim_Next(p, &nm, &len, &unlim);
+	    if ( pr->type == SCAN_DIM && strcmp(nm, pr->nm) == 0 ) {
+		match = !pr->val || len == pr->len;
+	    }
+	}
+	for (id = NC_GLOBAL, k = 0; k < rh->n_vars; k++) {
+	    p = Cat_Var_Next(p, &nm, &xtype, &ndims, &dim_ids);
+	    if ( pr->type == SCAN_VAR && strcmp(nm, pr->nm) == 0 ) {
+		match = 1;
+	    }
+	    if ( pr->type == SCAN_ATT && pr->var_nm
+		    && strcmp(nm, pr->var_nm) == 0 ) {
+		id = k;
+	    }
+	}
+	if ( pr->type == SCAN_ATT && (!pr->var_nm || id != NC_GLOBAL) ) {
+	    for (k = 0; k < rh->n_atts && !match; k++) {
+		p = Cat_Att_Next(p, &v, &nm, &xtype, &n, &vals);
+		if ( v != id || strcmp(nm, pr->nm) != 0 ) {
+		    continue;
+		}
+		if ( !pr->val ) {
+		    match = 1;
+		} else if ( xtype == NC_CHAR ) {
+		    match = n == strlen(pr->val)
+			&& memcmp(vals, pr->val, n) == 0;
+		} else if ( pr->is_num ) {
+		    for (j = 0; j < n && !match; j++) {
+			match = cat_att_val(xtype, vals, j) == pr->x;
+		    }
+		}
+		break;
+	    }
+	}
+	if ( !match ) {
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+/*
+   Return value i of unaligned attribute values vals of type xtype from a
+   catalog record, as a double.
+ */
+static double cat_att_val(int xtype, const unsigned char *vals, uint32_t i)
+{
+    signed char b;
+    unsigned char ub;
+    short s;
+    unsigned short us;
+    int n;
+    unsigned un;
+    float f;
+    double x;
+    long long ll;
+    unsigned long long ull;
+
+    vals += i * Cat_Type_Size(xtype);
+    switch (xtype) {
+	case NC_BYTE:   memcpy(&b, vals, 1);   return b;
+	case NC_UBYTE:  memcpy(&ub, vals, 1);  return ub;
+	case NC_SHORT:  memcpy(&s, vals, 2);   return s;
+	case NC_USHORT: memcpy(&us, vals, 2);  return us;
+	case NC_INT:    memcpy(&n, vals, 4);   return n;
+	case NC_UINT:   memcpy(&un, vals, 4);  return un;
+	case NC_FLOAT:  memcpy(&f, vals, 4);   return f;
+	case NC_DOUBLE: memcpy(&x, vals, 8);   return x;
+	case NC_INT64:  memcpy(&ll, vals, 8);  return ll;
+	case NC_UINT64: memcpy(&ull, vals, 8); return ull;
+	default:        return NAN;
+    }
+}
+
+/*
+   Compute a chunk shape for a variable with ndims dimensions with lengths
+   len, for access pattern pat, with about max_elem values per chunk. Store
+   the chunk lengths in chunk. Return 1 on success, 0 if pat is unknown.
+ */
+static int chunk_shape(char *pat, int ndims, const size_t *len,
+	size_t max_elem, size_t *chunk)
+{
+    size_t budget;			/* Values left for inner dimensions */
+    size_t l;				/* Length of a dimension, at least 1 */
+    double per;				/* Length for each remaining dimension */
+    int d, d0;
+
+    budget = (max_elem > 0) ? max_elem : 1;
+    if ( strcmp(pat, "record") == 0 ) {
+	/* One record, filled from the innermost dimension out */
+	chunk[0] = 1;
+	for (d = ndims - 1; d > 0; d--) {
+	    l = (len[d] > 0) ? len[d] : 1;
+	    chunk[d] = (l < budget) ? l : budget;
+	    budget /= chunk[d];
+	}
+	return 1;
+    } else if ( strcmp(pat, "series") == 0 ) {
+	/* As much of the first dimension as possible */
+	l = (len[0] > 0) ? len[0] : 1;
+	chunk[0] = (l < budget) ? l : budget;
+	budget /= chunk[0];
+	d0 = 1;
+    } else if ( strcmp(pat, "balanced") == 0 ) {
+	d0 = 0;
+    } else {
+	return 0;
+    }
+
+    /*
+       Share the budget about equally among dimensions d0 and beyond. Short
+       dimensions leave more for the others.
+     */
+
+    for (d = ndims - 1; d >= d0; d--) {
+	l = (len[d] > 0) ? len[d] : 1;
+	per = floor(pow((double)budget, 1.0 / (d - d0 + 1)) + 1.0e-9);
+	chunk[d] = (per < 1.0) ? 1 : (per > l) ? l : (size_t)per;
+	budget /= chunk[d];
+    }
+    return 1;
+}
+
+/*
+   Compute block shape blk for copying a variable with ndims dimensions
+   with lengths len and chunk lengths chunk. Blocks have a whole number of
+   chunks along each dimension, except at the ends of dimensions, so each
+   chunk is written once. Blocks have at most max_elem values, unless one
+   chunk is bigger.
+ */
+static void chunk_blk(int ndims, const size_t *len, const size_t *chunk,
+	size_t max_elem, size_t *blk)
+{
+    size_t n;				/* Number of values in block */
+    size_t k;				/* Number of chunks along dimension */
+    int d;
+
+    for (n = 1, d = 0; d < ndims; d++) {
+	blk[d] = (chunk[d] < len[d]) ? chunk[d] : len[d];
+	n *= blk[d];
+    }
+    for (d = ndims - 1; d >= 0; d--) {
+	n /= blk[d];
+	k = max_elem / (n * chunk[d]);
+	if ( k * chunk[d] >= len[d] ) {
+	    blk[d] = len[d];
+	    n *= blk[d];
+	} else {
+	    if ( k > 1 ) {
+		blk[d] = k * chunk[d];
+	    }
+	    break;
+	}
+    }
+}
+
+/*
+   Copy variable v, with ndims dimensions of lengths len, from file in_nm to
+   output file out_id, using n_jobs reader processes. If chunked is true,
+   blocks are aligned to chunks of the output variable with lengths chunk.
+   Blocks have about max_elem values. buf must have room for max_elem
+   values of the type of the variable, which are copied in that type.
+   Return 1 on success. On failure, print a message to stderr and return
+   0.
+
+   Readers take turns with blocks, so while this process writes (and
+   compresses) one block, the readers read (and decompress) the following
+   ones.
+ */
+static int copy_var(char *in_nm, int out_id, int v, int ndims, int n_jobs,
+	const size_t *len, const size_t *chunk, size_t max_elem, int chunked,
+	void *buf)
+{
+    char var_nm[NC_MAX_NAME + 1];	/* Variable name */
+    nc_type xtype;			/* Variable type */
+    size_t elem_sz;			/* Size of a value */
+    size_t blk[NC_MAX_VAR_DIMS];	/* Block shape */
+    struct Slab slab;			/* Iterates over blocks */
+    struct Rdr *rdrs = NULL;		/* Reader processes */
+    size_t n_blks;			/* Number of blocks */
+    size_t n, b;
+    int n_rdrs = 0;			/* Number of readers started */
+    int r, d;
+    int status;
+    int ok = 1;
+
+    if ( (status = nc_inq_varname(out_id, v, var_nm)) != NC_NOERR
+	    || (status = nc_inq_vartype(out_id, v, &xtype)) != NC_NOERR
+	    || (status = nc_inq_type(out_id, xtype, NULL, &elem_sz))
+	    != NC_NOERR ) {
+	fprintf(stderr, "Could not get name and type of variable %d.\n%s\n",
+		v, nc_strerror(status));
+	return 0;
+    }
+    if ( chunked ) {
+	chunk_blk(ndims, len, chunk, max_elem, blk);
+    } else {
+	/* Scalar */
+	blk[0] = 1;
+    }
+    if ( !Slab_Init_Blk(&slab, ndims, len, blk) ) {
+	fprintf(stderr, "Could not allocate slab iterator for %s.\n", var_nm);
+	return 0;
+    }
+    for (n_blks = 0; Slab_Next(&slab) > 0; n_blks++) {
+    }
+    Slab_Free(&slab);
+    for (n = 1, d = 0; d < ndims; d++) {
+	n *= blk[d];
+    }
+    if ( n > max_elem ) {
+	fprintf(stderr, "Chunks of %s have more than %zu values. Increase "
+		"memory budget.\n", var_nm, max_elem);
+	return 0;
+    }
+    if ( n_jobs > n_blks ) {
+	n_jobs = n_blks;
+    }
+    if ( !(rdrs = CALLOC(n_jobs, sizeof(struct Rdr))) ) {
+	fprintf(stderr, "Could not allocate %d readers.\n", n_jobs);
+	return 0;
+    }
+    for (n_rdrs = 0; n_rdrs < n_jobs; n_rdrs++) {
+	if ( !Rdr_Start_Blk(rdrs + n_rdrs, in_nm, var_nm, elem_sz, ndims, len,
+		    blk, n_rdrs, n_jobs) ) {
+	    ok = 0;
+	    goto done;
+	}
+    }
+    if ( !Slab_Init_Blk(&slab, ndims, len, blk) ) {
+	fprintf(stderr, "Could not allocate slab iterator for %s.\n", var_nm);
+	ok = 0;
+	goto done;
+    }
+    for (b = 0; (n = Slab_Next(&slab)) > 0; b++) {
+	r = b % n_rdrs;
+	if ( !Rdr_Get(rdrs + r, buf, n) ) {
+	    ok = 0;
+	    break;
+	}
+	status = nc_put_vara(out_id, v, slab.start, slab.count, buf);
+	if ( status != NC_NOERR ) {
+	    fprintf(stderr, "Could not write %s.\n%s\n", var_nm,
+		    nc_strerror(status));
+	    ok = 0;
+	    break;
+	}
+    }
+    Slab_Free(&slab);
+
+done:
+    for (r = 0; r < n_rdrs; r++) {
+	if ( !Rdr_Finish(rdrs + r, !ok) ) {
+	    ok = 0;
+	}
+    }
+    FREE(rdrs);
+    return ok;
+}
+
+/*
+   Parse selection s for a dimension of length len. s is an index, or
+   start:stop:step as for a Python slice, with any part omitted and negative
+   start and stop counted from the end. A negative step selects indeces in
+   decreasing order. Put the first index in *start, the number of indeces
+   selected in *count, and the step in *stride. Set *fixed to 1 if s is a
+   single index, otherwise 0. Return 1 on success, 0 if s is not valid.
+ */
+static int parse_sel(const char *s, size_t len, size_t *start, size_t *count,
+	ptrdiff_t *stride, int *fixed)
+{
+    long v[3];				/* start, stop, step */
+    int have[3] = {0, 0, 0};		/* If true, v[k] was given */
+    const char *p;
+    char *e;
+    long l = (long)len;
+    int k;
+
+    for (p = s, k = 0; k < 3; k++) {
+	if ( *p != ':' && *p != '\0' ) {
+	    v[k] = strtol(p, &e, 10);
+	    if ( e == p ) {
+		return 0;
+	    }
+	    have[k] = 1;
+	    p = e;
+	}
+	if ( *p == '\0' ) {
+	    break;
+	}
+	if ( *p++ != ':' || k == 2 ) {
+	    return 0;
+	}
+    }
+    if ( k == 0 ) {
+	/* Single index */
+	if ( !have[0] ) {
+	    return 0;
+	}
+	if ( v[0] < 0 ) {
+	    v[0] += l;
+	}
+	if ( v[0] < 0 || v[0] >= l ) {
+	    return 0;
+	}
+	*start = v[0];
+	*count = 1;
+	*stride = 1;
+	*fixed = 1;
+	return 1;
+    }
+    if ( !have[2] ) {
+	v[2] = 1;
+    }
+    if ( v[2] == 0 ) {
+	return 0;
+    }
+    if ( v[2] > 0 ) {
+	for (k = 0; k < 2; k++) {
+	    if ( !have[k] ) {
+		v[k] = (k == 0) ? 0 : l;
+	    } else if ( v[k] < 0 ) {
+		v[k] += l;
+	    }
+	    v[k] = (v[k] < 0) ? 0 : (v[k] > l) ? l : v[k];
+	}
+	*start = v[0];
+	*count = (v[1] > v[0]) ? (v[1] - v[0] + v[2] - 1) / v[2] : 0;
+    } else {
+	/* Going down, -1 is before the first index, not the last one */
+	for (k = 0; k < 2; k++) {
+	    if ( !have[k] ) {
+		v[k] = (k == 0) ? l - 1 : -1;
+	    } else if ( v[k] < 0 ) {
+		v[k] += l;
+	    }
+	    v[k] = (v[k] < -1) ? -1 : (v[k] > l - 1) ? l - 1 : v[k];
+	}
+	*start = (v[0] >= 0) ? v[0] : 0;
+	*count = (v[0] > v[1]) ? (v[0] - v[1] - v[2] - 1) / -v[2] : 0;
+    }
+    *stride = v[2];
+    *fixed = 0;
+    return 1;
+}
+
+/*
+   Read values of type xtype from variable var_id in file nc_id into dat,
+   as for nc_get_vars. Return value is as for nc_get_vars.
+ */
+static int get_vars(int nc_id, int var_id, nc_type xtype, const size_t *start,
+	const size_t *count, const ptrdiff_t *stride, void *dat)
+{
+    switch (xtype) {
+	case NC_BYTE:
+	case NC_CHAR:
+	    return nc_get_vars_text(nc_id, var_id, start, count, stride,
+		    (char *)dat);
+	case NC_SHORT:
+	    return nc_get_vars_short(nc_id, var_id, start, count, stride,
+		    (short *)dat);
+	case NC_INT:
+	    return nc_get_vars_int(nc_id, var_id, start, count, stride,
+		    (int *)dat);
+	case NC_FLOAT:
+	    return nc_get_vars_float(nc_id, var_id, start, count, stride,
+		    (float *)dat);
+	case NC_DOUBLE:
+	    return nc_get_vars_double(nc_id, var_id, start, count, stride,
+		    (double *)dat);
+	case NC_UBYTE:
+	    return nc_get_vars_ubyte(nc_id, var_id, start, count, stride,
+		    (unsigned char *)dat);
+	case NC_USHORT:
+	    return nc_get_vars_ushort(nc_id, var_id, start, count, stride,
+		    (unsigned short *)dat);
+	case NC_UINT:
+	    return nc_get_vars_uint(nc_id, var_id, start, count, stride,
+		    (unsigned int *)dat);
+	default:
+	    return NC_EBADTYPE;
+    }
+}
+
+/*
+   Append n values of type xtype from dat to ob as text. The first value is
+   element i of the output. Lines have llen values. Return 1 on success, 0
+   on failure.
+ */
+static int print_vals(struct Obuf *ob, nc_type xtype, const void *dat,
+	size_t n, size_t i, size_t llen)
+{
+    size_t j;
+    int ok = 1;
+
+    for (j = 0; ok && j < n; j++, i++) {
+	switch (xtype) {
+	    case NC_BYTE:
+	    case NC_CHAR:
+		ok = Obuf_LLong(ob, ((char *)dat)[j]);
+		break;
+	    case NC_SHORT:
+		ok = Obuf_LLong(ob, ((short *)dat)[j]);
+		break;
+	    case NC_INT:
+		ok = Obuf_LLong(ob, ((int *)dat)[j]);
+		break;
+	    case NC_FLOAT:
+		ok = Obuf_Float(ob, ((float *)dat)[j]);
+		break;
+	    case NC_DOUBLE:
+		ok = Obuf_Double(ob, ((double *)dat)[j]);
+		break;
+	    case NC_UBYTE:
+		ok = Obuf_LLong(ob, ((unsigned char *)dat)[j]);
+		break;
+	    case NC_USHORT:
+		ok = Obuf_LLong(ob, ((unsigned short *)dat)[j]);
+		break;
+	    case NC_UINT:
+		ok = Obuf_ULLong(ob, ((unsigned int *)dat)[j]);
+		break;
+	}
+	ok = ok && Obuf_Char(ob, ((i + 1) % llen) == 0 ? '\n' : ' ');
+    }
+    return ok;
+}
+
+/*
+   Read the next slab described by data source arg into dat. Put the number
+   of values read at n_p, zero if there are no more, and the index in the
+   output of the first value at i_p. Return 1 on success. On failure, print
+   a message to stderr and return 0.
+ */
+static int data_rd(void *arg, void *dat, size_t *n_p, size_t *i_p)
+{
+    struct Data_Src *src = arg;
+    size_t n;
+    int d;
+    int status;
+
+    if ( (n = Slab_Next(src->slab)) == 0 ) {
+	*n_p = 0;
+	return 1;
+    }
+    for (d = 0; d < src->num_dims; d++) {
+	if ( src->stride[d] > 0 ) {
+	    src->start[d] = src->sel_start[d]
+		+ src->slab->start[d] * src->stride[d];
+	    src->rd_stride[d] = src->stride[d];
+	} else {
+	    /* Start from the last index of the slab, the lowest in the file */
+	    src->start[d] = src->sel_start[d]
+		- (src->slab->start[d] + src->slab->count[d] - 1)
+		* (size_t)-src->stride[d];
+	    src->rd_stride[d] = -src->stride[d];
+	}
+    }
+    if ( (status = get_vars(src->nc_id, src->var_id, src->xtype, src->start,
+		    src->slab->count, src->rd_stride, dat)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: could not read %s.\n%s\n",
+		src->argv0, src->argv1, src->var_nm, nc_strerror(status));
+	return 0;
+    }
+    for (d = 0; d < src->num_dims; d++) {
+	if ( src->stride[d] < 0 ) {
+	    rev_dim(dat, src->elem_sz, src->num_dims, src->slab->count, d);
+	}
+    }
+    *n_p = n;
+    *i_p = src->i;
+    src->i += n;
+    return 1;
+}
+
+/*
+   Reverse the order of values along dimension d of array dat, which has
+   num_dims dimensions of lengths count and values of elem_sz bytes.
+ */
+static void rev_dim(unsigned char *dat, size_t elem_sz, int num_dims,
+	const size_t *count, int d)
+{
+    size_t n_outer, row;		/* Number of blocks outside d, bytes
+					   in each step along d */
+    unsigned char *blk, *p, *q;		/* Block, rows being swapped */
+    unsigned char t;
+    size_t i, j, k;
+    int e;
+
+    for (n_outer = 1, e = 0; e < d; e++) {
+	n_outer *= count[e];
+    }
+    for (row = elem_sz, e = d + 1; e < num_dims; e++) {
+	row *= count[e];
+    }
+    for (i = 0, blk = dat; i < n_outer; i++, blk += count[d] * row) {
+	for (j = 0; j < count[d] / 2; j++) {
+	    p = blk + j * row;
+	    q = blk + (count[d] - 1 - j) * row;
+	    for (k = 0; k < row; k++) {
+		t = p[k];
+		p[k] = q[k];
+		q[k] = t;
+	    }
+	}
+    }
+}
+
+/*
+   Append n values from dat, starting at index i in the output, to ob as
+   text. Only reads arg, so several threads may call this at once.
+ */
+static int data_fmt(void *arg, const void *dat, size_t n, size_t i,
+	struct Obuf *ob)
+{
+    struct Data_Src *src = arg;
+
+    return print_vals(ob, src->xtype, dat, n, i, src->llen);
+}
+
+/*
+   Return the numpy type string for NetCDF type xtype, with byte order of
+   this host, and put the size of one value in *sz. Return NULL if there is
+   no numpy type for xtype.
+ */
+static char *npy_descr(nc_type xtype, size_t *sz)
+{
+    int le = Raw_Little_Endian();
+
+    switch (xtype) {
+	case NC_BYTE:
+	    *sz = 1;
+	    return "|i1";
+	case NC_CHAR:
+	    *sz = 1;
+	    return "|S1";
+	case NC_SHORT:
+	    *sz = 2;
+	    return le ? "<i2" : ">i2";
+	case NC_INT:
+	    *sz = 4;
+	    return le ? "<i4" : ">i4";
+	case NC_FLOAT:
+	    *sz = 4;
+	    return le ? "<f4" : ">f4";
+	case NC_DOUBLE:
+	    *sz = 8;
+	    return le ? "<f8" : ">f8";
+	case NC_UBYTE:
+	    *sz = 1;
+	    return "|u1";
+	case NC_USHORT:
+	    *sz = 2;
+	    return le ? "<u2" : ">u2";
+	case NC_UINT:
+	    *sz = 4;
+	    return le ? "<u4" : ">u4";
+	default:
+	    *sz = 0;
+	    return NULL;
+    }
+}
+
+/*
+   Print storage layout for variable v, named var_nm, of type xtype with
+   num_dims dimensions identified by dim_ids, in file nc_fl_nm, opened as
+   nc_id, with format fmt. Also print warnings about chunk shapes that make
+   reading one record at a time slow. Return 1 on success. On failure, print
+   a message to stderr and return 0.
+ */
+static int print_storage(char *argv0, char *argv1, char *nc_fl_nm, int nc_id,
+	int fmt, int v, char *var_nm, nc_type xtype, int num_dims,
+	const int *dim_ids)
+{
+    int nc4;				/* If true, file is HDF5 based */
+    size_t len[NC_MAX_VAR_DIMS];	/* Dimension lengths */
+    size_t chunk[NC_MAX_VAR_DIMS];	/* Chunk lengths */
+    int layout = NC_CONTIGUOUS;		/* NC_CONTIGUOUS, NC_CHUNKED, ... */
+    char *layout_nm;			/* Name for layout */
+    int shuffle = 0, deflate = 0, level = 0;
+					/* Compression settings */
+    int endian = NC_ENDIAN_BIG;		/* Byte order in file */
+    char *endian_nm;			/* Name for endian */
+    int no_fill;			/* If true, fill mode is off */
+    size_t type_sz;			/* Size of one value in bytes */
+    size_t raw;				/* Size of variable uncompressed */
+    unsigned long long disk;		/* Size of variable in file */
+    size_t chunk_sz;			/* Size of a chunk in bytes */
+    size_t n_chunks;			/* Number of chunks in one record */
+    size_t cache_sz, cache_n;		/* Chunk cache size, slots */
+    float preempt;			/* Chunk cache preemption */
+    int d;
+    int status;
+
+    nc4 = fmt == NC_FORMAT_NETCDF4 || fmt == NC_FORMAT_NETCDF4_CLASSIC;
+    if ( (status = nc_inq_type(nc_id, xtype, NULL, &type_sz)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: could not get size of type for %s.\n%s\n",
+		argv0, argv1, var_nm, nc_strerror(status));
+	return 0;
+    }
+    for (raw = type_sz, d = 0; d < num_dims; d++) {
+	if ( (status = nc_inq_dimlen(nc_id, dim_ids[d], len + d))
+		!= NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not get length for dimension %d "
+		    "of %s.\n%s\n", argv0, argv1, d, var_nm,
+		    nc_strerror(status));
+	    return 0;
+	}
+	raw *= len[d];
+    }
+    if ( nc4 ) {
+	if ( (status = nc_inq_var_chunking(nc_id, v, &layout, chunk))
+		    != NC_NOERR
+		|| (status = nc_inq_var_deflate(nc_id, v, &shuffle, &deflate,
+			&level)) != NC_NOERR
+		|| (status = nc_inq_var_endian(nc_id, v, &endian))
+		    != NC_NOERR ) {
+	    fprintf(stderr, "%s %s: could not get storage information for "
+		    "%s.\n%s\n", argv0, argv1, var_nm, nc_strerror(status));
+	    return 0;
+	}
+    }
+    if ( (status = nc_inq_var_fill(nc_id, v, &no_fill, NULL)) != NC_NOERR ) {
+	fprintf(stderr, "%s %s: could not get fill mode for %s.\n%s\n",
+		argv0, argv1, var_nm, nc_strerror(status));
+	return 0;
+    }
+    switch (layout) {
+	case NC_CONTIGUOUS: layout_nm = "contiguous"; break;
+	case NC_CHUNKED:    layout_nm = "chunked";    break;
+#ifdef NC_COMPACT
+	case NC_COMPACT:    layout_nm = "compact";    break;
+#endif
+	default:            layout_nm = "unknown";    break;
+    }
+    switch (endian) {
+	case NC_ENDIAN_LITTLE: endian_nm = "little"; break;
+	case NC_ENDIAN_BIG:    endian_nm = "big";    break;
+	default:               endian_nm = "native"; break;
+    }
+    printf("storage %s %s", var_nm, layout_nm);
+    if ( layout == NC_CHUNKED ) {
+	for (d = 0; d < num_dims; d++) {
+	    printf("%c%zu", (d == 0) ? '=' : ',', chunk[d]);
+	}
+    }
+    printf(" deflate=%d shuffle=%d endian=%s fill=%s raw=%zu",
+	    deflate ? level : 0, shuffle, endian_nm, no_fill ? "off" : "on",
+	    raw);
+
+    /*
+       Classic formats store values uncompressed, so the size in the file
+       is the raw size. Otherwise, the size in the file is only available
+       from HDF5.
+     */
+
+    if ( !nc4 ) {
+	printf(" disk=%zu\n", raw);
+    } else if ( disk_size(nc_fl_nm, var_nm, &disk) ) {
+	printf(" disk=%llu\n", disk);
+    } else {
+	printf(" disk=-\n");
+    }
+    if ( layout != NC_CHUNKED || num_dims == 0 ) {
+	return 1;
+    }
+
+    /*
+       Warn about chunk shapes that are slow for reading one record, i.e.
+       one index of the first dimension, at a time.
+     */
+
+    for (chunk_sz = type_sz, d = 0; d < num_dims; d++) {
+	chunk_sz *= chunk[d];
+    }
+    for (n_chunks = 1, d = 1; d < num_dims; d++) {
+	n_chunks *= (len[d] + chunk[d] - 1) / chunk[d];
+    }
+    if ( num_dims > 1 && chunk[0] >= MAX_REC_AMP ) {
+	printf("warning %s chunks span %zu records, so reading one record "
+		"reads %zu times the values it needs\n",
+		var_nm, chunk[0], chunk[0]);
+    }
+    if ( chunk_sz < SMALL_CHUNK && (num_dims > 1 ? n_chunks : len[0]) > 1 ) {
+	printf("warning %s chunks have only %zu bytes, so reading %s reads "
+		"%zu chunks\n", var_nm, chunk_sz,
+		(num_dims > 1) ? "one record" : "the variable",
+		(num_dims > 1) ? n_chunks : (len[0] + chunk[0] - 1) / chunk[0]);
+    }
+    status = nc_get_var_chunk_cache(nc_id, v, &cache_sz, &cache_n, &preempt);
+    if ( status == NC_NOERR && chunk_sz > cache_sz ) {
+	printf("warning %s chunks have %zu bytes, more than the %zu byte "
+		"chunk cache, so each access %s the chunk again\n",
+		var_nm, chunk_sz, cache_sz,
+		deflate ? "decompresses" : "reads");
+    }
+    return 1;
+}
+
+/*
+   Put the number of bytes variable var_nm occupies in netCDF-4 file
+   nc_fl_nm at disk_p. Return 1 on success, or 0 if the size is not
+   available.
+ */
+static int disk_size(char *nc_fl_nm, char *var_nm, unsigned long long *disk_p)
+{
+#ifdef HAVE_HDF5
+    hid_t h5_id, ds_id;
+
+    H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+    if ( (h5_id = H5Fopen(nc_fl_nm, H5F_ACC_RDONLY, H5P_DEFAULT)) < 0 ) {
+	return 0;
+    }
+    if ( (ds_id = H5Chunk_Dset(h5_id, var_nm)) < 0 ) {
+	H5Fclose(h5_id);
+	return 0;
+    }
+    *disk_p = H5Dget_storage_size(ds_id);
+    H5Dclose(ds_id);
+    H5Fclose(h5_id);
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/*
+   nnetcdf batch [--cache=n] [--delim=s] [file]
+
+   Read subcommands, one per line, from file or standard input, and run
+   them in this process. Each line is a subcommand and its arguments, as
+   they would appear on the command line after the program name, separated
+   by white space. Blank lines and lines starting with # are ignored. Up to
+   n files (default BATCH_FILES) stay open between commands. After the
+   output of each command, print a line with s (default %%) followed by
+   "ok" or "error", so that a client at the other end of a pipe knows where
+   each response ends.
+ */
+static int batch_cb(int argc, char *argv[])
+{
+    char *argv0, *argv1;		/* argv[0], argv[1] */
+    char *in_nm = NULL;			/* Path to command file */
+    FILE *in = stdin;			/* Command stream */
+    char *delim = "%%";			/* Start of line after each response */
+    long max_files = BATCH_FILES;	/* Maximum number of open files */
+    struct NC_Cache cache;		/* Open files */
+    char *opt, *val;			/* Option name and value */
+    int a;				/* Index in argv */
+    char *ln = NULL, *ln1;		/* Command line */
+    size_t ln_sz = BATCH_LINE;		/* Allocation at ln */
+    size_t l;				/* Length of text at ln */
+    char **cv = NULL;			/* Words from ln */
+    size_t cv_sz = 0;			/* Allocation at cv */
+    int cc;				/* Number of words at cv */
+    int ok = 1, cmd_ok;			/* Results of batch and command */
+
+    argv0 = argv[0];
+    argv1 = argv[1];
+    for (a = 2; a < argc && strncmp(argv[a], "--", 2) == 0; a++) {
+	opt = argv[a];
+	if ( (val = opt_val("--cache", &a, argc, argv)) ) {
+	    if ( sscanf(val, "%ld", &max_files) != 1 || max_files < 1 ) {
+		fprintf(stderr, "%s %s: expected positive integer for number "
+			"of cached files, got %s\n", argv0, argv1, val);
+		return 0;
+	    }
+	} else if ( (val = opt_val("--delim", &a, argc, argv)) ) {
+	    delim = val;
+	} else {
+	    fprintf(stderr, "%s %s: unknown option or missing value %s\n",
+		    argv0, argv1, opt);
+	    return 0;
+	}
+    }
+    if ( argc - a > 1 ) {
+	fprintf(stderr, "Usage: %s %s [--cache=n] [--delim=s] [file]\n",
+		argv0, argv1);
+	return 0;
+    }
+    if ( a < argc && strcmp(argv[a], "-") != 0 ) {
+	in_nm = argv[a];
+	if ( !(in = fopen(in_nm, "r")) ) {
+	    fprintf(stderr, "%s %s: could not open %s.\n%s\n",
+		    argv0, argv1, in_nm, strerror(errno));
+	    return 0;
+	}
+    }
+    if ( !(ln = MALLOC(ln_sz)) ) {
+	fprintf(stderr, "%s %s: could not allocate command buffer.\n",
+		argv0, argv1);
+	goto error;
+    }
+    if ( !NC_Cache_Init(&cache, max_files, 0) ) {
+	fprintf(stderr, "%s %s: could not create file cache.\n",
+		argv0, argv1);
+	goto error;
+    }
+    nc_cache = &cache;
+
+    while ( fgets(ln, ln_sz, in) ) {
+
+	/* Get the rest of long lines */
+	for (l = strlen(ln); l == ln_sz - 1 && ln[l - 1] != '\n'; ) {
+	    if ( !(ln1 = REALLOC(ln, 2 * ln_sz)) ) {
+		fprintf(stderr, "%s %s: could not allocate command buffer.\n",
+			argv0, argv1);
+		goto error;
+	    }
+	    ln = ln1;
+	    ln_sz *= 2;
+	    if ( !fgets(ln + l, ln_sz - l, in) ) {
+		break;
+	    }
+	    l += strlen(ln + l);
+	}
+
+	if ( (cc = split_ln(argv0, ln, &cv, &cv_sz)) == -1 ) {
+	    fprintf(stderr, "%s %s: could not allocate argument vector.\n",
+		    argv0, argv1);
+	    goto error;
+	}
+	if ( cc == 1 || cv[1][0] == '#' ) {
+	    continue;
+	}
+	fflush(stdout);
+	cmd_ok = run_cmd(cc, cv);
+	ok = ok && cmd_ok;
+	printf("%s %s\n", delim, cmd_ok ? "ok" : "error");
+	fflush(stdout);
+    }
+    if ( ferror(in) ) {
+	fprintf(stderr, "%s %s: failed to read commands.\n%s\n",
+		argv0, argv1, strerror(errno));
+	goto error;
+    }
+
+    nc_cache = NULL;
+    NC_Cache_Free(&cache);
+    if ( in_nm ) {
+	fclose(in);
+    }
+    FREE(cv);
+    FREE(ln);
+    return ok;
+
+error:
+    if ( nc_cache ) {
+	nc_cache = NULL;
+	NC_Cache_Free(&cache);
+    }
+    if ( in_nm ) {
+	fclose(in);
+    }
+    FREE(cv);
+    FREE(ln);
+    return 0;
+}
+
+/*
+   nnetcdf serve [--cache=n] [--slab-cache=MB] socket
+
+   Listen for connections on Unix domain socket socket, and answer requests
+   from any number of local clients. A request is a line with a subcommand
+   and its arguments, as for batch. The response is a line with "ok n" or
+   "error n", followed by n bytes of output from the subcommand or error
+   messages. Binary output, e.g. from data --format=raw, is sent as is.
+
+   All clients share one cache of up to n open files (default BATCH_FILES)
+   and their variable identifiers, and up to MB megabytes (default
+   SERVE_SLAB_MB) of output from recent data requests. libnetcdf is not
+   thread safe, so requests run one at a time in this process, while the
+   poll loop buffers input and output for every client. A client with
+   SERVE_OUT bytes of responses waiting gets no more answers until it
+   reads them.
+ */
+static int serve_cb(int argc, char *argv[])
+{
+    char *argv0, *argv1;		/* argv[0], argv[1] */
+    char *sock_nm;			/* Path to socket */
+    struct sockaddr_un addr;		/* Socket address */
+    int lsn = -1;			/* Listening socket */
+    int fd;				/* Socket for new client */
+    struct stat sbuf;			/* Information about sock_nm */
+    long max_files = BATCH_FILES;	/* Maximum number of open files */
+    long slab_mb = SERVE_SLAB_MB;	/* Megabytes of values to keep */
+    struct NC_Cache cache;		/* Open files and recent values */
+    FILE *out_fl = NULL, *err_fl = NULL;/* Receive subcommand output */
+    struct Serve_Clnt *clnts = NULL, *c;/* Clients */
+    struct pollfd *pfds = NULL;		/* Sockets to poll */
+    void *t;				/* Reallocation of clnts or pfds */
+    size_t n_clnts = 0;			/* Number of clients */
+    size_t n_polled;			/* Number of clients polled */
+    size_t clnts_sz = 0;		/* Allocation at clnts and pfds */
+    size_t i, j;
+    char *nl;				/* End of request */
+    char **cv = NULL;			/* Words from request */
+    size_t cv_sz = 0;			/* Allocation at cv */
+    ssize_t l;				/* Bytes read or written */
+    struct sigaction act, old_int, old_term, old_pipe;
+    char *opt, *val;			/* Option name and value */
+    int a;				/* Index in argv */
+    int ok = 0;				/* Return value */
+
+    argv0 = argv[0];
+    argv1 = argv[1];
+    for (a = 2; a < argc && strncmp(argv[a], "--", 2) == 0; a++) {
+	opt = argv[a];
+	if ( (val = opt_val("--cache", &a, argc, argv)) ) {
+	    if ( sscanf(val, "%ld", &max_files) != 1 || max_files < 1 ) {
+		fprintf(stderr, "%s %s: expected positive integer for number "
+			"of cached files, got %s\n", argv0, argv1, val);
+		return 0;
+	    }
+	} else if ( (val = opt_val("--slab-cache", &a, argc, argv)) ) {
+	    if ( sscanf(val, "%ld", &slab_mb) != 1 || slab_mb < 0 ) {
+		fprintf(stderr, "%s %s: expected non-negative integer for "
+			"slab cache size, got %s\n", argv0, argv1, val);
+		return 0;
+	    }
+	} else {
+	    fprintf(stderr, "%s %s: unknown option or missing value %s\n",
+		    argv0, argv1, opt);
+	    return 0;
+	}
+    }
+    if ( argc - a != 1 ) {
+	fprintf(stderr, "Usage: %s %s [--cache=n] [--slab-cache=MB] socket\n",
+		argv0, argv1);
+	return 0;
+    }
+    sock_nm = argv[a];
+    if ( strlen(sock_nm) >= sizeof(addr.sun_path) ) {
+	fprintf(stderr, "%s %s: socket path %s is too long.\n",
+		argv0, argv1, sock_nm);
+	return 0;
+    }
+
+    /* Replace socket left by a previous server */
+    if ( stat(sock_nm, &sbuf) == 0 && S_ISSOCK(sbuf.st_mode) ) {
+	unlink(sock_nm);
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, sock_nm);
+    if ( (lsn = socket(AF_UNIX, SOCK_STREAM, 0)) == -1
+	    || bind(lsn, (struct sockaddr *)&addr, sizeof(addr)) == -1
+	    || listen(lsn, SOMAXCONN) == -1
+	    || fcntl(lsn, F_SETFL, O_NONBLOCK) == -1 ) {
+	fprintf(stderr, "%s %s: could not listen on %s.\n%s\n",
+		argv0, argv1, sock_nm, strerror(errno));
+	if ( lsn != -1 ) {
+	    close(lsn);
+	}
+	return 0;
+    }
+    if ( !(out_fl = tmpfile()) || !(err_fl = tmpfile()) ) {
+	fprintf(stderr, "%s %s: could not create files for output.\n%s\n",
+		argv0, argv1, strerror(errno));
+	goto end;
+    }
+    if ( !NC_Cache_Init(&cache, max_files, (size_t)slab_mb << 20) ) {
+	fprintf(stderr, "%s %s: could not create file cache.\n",
+		argv0, argv1);
+	goto end;
+    }
+    nc_cache = &cache;
+
+    /* Stop on interrupt. Let writes to departed clients fail. */
+    serve_stop = 0;
+    memset(&act, 0, sizeof(act));
+    sigemptyset(&act.sa_mask);
+    act.sa_handler = serve_handler;
+    sigaction(SIGINT, &act, &old_int);
+    sigaction(SIGTERM, &act, &old_term);
+    act.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &act, &old_pipe);
+
+    while ( !serve_stop ) {
+	if ( n_clnts + 1 > clnts_sz ) {
+	    clnts_sz = (clnts_sz > 0) ? 2 * clnts_sz : 16;
+	    if ( !(t = REALLOC(clnts, clnts_sz * sizeof(struct Serve_Clnt))) ) {
+		fprintf(stderr, "%s %s: could not allocate client list.\n",
+			argv0, argv1);
+		goto end;
+	    }
+	    clnts = t;
+	    if ( !(t = REALLOC(pfds, (clnts_sz + 1) * sizeof(struct pollfd))) ) {
+		fprintf(stderr, "%s %s: could not allocate poll list.\n",
+			argv0, argv1);
+		goto end;
+	    }
+	    pfds = t;
+	}
+	pfds[0].fd = lsn;
+	pfds[0].events = POLLIN;
+	for (i = 0; i < n_clnts; i++) {
+	    pfds[i + 1].fd = clnts[i].fd;
+	    pfds[i + 1].events = (clnts[i].eof
+		    || clnts[i].out_len - clnts[i].out_off >= SERVE_OUT
+		    ? 0 : POLLIN) | (clnts[i].out_len > 0 ? POLLOUT : 0);
+	    pfds[i + 1].revents = 0;
+	}
+	n_polled = n_clnts;
+	if ( poll(pfds, n_polled + 1, -1) == -1 ) {
+	    if ( errno == EINTR ) {
+		continue;
+	    }
+	    fprintf(stderr, "%s %s: poll failed.\n%s\n",
+		    argv0, argv1, strerror(errno));
+	    goto end;
+	}
+
+	/* Requests and responses for current clients */
+	for (i = 0; i < n_polled; i++) {
+	    c = clnts + i;
+	    if ( (pfds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))
+		    && c->in_len < SERVE_LINE ) {
+		l = read(c->fd, c->in + c->in_len, SERVE_LINE - c->in_len);
+		if ( l == 0 || (l == -1 && errno != EINTR && errno != EAGAIN) ) {
+		    c->eof = 1;
+		} else if ( l > 0 ) {
+		    c->in_len += l;
+		}
+	    }
+	    if ( c->out_len > 0 ) {
+		l = write(c->fd, c->out + c->out_off, c->out_len - c->out_off);
+		if ( l > 0 ) {
+		    c->out_off += l;
+		} else if ( l == -1 && errno != EINTR && errno != EAGAIN ) {
+		    serve_close(c);
+		    continue;
+		}
+		if ( c->out_off == c->out_len ) {
+		    c->out_off = c->out_len = 0;
+		}
+	    }
+
+	    /*
+	       Answer requests after sending what the socket takes, and leave
+	       them in c->in while too much output is waiting. Otherwise a
+	       client that sends requests without reading the responses could
+	       make the server buffer without limit.
+	     */
+
+	    while ( c->out_len - c->out_off < SERVE_OUT
+		    && (nl = memchr(c->in, '\n', c->in_len)) ) {
+		*nl = '\0';
+		serve_req(c, argv0, c->in, &cv, &cv_sz, fileno(out_fl),
+			fileno(err_fl));
+		c->in_len -= nl + 1 - c->in;
+		memmove(c->in, nl + 1, c->in_len);
+	    }
+	    if ( c->in_len == SERVE_LINE && !memchr(c->in, '\n', c->in_len) ) {
+		static char msg[] = "request too long\n";
+		char hdr[64];
+
+		sprintf(hdr, "error %zu\n", sizeof(msg) - 1);
+		serve_put(c, hdr, strlen(hdr));
+		serve_put(c, msg, sizeof(msg) - 1);
+		c->in_len = 0;
+		c->eof = 1;
+	    }
+	    if ( c->eof && c->out_len == 0 ) {
+		serve_close(c);
+	    }
+	}
+	for (i = j = 0; i < n_clnts; i++) {
+	    if ( clnts[i].fd != -1 ) {
+		clnts[j++] = clnts[i];
+	    }
+	}
+	n_clnts = j;
+
+	/* New clients */
+	if ( (pfds[0].revents & POLLIN) && n_clnts < clnts_sz
+		&& (fd = accept(lsn, NULL, NULL)) != -1 ) {
+	    c = clnts + n_clnts;
+	    memset(c, 0, sizeof(struct Serve_Clnt));
+	    c->fd = fd;
+	    if ( fcntl(fd, F_SETFL, O_NONBLOCK) == -1
+		    || !(c->in = MALLOC(SERVE_LINE)) ) {
+		fprintf(stderr, "%s %s: could not set up client.\n",
+			argv0, argv1);
+		serve_close(c);
+	    } else {
+		n_clnts++;
+	    }
+	}
+    }
+    ok = 1;
+
+end:
+    for (i = 0; i < n_clnts; i++) {
+	serve_close(clnts + i);
+    }
+    if ( nc_cache ) {
+	nc_cache = NULL;
+	NC_Cache_Free(&cache);
+	sigaction(SIGINT, &old_int, NULL);
+	sigaction(SIGTERM, &old_term, NULL);
+	sigaction(SIGPIPE, &old_pipe, NULL);
+    }
+    close(lsn);
+    unlink(sock_nm);
+    if ( out_fl ) {
+	fclose(out_fl);
+    }
+    if ( err_fl ) {
+	fclose(err_fl);
+    }
+    FREE(pfds);
+    FREE(clnts);
+    FREE(cv);
+    return ok;
+}
+
+/*
+   Run request ln from serve client c and append the response to its
+   output. argv0 is the program name. *cv_p and *cv_sz_p are the argument
+   vector, as for split_ln. out_fd and err_fd are files that capture
+   standard output and standard error from the subcommand.
+ */
+static void serve_req(struct Serve_Clnt *c, char *argv0, char *ln,
+	char ***cv_p, size_t *cv_sz_p, int out_fd, int err_fd)
+{
+    int cc;				/* Number of words at *cv_p */
+    char **cv;				/* Words from ln */
+    char *key = NULL;			/* Identifies data response */
+    size_t key_len;			/* Length of key */
+    char *path = NULL;			/* File for data request */
+    void *buf = NULL;			/* Response */
+    size_t n;				/* Size of cached response */
+    off_t sz;				/* Size of response */
+    ssize_t l;				/* Bytes read */
+    int sv_out = -1, sv_err = -1;	/* Server stdout and stderr */
+    int fd;				/* Which output to send */
+    int ok;				/* Result of subcommand */
+    char hdr[64];			/* Response header */
+    int a;
+
+    if ( (cc = split_ln(argv0, ln, cv_p, cv_sz_p)) == -1 ) {
+	serve_put(c, "error 0\n", 8);
+	return;
+    }
+    cv = *cv_p;
+    if ( cc == 1 || cv[1][0] == '#' ) {
+	return;
+    }
+
+    /*
+       Output from data requests is cached, keyed by normalized request.
+       With --shm, output names a shared memory segment that the client
+       may have removed, so it is not cached.
+     */
+
+    if ( strcmp(cv[1], "data") == 0 && cc > 3 ) {
+	for (key_len = 0, a = 1; a < cc; a++) {
+	    if ( strncmp(cv[a], "--shm", 5) == 0 ) {
+		key_len = 0;
+		break;
+	    }
+	    key_len += strlen(cv[a]) + 1;
+	}
+	if ( key_len > 0 && (key = MALLOC(key_len)) ) {
+	    for (*key = '\0', a = 1; a < cc; a++) {
+		strcat(key, cv[a]);
+		strcat(key, (a + 1 < cc) ? " " : "");
+	    }
+	    path = cv[cc - 1];
+	    if ( (buf = NC_Cache_Slab_Get(nc_cache, key, path, &n)) ) {
+		sprintf(hdr, "ok %zu\n", n);
+		serve_put(c, hdr, strlen(hdr));
+		serve_put(c, buf, n);
+		FREE(key);
+		return;
+	    }
+	}
+    }
+
+    /* Run subcommand with standard output and error going to files */
+    fflush(stdout);
+    fflush(stderr);
+    if ( ftruncate(out_fd, 0) == -1 || lseek(out_fd, 0, SEEK_SET) == -1
+	    || ftruncate(err_fd, 0) == -1 || lseek(err_fd, 0, SEEK_SET) == -1
+	    || (sv_out = dup(STDOUT_FILENO)) == -1
+	    || (sv_err = dup(STDERR_FILENO)) == -1
+	    || dup2(out_fd, STDOUT_FILENO) == -1
+	    || dup2(err_fd, STDERR_FILENO) == -1 ) {
+	ok = 0;
+    } else {
+	ok = run_cmd(cc, cv);
+	fflush(stdout);
+	fflush(stderr);
+    }
+    if ( sv_out != -1 ) {
+	dup2(sv_out, STDOUT_FILENO);
+	close(sv_out);
+    }
+    if ( sv_err != -1 ) {
+	dup2(sv_err, STDERR_FILENO);
+	close(sv_err);
+    }
+
+    fd = ok ? out_fd : err_fd;
+    if ( (sz = lseek(fd, 0, SEEK_END)) == -1
+	    || !(buf = MALLOC(sz > 0 ? sz : 1)) ) {
+	serve_put(c, "error 0\n", 8);
+	FREE(key);
+	return;
+    }
+    for (l = 0; l < sz; ) {
+	ssize_t r = pread(fd, (char *)buf + l, sz - l, l);
+
+	if ( r <= 0 ) {
+	    break;
+	}
+	l += r;
+    }
+    sprintf(hdr, "%s %zu\n", ok ? "ok" : "error", (size_t)l);
+    serve_put(c, hdr, strlen(hdr));
+    serve_put(c, buf, l);
+    if ( !(ok && key && l == sz
+		&& NC_Cache_Slab_Put(nc_cache, key, path, buf, sz)) ) {
+	FREE(buf);
+    }
+    FREE(key);
+}
+
+/*
+   Append n bytes from p to output for client c. Return 1 on success. If
+   allocation fails, mark the client for closing and return 0.
+ */
+static int serve_put(struct Serve_Clnt *c, const void *p, size_t n)
+{
+    size_t sz;
+    char *t;
+
+    /* Drop bytes already sent before growing the buffer */
+    if ( c->out_off > 0 && c->out_len + n > c->out_sz ) {
+	c->out_len -= c->out_off;
+	memmove(c->out, c->out + c->out_off, c->out_len);
+	c->out_off = 0;
+    }
+    if ( c->out_len + n > c->out_sz ) {
+	for (sz = (c->out_sz > 0) ? c->out_sz : 4096; sz < c->out_len + n; ) {
+	    sz *= 2;
+	}
+	if ( !(t = REALLOC(c->out, sz)) ) {
+	    c->eof = 1;
+	    return 0;
+	}
+	c->out = t;
+	c->out_sz = sz;
+    }
+    memcpy(c->out + c->out_len, p, n);
+    c->out_len += n;
+    return 1;
+}
+
+/* Close connection to client c and free its buffers */
+static void serve_close(struct Serve_Clnt *c)
+{
+    if ( c->fd != -1 ) {
+	close(c->fd);
+    }
+    c->fd = -1;
+    FREE(c->in);
+    FREE(c->out);
+    c->in = c->out = NULL;
+    c->in_len = c->out_len = c->out_off = c->out_sz = 0;
+}
+
+/* Stop serve */
+static void serve_handler(int signum)
+{
+    serve_stop = 1;
+}
+
+/*
+   Split command line ln into words at white space, and store them in
+   argument vector *cv_p, which has *cv_sz_p elements and grows as needed.
+   Element 0 is argv0, so that the vector can go to a subcommand callback.
+   The words point into ln. Return the number of elements, or -1 if
+   allocation fails.
+ */
+static int split_ln(char *argv0, char *ln, char ***cv_p, size_t *cv_sz_p)
+{
+    char **cv = *cv_p, **cv1;
+    size_t cv_sz = *cv_sz_p;
+    int cc;
+    char *w;
+
+    for (cc = 0, w = argv0; w; ) {
+	if ( (size_t)cc + 2 > cv_sz ) {
+	    cv_sz = (cv_sz > 0) ? 2 * cv_sz : 16;
+	    if ( !(cv1 = REALLOC(cv, cv_sz * sizeof(char *))) ) {
+		return -1;
+	    }
+	    *cv_p = cv = cv1;
+	    *cv_sz_p = cv_sz;
+	}
+	cv[cc++] = w;
+	w = strtok((cc == 1) ? ln : NULL, " \t\r\n");
+    }
+    cv[cc] = NULL;
+    return cc;
+}
+
+/*
+   Run the subcommand in cv[1] with cc arguments from cv, for batch and
+   serve. Return the value from the subcommand callback, or 0 if the
+   command is unknown or may not be nested.
+ */
+static int run_cmd(int cc, char **cv)
+{
+    int n;
+
+    n = Hash(cv[1], N_HASH_CMD);
+    if ( strcmp(cv[1], cmd1v[n]) != 0
+	    || cb1v[n] == batch_cb || cb1v[n] == serve_cb ) {
+	fprintf(stderr, "%s: unknown or disallowed command %s\n",
+		cv[0], cv[1]);
+	return 0;
+    }
+    if ( !cb1v[n](cc, cv) ) {
+	fprintf(stderr, "%s: %s failed.\n", cv[0], cv[1]);
+	return 0;
+    }
+    return 1;
+}
+
+/*
+   Open NetCDF file path, putting the identifier at nc_id_p. In batch, fetch
+   the identifier from the file cache. Return value is as for nc_open.
+ */
+static int app_open(char *path, int *nc_id_p)
+{
+    return nc_cache ? NC_Cache_Open(nc_cache, path, nc_id_p)
+	: nc_open(path, 0, nc_id_p);
+}
+
+/* Close a file opened with app_open. Cached files stay open. */
+static int app_close(int nc_id)
+{
+    return nc_cache ? NC_NOERR : nc_close(nc_id);
+}
+
+/* Fetch the identifier for variable var_nm, as for nc_inq_varid. */
+static int app_varid(int nc_id, char *var_nm, int *var_id_p)
+{
+    return nc_cache ? NC_Cache_Varid(nc_cache, nc_id, var_nm, var_id_p)
+	: nc_inq_varid(nc_id, var_nm, var_id_p);
+}
@@ -473,6 +473,116 @@ double * NNC_Get_Var_Double(int ncid, const char *name, double *dPtr,
     return dPtr;
 }
 
+/*
+   Retrieve a hyperslab of a variable from a NetCDF file as doubles.
+   See nnetcdf (3).
+ */
+double * NNC_Get_Vara_Double(int ncid, const char *name, const size_t *start,
+	const size_t *count, double *dPtr, jmp_buf error_env)
+{
+    int varid;		/* Variable identifier */
+    nc_type xtype;	/* Type of variable in file */
+    int ndims;		/* Number of dimensions of variable */
+    size_t sz;		/* Number of values in hyperslab */
+    int d;
+    int status;
+
+    if ((status = nc_inq_varid(ncid, name, &varid)) != 0) {
+	fprintf(stderr, "No variable named %s. NetCDF error message is: %s\n",
+		name, nc_strerror(status));
+	longjmp(error_env, NNCDF_ERROR);
+    }
+    if ((status = nc_inq_vartype(ncid, varid, &xtype)) != 0
+	    || (status = nc_inq_varndims(ncid, varid, &ndims)) != 0) {
+	fprintf(stderr, "Could not get type and dimension count for %s. "
+		"NetCDF error message is: %s\n", name, nc_strerror(status));
+	longjmp(error_env, NNCDF_ERROR);
+    }
+    for (sz = 1, d = 0; d < ndims; d++) {
+	sz *= count[d];
+    }
+    if ( !dPtr && !(dPtr = MALLOC(sz * sizeof(double))) ) {
+	fprintf(stderr, "Could not allocate array of %zu values for %s\n",
+		sz, name);
+	longjmp(error_env, NNCDF_ERROR);
+    }
+    if ( xtype == NC_CHAR ) {
+	/*
+	   NetCDF will not convert text to numbers, so fetch characters and
+	   convert them here.
+	 */
+
+	char *c;
+	size_t n;
+
+	if ( !(c = MALLOC(sz)) ) {
+	    fprintf(stderr, "Could not allocate array of %zu characters "
+		    "for %s\n", sz, name);
+	    longjmp(error_env, NNCDF_ERROR);
+	}
+	if ((status = nc_get_vara_text(ncid, varid, start, count, c)) != 0) {
+	    fprintf(stderr, "Could not get values for %s. "
+		    "NetCDF error message is: %s\n",
+		    name, nc_strerror(status));
+	    FREE(c);
+	    longjmp(error_env, NNCDF_ERROR);
+	}
+	for (n = 0; n < sz; n++) {
+	    dPtr[n] = c[n];
+	}
+	FREE(c);
+    } else if ((status = nc_get_vara_double(ncid, varid, start, count, dPtr))
+	    != 0) {
+	fprintf(stderr, "Could not get values for %s. "
+		"NetCDF error message is: %s\n", name, nc_strerror(status));
+	longjmp(error_env, NNCDF_ERROR);
+    }
+    return dPtr;
+}
+
+/*
+   Retrieve a hyperslab of a variable from a NetCDF file, with values in
+   their own type. See nnetcdf (3).
+ */
+void * NNC_Get_Vara(int ncid, const char *name, const size_t *start,
+	const size_t *count, void *vPtr, jmp_buf error_env)
+{
+    int varid;		/* Variable identifier */
+    nc_type xtype;	/* Type of variable in file */
+    size_t elem_sz;	/* Size of one value */
+    int ndims;		/* Number of dimensions of variable */
+    size_t sz;		/* Number of values in hyperslab */
+    int d;
+    int status;
+
+    if ((status = nc_inq_varid(ncid, name, &varid)) != 0) {
+	fprintf(stderr, "No variable named %s. NetCDF error message is: %s\n",
+		name, nc_strerror(status));
+	longjmp(error_env, NNCDF_ERROR);
+    }
+    if ((status = nc_inq_vartype(ncid, varid, &xtype)) != 0
+	    || (status = nc_inq_type(ncid, xtype, NULL, &elem_sz)) != 0
+	    || (status = nc_inq_varndims(ncid, varid, &ndims)) != 0) {
+	fprintf(stderr, "Could not get type and dimension count for %s. "
+		"NetCDF error message is: %s\n", name, nc_strerror(status));
+	longjmp(error_env, NNCDF_ERROR);
+    }
+    for (sz = 1, d = 0; d < ndims; d++) {
+	sz *= count[d];
+    }
+    if ( !vPtr && !(vPtr = MALLOC(sz * elem_sz)) ) {
+	fprintf(stderr, "Could not allocate array of %zu values for %s\n",
+		sz, name);
+	longjmp(error_env, NNCDF_ERROR);
+    }
+    if ((status = nc_get_vara(ncid, varid, start, count, vPtr)) != 0) {
+	fprintf(stderr, "Could not get values for %s. "
+		"NetCDF error message is: %s\n", name, nc_strerror(status));
+	longjmp(error_env, NNCDF_ERROR);
+    }
+    return vPtr;
+}
+
 /* Get a string attribute associated with a NetCDF variable. See nnetcdf (3). */
 char * NNC_Get_Att_String(int ncid, const char *name, const char *att,
 	jmp_buf error_env)
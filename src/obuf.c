@@ -0,0 +1,165 @@
+/*
+   -	obuf.c --
+   -		Buffered output of numbers as text. See obuf.h
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include "alloc.h"
+#include "fmt.h"
+#include "obuf.h"
+
+/*
+   Initialize ob to send text to file descriptor fd in writes of about cap
+   bytes. Return 1 on success. On failure, print a message to stderr and
+   return 0.
+ */
+int Obuf_Init(struct Obuf *ob, int fd, size_t cap)
+{
+    ob->fd = fd;
+    ob->len = 0;
+    if ( cap < FMT_BUF_LEN ) {
+	cap = FMT_BUF_LEN;
+    }
+    ob->cap = cap;
+    if ( !(ob->buf = MALLOC(cap)) ) {
+	fprintf(stderr, "Could not allocate output buffer with %zu bytes.\n",
+		cap);
+	return 0;
+    }
+    return 1;
+}
+
+/*
+   Append text for v to ob. Return 1 on success. On failure, print a message
+   to stderr and return 0.
+ */
+int Obuf_Double(struct Obuf *ob, double v)
+{
+    if ( ob->cap - ob->len < FMT_BUF_LEN && !Obuf_Flush(ob) ) {
+	return 0;
+    }
+    ob->len += Fmt_Double(ob->buf + ob->len, v);
+    return 1;
+}
+
+int Obuf_Float(struct Obuf *ob, float v)
+{
+    if ( ob->cap - ob->len < FMT_BUF_LEN && !Obuf_Flush(ob) ) {
+	return 0;
+    }
+    ob->len += Fmt_Float(ob->buf + ob->len, v);
+    return 1;
+}
+
+int Obuf_LLong(struct Obuf *ob, long long v)
+{
+    if ( ob->cap - ob->len < FMT_BUF_LEN && !Obuf_Flush(ob) ) {
+	return 0;
+    }
+    ob->len += Fmt_LLong(ob->buf + ob->len, v);
+    return 1;
+}
+
+int Obuf_ULLong(struct Obuf *ob, unsigned long long v)
+{
+    if ( ob->cap - ob->len < FMT_BUF_LEN && !Obuf_Flush(ob) ) {
+	return 0;
+    }
+    ob->len += Fmt_ULLong(ob->buf + ob->len, v);
+    return 1;
+}
+
+int Obuf_Char(struct Obuf *ob, char c)
+{
+    if ( ob->len == ob->cap && !Obuf_Flush(ob) ) {
+	return 0;
+    }
+    ob->buf[ob->len++] = c;
+    return 1;
+}
+
+/*
+   Write contents of ob to its file descriptor and empty it. If ob has no
+   file descriptor, enlarge its buffer instead. Return 1 on success. On
+   failure, print a message to stderr and return 0.
+ */
+int Obuf_Flush(struct Obuf *ob)
+{
+    char *t;
+
+    if ( ob->fd == -1 ) {
+	if ( !(t = REALLOC(ob->buf, 2 * ob->cap)) ) {
+	    fprintf(stderr, "Could not grow output buffer to %zu bytes.\n",
+		    2 * ob->cap);
+	    return 0;
+	}
+	ob->buf = t;
+	ob->cap *= 2;
+	return 1;
+    }
+    return Obuf_Send(ob, ob->fd);
+}
+
+/*
+   Write contents of ob to file descriptor fd and empty it. Return 1 on
+   success. On failure, print a message to stderr and return 0.
+ */
+int Obuf_Send(struct Obuf *ob, int fd)
+{
+    char *p, *e;
+    ssize_t w;
+
+    for (p = ob->buf, e = p + ob->len; p < e; p += w) {
+	if ( (w = write(fd, p, e - p)) == -1 ) {
+	    if ( errno == EINTR ) {
+		w = 0;
+		continue;
+	    }
+	    fprintf(stderr, "Could not write output.\n");
+	    perror(NULL);
+	    return 0;
+	}
+    }
+    ob->len = 0;
+    return 1;
+}
+
+/* Free memory associated with ob. Unwritten text is discarded. */
+void Obuf_Free(struct Obuf *ob)
+{
+    FREE(ob->buf);
+    ob->len = ob->cap = 0;
+}
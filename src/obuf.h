@@ -0,0 +1,65 @@
+/*
+   -	obuf.h --
+   -		Declarations for buffered output of numbers as text
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#ifndef OBUF_H_
+#define OBUF_H_
+
+#include <stdlib.h>
+
+/*
+   An output buffer collects text in memory and sends it to a file
+   descriptor with write(2) when the buffer is full or flushed. Numbers
+   are converted with the functions in fmt.h. If the file descriptor is -1,
+   the buffer grows instead, and text stays in memory until sent with
+   Obuf_Send.
+ */
+
+struct Obuf {
+    int fd;				/* Output file descriptor, or -1 */
+    char *buf;				/* Text not yet written */
+    size_t len;				/* Number of characters in buf */
+    size_t cap;				/* Allocated size of buf */
+};
+
+int Obuf_Init(struct Obuf *, int, size_t);
+int Obuf_Double(struct Obuf *, double);
+int Obuf_Float(struct Obuf *, float);
+int Obuf_LLong(struct Obuf *, long long);
+int Obuf_ULLong(struct Obuf *, unsigned long long);
+int Obuf_Char(struct Obuf *, char);
+int Obuf_Flush(struct Obuf *);
+int Obuf_Send(struct Obuf *, int);
+void Obuf_Free(struct Obuf *);
+
+#endif
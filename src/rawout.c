@@ -0,0 +1,199 @@
+/*
+   -	rawout.c --
+   -		Output of values in binary form. See rawout.h
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE			/* For vmsplice */
+#endif
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "rawout.h"
+
+/* Size of writes to regular files. Writes start at multiples of this. */
+#define RAW_CHUNK (8 << 20)
+
+/* Identifies a npy file, version 1.0 */
+#define NPY_MAGIC "\x93NUMPY\x01\x00"
+#define NPY_MAGIC_LEN 8
+
+/* npy header length, including magic and length, is a multiple of this */
+#define NPY_ALIGN 64
+
+static int write_all(int, const char *, size_t, size_t);
+
+/*
+   Send n bytes from buf to file descriptor fd. If fd is a pipe, the
+   system has vmsplice, and pinned is not NULL, pages of buf are handed to
+   the pipe instead of copied, and *pinned is set to 1. In that case, the
+   caller must not modify or free buf before the process exits, because
+   the reader of the pipe may not have consumed the pages yet. If fd is a
+   regular file, write in large chunks aligned to file offsets that are
+   multiples of RAW_CHUNK. Otherwise, write as usual. Return 1 on success.
+   On failure, print a message to stderr and return 0.
+ */
+int Raw_Write(int fd, const void *buf, size_t n, int *pinned)
+{
+    struct stat sbuf;
+    const char *p = buf;
+    off_t off;				/* Offset in regular file */
+    size_t first;			/* Size of first write to reach
+					   alignment */
+
+    if ( fstat(fd, &sbuf) == -1 ) {
+	fprintf(stderr, "Could not get status of output.\n");
+	perror(NULL);
+	return 0;
+    }
+#ifdef __linux__
+    if ( S_ISFIFO(sbuf.st_mode) && pinned ) {
+	struct iovec iov;
+	ssize_t w;
+	int sent = 0;			/* If true, pages went to pipe */
+
+	while ( n > 0 ) {
+	    iov.iov_base = (void *)p;
+	    iov.iov_len = n;
+	    if ( (w = vmsplice(fd, &iov, 1, 0)) == -1 ) {
+		if ( errno == EINTR ) {
+		    continue;
+		}
+		if ( !sent && (errno == EINVAL || errno == ENOSYS) ) {
+		    /* No vmsplice for this pipe. Copy instead. */
+		    break;
+		}
+		fprintf(stderr, "Could not send output to pipe.\n");
+		perror(NULL);
+		return 0;
+	    }
+	    sent = *pinned = 1;
+	    p += w;
+	    n -= w;
+	}
+	if ( n == 0 ) {
+	    return 1;
+	}
+    }
+#endif
+    if ( S_ISREG(sbuf.st_mode) && (off = lseek(fd, 0, SEEK_CUR)) != -1 ) {
+	first = RAW_CHUNK - (size_t)(off % RAW_CHUNK);
+	if ( first > n ) {
+	    first = n;
+	}
+	return write_all(fd, p, first, first)
+	    && write_all(fd, p + first, n - first, RAW_CHUNK);
+    }
+    return write_all(fd, p, n, RAW_CHUNK);
+}
+
+/*
+   Write n bytes from buf to fd, with write calls of at most chunk bytes.
+   Return 1 on success. On failure, print a message to stderr and return 0.
+ */
+static int write_all(int fd, const char *buf, size_t n, size_t chunk)
+{
+    const char *p, *e;
+    ssize_t w;
+
+    for (p = buf, e = p + n; p < e; p += w) {
+	if ( (w = write(fd, p, (size_t)(e - p) < chunk ? (size_t)(e - p)
+			: chunk)) == -1 ) {
+	    if ( errno == EINTR ) {
+		w = 0;
+		continue;
+	    }
+	    fprintf(stderr, "Could not write output.\n");
+	    perror(NULL);
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+/*
+   Put a header for a npy file into buf, which has buf_sz bytes. descr is
+   the numpy type string, e.g. "<f8". Array has ndims dimensions with
+   lengths shape, in C order. Return the header length, or 0 if buf is too
+   small.
+ */
+size_t Raw_Npy_Header(char *buf, size_t buf_sz, const char *descr,
+	int ndims, const size_t *shape)
+{
+    size_t l;				/* Length so far */
+    size_t h_len;			/* Length of header after magic and
+					   length */
+    int d;
+
+    if ( buf_sz < NPY_ALIGN ) {
+	return 0;
+    }
+    memcpy(buf, NPY_MAGIC, NPY_MAGIC_LEN);
+    l = NPY_MAGIC_LEN + 2;
+    l += snprintf(buf + l, buf_sz - l,
+	    "{'descr': '%s', 'fortran_order': False, 'shape': (", descr);
+    for (d = 0; l < buf_sz && d < ndims; d++) {
+	l += snprintf(buf + l, buf_sz - l, "%s%zu", (d > 0) ? ", " : "",
+		shape[d]);
+    }
+    if ( l < buf_sz ) {
+	l += snprintf(buf + l, buf_sz - l, "%s), }", (ndims == 1) ? "," : "");
+    }
+    if ( l >= buf_sz ) {
+	return 0;
+    }
+
+    /* Pad with spaces and end with newline */
+    h_len = (l + 1 + NPY_ALIGN - 1) / NPY_ALIGN * NPY_ALIGN;
+    if ( h_len > buf_sz || h_len - NPY_MAGIC_LEN - 2 > 0xFFFF ) {
+	return 0;
+    }
+    memset(buf + l, ' ', h_len - l - 1);
+    buf[h_len - 1] = '\n';
+    buf[NPY_MAGIC_LEN] = (h_len - NPY_MAGIC_LEN - 2) & 0xFF;
+    buf[NPY_MAGIC_LEN + 1] = ((h_len - NPY_MAGIC_LEN - 2) >> 8) & 0xFF;
+    return h_len;
+}
+
+/* Return 1 if this host is little endian, 0 if big endian. */
+int Raw_Little_Endian(void)
+{
+    unsigned int i = 1;
+
+    return *(unsigned char *)&i == 1;
+}
@@ -0,0 +1,256 @@
+/*
+   -	rdr.c --
+   -		This file defines functions that read blocks of a
+   -		NetCDF variable in a separate process. See rdr.h.
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <setjmp.h>
+#include <sys/wait.h>
+#include "alloc.h"
+#include "nnetcdf.h"
+#include "slab.h"
+#include "rdr.h"
+
+static int rdr_start(struct Rdr *, int, char **, const char *, size_t, int,
+	const size_t *, const size_t *, const size_t *, size_t, const size_t *,
+	size_t, size_t);
+static void rdr_child(int, int, char **, const char *, size_t, int,
+	const size_t *, const size_t *, const size_t *, size_t, const size_t *,
+	size_t, size_t);
+
+/*
+   Start a reader for variable var_nm in the n_files files named in paths.
+   The variable has ndims dimensions with lengths len. The box of ext
+   elements along each dimension starting at org will be sent in blocks of
+   at most blk_elem values, as from Slab_Init_Box. Values are sent as
+   doubles. Return 1 on success. On failure, print a message to stderr and
+   return 0.
+ */
+int Rdr_Start(struct Rdr *rdr, int n_files, char **paths, const char *var_nm,
+	int ndims, const size_t *len, const size_t *org, const size_t *ext,
+	size_t blk_elem)
+{
+    return rdr_start(rdr, n_files, paths, var_nm, 0, ndims, len, org, ext,
+	    blk_elem, NULL, 0, 1);
+}
+
+/*
+   Start a reader for variable var_nm in the file named path. Values are
+   sent in the type of the variable, which has size elem_sz and must not
+   be a string or other type that holds pointers. The variable has ndims
+   dimensions with lengths len. It is visited in blocks with blk elements
+   along each dimension, as from Slab_Init_Blk, and the reader sends
+   blocks first, first + step, first + 2 * step, ... Several readers with
+   the same step and different first values can share the blocks of one
+   variable. Return 1 on success. On failure, print a message to stderr
+   and return 0.
+ */
+int Rdr_Start_Blk(struct Rdr *rdr, char *path, const char *var_nm,
+	size_t elem_sz, int ndims, const size_t *len, const size_t *blk,
+	size_t first, size_t step)
+{
+    size_t blk_elem;
+    int d;
+
+    for (blk_elem = 1, d = 0; d < ndims; d++) {
+	blk_elem *= blk[d];
+    }
+    return rdr_start(rdr, 1, &path, var_nm, elem_sz, ndims, len, NULL, NULL,
+	    blk_elem, blk, first, step);
+}
+
+/*
+   Start a reader. Parameters are as for Rdr_Start and Rdr_Start_Blk. If
+   blk is NULL, blocks come from Slab_Init_Box. If elem_sz is 0, values are
+   sent as doubles, otherwise in their own type.
+ */
+static int rdr_start(struct Rdr *rdr, int n_files, char **paths,
+	const char *var_nm, size_t elem_sz, int ndims, const size_t *len,
+	const size_t *org, const size_t *ext, size_t blk_elem,
+	const size_t *blk, size_t first, size_t step)
+{
+    int fds[2];				/* Data pipe */
+
+    rdr->pid = -1;
+    rdr->fd = -1;
+    rdr->elem_sz = (elem_sz > 0) ? elem_sz : sizeof(double);
+    if ( pipe(fds) == -1 ) {
+	fprintf(stderr, "Could not create pipe for reader.\n");
+	perror(NULL);
+	return 0;
+    }
+
+    /* Do not let the child repeat output that is still buffered */
+    fflush(stdout);
+    fflush(stderr);
+    switch (rdr->pid = fork()) {
+	case -1:
+	    fprintf(stderr, "Could not create reader process.\n");
+	    perror(NULL);
+	    close(fds[0]);
+	    close(fds[1]);
+	    return 0;
+	case 0:
+	    close(fds[0]);
+	    rdr_child(fds[1], n_files, paths, var_nm, elem_sz, ndims, len, org,
+		    ext, blk_elem, blk, first, step);
+	    _exit(EXIT_FAILURE);
+	default:
+	    close(fds[1]);
+	    rdr->fd = fds[0];
+    }
+    return 1;
+}
+
+/*
+   Body of reader process. Send blocks to file descriptor fd. Parameters are
+   as for rdr_start. This function does not return.
+ */
+static void rdr_child(int fd, int n_files, char **paths, const char *var_nm,
+	size_t elem_sz, int ndims, const size_t *len, const size_t *org,
+	const size_t *ext, size_t blk_elem, const size_t *blk, size_t first,
+	size_t step)
+{
+    int *nc_ids;			/* NetCDF file identifiers */
+    void *buf;				/* Values for a block */
+    size_t sz;				/* Size of a value in buf */
+    struct Slab slab;			/* Block iterator */
+    jmp_buf err_env;			/* Jump buffer for nnetcdf calls */
+    size_t n;				/* Number of values in block */
+    char *p, *e;			/* Point into buf while writing */
+    ssize_t w;				/* Number of bytes written */
+    int f;				/* File index */
+    size_t b;				/* Block index */
+
+    if ( setjmp(err_env) == NNCDF_ERROR ) {
+	fprintf(stderr, "Reader failed to retrieve %s.\n", var_nm);
+	_exit(EXIT_FAILURE);
+    }
+    if ( !(nc_ids = CALLOC(n_files, sizeof(int)))
+	    || !(buf = CALLOC(blk_elem > 0 ? blk_elem : 1,
+		    sz = (elem_sz > 0) ? elem_sz : sizeof(double)))
+	    || !(blk ? Slab_Init_Blk(&slab, ndims, len, blk)
+		: Slab_Init_Box(&slab, ndims, len, org, ext, blk_elem)) ) {
+	fprintf(stderr, "Reader could not allocate memory.\n");
+	_exit(EXIT_FAILURE);
+    }
+    for (f = 0; f < n_files; f++) {
+	nc_ids[f] = NNC_Open(paths[f], err_env);
+    }
+    for (b = 0; (n = Slab_Next(&slab)) > 0; b++) {
+	if ( b % step != first ) {
+	    continue;
+	}
+	for (f = 0; f < n_files; f++) {
+	    if ( elem_sz > 0 ) {
+		NNC_Get_Vara(nc_ids[f], var_nm, slab.start, slab.count, buf,
+			err_env);
+	    } else {
+		NNC_Get_Vara_Double(nc_ids[f], var_nm, slab.start, slab.count,
+			buf, err_env);
+	    }
+	    for (p = (char *)buf, e = p + n * sz; p < e; p += w) {
+		if ( (w = write(fd, p, e - p)) == -1 ) {
+		    if ( errno == EINTR ) {
+			w = 0;
+			continue;
+		    }
+		    _exit(EXIT_FAILURE);
+		}
+	    }
+	}
+    }
+    _exit(EXIT_SUCCESS);
+}
+
+/*
+   Fetch the next block, with n values, from reader rdr into buf. Return 1
+   on success. If the reader fails, print a message to stderr and return 0.
+ */
+int Rdr_Get(struct Rdr *rdr, void *buf, size_t n)
+{
+    char *p, *e;			/* Point into buf while reading */
+    ssize_t r;				/* Number of bytes read */
+
+    for (p = (char *)buf, e = p + n * rdr->elem_sz; p < e; p += r) {
+	if ( (r = read(rdr->fd, p, e - p)) == -1 ) {
+	    if ( errno == EINTR ) {
+		r = 0;
+		continue;
+	    }
+	    fprintf(stderr, "Could not read from reader process %ld.\n",
+		    (long)rdr->pid);
+	    perror(NULL);
+	    return 0;
+	} else if ( r == 0 ) {
+	    fprintf(stderr, "Reader process %ld ended early.\n",
+		    (long)rdr->pid);
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+/*
+   Close reader rdr and wait for its process to exit. If stop is true, tell
+   the process to stop, even if it has not sent all of its blocks. Return 1
+   if the process succeeded or was stopped, otherwise 0.
+ */
+int Rdr_Finish(struct Rdr *rdr, int stop)
+{
+    int status;
+
+    if ( rdr->pid == -1 ) {
+	return 0;
+    }
+    if ( stop ) {
+	kill(rdr->pid, SIGTERM);
+    }
+    close(rdr->fd);
+    while ( waitpid(rdr->pid, &status, 0) == -1 ) {
+	if ( errno != EINTR ) {
+	    return 0;
+	}
+    }
+    rdr->pid = -1;
+    rdr->fd = -1;
+    if ( stop ) {
+	return 1;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
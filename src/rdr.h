@@ -0,0 +1,63 @@
+/*
+   -	rdr.h --
+   -		This file declares functions that read blocks of a
+   -		NetCDF variable in a separate process.
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#ifndef RDR_H_
+#define RDR_H_
+
+#include "unix_defs.h"
+#include <stdlib.h>
+
+/*
+   A reader is a child process that visits a variable in one or more
+   NetCDF files in blocks, as a slab iterator would (see slab.h), and writes
+   the values, as doubles or in their own type, to a pipe. For each block,
+   it sends the block from each file in turn. NetCDF calls are not thread
+   safe, so this is how several files can be read at once.
+ */
+
+struct Rdr {
+    pid_t pid;				/* Process identifier of child */
+    int fd;				/* Read end of data pipe */
+    size_t elem_sz;			/* Size of a value from the pipe */
+};
+
+int Rdr_Start(struct Rdr *, int, char **, const char *, int, const size_t *,
+	const size_t *, const size_t *, size_t);
+int Rdr_Start_Blk(struct Rdr *, char *, const char *, size_t, int,
+	const size_t *, const size_t *, size_t, size_t);
+int Rdr_Get(struct Rdr *, void *, size_t);
+int Rdr_Finish(struct Rdr *, int);
+
+#endif
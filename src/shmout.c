@@ -0,0 +1,139 @@
+/*
+   -	shmout.c --
+   -		Export of values in shared memory
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "shmout.h"
+
+/* Maximum number of generated names to try */
+#define SHM_TRIES 100
+
+/*
+   Create a shared memory segment named nm for num_elem values of type
+   xtype, each elem_sz bytes, with dimensions shape[0 .. ndims - 1], and
+   write the header. If fill is not NULL, it points to the fill value. If
+   nm is empty, generate a name and copy it to nm, which must have space
+   for nm_sz characters. Return the address of the segment in this process,
+   and put its size at seg_sz_p. Values go at the address plus data_off
+   from the header. Caller should munmap the segment when done writing,
+   and leave removal to the consumer. On failure, print a message to
+   stderr and return NULL.
+ */
+void *Shm_Create(char *nm, size_t nm_sz, int xtype, size_t elem_sz,
+	int ndims, const size_t *shape, const void *fill, size_t *seg_sz_p)
+{
+    struct Shm_Hdr hdr;			/* Segment header */
+    uint64_t *dims;			/* Dimension lengths in segment */
+    size_t num_elem;			/* Number of values */
+    size_t seg_sz;			/* Size of segment */
+    void *seg;				/* Address of segment */
+    int fd = -1;			/* Segment file descriptor */
+    int gen;				/* If true, generate name */
+    int n, d;
+
+    if ( elem_sz > sizeof(hdr.fill) ) {
+	fprintf(stderr, "Values of %zu bytes not supported in shared "
+		"memory.\n", elem_sz);
+	return NULL;
+    }
+    for (num_elem = 1, d = 0; d < ndims; d++) {
+	num_elem *= shape[d];
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    strcpy(hdr.magic, SHM_MAGIC);
+    hdr.xtype = xtype;
+    hdr.elem_sz = elem_sz;
+    hdr.ndims = ndims;
+    hdr.num_elem = num_elem;
+    hdr.data_off = sizeof(hdr) + ndims * sizeof(uint64_t);
+    hdr.data_off = (hdr.data_off + SHM_ALIGN - 1) / SHM_ALIGN * SHM_ALIGN;
+    if ( fill ) {
+	hdr.have_fill = 1;
+	memcpy(hdr.fill, fill, elem_sz);
+    }
+    seg_sz = hdr.data_off + num_elem * elem_sz;
+
+    /* Names are process id and a counter, so concurrent runs do not clash */
+    gen = (nm[0] == '\0');
+    for (n = 0; n < SHM_TRIES; n++) {
+	if ( gen && snprintf(nm, nm_sz, "/nnetcdf.%ld.%d", (long)getpid(), n)
+		>= (int)nm_sz ) {
+	    fprintf(stderr, "No space for shared memory name.\n");
+	    return NULL;
+	}
+	if ( (fd = shm_open(nm, O_RDWR | O_CREAT | O_EXCL, 0600)) != -1
+		|| !gen || errno != EEXIST ) {
+	    break;
+	}
+    }
+    if ( fd == -1 ) {
+	fprintf(stderr, "Could not create shared memory %s.\n%s\n",
+		nm, strerror(errno));
+	return NULL;
+    }
+    if ( ftruncate(fd, seg_sz) == -1 ) {
+	fprintf(stderr, "Could not allocate %zu bytes of shared memory for "
+		"%s.\n%s\n", seg_sz, nm, strerror(errno));
+	close(fd);
+	shm_unlink(nm);
+	return NULL;
+    }
+    seg = mmap(NULL, seg_sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if ( seg == MAP_FAILED ) {
+	fprintf(stderr, "Could not map shared memory %s.\n%s\n",
+		nm, strerror(errno));
+	shm_unlink(nm);
+	return NULL;
+    }
+    memcpy(seg, &hdr, sizeof(hdr));
+    dims = (uint64_t *)((char *)seg + sizeof(hdr));
+    for (d = 0; d < ndims; d++) {
+	dims[d] = shape[d];
+    }
+    *seg_sz_p = seg_sz;
+    return seg;
+}
+
+/* Remove shared memory segment nm, e.g. after a failed export */
+void Shm_Unlink(const char *nm)
+{
+    shm_unlink(nm);
+}
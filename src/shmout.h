@@ -0,0 +1,70 @@
+/*
+   -	shmout.h --
+   -		Declarations for export of values in shared memory
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#ifndef SHMOUT_H_
+#define SHMOUT_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/*
+   Functions that put arrays of values in a POSIX shared memory segment,
+   so that another process on the same host can map them without copying
+   or parsing.
+
+   A segment starts with a struct Shm_Hdr, followed by ndims uint64_t
+   dimension lengths, followed by the values, in native byte order, at
+   offset data_off from the start of the segment. data_off is a multiple of
+   SHM_ALIGN.
+ */
+
+#define SHM_MAGIC "NNCSHM1"
+#define SHM_ALIGN 64
+
+struct Shm_Hdr {
+    char magic[8];			/* SHM_MAGIC, NUL terminated */
+    int32_t xtype;			/* NetCDF type of values */
+    uint32_t elem_sz;			/* Size of one value in bytes */
+    uint32_t ndims;			/* Number of dimensions */
+    uint32_t have_fill;			/* If true, fill holds a fill value */
+    uint64_t num_elem;			/* Number of values */
+    uint64_t data_off;			/* Offset of values in segment */
+    unsigned char fill[8];		/* Fill value, same type as values */
+};
+
+void *Shm_Create(char *, size_t, int, size_t, int, const size_t *,
+	const void *, size_t *);
+void Shm_Unlink(const char *);
+
+#endif
@@ -0,0 +1,198 @@
+/*
+   -	slab.c --
+   -		This file defines an iterator that visits a large
+   -		array in blocks of bounded size. See slab.h.
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#include <stdlib.h>
+#include "alloc.h"
+#include "slab.h"
+
+/*
+   Initialize slab to visit an array with ndims dimensions whose lengths are
+   given in len, in blocks of no more than max_elem elements. Blocks span as
+   many of the innermost dimensions as possible, so that each block is
+   contiguous in the file. Return 1 on success, 0 on failure.
+ */
+int Slab_Init(struct Slab *slab, int ndims, const size_t *len,
+	size_t max_elem)
+{
+    return Slab_Init_Box(slab, ndims, len, NULL, NULL, max_elem);
+}
+
+/*
+   Initialize slab to visit the box with ext elements along each dimension,
+   starting at index org, in an array with ndims dimensions whose lengths are
+   given in len. If org is NULL, the box starts at the beginning of the
+   array. If ext is NULL, the box extends to the end of each dimension. The
+   box is visited as Slab_Init visits a whole array. Block starts are
+   indeces in the whole array. Return 1 on success, 0 on failure.
+ */
+int Slab_Init_Box(struct Slab *slab, int ndims, const size_t *len,
+	const size_t *org, const size_t *ext, size_t max_elem)
+{
+    size_t *a;				/* Storage for slab arrays */
+    size_t inner;			/* Number of elements in dimensions
+					   inside current one */
+    int d, dd;
+
+    slab->ndims = ndims;
+    slab->len = slab->org = slab->ext = NULL;
+    slab->blk = slab->start = slab->count = NULL;
+    slab->state = 0;
+    if ( ndims == 0 ) {
+	return 1;
+    }
+    if ( !(a = CALLOC(6 * ndims, sizeof(size_t))) ) {
+	return 0;
+    }
+    slab->len = a;
+    slab->org = a + ndims;
+    slab->ext = a + 2 * ndims;
+    slab->blk = a + 3 * ndims;
+    slab->start = a + 4 * ndims;
+    slab->count = a + 5 * ndims;
+    if ( max_elem < 1 ) {
+	max_elem = 1;
+    }
+    for (d = 0; d < ndims; d++) {
+	slab->len[d] = len[d];
+	slab->org[d] = org ? org[d] : 0;
+	slab->ext[d] = ext ? ext[d] : len[d] - slab->org[d];
+	slab->start[d] = slab->org[d];
+	slab->blk[d] = 1;
+    }
+    for (inner = 1, d = ndims - 1; d >= 0; d--) {
+	if ( slab->ext[d] <= max_elem / inner ) {
+	    slab->blk[d] = (slab->ext[d] > 0) ? slab->ext[d] : 1;
+	    inner *= slab->blk[d];
+	} else {
+	    slab->blk[d] = max_elem / inner;
+	    for (dd = 0; dd < d; dd++) {
+		slab->blk[dd] = 1;
+	    }
+	    break;
+	}
+    }
+    return 1;
+}
+
+/*
+   Initialize slab to visit an array of ndims dimensions with lengths len in
+   blocks with blk elements along each dimension. Blocks at the end of a
+   dimension may be shorter. Return 1 on success, 0 if allocation fails.
+ */
+int Slab_Init_Blk(struct Slab *slab, int ndims, const size_t *len,
+	const size_t *blk)
+{
+    int d;
+
+    if ( !Slab_Init_Box(slab, ndims, len, NULL, NULL, 1) ) {
+	return 0;
+    }
+    for (d = 0; d < ndims; d++) {
+	slab->blk[d] = (blk[d] > 0) ? blk[d] : 1;
+    }
+    return 1;
+}
+
+/*
+   Advance slab to the next block. Set slab->start and slab->count for the
+   block and return the number of elements in it. Return 0 when there are no
+   more blocks.
+ */
+size_t Slab_Next(struct Slab *slab)
+{
+    size_t n;
+    int d;
+
+    if ( slab->state == -1 ) {
+	return 0;
+    }
+    if ( slab->state == 0 ) {
+	for (d = 0; d < slab->ndims; d++) {
+	    if ( slab->ext[d] == 0 ) {
+		slab->state = -1;
+		return 0;
+	    }
+	}
+	slab->state = 1;
+    } else {
+	for (d = slab->ndims - 1; d >= 0; d--) {
+	    slab->start[d] += slab->blk[d];
+	    if ( slab->start[d] < slab->org[d] + slab->ext[d] ) {
+		break;
+	    }
+	    slab->start[d] = slab->org[d];
+	}
+	if ( d < 0 ) {
+	    slab->state = -1;
+	    return 0;
+	}
+    }
+    for (n = 1, d = 0; d < slab->ndims; d++) {
+	slab->count[d] = slab->org[d] + slab->ext[d] - slab->start[d];
+	if ( slab->count[d] > slab->blk[d] ) {
+	    slab->count[d] = slab->blk[d];
+	}
+	n *= slab->count[d];
+    }
+    return n;
+}
+
+/*
+   Return the row major index in the whole array of element n of the current
+   block.
+ */
+size_t Slab_Offset(const struct Slab *slab, size_t n)
+{
+    size_t i, off, stride;
+    int d;
+
+    for (off = 0, stride = 1, d = slab->ndims - 1; d >= 0; d--) {
+	i = slab->start[d] + n % slab->count[d];
+	n /= slab->count[d];
+	off += i * stride;
+	stride *= slab->len[d];
+    }
+    return off;
+}
+
+/* Free memory associated with slab. */
+void Slab_Free(struct Slab *slab)
+{
+    if ( slab->len ) {
+	FREE(slab->len);
+    }
+    slab->len = slab->org = slab->ext = NULL;
+    slab->blk = slab->start = slab->count = NULL;
+}
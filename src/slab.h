@@ -0,0 +1,68 @@
+/*
+   -	slab.h --
+   -		This file declares an iterator that visits a large
+   -		array in blocks of bounded size.
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#ifndef SLAB_H_
+#define SLAB_H_
+
+#include <stdlib.h>
+
+/*
+   Block iterator. Visits an array of ndims dimensions, or a box within it,
+   in blocks of at most max_elem elements. Each block is a hyperslab suitable
+   for the start and count arguments of nc_get_vara_... Blocks are visited
+   in file order.
+ */
+
+struct Slab {
+    int ndims;				/* Number of dimensions */
+    size_t *len;			/* Length of each dimension */
+    size_t *org;			/* Start of box to visit */
+    size_t *ext;			/* Size of box to visit */
+    size_t *blk;			/* Block length along each dimension */
+    size_t *start;			/* Start of current block */
+    size_t *count;			/* Size of current block */
+    int state;				/* 0 before first block, 1 while
+					   visiting, -1 when done */
+};
+
+int Slab_Init(struct Slab *, int, const size_t *, size_t);
+int Slab_Init_Box(struct Slab *, int, const size_t *, const size_t *,
+	const size_t *, size_t);
+int Slab_Init_Blk(struct Slab *, int, const size_t *, const size_t *);
+size_t Slab_Next(struct Slab *);
+size_t Slab_Offset(const struct Slab *, size_t);
+void Slab_Free(struct Slab *);
+
+#endif
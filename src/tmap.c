@@ -0,0 +1,365 @@
+/*
+   -	tmap.c --
+   -		Maps of tile difference statistics. See tmap.h
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <netcdf.h>
+#include "alloc.h"
+#include "tmap.h"
+
+static size_t tile_elem(const struct Tmap *, size_t);
+
+/*
+   Initialize tm for arrays with ndims dimensions of lengths len, with
+   tiles of ty by tx elements over the last two dimensions. If ndims is 1,
+   tiles are tx elements long. Return 1 on success. On failure, return 0
+   and print a message to stderr.
+ */
+int Tmap_Init(struct Tmap *tm, int ndims, const size_t *len, size_t ty,
+	size_t tx)
+{
+    int d;
+
+    memset(tm, 0, sizeof(struct Tmap));
+    if ( ty == 0 || tx == 0 || ty > INT_MAX / tx ) {
+	fprintf(stderr, "Tile size %zu by %zu is out of range.\n", ty, tx);
+	return 0;
+    }
+    tm->ndims = ndims;
+    tm->ty = (ndims >= 2) ? ty : 1;
+    tm->tx = (ndims >= 1) ? tx : 1;
+    for (tm->n_lead = 1, d = 0; d < ndims - 2; d++) {
+	tm->n_lead *= len[d];
+    }
+    tm->nty = (ndims >= 2) ? (len[ndims - 2] + ty - 1) / ty : 1;
+    tm->ntx = (ndims >= 1) ? (len[ndims - 1] + tx - 1) / tx : 1;
+    tm->n_tiles = tm->n_lead * tm->nty * tm->ntx;
+    if ( !(tm->len = CALLOC(ndims + 1, sizeof(size_t)))
+	    || !(tm->idx = CALLOC(ndims + 1, sizeof(size_t)))
+	    || (tm->n_tiles > 0
+		&& !(tm->tiles = CALLOC(tm->n_tiles,
+			sizeof(struct Tmap_Tile)))) ) {
+	fprintf(stderr, "Could not allocate map for %zu tiles.\n",
+		tm->n_tiles);
+	Tmap_Free(tm);
+	return 0;
+    }
+    for (d = 0; d < ndims; d++) {
+	tm->len[d] = len[d];
+    }
+    return 1;
+}
+
+/*
+   Add the first n values of the block of x1 and x2 at slab to tm. Values
+   with absolute value greater than or equal to ign are skipped. The values
+   are in the order the slab iterator returns them, so the first n values
+   of a block can be added if the rest of the block is not compared.
+ */
+void Tmap_Block(struct Tmap *tm, const double *x1, const double *x2,
+	size_t n, const struct Slab *slab, double ign)
+{
+    int nd = tm->ndims;
+    size_t *idx = tm->idx;		/* Index of row in block */
+    size_t row_len;			/* Length of a row in block */
+    size_t lead;			/* Offset of row in leading
+					   dimensions */
+    size_t y, x;			/* Index along last two dimensions */
+    struct Tmap_Tile *row_tiles;	/* First tile in row of tiles */
+    struct Tmap_Tile *t;
+    double v1, v2, d, ad;
+    size_t i, j;
+    int k;
+
+    row_len = (nd >= 1) ? slab->count[nd - 1] : 1;
+    for (k = 0; k < nd; k++) {
+	idx[k] = 0;
+    }
+    for (i = 0; i < n; ) {
+	for (lead = 0, k = 0; k < nd - 2; k++) {
+	    lead = lead * tm->len[k] + slab->start[k] + idx[k];
+	}
+	y = (nd >= 2) ? slab->start[nd - 2] + idx[nd - 2] : 0;
+	x = (nd >= 1) ? slab->start[nd - 1] : 0;
+	row_tiles = tm->tiles + (lead * tm->nty + y / tm->ty) * tm->ntx;
+	for (j = 0; j < row_len && i < n; j++, i++, x++) {
+	    v1 = x1[i];
+	    v2 = x2[i];
+	    if ( !(fabs(v1) < ign && fabs(v2) < ign) ) {
+		continue;
+	    }
+	    t = row_tiles + x / tm->tx;
+	    d = v2 - v1;
+	    t->n++;
+	    t->sum += d;
+	    t->sum2 += d * d;
+	    if ( d != 0.0 ) {
+		t->n_diff++;
+		if ( (ad = fabs(d)) > t->max_abs ) {
+		    t->max_abs = ad;
+		}
+	    }
+	}
+
+	/* Go to next row */
+	for (k = nd - 2; k >= 0; k--) {
+	    if ( ++idx[k] < slab->count[k] ) {
+		break;
+	    }
+	    idx[k] = 0;
+	}
+    }
+}
+
+/*
+   Write n_maps maps to a new NetCDF file at path. Map i compares variable
+   var_nm in file paths[i] with the same variable in reference file ref.
+   The file has variables n, n_diff, bias, rms, and max_abs, each with a
+   member dimension followed by the leading dimensions of the arrays and
+   the tile dimensions. Tiles with no values compared are filled. For maps
+   marked same, n is the number of values in each tile and the other
+   statistics are 0. Return 1 on success. On failure, return 0 and print a
+   message to stderr.
+ */
+int Tmap_Write(const char *path, const char *var_nm, const char *ref,
+	char **paths, const struct Tmap *maps, int n_maps)
+{
+    const struct Tmap *tm = maps;
+    int nc_id;
+    int status;
+    int dim_ids[NC_MAX_VAR_DIMS];	/* Dimensions of output variables */
+    int n_dims;				/* Number of output dimensions */
+    int path_dim_ids[2];		/* Dimensions of file variable */
+    char dim_nm[NC_MAX_NAME];
+    int file_id, n_id, n_diff_id, bias_id, rms_id, max_abs_id;
+    size_t path_len;			/* Maximum length of a path */
+    size_t start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS];
+    size_t p_start[2], p_count[2];	/* Location of path in file
+					   variable */
+    int ti[2];				/* Tile size */
+    int *ibuf1 = NULL, *ibuf2 = NULL;	/* Output buffers */
+    double *dbuf1 = NULL, *dbuf2 = NULL, *dbuf3 = NULL;
+    const struct Tmap_Tile *t;
+    size_t i;
+    int m, d;
+
+    if ( tm->ndims + 1 > NC_MAX_VAR_DIMS ) {
+	fprintf(stderr, "Too many dimensions for map in %s.\n", path);
+	return 0;
+    }
+    if ( (status = nc_create(path, NC_CLOBBER | NC_64BIT_OFFSET, &nc_id))
+	    != NC_NOERR ) {
+	fprintf(stderr, "Could not create %s.\n%s\n", path,
+		nc_strerror(status));
+	return 0;
+    }
+    for (path_len = 1, m = 0; m < n_maps; m++) {
+	if ( strlen(paths[m]) + 1 > path_len ) {
+	    path_len = strlen(paths[m]) + 1;
+	}
+    }
+    ti[0] = tm->ty;
+    ti[1] = tm->tx;
+
+    /* Define dimensions, variables, and attributes */
+    n_dims = 0;
+    status = nc_def_dim(nc_id, "member", n_maps, dim_ids + n_dims++);
+    for (d = 0; status == NC_NOERR && d < tm->ndims - 2; d++) {
+	snprintf(dim_nm, NC_MAX_NAME, "dim%d", d);
+	status = nc_def_dim(nc_id, dim_nm, tm->len[d], dim_ids + n_dims++);
+    }
+    if ( status == NC_NOERR && tm->ndims >= 2 ) {
+	status = nc_def_dim(nc_id, "tile_y", tm->nty, dim_ids + n_dims++);
+    }
+    if ( status == NC_NOERR && tm->ndims >= 1 ) {
+	status = nc_def_dim(nc_id, "tile_x", tm->ntx, dim_ids + n_dims++);
+    }
+    path_dim_ids[0] = dim_ids[0];
+    if ( status == NC_NOERR ) {
+	status = nc_def_dim(nc_id, "path_len", path_len, path_dim_ids + 1);
+    }
+    if ( status == NC_NOERR ) {
+	status = nc_def_var(nc_id, "file", NC_CHAR, 2, path_dim_ids, &file_id);
+    }
+    if ( status == NC_NOERR ) {
+	status = nc_def_var(nc_id, "n", NC_INT, n_dims, dim_ids, &n_id);
+    }
+    if ( status == NC_NOERR ) {
+	status = nc_def_var(nc_id, "n_diff", NC_INT, n_dims, dim_ids,
+		&n_diff_id);
+    }
+    if ( status == NC_NOERR ) {
+	status = nc_def_var(nc_id, "bias", NC_DOUBLE, n_dims, dim_ids,
+		&bias_id);
+    }
+    if ( status == NC_NOERR ) {
+	status = nc_def_var(nc_id, "rms", NC_DOUBLE, n_dims, dim_ids,
+		&rms_id);
+    }
+    if ( status == NC_NOERR ) {
+	status = nc_def_var(nc_id, "max_abs", NC_DOUBLE, n_dims, dim_ids,
+		&max_abs_id);
+    }
+    if ( status == NC_NOERR ) {
+	status = nc_put_att_text(nc_id, NC_GLOBAL, "variable",
+		strlen(var_nm), var_nm);
+    }
+    if ( status == NC_NOERR ) {
+	status = nc_put_att_text(nc_id, NC_GLOBAL, "reference",
+		strlen(ref), ref);
+    }
+    if ( status == NC_NOERR ) {
+	status = nc_put_att_int(nc_id, NC_GLOBAL, "tile_size", NC_INT, 2, ti);
+    }
+    if ( status == NC_NOERR ) {
+	status = nc_enddef(nc_id);
+    }
+    if ( status != NC_NOERR ) {
+	fprintf(stderr, "Could not define map in %s.\n%s\n", path,
+		nc_strerror(status));
+	nc_close(nc_id);
+	return 0;
+    }
+
+    /* Write one member at a time */
+    if ( tm->n_tiles > 0
+	    && (!(ibuf1 = CALLOC(tm->n_tiles, sizeof(int)))
+		|| !(ibuf2 = CALLOC(tm->n_tiles, sizeof(int)))
+		|| !(dbuf1 = CALLOC(tm->n_tiles, sizeof(double)))
+		|| !(dbuf2 = CALLOC(tm->n_tiles, sizeof(double)))
+		|| !(dbuf3 = CALLOC(tm->n_tiles, sizeof(double)))) ) {
+	fprintf(stderr, "Could not allocate output buffers for map.\n");
+	status = NC_ENOMEM;
+	goto done;
+    }
+    for (d = 1; d < n_dims; d++) {
+	start[d] = 0;
+    }
+    count[0] = p_count[0] = 1;
+    p_start[1] = 0;
+    for (d = 1; d < n_dims - (tm->ndims >= 2) - (tm->ndims >= 1); d++) {
+	count[d] = tm->len[d - 1];
+    }
+    if ( tm->ndims >= 2 ) {
+	count[d++] = tm->nty;
+    }
+    if ( tm->ndims >= 1 ) {
+	count[d++] = tm->ntx;
+    }
+    for (m = 0; m < n_maps; m++) {
+	tm = maps + m;
+	start[0] = m;
+	for (i = 0; i < tm->n_tiles; i++) {
+	    t = tm->tiles + i;
+	    if ( tm->same ) {
+		ibuf1[i] = tile_elem(tm, i);
+		ibuf2[i] = 0;
+		dbuf1[i] = dbuf2[i] = dbuf3[i] = 0.0;
+	    } else if ( t->n == 0 ) {
+		ibuf1[i] = ibuf2[i] = 0;
+		dbuf1[i] = dbuf2[i] = dbuf3[i] = NC_FILL_DOUBLE;
+	    } else {
+		ibuf1[i] = t->n;
+		ibuf2[i] = t->n_diff;
+		dbuf1[i] = t->sum / t->n;
+		dbuf2[i] = sqrt(t->sum2 / t->n);
+		dbuf3[i] = t->max_abs;
+	    }
+	}
+	p_start[0] = m;
+	p_count[1] = strlen(paths[m]) + 1;
+	if ( (status = nc_put_vara_text(nc_id, file_id, p_start, p_count,
+			paths[m])) != NC_NOERR ) {
+	    break;
+	}
+	if ( tm->n_tiles == 0 ) {
+	    continue;
+	}
+	if ( (status = nc_put_vara_int(nc_id, n_id, start, count, ibuf1))
+		!= NC_NOERR
+		|| (status = nc_put_vara_int(nc_id, n_diff_id, start, count,
+			ibuf2)) != NC_NOERR
+		|| (status = nc_put_vara_double(nc_id, bias_id, start, count,
+			dbuf1)) != NC_NOERR
+		|| (status = nc_put_vara_double(nc_id, rms_id, start, count,
+			dbuf2)) != NC_NOERR
+		|| (status = nc_put_vara_double(nc_id, max_abs_id, start,
+			count, dbuf3)) != NC_NOERR ) {
+	    break;
+	}
+    }
+    if ( status != NC_NOERR ) {
+	fprintf(stderr, "Could not write map to %s.\n%s\n", path,
+		nc_strerror(status));
+    }
+
+done:
+    FREE(ibuf1);
+    FREE(ibuf2);
+    FREE(dbuf1);
+    FREE(dbuf2);
+    FREE(dbuf3);
+    if ( nc_close(nc_id) != NC_NOERR ) {
+	fprintf(stderr, "Could not close %s.\n", path);
+	return 0;
+    }
+    return status == NC_NOERR;
+}
+
+/* Free memory associated with tm. */
+void Tmap_Free(struct Tmap *tm)
+{
+    FREE(tm->len);
+    FREE(tm->idx);
+    FREE(tm->tiles);
+    memset(tm, 0, sizeof(struct Tmap));
+}
+
+/*
+   Return the number of array elements in tile i of tm. Tiles at the ends
+   of the last two dimensions may be partial.
+ */
+static size_t tile_elem(const struct Tmap *tm, size_t i)
+{
+    size_t ny, nx;			/* Elements left from start of tile */
+
+    ny = (tm->ndims >= 2)
+	? tm->len[tm->ndims - 2] - i / tm->ntx % tm->nty * tm->ty : 1;
+    nx = (tm->ndims >= 1) ? tm->len[tm->ndims - 1] - i % tm->ntx * tm->tx : 1;
+    return ((ny < tm->ty) ? ny : tm->ty) * ((nx < tm->tx) ? nx : tm->tx);
+}
@@ -0,0 +1,77 @@
+/*
+   -	tmap.h --
+   -		Declarations for maps of tile difference statistics
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#ifndef TMAP_H_
+#define TMAP_H_
+
+#include <stdlib.h>
+#include "slab.h"
+
+/*
+   A tile map accumulates statistics of the differences between two
+   arrays in tiles of ty by tx elements over the last two dimensions.
+   Leading dimensions are kept, so the map has the shape of the arrays
+   with the last two dimensions divided into tiles.
+ */
+
+struct Tmap_Tile {
+    size_t n;				/* Number of values compared */
+    size_t n_diff;			/* Number of values that differ */
+    double sum, sum2;			/* Sum of differences and of squares
+					   of differences */
+    double max_abs;			/* Maximum absolute difference */
+};
+
+struct Tmap {
+    int ndims;				/* Number of dimensions of arrays */
+    size_t *len;			/* Dimension lengths of arrays */
+    size_t ty, tx;			/* Tile size */
+    size_t n_lead;			/* Product of leading dimensions */
+    size_t nty, ntx;			/* Number of tiles along last two
+					   dimensions */
+    size_t n_tiles;			/* Number of tiles */
+    int same;				/* If true, arrays are known to be
+					   the same without being compared */
+    struct Tmap_Tile *tiles;		/* Tile statistics */
+    size_t *idx;			/* Scratch index for Tmap_Block */
+};
+
+int Tmap_Init(struct Tmap *, int, const size_t *, size_t, size_t);
+void Tmap_Block(struct Tmap *, const double *, const double *, size_t,
+	const struct Slab *, double);
+int Tmap_Write(const char *, const char *, const char *, char **,
+	const struct Tmap *, int);
+void Tmap_Free(struct Tmap *);
+
+#endif
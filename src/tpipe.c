@@ -0,0 +1,290 @@
+/*
+   -	tpipe.c --
+   -		Threaded read, format, write pipeline
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "alloc.h"
+#include "obuf.h"
+#include "tpipe.h"
+
+/*
+   A slot holds one block as it moves through the pipeline. Block number
+   seq uses slot seq % n_slots, so blocks leave the pipeline in the order
+   they entered it.
+ */
+
+enum Slot_State {
+    SLOT_FREE,				/* Available to reader */
+    SLOT_READ,				/* Has data, waiting for a formatter */
+    SLOT_BUSY,				/* Being formatted */
+    SLOT_DONE				/* Has text, waiting for writer */
+};
+
+struct Slot {
+    enum Slot_State state;
+    void *dat;				/* Block values */
+    size_t n;				/* Number of values in dat */
+    size_t i;				/* Index of first value of block in
+					   output */
+    struct Obuf ob;			/* Text for dat */
+};
+
+struct Tpipe {
+    pthread_mutex_t mtx;		/* Protects everything below */
+    pthread_cond_t cond;		/* Signals change of slot state */
+    struct Slot *slots;
+    size_t n_slots;
+    size_t n_rd;			/* Number of blocks read */
+    size_t n_fmt;			/* Number of blocks given to formatters */
+    size_t n_wr;			/* Number of blocks written */
+    int eof;				/* If true, reader is done */
+    int err;				/* If true, a stage failed */
+    int fd;				/* Output file descriptor */
+    int (*fmt)(void *, const void *, size_t, size_t, struct Obuf *);
+    void *ctx;				/* Argument for rd and fmt */
+};
+
+static void *fmt_thread(void *);
+static void *wr_thread(void *);
+
+/*
+   Run a pipeline that sends text to file descriptor fd. The calling thread
+   obtains blocks with rd(ctx, buf, &n, &i), which should put up to
+   blk_sz bytes of values in buf, the number of values in n, and the index
+   of the first value in the output in i. rd should set n to 0 when there
+   are no more blocks. rd returns 1 on success, 0 on failure. n_fmt threads
+   convert the blocks to text with fmt(ctx, buf, n, i, ob), which appends
+   the text to ob and returns 1 on success, 0 on failure. ob has room for
+   txt_sz bytes, and grows if fmt appends more. Another thread writes the
+   text to fd in block order.
+
+   Return 1 on success. On failure, print a message to stderr and return 0.
+ */
+int Tpipe_Run(int fd, int n_fmt, size_t blk_sz, size_t txt_sz,
+	int (*rd)(void *, void *, size_t *, size_t *),
+	int (*fmt)(void *, const void *, size_t, size_t, struct Obuf *),
+	void *ctx)
+{
+    struct Tpipe tp;
+    struct Slot *slot;
+    pthread_t *fmt_tids = NULL;		/* Formatter threads */
+    pthread_t wr_tid;			/* Writer thread */
+    int n_tids = 0;			/* Number of formatter threads
+					   started */
+    int have_wr = 0;			/* If true, writer thread started */
+    size_t s;
+    size_t n, i;
+    void *dat;
+    int status;
+    int ok = 0;				/* Return value */
+
+    if ( n_fmt < 1 ) {
+	n_fmt = 1;
+    }
+    memset(&tp, 0, sizeof(tp));
+    tp.fd = fd;
+    tp.fmt = fmt;
+    tp.ctx = ctx;
+
+    /*
+       Two slots per formatter keeps every formatter busy while the writer
+       and reader work on other slots.
+     */
+
+    tp.n_slots = 2 * (size_t)n_fmt + 2;
+    if ( !(tp.slots = CALLOC(tp.n_slots, sizeof(struct Slot))) ) {
+	fprintf(stderr, "Could not allocate %zu pipeline slots.\n",
+		tp.n_slots);
+	return 0;
+    }
+    for (s = 0; s < tp.n_slots; s++) {
+	tp.slots[s].state = SLOT_FREE;
+	if ( !(tp.slots[s].dat = MALLOC(blk_sz > 0 ? blk_sz : 1))
+		|| !Obuf_Init(&tp.slots[s].ob, -1, txt_sz) ) {
+	    fprintf(stderr, "Could not allocate buffers for pipeline.\n");
+	    goto error;
+	}
+    }
+    if ( !(fmt_tids = CALLOC(n_fmt, sizeof(pthread_t))) ) {
+	fprintf(stderr, "Could not allocate identifiers for %d formatter "
+		"threads.\n", n_fmt);
+	goto error;
+    }
+    pthread_mutex_init(&tp.mtx, NULL);
+    pthread_cond_init(&tp.cond, NULL);
+    if ( (status = pthread_create(&wr_tid, NULL, wr_thread, &tp)) != 0 ) {
+	fprintf(stderr, "Could not start writer thread.\n%s\n",
+		strerror(status));
+	goto stop;
+    }
+    have_wr = 1;
+    for (n_tids = 0; n_tids < n_fmt; n_tids++) {
+	status = pthread_create(fmt_tids + n_tids, NULL, fmt_thread, &tp);
+	if ( status != 0 ) {
+	    fprintf(stderr, "Could not start formatter thread.\n%s\n",
+		    strerror(status));
+	    goto stop;
+	}
+    }
+
+    /*
+       Read blocks into free slots. The reader owns a slot from when it
+       becomes free until it is marked read, so it reads without the lock.
+     */
+
+    while (1) {
+	pthread_mutex_lock(&tp.mtx);
+	slot = tp.slots + tp.n_rd % tp.n_slots;
+	while ( !tp.err && slot->state != SLOT_FREE ) {
+	    pthread_cond_wait(&tp.cond, &tp.mtx);
+	}
+	if ( tp.err ) {
+	    pthread_mutex_unlock(&tp.mtx);
+	    break;
+	}
+	dat = slot->dat;
+	pthread_mutex_unlock(&tp.mtx);
+	if ( !rd(ctx, dat, &n, &i) ) {
+	    goto stop;
+	}
+	pthread_mutex_lock(&tp.mtx);
+	if ( n == 0 ) {
+	    tp.eof = 1;
+	    pthread_cond_broadcast(&tp.cond);
+	    pthread_mutex_unlock(&tp.mtx);
+	    break;
+	}
+	slot->n = n;
+	slot->i = i;
+	slot->state = SLOT_READ;
+	tp.n_rd++;
+	pthread_cond_broadcast(&tp.cond);
+	pthread_mutex_unlock(&tp.mtx);
+    }
+    goto join;
+
+stop:
+    pthread_mutex_lock(&tp.mtx);
+    tp.err = 1;
+    pthread_cond_broadcast(&tp.cond);
+    pthread_mutex_unlock(&tp.mtx);
+
+join:
+    for ( ; n_tids > 0; n_tids--) {
+	pthread_join(fmt_tids[n_tids - 1], NULL);
+    }
+    if ( have_wr ) {
+	pthread_join(wr_tid, NULL);
+    }
+    pthread_cond_destroy(&tp.cond);
+    pthread_mutex_destroy(&tp.mtx);
+    ok = have_wr && !tp.err;
+
+error:
+    for (s = 0; s < tp.n_slots; s++) {
+	FREE(tp.slots[s].dat);
+	Obuf_Free(&tp.slots[s].ob);
+    }
+    FREE(tp.slots);
+    FREE(fmt_tids);
+    return ok;
+}
+
+/* Convert blocks to text, in any order, until the reader is done */
+static void *fmt_thread(void *arg)
+{
+    struct Tpipe *tp = arg;
+    struct Slot *slot;
+    int ok;
+
+    pthread_mutex_lock(&tp->mtx);
+    while (1) {
+	while ( !tp->err && !tp->eof && tp->n_fmt == tp->n_rd ) {
+	    pthread_cond_wait(&tp->cond, &tp->mtx);
+	}
+	if ( tp->err || tp->n_fmt == tp->n_rd ) {
+	    break;
+	}
+	slot = tp->slots + tp->n_fmt % tp->n_slots;
+	slot->state = SLOT_BUSY;
+	tp->n_fmt++;
+	pthread_mutex_unlock(&tp->mtx);
+	slot->ob.len = 0;
+	ok = tp->fmt(tp->ctx, slot->dat, slot->n, slot->i, &slot->ob);
+	pthread_mutex_lock(&tp->mtx);
+	if ( !ok ) {
+	    tp->err = 1;
+	} else {
+	    slot->state = SLOT_DONE;
+	}
+	pthread_cond_broadcast(&tp->cond);
+    }
+    pthread_mutex_unlock(&tp->mtx);
+    return NULL;
+}
+
+/* Write text from blocks in the order they were read */
+static void *wr_thread(void *arg)
+{
+    struct Tpipe *tp = arg;
+    struct Slot *slot;
+    int ok;
+
+    pthread_mutex_lock(&tp->mtx);
+    while (1) {
+	slot = tp->slots + tp->n_wr % tp->n_slots;
+	while ( !tp->err && slot->state != SLOT_DONE
+		&& !(tp->eof && tp->n_wr == tp->n_rd) ) {
+	    pthread_cond_wait(&tp->cond, &tp->mtx);
+	}
+	if ( tp->err || slot->state != SLOT_DONE ) {
+	    break;
+	}
+	pthread_mutex_unlock(&tp->mtx);
+	ok = Obuf_Send(&slot->ob, tp->fd);
+	pthread_mutex_lock(&tp->mtx);
+	if ( !ok ) {
+	    tp->err = 1;
+	} else {
+	    slot->state = SLOT_FREE;
+	    tp->n_wr++;
+	}
+	pthread_cond_broadcast(&tp->cond);
+    }
+    pthread_mutex_unlock(&tp->mtx);
+    return NULL;
+}
@@ -0,0 +1,122 @@
+/*
+   -	varstat.c --
+   -		Summary statistics of a variable
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#include <math.h>
+#include "diffstat.h"
+#include "varstat.h"
+
+/* Initialize stats for a variable with no values */
+void Var_Stats_Init(struct Var_Stats *stats)
+{
+    stats->n = stats->n_fill = 0;
+    stats->min = stats->max = NAN;
+    stats->mean = stats->ss = 0.0;
+}
+
+/*
+   Compute statistics for the n values in array x and store them in stats,
+   replacing its previous contents. If have_fill is true, values equal to
+   fill are fill values. NaN values are always fill values.
+
+   As in Diff_Block, pass 1 gets counts, sums, and extrema, and pass 2 gets
+   deviations from the mean. Both passes run over memory the caller has
+   already filled, so the file is only read once.
+ */
+void Var_Stats_Block(struct Var_Stats *stats, const double *x, size_t n,
+	int have_fill, double fill)
+{
+    double s, e, v;
+    double min = INFINITY, max = -INFINITY;
+    size_t n_valid;
+    size_t i;
+
+    Var_Stats_Init(stats);
+    if ( n == 0 ) {
+	return;
+    }
+
+    /* Pass 1 - counts, sums, extrema */
+    for (s = 0.0, n_valid = 0, i = 0; i < n; i++) {
+	v = x[i];
+	if ( isnan(v) || (have_fill && v == fill) ) {
+	    continue;
+	}
+	s += v;
+	min = (v < min) ? v : min;
+	max = (v > max) ? v : max;
+	n_valid++;
+    }
+    stats->n = n_valid;
+    stats->n_fill = n - n_valid;
+    if ( n_valid == 0 ) {
+	return;
+    }
+    stats->min = min;
+    stats->max = max;
+    stats->mean = s / n_valid;
+
+    /* Pass 2 - second moment */
+    for (s = 0.0, i = 0; i < n; i++) {
+	v = x[i];
+	if ( isnan(v) || (have_fill && v == fill) ) {
+	    continue;
+	}
+	e = v - stats->mean;
+	s += e * e;
+    }
+    stats->ss = s;
+}
+
+/* Add the statistics in b to a */
+void Var_Stats_Merge(struct Var_Stats *a, const struct Var_Stats *b)
+{
+    if ( b->n > 0 ) {
+	if ( a->n == 0 ) {
+	    a->min = b->min;
+	    a->max = b->max;
+	} else {
+	    a->min = (b->min < a->min) ? b->min : a->min;
+	    a->max = (b->max > a->max) ? b->max : a->max;
+	}
+    }
+    Diff_Merge_Moments(a->n, &a->mean, &a->ss, b->n, b->mean, b->ss);
+    a->n += b->n;
+    a->n_fill += b->n_fill;
+}
+
+/* Return sample standard deviation of valid values in stats */
+double Var_Stats_SD(const struct Var_Stats *stats)
+{
+    return (stats->n > 1) ? sqrt(stats->ss / (stats->n - 1)) : NAN;
+}
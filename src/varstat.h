@@ -0,0 +1,59 @@
+/*
+   -	varstat.h --
+   -		Declarations for summary statistics of a variable
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#ifndef VARSTAT_H_
+#define VARSTAT_H_
+
+#include <stdlib.h>
+
+/*
+   Summary statistics for the values of a variable. Fill values are counted
+   but otherwise ignored.
+ */
+
+struct Var_Stats {
+    size_t n;				/* Number of valid values */
+    size_t n_fill;			/* Number of fill values */
+    double min, max;			/* Extrema of valid values */
+    double mean;			/* Mean of valid values */
+    double ss;				/* Sum of squared deviations from
+					   mean */
+};
+
+void Var_Stats_Init(struct Var_Stats *);
+void Var_Stats_Block(struct Var_Stats *, const double *, size_t, int, double);
+void Var_Stats_Merge(struct Var_Stats *, const struct Var_Stats *);
+double Var_Stats_SD(const struct Var_Stats *);
+
+#endif
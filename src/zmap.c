@@ -0,0 +1,446 @@
+/*
+   -	zmap.c --
+   -		Zone maps, per block extrema of a variable
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#define _XOPEN_SOURCE 700		/* For st_mtim */
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/stat.h>
+#include "alloc.h"
+#include "zmap.h"
+
+static int rd_all(FILE *, void *, size_t);
+static int64_t mtime_ns(const struct stat *);
+
+/*
+   Initialize zone map zm for variable var_nm with ndims dimensions of
+   lengths len, divided into blocks of lengths blk. Block summaries are
+   allocated but not set. Return 1 on success. On failure, print a message
+   to stderr and return 0.
+ */
+int Zmap_Init(struct Zmap *zm, const char *var_nm, int ndims,
+	const size_t *len, const size_t *blk)
+{
+    int d;
+
+    memset(zm, 0, sizeof(struct Zmap));
+    zm->ndims = ndims;
+    if ( !(zm->var_nm = MALLOC(strlen(var_nm) + 1))
+	    || !(zm->len = CALLOC(ndims + 1, sizeof(size_t)))
+	    || !(zm->blk = CALLOC(ndims + 1, sizeof(size_t)))
+	    || !(zm->n_blk_d = CALLOC(ndims + 1, sizeof(size_t))) ) {
+	fprintf(stderr, "Could not allocate zone map for %s.\n", var_nm);
+	Zmap_Free(zm);
+	return 0;
+    }
+    strcpy(zm->var_nm, var_nm);
+    for (zm->n_blk = 1, d = 0; d < ndims; d++) {
+	zm->len[d] = len[d];
+	zm->blk[d] = (blk[d] > 0) ? blk[d] : 1;
+	zm->n_blk_d[d] = (len[d] + zm->blk[d] - 1) / zm->blk[d];
+	zm->n_blk *= zm->n_blk_d[d];
+    }
+    if ( !(zm->blks = CALLOC(zm->n_blk + 1, sizeof(struct Zmap_Blk))) ) {
+	fprintf(stderr, "Could not allocate zone map with %zu blocks for "
+		"%s.\n", zm->n_blk, var_nm);
+	Zmap_Free(zm);
+	return 0;
+    }
+    return 1;
+}
+
+/*
+   Store in zb the extrema and fill count of the n values in x. If
+   have_fill is true, values equal to fill are fill values. NaN values are
+   always fill values.
+ */
+void Zmap_Scan(struct Zmap_Blk *zb, const double *x, size_t n, int have_fill,
+	double fill)
+{
+    double min = INFINITY, max = -INFINITY;
+    size_t n_fill = 0;
+    double v;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+	v = x[i];
+	if ( isnan(v) || (have_fill && v == fill) ) {
+	    n_fill++;
+	    continue;
+	}
+	min = (v < min) ? v : min;
+	max = (v > max) ? v : max;
+    }
+    zb->min = (n_fill < n) ? min : NAN;
+    zb->max = (n_fill < n) ? max : NAN;
+    zb->n_fill = n_fill;
+}
+
+/*
+   Write zone map zm for source file src to file path. Data go to a
+   temporary file which then replaces path, so a reader never sees a
+   partial zone map. Return 1 on success. On failure, print a message to
+   stderr and return 0.
+ */
+int Zmap_Write(const struct Zmap *zm, const char *path, const char *src)
+{
+    struct Zmap_Hdr hdr;
+    struct stat sbuf;
+    char *tmp;				/* Temporary file */
+    int fd;
+    FILE *out = NULL;
+    int err;				/* Error from writes */
+    char pad[8] = {0};
+    uint64_t u;
+    size_t l;
+    int d;
+
+    if ( stat(src, &sbuf) == -1 ) {
+	fprintf(stderr, "Could not get status of %s.\n%s\n",
+		src, strerror(errno));
+	return 0;
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, ZMAP_MAGIC, sizeof(hdr.magic));
+    hdr.src_size = sbuf.st_size;
+    hdr.src_mtime = mtime_ns(&sbuf);
+    hdr.ndims = zm->ndims;
+    hdr.name_len = l = strlen(zm->var_nm);
+    hdr.n_blk = zm->n_blk;
+    if ( !(tmp = MALLOC(strlen(path) + 8)) ) {
+	fprintf(stderr, "Could not allocate name for temporary file.\n");
+	return 0;
+    }
+    sprintf(tmp, "%s.XXXXXX", path);
+    if ( (fd = mkstemp(tmp)) == -1 || !(out = fdopen(fd, "wb")) ) {
+	fprintf(stderr, "Could not open %s for writing.\n%s\n",
+		tmp, strerror(errno));
+	if ( fd != -1 ) {
+	    close(fd);
+	    unlink(tmp);
+	}
+	FREE(tmp);
+	return 0;
+    }
+    fwrite(&hdr, sizeof(hdr), 1, out);
+    fwrite(zm->var_nm, 1, l, out);
+    fwrite(pad, 1, (8 - l % 8) % 8, out);
+    for (d = 0; d < zm->ndims; d++) {
+	u = zm->len[d];
+	fwrite(&u, sizeof(u), 1, out);
+    }
+    for (d = 0; d < zm->ndims; d++) {
+	u = zm->blk[d];
+	fwrite(&u, sizeof(u), 1, out);
+    }
+    fwrite(zm->blks, sizeof(struct Zmap_Blk), zm->n_blk, out);
+    err = ferror(out);
+    if ( fclose(out) == EOF || err ) {
+	fprintf(stderr, "Could not write zone map to %s.\n%s\n",
+		tmp, strerror(errno));
+	unlink(tmp);
+	FREE(tmp);
+	return 0;
+    }
+    if ( rename(tmp, path) == -1 ) {
+	fprintf(stderr, "Could not move zone map %s to %s.\n%s\n",
+		tmp, path, strerror(errno));
+	unlink(tmp);
+	FREE(tmp);
+	return 0;
+    }
+    FREE(tmp);
+    return 1;
+}
+
+/*
+   Read zone map for variable var_nm in source file src from file path into
+   zm. Return 1 on success. Return 0 if path does not exist, or if src has
+   changed since the zone map was made, or if the zone map is for another
+   variable. On other failures, print a message to stderr and return -1.
+ */
+int Zmap_Read(struct Zmap *zm, const char *path, const char *src,
+	const char *var_nm)
+{
+    struct Zmap_Hdr hdr;
+    struct stat sbuf;
+    FILE *in;
+    char *nm = NULL;
+    uint64_t *u = NULL;
+    size_t *len = NULL, *blk = NULL;
+    size_t l;
+    int d;
+    int status = -1;
+
+    if ( stat(src, &sbuf) == -1 ) {
+	fprintf(stderr, "Could not get status of %s.\n%s\n",
+		src, strerror(errno));
+	return -1;
+    }
+    if ( !(in = fopen(path, "rb")) ) {
+	if ( errno == ENOENT ) {
+	    return 0;
+	}
+	fprintf(stderr, "Could not open zone map %s.\n%s\n",
+		path, strerror(errno));
+	return -1;
+    }
+    if ( !rd_all(in, &hdr, sizeof(hdr))
+	    || memcmp(hdr.magic, ZMAP_MAGIC, sizeof(hdr.magic)) != 0 ) {
+	fprintf(stderr, "%s is not a zone map.\n", path);
+	goto end;
+    }
+    if ( hdr.src_size != (uint64_t)sbuf.st_size
+	    || hdr.src_mtime != mtime_ns(&sbuf) ) {
+	status = 0;
+	goto end;
+    }
+    l = hdr.name_len + (8 - hdr.name_len % 8) % 8;
+    if ( !(nm = CALLOC(l + 1, 1))
+	    || !(u = CALLOC(2 * hdr.ndims + 1, sizeof(uint64_t)))
+	    || !(len = CALLOC(hdr.ndims + 1, sizeof(size_t)))
+	    || !(blk = CALLOC(hdr.ndims + 1, sizeof(size_t))) ) {
+	fprintf(stderr, "Could not allocate memory to read zone map %s.\n",
+		path);
+	goto end;
+    }
+    if ( !rd_all(in, nm, l) || !rd_all(in, u, 2 * hdr.ndims * sizeof(*u)) ) {
+	fprintf(stderr, "Could not read zone map %s.\n", path);
+	goto end;
+    }
+    if ( strcmp(nm, var_nm) != 0 ) {
+	status = 0;
+	goto end;
+    }
+    for (d = 0; d < (int)hdr.ndims; d++) {
+	len[d] = u[d];
+	blk[d] = u[hdr.ndims + d];
+    }
+    if ( !Zmap_Init(zm, var_nm, hdr.ndims, len, blk) ) {
+	goto end;
+    }
+    if ( zm->n_blk != hdr.n_blk
+	    || !rd_all(in, zm->blks, zm->n_blk * sizeof(struct Zmap_Blk)) ) {
+	fprintf(stderr, "Could not read blocks from zone map %s.\n", path);
+	Zmap_Free(zm);
+	goto end;
+    }
+    status = 1;
+
+end:
+    fclose(in);
+    FREE(blk);
+    FREE(len);
+    FREE(u);
+    FREE(nm);
+    return status;
+}
+
+/*
+   Copy the default zone map path for variable var_nm in source file src,
+   "src.var_nm.zmap", to buf, which has space for buf_sz characters. Return
+   1 on success, 0 if buf is too small.
+ */
+int Zmap_Path(char *buf, size_t buf_sz, const char *src, const char *var_nm)
+{
+    return snprintf(buf, buf_sz, "%s.%s.zmap", src, var_nm) < (int)buf_sz;
+}
+
+/*
+   Put the start and count of block b of zm in start and count, as for
+   nc_get_vara.
+ */
+void Zmap_Blk_Box(const struct Zmap *zm, size_t b, size_t *start,
+	size_t *count)
+{
+    int d;
+
+    for (d = zm->ndims - 1; d >= 0; d--) {
+	start[d] = (b % zm->n_blk_d[d]) * zm->blk[d];
+	count[d] = (start[d] + zm->blk[d] < zm->len[d])
+	    ? zm->blk[d] : zm->len[d] - start[d];
+	b /= zm->n_blk_d[d];
+    }
+}
+
+/*
+   Parse comparison s, one of < <= > >= == !=, into *op. Return 1 on
+   success, 0 if s is not a comparison.
+ */
+int Zmap_Op_Parse(const char *s, enum Zmap_Op *op)
+{
+    static const char *ops[] = {"<", "<=", ">", ">=", "==", "!="};
+    int n;
+
+    for (n = 0; n < (int)(sizeof(ops) / sizeof(ops[0])); n++) {
+	if ( strcmp(s, ops[n]) == 0 ) {
+	    *op = (enum Zmap_Op)n;
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+/*
+   For each block b in zm, set match[b] to 1 if the block might have a
+   valid value x for which "x op v" is true, otherwise 0. Return the number
+   of blocks that might match.
+ */
+size_t Zmap_Match(const struct Zmap *zm, enum Zmap_Op op, double v,
+	unsigned char *match)
+{
+    const struct Zmap_Blk *zb;
+    size_t b, n;
+    int m;
+
+    for (n = 0, b = 0; b < zm->n_blk; b++) {
+	zb = zm->blks + b;
+	if ( isnan(zb->min) ) {
+	    m = 0;
+	} else {
+	    switch (op) {
+		case ZMAP_LT: m = zb->min < v;				break;
+		case ZMAP_LE: m = zb->min <= v;				break;
+		case ZMAP_GT: m = zb->max > v;				break;
+		case ZMAP_GE: m = zb->max >= v;				break;
+		case ZMAP_EQ: m = zb->min <= v && v <= zb->max;		break;
+		case ZMAP_NE: m = !(zb->min == v && zb->max == v);	break;
+		default:      m = 1;					break;
+	    }
+	}
+	match[b] = m;
+	n += m;
+    }
+    return n;
+}
+
+/*
+   For each of the n values in x, clear m[i] unless x[i] is valid and
+   "x[i] op v" is true. If have_fill is true, values equal to fill are not
+   valid. NaN values are never valid. Return the number of nonzero elements
+   left in m. The loops have no branches, so compilers can vectorize them.
+ */
+size_t Zmap_Filter(enum Zmap_Op op, double v, const double *x, size_t n,
+	int have_fill, double fill, unsigned char *m)
+{
+    size_t i, k;
+
+    if ( !have_fill ) {
+	fill = NAN;			/* x[i] != fill is always true */
+    }
+    switch (op) {
+	case ZMAP_LT:
+	    for (i = 0; i < n; i++) {
+		m[i] &= (x[i] < v) & (x[i] != fill);
+	    }
+	    break;
+	case ZMAP_LE:
+	    for (i = 0; i < n; i++) {
+		m[i] &= (x[i] <= v) & (x[i] != fill);
+	    }
+	    break;
+	case ZMAP_GT:
+	    for (i = 0; i < n; i++) {
+		m[i] &= (x[i] > v) & (x[i] != fill);
+	    }
+	    break;
+	case ZMAP_GE:
+	    for (i = 0; i < n; i++) {
+		m[i] &= (x[i] >= v) & (x[i] != fill);
+	    }
+	    break;
+	case ZMAP_EQ:
+	    for (i = 0; i < n; i++) {
+		m[i] &= (x[i] == v) & (x[i] != fill);
+	    }
+	    break;
+	case ZMAP_NE:
+	    for (i = 0; i < n; i++) {
+		m[i] &= (x[i] != v) & (x[i] != fill) & (x[i] == x[i]);
+	    }
+	    break;
+    }
+    for (k = 0, i = 0; i < n; i++) {
+	k += m[i];
+    }
+    return k;
+}
+
+/*
+   Put the indeces of the nonzero elements among the n elements of m in
+   idx, which must have space for n elements. Return the number of indeces.
+ */
+size_t Zmap_Compress(const unsigned char *m, size_t n, size_t *idx)
+{
+    size_t i, k;
+
+    for (k = 0, i = 0; i < n; i++) {
+	idx[k] = i;
+	k += (m[i] != 0);
+    }
+    return k;
+}
+
+/* Free memory associated with zm */
+void Zmap_Free(struct Zmap *zm)
+{
+    FREE(zm->blks);
+    FREE(zm->n_blk_d);
+    FREE(zm->blk);
+    FREE(zm->len);
+    FREE(zm->var_nm);
+    memset(zm, 0, sizeof(struct Zmap));
+}
+
+/* Read n bytes from in into buf. Return 1 on success, 0 on failure. */
+static int rd_all(FILE *in, void *buf, size_t n)
+{
+    return n == 0 || fread(buf, 1, n, in) == n;
+}
+
+/*
+   Return the modification time in sbuf in nanoseconds, to the nanosecond
+   where the system provides it.
+ */
+static int64_t mtime_ns(const struct stat *sbuf)
+{
+#if _POSIX_VERSION >= 200809L
+    return (int64_t)sbuf->st_mtim.tv_sec * 1000000000 + sbuf->st_mtim.tv_nsec;
+#else
+    return (int64_t)sbuf->st_mtime * 1000000000;
+#endif
+}
@@ -0,0 +1,100 @@
+/*
+   -	zmap.h --
+   -		Declarations for zone maps, per block extrema of a variable
+   .
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .	
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .	
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .	
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#ifndef ZMAP_H_
+#define ZMAP_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/*
+   A zone map divides a variable into blocks, which are tiles of a fixed
+   shape in file order, as for Slab_Init_Blk, and records the extrema and
+   number of fill values for each block. Range queries read only the blocks
+   whose extrema admit a match.
+
+   A zone map file ("sidecar") has a struct Zmap_Hdr, the variable name,
+   padded with nul to a multiple of 8 bytes, ndims uint64_t dimension
+   lengths, ndims uint64_t block lengths, then n_blk struct Zmap_Blk, all in
+   native byte order. The header records the size and modification time of
+   the source file, so that a stale zone map can be detected.
+ */
+
+#define ZMAP_MAGIC "NNCZMAP2"
+
+struct Zmap_Hdr {
+    char magic[8];			/* ZMAP_MAGIC, no nul */
+    uint64_t src_size;			/* Size of source file */
+    int64_t src_mtime;			/* Modification time of source,
+					   nanoseconds */
+    uint32_t ndims;			/* Number of dimensions */
+    uint32_t name_len;			/* Length of variable name */
+    uint64_t n_blk;			/* Number of blocks */
+};
+
+struct Zmap_Blk {
+    double min, max;			/* Extrema of valid values, NaN if
+					   block has none */
+    uint64_t n_fill;			/* Number of fill or NaN values */
+};
+
+struct Zmap {
+    char *var_nm;			/* Variable name */
+    int ndims;				/* Number of dimensions */
+    size_t *len;			/* Dimension lengths */
+    size_t *blk;			/* Block lengths */
+    size_t *n_blk_d;			/* Number of blocks along each
+					   dimension */
+    size_t n_blk;			/* Number of blocks */
+    struct Zmap_Blk *blks;		/* Block summaries in file order */
+};
+
+/* Comparisons for queries */
+enum Zmap_Op {ZMAP_LT, ZMAP_LE, ZMAP_GT, ZMAP_GE, ZMAP_EQ, ZMAP_NE};
+
+int Zmap_Init(struct Zmap *, const char *, int, const size_t *,
+	const size_t *);
+void Zmap_Scan(struct Zmap_Blk *, const double *, size_t, int, double);
+int Zmap_Write(const struct Zmap *, const char *, const char *);
+int Zmap_Read(struct Zmap *, const char *, const char *, const char *);
+int Zmap_Path(char *, size_t, const char *, const char *);
+void Zmap_Blk_Box(const struct Zmap *, size_t, size_t *, size_t *);
+int Zmap_Op_Parse(const char *, enum Zmap_Op *);
+size_t Zmap_Match(const struct Zmap *, enum Zmap_Op, double, unsigned char *);
+size_t Zmap_Filter(enum Zmap_Op, double, const double *, size_t, int, double,
+	unsigned char *);
+size_t Zmap_Compress(const unsigned char *, size_t, size_t *);
+void Zmap_Free(struct Zmap *);
+
+#endif